@@ -2,6 +2,9 @@
 using System;
 using System.Text;
 using System.Runtime.InteropServices;
+using System.Threading.Tasks;
+using Unity.Collections;
+using Unity.Collections.LowLevel.Unsafe;
 
 #pragma warning disable 114, 465
 
@@ -13,6 +16,75 @@ public enum Message
     None = -1,
     Reinitialized = 0,
     TextureSizeChanged = 1,
+    SnapshotCompleted = 2,
+    SnapshotFailed = 3,
+}
+
+public enum DesktopEventType
+{
+    None = 0,
+    Message = 1,
+    FrameReady = 2,
+    CursorMoved = 3,
+    CursorShapeChanged = 4,
+    StateChanged = 5,
+    TopologyChanged = 6,
+    Overflow = 7,
+    WatchRegionChanged = 8,
+}
+
+// FrameReady: seq is the frame id and x / y / width / height are the bounds of the damaged area.
+// CursorMoved: value is the visibility and x / y is the position.
+// CursorShapeChanged: value is the CursorShapeType and width / height is the shape size.
+// StateChanged: value is the DuplicatorState. TopologyChanged: value is the monitor count.
+// Overflow: value is the number of dropped events.
+// WatchRegionChanged: value is the region id, seq is the frame id and x / y / width / height are
+// the bounds of the changed part of the region.
+// The layout must match Event in Event.h.
+[StructLayout(LayoutKind.Sequential)]
+public struct DesktopEvent
+{
+    public DesktopEventType type;
+    public int id;
+    public uint seq;
+    public int value;
+    public int x;
+    public int y;
+    public int width;
+    public int height;
+    public uint moveRectCount;
+    public uint dirtyRectCount;
+}
+
+// The layouts of MonitorInfo and FrameInfo must match the ones in Monitor.h.
+[StructLayout(LayoutKind.Sequential)]
+public struct MonitorInfo
+{
+    public int id;
+    public DuplicatorState state;
+    public int left;
+    public int top;
+    public int right;
+    public int bottom;
+    public int width;
+    public int height;
+    public MonitorRotation rotation;
+    public int dpiX;
+    public int dpiY;
+    public int isPrimary;
+    public int isHDR;
+}
+
+[StructLayout(LayoutKind.Sequential)]
+public struct FrameInfo
+{
+    public long presentTime;
+    public uint id;
+    public uint renderedId;
+    public uint accumulatedFrames;
+    public int moveRectCount;
+    public int dirtyRectCount;
+    public int hasBeenUpdated;
 }
 
 public enum CursorShapeType
@@ -47,6 +119,171 @@ public enum DuplicatorState
     Unknown = 999,
 }
 
+public enum ReplaySpeed
+{
+    Recorded = 0,
+    Maximum = 1,
+}
+
+public enum ReplayExportFormat
+{
+    Session = 0,
+    QoiSequence = 1,
+}
+
+public enum ReplayExportState
+{
+    None = 0,
+    Exporting = 1,
+    Completed = 2,
+    Failed = 3,
+}
+
+public enum SnapshotState
+{
+    None = 0,
+    Capturing = 1,
+    Encoding = 2,
+    Completed = 3,
+    Failed = 4,
+}
+
+public enum LatencyStage
+{
+    PresentToAcquire = 0,
+    AcquireToCopy = 1,
+    CopyToPublish = 2,
+    PublishToRender = 3,
+    RenderToReadback = 4,
+    PresentToRender = 5,
+    ProbeToReadback = 6,
+    FrameAge = 7,
+}
+
+// Durations are in microseconds.
+[StructLayout(LayoutKind.Sequential)]
+public struct LatencyStats
+{
+    public uint count;
+    public float mean;
+    public float p50;
+    public float p90;
+    public float p99;
+    public float max;
+}
+
+// Bytes held by the plugin. Evictions are the releases done by the memory budget and the idle check.
+[StructLayout(LayoutKind.Sequential)]
+public struct MemoryStats
+{
+    public long sharedTextureBytes;
+    public long readbackTextureBytes;
+    public long readbackBufferBytes;
+    public long metadataBytes;
+    public long cursorBytes;
+    public long regionStatsBytes;
+    public long cursorRegionBytes;
+    public long replayRingBytes;
+    public long totalBytes;
+    public long evictionCount;
+    public long evictedBytes;
+}
+
+// Render cadence tracked for the phase locked capture (see Monitor.phaseLockEnabled).
+[StructLayout(LayoutKind.Sequential)]
+public struct PhaseLockInfo
+{
+    public int isEnabled;
+    public int isLocked;
+    public float renderPeriodMs;
+    public float renderJitterMs;
+    public float captureLeadMs;
+    public float frameAgeMs;
+}
+
+// Mean color (0 - 255) of an edge zone or a region (see Monitor.GetRegionStats()).
+[StructLayout(LayoutKind.Sequential)]
+public struct RegionMean
+{
+    public float r;
+    public float g;
+    public float b;
+    public float luma;
+
+    public Color32 color
+    {
+        get { return new Color32((byte)r, (byte)g, (byte)b, 255); }
+    }
+}
+
+// Top-left corner of a template found by Monitor.FindTemplate() in monitor coordinates.
+[StructLayout(LayoutKind.Sequential)]
+public struct TemplateMatch
+{
+    public int x;
+    public int y;
+    public float score;
+}
+
+[StructLayout(LayoutKind.Sequential)]
+public struct RegionStatsInfo
+{
+    public uint frameId;
+    public int width;
+    public int height;
+    public int cellSize;
+    public int edgeZoneCount;
+    public int regionCount;
+    public float meanLuma;
+    public float updateMs;
+}
+
+// Where the pixels of Monitor.GetCursorRegion() were copied from, in captured area coordinates.
+[StructLayout(LayoutKind.Sequential)]
+public struct CursorRegionInfo
+{
+    public ulong sequence;
+    public uint frameId;
+    public int isCursorVisible;
+    public int x;
+    public int y;
+    public int width;
+    public int height;
+    public int cursorX;
+    public int cursorY;
+}
+
+[StructLayout(LayoutKind.Sequential)]
+public struct ReplayRingInfo
+{
+    public long bytes;
+    public long maxBytes;
+    public int frameCount;
+    public int keyFrameCount;
+    public float durationSec;
+    public float addMs;
+}
+
+public enum QosPriority
+{
+    Low = 0,
+    Normal = 1,
+    High = 2,
+}
+
+// Frame rate of a monitor as chosen by the QoS scheduler and as measured on the capture thread.
+[StructLayout(LayoutKind.Sequential)]
+public struct QosInfo
+{
+    public int targetFrameRate;
+    public QosPriority priority;
+    public int effectiveFrameRate;
+    public QosPriority effectivePriority;
+    public float measuredFrameRate;
+    public float frameCostMs;
+    public long pixelsPerSecond;
+}
+
 public enum DebugMode
 {
     None = 0,
@@ -54,6 +291,13 @@ public enum DebugMode
     UnityLog = 2, /* currently has bug when app exits. */
 }
 
+public enum DebugLevel
+{
+    Verbose = 0,
+    Log = 1,
+    Error = 2,
+}
+
 [StructLayout(LayoutKind.Sequential)]
 public struct RECT
 {
@@ -93,6 +337,9 @@ public static class Lib
     [DllImport(dllName)]
     public static extern void Update();
     [DllImport(dllName)]
+    public static extern int DrainEvents([Out] DesktopEvent[] buffer, int capacity);
+    // Only for plugins built before DrainEvents() (see Manager.UpdateEvents()).
+    [DllImport(dllName)]
     public static extern Message PopMessage();
     [DllImport(dllName)]
     public static extern void EnableDebug();
@@ -101,6 +348,8 @@ public static class Lib
     [DllImport(dllName)]
     public static extern void SetDebugMode(DebugMode mode);
     [DllImport(dllName)]
+    public static extern void SetDebugLevel(DebugLevel level);
+    [DllImport(dllName)]
     public static extern void SetLogFunc(DebugLogDelegate func);
     [DllImport(dllName)]
     public static extern void SetErrorFunc(DebugLogDelegate func);
@@ -119,6 +368,10 @@ public static class Lib
     [DllImport(dllName)]
     public static extern int GetId(int id);
     [DllImport(dllName)]
+    public static extern int GetMonitorInfos([Out] MonitorInfo[] infos, int capacity);
+    [DllImport(dllName)]
+    public static extern bool GetFrameInfo(int id, out FrameInfo info);
+    [DllImport(dllName)]
     public static extern DuplicatorState GetState(int id);
     [DllImport(dllName)]
     public static extern void GetName(int id, StringBuilder buf, int len);
@@ -165,27 +418,199 @@ public static class Lib
     [DllImport(dllName)]
     public static extern int GetCursorHotSpotY();
     [DllImport(dllName)]
+    public static extern uint GetCursorSequence();
+    [DllImport(dllName)]
     public static extern int SetTexturePtr(int id, IntPtr ptr);
     [DllImport(dllName)]
     public static extern IntPtr GetSharedTextureHandle(int id);
     [DllImport(dllName)]
     public static extern int GetMoveRectCount(int id);
-    [DllImport(dllName, EntryPoint = "GetMoveRects")]
-    private static extern IntPtr GetMoveRects_Internal(int id);
     [DllImport(dllName)]
     public static extern int GetDirtyRectCount(int id);
+    // Copy functions return the total number of rects, which can be larger than capacity.
+    [DllImport(dllName)]
+    public static extern int CopyMoveRects(int id, [Out] DXGI_OUTDUPL_MOVE_RECT[] output, int capacity, out ulong frameSeq);
+    [DllImport(dllName, EntryPoint = "CopyMoveRects")]
+    public static extern int CopyMoveRects(int id, IntPtr output, int capacity, out ulong frameSeq);
+    [DllImport(dllName)]
+    public static extern int CopyDirtyRects(int id, [Out] RECT[] output, int capacity, out ulong frameSeq);
+    [DllImport(dllName, EntryPoint = "CopyDirtyRects")]
+    public static extern int CopyDirtyRects(int id, IntPtr output, int capacity, out ulong frameSeq);
+    // Only for plugins built before the copy functions (see GetMoveRects()).
+    [DllImport(dllName, EntryPoint = "GetMoveRects")]
+    private static extern IntPtr GetMoveRects_Internal(int id);
     [DllImport(dllName, EntryPoint = "GetDirtyRects")]
     private static extern IntPtr GetDirtyRects_Internal(int id);
+    // Writes width * height RGBA32 pixels to ptr. It can be called from worker threads.
     [DllImport(dllName, EntryPoint = "GetPixels")]
-    private static extern bool GetPixels_Internal(int id, IntPtr ptr, int x, int y, int width, int height);
+    public static extern bool GetPixels(int id, IntPtr ptr, int x, int y, int width, int height);
     [DllImport(dllName)]
     public static extern IntPtr GetBuffer(int id);
+    // Returns the whole size of the buffer, which can be larger than size.
+    [DllImport(dllName)]
+    public static extern int CopyBuffer(int id, [Out] byte[] output, int size);
+    [DllImport(dllName, EntryPoint = "CopyBuffer")]
+    public static extern int CopyBuffer(int id, IntPtr output, int size);
     [DllImport(dllName)]
     public static extern bool HasBeenUpdated(int id);
     [DllImport(dllName)]
     public static extern bool UseGetPixels(int id, bool use);
     [DllImport(dllName)]
+    public static extern int FindTemplate(int id, Color32[] pixels, int width, int height, ref RECT searchRect, float threshold, ref uint frameId, [Out] TemplateMatch[] results, int capacity);
+    [DllImport(dllName)]
+    public static extern bool SetCropRect(int id, int x, int y, int width, int height);
+    [DllImport(dllName)]
+    public static extern void ClearCropRect(int id);
+    [DllImport(dllName)]
+    public static extern bool GetCropRect(int id, out RECT rect);
+    [DllImport(dllName)]
+    public static extern bool RegisterWatchRegion(int id, int regionId, int x, int y, int width, int height);
+    [DllImport(dllName)]
+    public static extern bool UnregisterWatchRegion(int id, int regionId);
+    [DllImport(dllName)]
+    public static extern void ClearWatchRegions(int id);
+    [DllImport(dllName)]
+    public static extern int GetWatchRegionCount(int id);
+    [DllImport(dllName)]
     public static extern void SetFrameRate(uint frameRate);
+    [DllImport(dllName)]
+    public static extern void SetTargetFrameRate(int id, uint frameRate);
+    [DllImport(dllName)]
+    public static extern uint GetTargetFrameRate(int id);
+    [DllImport(dllName)]
+    public static extern void SetQosPriority(int id, QosPriority priority);
+    [DllImport(dllName)]
+    public static extern QosPriority GetQosPriority(int id);
+    [DllImport(dllName)]
+    public static extern bool GetQosInfo(int id, out QosInfo info);
+    [DllImport(dllName)]
+    public static extern void SetQosPixelBudget(long pixelsPerSecond);
+    [DllImport(dllName)]
+    public static extern long GetQosPixelBudget();
+    [DllImport(dllName)]
+    public static extern void SetQosCpuBudget(float msPerSecond);
+    [DllImport(dllName)]
+    public static extern float GetQosCpuBudget();
+    [DllImport(dllName)]
+    public static extern bool TakeSnapshot(string path);
+    [DllImport(dllName)]
+    public static extern SnapshotState GetSnapshotState();
+    [DllImport(dllName)]
+    public static extern int GetSnapshotDataSize();
+    [DllImport(dllName)]
+    public static extern bool GetSnapshotData(byte[] buffer, int size);
+    [DllImport(dllName)]
+    public static extern void EnableCompositeBuffer();
+    [DllImport(dllName)]
+    public static extern void DisableCompositeBuffer();
+    [DllImport(dllName)]
+    public static extern bool IsCompositeBufferEnabled();
+    [DllImport(dllName)]
+    public static extern int GetCompositeBufferLeft();
+    [DllImport(dllName)]
+    public static extern int GetCompositeBufferTop();
+    [DllImport(dllName)]
+    public static extern int GetCompositeBufferWidth();
+    [DllImport(dllName)]
+    public static extern int GetCompositeBufferHeight();
+    [DllImport(dllName)]
+    public static extern ulong GetCompositeBufferUpdateCount();
+    [DllImport(dllName)]
+    public static extern IntPtr LockCompositeBuffer(out int pitch);
+    [DllImport(dllName)]
+    public static extern void UnlockCompositeBuffer();
+    [DllImport(dllName)]
+    public static extern void EnableTrace();
+    [DllImport(dllName)]
+    public static extern void DisableTrace();
+    [DllImport(dllName)]
+    public static extern bool IsTraceEnabled();
+    [DllImport(dllName)]
+    public static extern bool DumpTrace(string path);
+    [DllImport(dllName)]
+    public static extern bool StartRecording(int id, string path);
+    [DllImport(dllName)]
+    public static extern void StopRecording(int id);
+    [DllImport(dllName)]
+    public static extern bool IsRecording(int id);
+    [DllImport(dllName)]
+    public static extern bool StartReplay(int id, string path, ReplaySpeed speed, bool loop);
+    [DllImport(dllName)]
+    public static extern void StopReplay(int id);
+    [DllImport(dllName)]
+    public static extern bool IsReplaying(int id);
+    [DllImport(dllName)]
+    public static extern bool EnableReplayRing(int id, long maxBytes, float durationSec, float keyFrameIntervalSec);
+    [DllImport(dllName)]
+    public static extern void DisableReplayRing(int id);
+    [DllImport(dllName)]
+    public static extern bool IsReplayRingEnabled(int id);
+    [DllImport(dllName)]
+    public static extern bool ExportReplayRing(int id, string path, ReplayExportFormat format);
+    [DllImport(dllName)]
+    public static extern ReplayExportState GetReplayExportState(int id);
+    [DllImport(dllName)]
+    public static extern bool GetReplayRingInfo(int id, out ReplayRingInfo info);
+    [DllImport(dllName)]
+    public static extern bool EnableSharedMemoryExport(int id, int slotCount);
+    [DllImport(dllName)]
+    public static extern void DisableSharedMemoryExport(int id);
+    [DllImport(dllName)]
+    public static extern bool IsSharedMemoryExportEnabled(int id);
+    [DllImport(dllName)]
+    public static extern bool StartStreaming(int id, int port);
+    [DllImport(dllName)]
+    public static extern void StopStreaming(int id);
+    [DllImport(dllName)]
+    public static extern bool IsStreaming(int id);
+    [DllImport(dllName)]
+    public static extern int GetStreamingClientCount(int id);
+    [DllImport(dllName)]
+    public static extern bool EnableRegionStats(int id, int cellSize);
+    [DllImport(dllName)]
+    public static extern void DisableRegionStats(int id);
+    [DllImport(dllName)]
+    public static extern bool IsRegionStatsEnabled(int id);
+    [DllImport(dllName)]
+    public static extern bool SetRegionStatsEdgeZones(int id, int horizontalCount, int verticalCount, int depth);
+    [DllImport(dllName)]
+    public static extern void SetRegionStatsRects(int id, RECT[] rects, int count);
+    [DllImport(dllName)]
+    public static extern int GetRegionStats(int id, out RegionStatsInfo info, [Out] RegionMean[] means, int capacity, [Out] uint[] histogram);
+    [DllImport(dllName)]
+    public static extern bool EnableCursorRegion(int id, int width, int height);
+    [DllImport(dllName)]
+    public static extern void DisableCursorRegion(int id);
+    [DllImport(dllName)]
+    public static extern bool IsCursorRegionEnabled(int id);
+    [DllImport(dllName)]
+    public static extern bool GetCursorRegion(int id, out CursorRegionInfo info, [Out] Color32[] pixels, int capacity);
+    [DllImport(dllName)]
+    public static extern bool GetLatencyStats(int id, LatencyStage stage, out LatencyStats stats);
+    [DllImport(dllName)]
+    public static extern void ResetLatencyStats(int id);
+    [DllImport(dllName)]
+    public static extern void SetLatencyProbeEnabled(int id, bool enabled);
+    [DllImport(dllName)]
+    public static extern bool IsLatencyProbeEnabled(int id);
+    [DllImport(dllName)]
+    public static extern void SetPhaseLockEnabled(int id, bool enabled);
+    [DllImport(dllName)]
+    public static extern bool IsPhaseLockEnabled(int id);
+    [DllImport(dllName)]
+    public static extern bool GetPhaseLockInfo(int id, out PhaseLockInfo info);
+    [DllImport(dllName)]
+    public static extern bool GetMemoryStats(int id, out MemoryStats stats);
+    [DllImport(dllName)]
+    public static extern void SetMemoryBudget(long bytes);
+    [DllImport(dllName)]
+    public static extern long GetMemoryBudget();
+    [DllImport(dllName)]
+    public static extern void SetReadbackIdleFrameCount(int count);
+    [DllImport(dllName)]
+    public static extern int GetReadbackIdleFrameCount();
+    [DllImport(dllName)]
+    public static extern long ReleaseReadback(int id);
 
     public static string GetName(int id)
     {
@@ -194,8 +619,19 @@ public static class Lib
         return buf.ToString();
     }
 
+    // Set when the plugin is older than these scripts and does not export CopyMoveRects() / CopyDirtyRects().
+    static bool isCopyRectsMissing_ = false;
+
     public static DXGI_OUTDUPL_MOVE_RECT[] GetMoveRects(int id)
     {
+        if (!isCopyRectsMissing_) {
+            try {
+                return CopyMoveRects(id);
+            } catch (EntryPointNotFoundException) {
+                isCopyRectsMissing_ = true;
+            }
+        }
+
         var count = GetMoveRectCount(id);
         var rects = new DXGI_OUTDUPL_MOVE_RECT[count];
         var ptr = GetMoveRects_Internal(id);
@@ -209,6 +645,14 @@ public static class Lib
 
     public static RECT[] GetDirtyRects(int id)
     {
+        if (!isCopyRectsMissing_) {
+            try {
+                return CopyDirtyRects(id);
+            } catch (EntryPointNotFoundException) {
+                isCopyRectsMissing_ = true;
+            }
+        }
+
         var count = GetDirtyRectCount(id);
         var rects = new RECT[count];
         var ptr = GetDirtyRects_Internal(id);
@@ -220,6 +664,58 @@ public static class Lib
         return rects;
     }
 
+    static DXGI_OUTDUPL_MOVE_RECT[] CopyMoveRects(int id)
+    {
+        ulong frameSeq;
+        var rects = new DXGI_OUTDUPL_MOVE_RECT[CopyMoveRects(id, IntPtr.Zero, 0, out frameSeq)];
+        var count = CopyMoveRects(id, rects, rects.Length, out frameSeq);
+        // The frame can be updated between the calls.
+        if (count != rects.Length) {
+            Array.Resize(ref rects, count);
+            CopyMoveRects(id, rects, rects.Length, out frameSeq);
+        }
+        return rects;
+    }
+
+    static RECT[] CopyDirtyRects(int id)
+    {
+        ulong frameSeq;
+        var rects = new RECT[CopyDirtyRects(id, IntPtr.Zero, 0, out frameSeq)];
+        var count = CopyDirtyRects(id, rects, rects.Length, out frameSeq);
+        if (count != rects.Length) {
+            Array.Resize(ref rects, count);
+            CopyDirtyRects(id, rects, rects.Length, out frameSeq);
+        }
+        return rects;
+    }
+
+    public static unsafe int CopyMoveRects(int id, NativeArray<DXGI_OUTDUPL_MOVE_RECT> output, out ulong frameSeq)
+    {
+        var ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(output);
+        return CopyMoveRects(id, ptr, output.Length, out frameSeq);
+    }
+
+    public static unsafe int CopyDirtyRects(int id, NativeArray<RECT> output, out ulong frameSeq)
+    {
+        var ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(output);
+        return CopyDirtyRects(id, ptr, output.Length, out frameSeq);
+    }
+
+    public static unsafe int CopyBuffer(int id, NativeArray<byte> output)
+    {
+        var ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(output);
+        return CopyBuffer(id, ptr, output.Length);
+    }
+
+    public static byte[] GetSnapshotData()
+    {
+        var size = GetSnapshotDataSize();
+        if (size <= 0) return null;
+        var data = new byte[size];
+        if (!GetSnapshotData(data, size)) return null;
+        return data;
+    }
+
     public static Color32[] GetPixels(int id, int x, int y, int width, int height)
     {
         var color = new Color32[width * height];       
@@ -233,19 +729,48 @@ public static class Lib
             Debug.LogErrorFormat("colors is small.", id, x, y, width, height);
             return false;
         }
-		var handle = GCHandle.Alloc(colors, GCHandleType.Pinned);
-		var ptr = handle.AddrOfPinnedObject();
-        if (!GetPixels_Internal(id, ptr, x, y, width, height)) {
-            Debug.LogErrorFormat("GetPixels({0}, {1}, {2}, {3}, {4}) failed.", id, x, y, width, height);
+        unsafe {
+            fixed (Color32* ptr = colors) {
+                return GetPixelsChecked(id, (IntPtr)ptr, x, y, width, height);
+            }
+        }
+    }
+
+    public static unsafe bool GetPixels(int id, NativeArray<Color32> colors, int x, int y, int width, int height)
+    {
+        if (colors.Length < width * height) {
+            Debug.LogErrorFormat("colors is small.", id, x, y, width, height);
             return false;
         }
-        handle.Free();
-        return true;
+        var ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(colors);
+        return GetPixelsChecked(id, ptr, x, y, width, height);
     }
 
-    public static Color32 GetPixel(int id, int x, int y)
+    // Reads the pixels on a worker thread. colors must not be disposed until the task completes.
+    public static unsafe Task<bool> GetPixelsAsync(int id, NativeArray<Color32> colors, int x, int y, int width, int height)
     {
-        return GetPixels(id, x, y, 1, 1)[0];
+        if (colors.Length < width * height) {
+            Debug.LogErrorFormat("colors is small.", id, x, y, width, height);
+            return Task.FromResult(false);
+        }
+        var ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(colors);
+        return Task.Run(() => GetPixels(id, ptr, x, y, width, height));
+    }
+
+    public static unsafe Color32 GetPixel(int id, int x, int y)
+    {
+        var color = new Color32();
+        GetPixelsChecked(id, (IntPtr)(&color), x, y, 1, 1);
+        return color;
+    }
+
+    static bool GetPixelsChecked(int id, IntPtr ptr, int x, int y, int width, int height)
+    {
+        if (!GetPixels(id, ptr, x, y, width, height)) {
+            Debug.LogErrorFormat("GetPixels({0}, {1}, {2}, {3}, {4}) failed.", id, x, y, width, height);
+            return false;
+        }
+        return true;
     }
 }
 
@@ -34,14 +34,34 @@ public class Manager : MonoBehaviour
         get { return instance.monitors_; }
     }
 
+    // Monitor properties are served from these snapshots, which are fetched with one call per frame.
+    static MonitorInfo[] monitorInfos_ = new MonitorInfo[0];
+    static int monitorCount_ = 0;
+
     static public int monitorCount
     {
-        get { return Lib.GetMonitorCount(); }
+        get { return monitorCount_; }
     }
 
+    // Cursor states are updated by events instead of being fetched for each access.
+    static int cursorMonitorId_ = -1;
     static public int cursorMonitorId 
     {
-        get { return Lib.GetCursorMonitorId(); }
+        get { return cursorMonitorId_; }
+    }
+
+    static public bool isCursorVisible { get; private set; }
+    static public int cursorX { get; private set; }
+    static public int cursorY { get; private set; }
+    static public int cursorShapeWidth { get; private set; }
+    static public int cursorShapeHeight { get; private set; }
+    static public CursorShapeType cursorShapeType { get; private set; }
+
+    // Incremented whenever the cursor image is updated, including pointer-only updates which
+    // do not produce new desktop frames.
+    static public uint cursorSequence
+    {
+        get { return Lib.GetCursorSequence(); }
     }
 
     static public Monitor primary
@@ -55,12 +75,17 @@ public class Manager : MonoBehaviour
     [Tooltip("Debug mode is not applied while running.")]
     [SerializeField] DebugMode debugMode = DebugMode.File;
 
+    [Tooltip("Verbose outputs the function scope timers of debug builds.")]
+    [SerializeField] DebugLevel debugLevel = DebugLevel.Log;
+
     [SerializeField] float retryReinitializationDuration = 1f;
 
     private Coroutine renderCoroutine_ = null;
     private bool shouldReinitialize_ = false;
     private float reinitializationTimer_ = 0f;
     private bool isFirstFrame_ = true;
+    private bool hasTopologyChanged_ = false;
+    private int monitorInfoFrameCount_ = -1;
 
     public static event Lib.DebugLogDelegate onDebugLog = OnDebugLog;
     public static event Lib.DebugLogDelegate onDebugErr = OnDebugErr;
@@ -73,6 +98,73 @@ public class Manager : MonoBehaviour
     public delegate void ReinitializeHandler();
     public static event ReinitializeHandler onReinitialized;
 
+    public delegate void SnapshotHandler(bool succeeded);
+    public static event SnapshotHandler onSnapshotFinished;
+
+    public delegate void DesktopEventHandler(DesktopEvent e);
+    public static event DesktopEventHandler onEvent;
+
+    public delegate void WatchRegionHandler(Monitor monitor, int regionId, RectInt changedRect);
+    public static event WatchRegionHandler onWatchRegionChanged;
+
+    private DesktopEvent[] events_ = new DesktopEvent[256];
+
+    public static MonitorInfo GetMonitorInfo(int id)
+    {
+        if (id < 0 || id >= monitorCount_) {
+            var info = new MonitorInfo();
+            info.id = id;
+            info.state = DuplicatorState.NotSet;
+            return info;
+        }
+        return monitorInfos_[id];
+    }
+
+    // Set when the plugin is older than these scripts and lacks GetMonitorInfos() / DrainEvents().
+    // Then the states are polled for each property and messages with PopMessage() as before.
+    static bool isMonitorInfosMissing_ = false;
+    static bool isEventQueueMissing_ = false;
+
+    static void UpdateMonitorInfos()
+    {
+        if (!isMonitorInfosMissing_) {
+            try {
+                var count = Lib.GetMonitorInfos(monitorInfos_, monitorInfos_.Length);
+                if (count > monitorInfos_.Length) {
+                    monitorInfos_ = new MonitorInfo[count];
+                    count = Lib.GetMonitorInfos(monitorInfos_, monitorInfos_.Length);
+                }
+                monitorCount_ = count;
+                return;
+            } catch (System.EntryPointNotFoundException) {
+                isMonitorInfosMissing_ = true;
+            }
+        }
+
+        var monitorCount = Lib.GetMonitorCount();
+        if (monitorCount > monitorInfos_.Length) {
+            monitorInfos_ = new MonitorInfo[monitorCount];
+        }
+        for (int i = 0; i < monitorCount; ++i) {
+            var info = new MonitorInfo();
+            info.id = i;
+            info.state = Lib.GetState(i);
+            info.left = Lib.GetLeft(i);
+            info.top = Lib.GetTop(i);
+            info.right = Lib.GetRight(i);
+            info.bottom = Lib.GetBottom(i);
+            info.width = Lib.GetWidth(i);
+            info.height = Lib.GetHeight(i);
+            info.rotation = Lib.GetRotation(i);
+            info.dpiX = Lib.GetDpiX(i);
+            info.dpiY = Lib.GetDpiY(i);
+            info.isPrimary = Lib.IsPrimary(i) ? 1 : 0;
+            info.isHDR = Lib.IsHDR(i) ? 1 : 0;
+            monitorInfos_[i] = info;
+        }
+        monitorCount_ = monitorCount;
+    }
+
     public static Monitor GetMonitor(int id)
     {
         if (id < 0 || id >= Manager.monitors.Count) {
@@ -98,6 +190,7 @@ public class Manager : MonoBehaviour
         instance_ = this;
 
         Lib.SetDebugMode(debugMode);
+        SetDebugLevel();
         Lib.SetLogFunc(onDebugLog);
         Lib.SetErrorFunc(onDebugErr);
 
@@ -116,6 +209,7 @@ public class Manager : MonoBehaviour
     {
         Lib.Finalize();
         DestroyMonitors();
+        PixelBufferPool.Clear();
     }
 
     void OnEnable()
@@ -126,9 +220,18 @@ public class Manager : MonoBehaviour
         }
 
         Lib.SetDebugMode(debugMode);
+        SetDebugLevel();
         Lib.SetLogFunc(onDebugLog);
     }
 
+    // The default level is not sent, so that plugins built before SetDebugLevel() can be used.
+    void SetDebugLevel()
+    {
+        if (debugLevel != DebugLevel.Log) {
+            Lib.SetDebugLevel(debugLevel);
+        }
+    }
+
     void OnDisable()
     {
         if (renderCoroutine_ != null) {
@@ -143,11 +246,138 @@ public class Manager : MonoBehaviour
     void Update()
     {
         Lib.Update();
+        if (monitorInfoFrameCount_ != Time.frameCount) {
+            UpdateMonitorInfos();
+            monitorInfoFrameCount_ = Time.frameCount;
+        }
+        UpdateEvents();
         ReinitializeIfNeeded();
-        UpdateMessage();
         isFirstFrame_ = false;
     }
 
+    // Captures all monitors into one QOI image in the virtual desktop layout without blocking
+    // the main thread. The image is written to the path if given, otherwise it can be fetched
+    // with GetSnapshotData() after onSnapshotFinished is invoked.
+    public static bool TakeSnapshot(string path = null)
+    {
+        return Lib.TakeSnapshot(path);
+    }
+
+    public static SnapshotState snapshotState
+    {
+        get { return Lib.GetSnapshotState(); }
+    }
+
+    public static byte[] GetSnapshotData()
+    {
+        return Lib.GetSnapshotData();
+    }
+
+    // An image of the whole virtual desktop (BGRA32) which capture threads keep up to date
+    // by copying only the changed regions of each monitor.
+    public static bool compositeBufferEnabled
+    {
+        get { return Lib.IsCompositeBufferEnabled(); }
+        set
+        {
+            if (value) {
+                Lib.EnableCompositeBuffer();
+            } else {
+                Lib.DisableCompositeBuffer();
+            }
+        }
+    }
+
+    public static RectInt compositeBufferRect
+    {
+        get
+        {
+            return new RectInt(
+                Lib.GetCompositeBufferLeft(),
+                Lib.GetCompositeBufferTop(),
+                Lib.GetCompositeBufferWidth(),
+                Lib.GetCompositeBufferHeight());
+        }
+    }
+
+    public static ulong compositeBufferUpdateCount
+    {
+        get { return Lib.GetCompositeBufferUpdateCount(); }
+    }
+
+    // Capture threads skip writing while the buffer is locked, so call UnlockCompositeBuffer() soon.
+    public static System.IntPtr LockCompositeBuffer(out int pitch)
+    {
+        return Lib.LockCompositeBuffer(out pitch);
+    }
+
+    public static void UnlockCompositeBuffer()
+    {
+        Lib.UnlockCompositeBuffer();
+    }
+
+    // Records timelines of the capture, render and readback threads with little overhead
+    // (also in release builds). DumpTrace() writes a Chrome / Perfetto trace JSON file.
+    public static bool traceEnabled
+    {
+        get { return Lib.IsTraceEnabled(); }
+        set
+        {
+            if (value) {
+                Lib.EnableTrace();
+            } else {
+                Lib.DisableTrace();
+            }
+        }
+    }
+
+    public static bool DumpTrace(string path)
+    {
+        return Lib.DumpTrace(path);
+    }
+
+    // Bytes of all monitors and the cursor.
+    public static MemoryStats memoryStats
+    {
+        get
+        {
+            MemoryStats stats;
+            Lib.GetMemoryStats(-1, out stats);
+            return stats;
+        }
+    }
+
+    // While the total is over the budget, readback resources are released in least recently used
+    // order (0 means no limit). Shared textures are never released since the capture needs them.
+    public static long memoryBudget
+    {
+        get { return Lib.GetMemoryBudget(); }
+        set { Lib.SetMemoryBudget(value); }
+    }
+
+    // Readback resources not used for this many frames are released (0, the default, keeps them).
+    // The CPU copy of monitors with useGetPixels is kept regardless.
+    public static int readbackIdleFrameCount
+    {
+        get { return Lib.GetReadbackIdleFrameCount(); }
+        set { Lib.SetReadbackIdleFrameCount(value); }
+    }
+
+    // Total capture pixels per second of all monitors (0 means no limit). While it is exceeded,
+    // the frame rates of low priority monitors are lowered first (see Monitor.qosPriority).
+    public static long qosPixelBudget
+    {
+        get { return Lib.GetQosPixelBudget(); }
+        set { Lib.SetQosPixelBudget(value); }
+    }
+
+    // Same as qosPixelBudget for the CPU milliseconds per second the capture threads spend on frames.
+    public static float qosCpuBudget
+    {
+        get { return Lib.GetQosCpuBudget(); }
+        set { Lib.SetQosCpuBudget(value); }
+    }
+
     [ContextMenu("Reinitialize")]
     public void Reinitialize()
     {
@@ -163,6 +393,7 @@ public class Manager : MonoBehaviour
     {
         bool reinitializeNeeded = false;
 
+        // Monitor states are kept up to date by StateChanged events.
         for (int i = 0; i < monitors.Count; ++i) {
             var monitor = monitors[i];
             var state = monitor.state;
@@ -178,8 +409,9 @@ public class Manager : MonoBehaviour
             }
         }
 
-        if (Lib.HasMonitorCountChanged()) {
+        if (hasTopologyChanged_) {
             reinitializeNeeded = true;
+            hasTopologyChanged_ = false;
         }
 
         if (!shouldReinitialize_ && reinitializeNeeded) {
@@ -196,25 +428,141 @@ public class Manager : MonoBehaviour
         }
     }
 
+    void UpdateEvents()
+    {
+        if (isEventQueueMissing_) {
+            UpdateMessage();
+            return;
+        }
+
+        // All the events are fetched with a few calls instead of polling each property.
+        int count;
+        try {
+            count = Lib.DrainEvents(events_, events_.Length);
+        } catch (System.EntryPointNotFoundException) {
+            Debug.LogWarning("[uDD] The plugin does not have DrainEvents(), so its states are polled instead.");
+            isEventQueueMissing_ = true;
+            UpdateMessage();
+            return;
+        }
+
+        for (;;) {
+            for (int i = 0; i < count; ++i) {
+                OnEvent(events_[i]);
+            }
+            if (count < events_.Length) break;
+            count = Lib.DrainEvents(events_, events_.Length);
+        }
+    }
+
+    // Polling path for plugins built before DrainEvents(). Monitor states are already polled by
+    // UpdateMonitorInfos() in this case.
     void UpdateMessage()
     {
+        SyncCursorStates();
+
+        if (Lib.HasMonitorCountChanged()) {
+            hasTopologyChanged_ = true;
+        }
+
         var message = Lib.PopMessage();
         while (message != Message.None) {
-            Debug.Log("[uDD] " + message);
-            switch (message) {
-                case Message.Reinitialized:
-                    ReinitializeMonitors();
-                    break;
-                case Message.TextureSizeChanged:
-                    RecreateTextures();
-                    break;
-                default:
-                    break;
-            }
+            OnMessage(message);
             message = Lib.PopMessage();
         }
     }
 
+    void OnEvent(DesktopEvent e)
+    {
+        switch (e.type) {
+            case DesktopEventType.Message:
+                OnMessage((Message)e.value);
+                break;
+            case DesktopEventType.FrameReady:
+                if (e.id >= 0 && e.id < monitors.Count) {
+                    monitors[e.id].OnFrameReady(e);
+                }
+                break;
+            case DesktopEventType.CursorMoved:
+                cursorMonitorId_ = e.id;
+                isCursorVisible = e.value != 0;
+                cursorX = e.x;
+                cursorY = e.y;
+                break;
+            case DesktopEventType.CursorShapeChanged:
+                cursorShapeWidth = e.width;
+                cursorShapeHeight = e.height;
+                cursorShapeType = (CursorShapeType)e.value;
+                break;
+            case DesktopEventType.StateChanged:
+                if (e.id >= 0 && e.id < monitorCount_) {
+                    monitorInfos_[e.id].state = (DuplicatorState)e.value;
+                }
+                break;
+            case DesktopEventType.TopologyChanged:
+                hasTopologyChanged_ = true;
+                break;
+            case DesktopEventType.Overflow:
+                Debug.LogWarningFormat("[uDD] {0} events were dropped.", e.value);
+                SyncStates();
+                break;
+            case DesktopEventType.WatchRegionChanged:
+                if (e.id >= 0 && e.id < monitors.Count && onWatchRegionChanged != null) {
+                    onWatchRegionChanged(monitors[e.id], e.value, new RectInt(e.x, e.y, e.width, e.height));
+                }
+                break;
+            default:
+                break;
+        }
+
+        if (onEvent != null) {
+            onEvent(e);
+        }
+    }
+
+    // Fetches the states that are otherwise updated by events.
+    void SyncStates()
+    {
+        SyncCursorStates();
+        UpdateMonitorInfos();
+
+        if (Lib.HasMonitorCountChanged()) {
+            hasTopologyChanged_ = true;
+        }
+    }
+
+    void SyncCursorStates()
+    {
+        cursorMonitorId_ = Lib.GetCursorMonitorId();
+        isCursorVisible = Lib.IsCursorVisible();
+        cursorX = Lib.GetCursorX();
+        cursorY = Lib.GetCursorY();
+        cursorShapeWidth = Lib.GetCursorShapeWidth();
+        cursorShapeHeight = Lib.GetCursorShapeHeight();
+        cursorShapeType = Lib.GetCursorShapeType();
+    }
+
+    void OnMessage(Message message)
+    {
+        Debug.Log("[uDD] " + message);
+        switch (message) {
+            case Message.Reinitialized:
+                ReinitializeMonitors();
+                break;
+            case Message.TextureSizeChanged:
+                RecreateTextures();
+                break;
+            case Message.SnapshotCompleted:
+            case Message.SnapshotFailed:
+                if (onSnapshotFinished != null) {
+                    onSnapshotFinished(message == Message.SnapshotCompleted);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
     IEnumerator OnRender()
     {
         for (;;) {
@@ -232,9 +580,11 @@ public class Manager : MonoBehaviour
     void CreateMonitors()
     {
         DestroyMonitors();
+        UpdateMonitorInfos();
         for (int i = 0; i < monitorCount; ++i) {
             monitors.Add(new Monitor(i));
         }
+        SyncStates();
     }
 
     void DestroyMonitors()
@@ -247,6 +597,7 @@ public class Manager : MonoBehaviour
 
     void ReinitializeMonitors()
     {
+        UpdateMonitorInfos();
         for (int i = 0; i < monitorCount; ++i) {
             if (i == monitors.Count) {
                 monitors.Add(new Monitor(i));
@@ -1,4 +1,7 @@
 ﻿using UnityEngine;
+using Unity.Collections;
+using System.Threading.Tasks;
+using System.Collections.Generic;
 
 namespace uDesktopDuplication
 {
@@ -55,9 +58,15 @@ public class Monitor
         get { return id < Manager.monitorCount; } 
     }
 
+    // A snapshot taken once per frame by Manager (state is also updated by StateChanged events).
+    public MonitorInfo info
+    {
+        get { return Manager.GetMonitorInfo(id); }
+    }
+
     public DuplicatorState state
     {
-        get { return Lib.GetState(id); }
+        get { return info.state; }
     }
 
     public bool available
@@ -77,44 +86,44 @@ public class Monitor
 
     public bool isPrimary
     { 
-        get { return Lib.IsPrimary(id); }
+        get { return info.isPrimary != 0; }
     }
 
     public int left
     { 
-        get { return Lib.GetLeft(id); }
+        get { return info.left; }
     }
 
     public int right
     { 
-        get { return Lib.GetRight(id); }
+        get { return info.right; }
     }
 
     public int top
     { 
-        get { return Lib.GetTop(id); }
+        get { return info.top; }
     }
 
     public int bottom
     { 
-        get { return Lib.GetBottom(id); }
+        get { return info.bottom; }
     }
 
     public int width 
     { 
-        get { return Lib.GetWidth(id); }
+        get { return info.width; }
     }
 
     public int height
     { 
-        get { return Lib.GetHeight(id); }
+        get { return info.height; }
     }
 
     public int dpiX
     { 
         get 
         {
-            var dpi = Lib.GetDpiX(id); 
+            var dpi = info.dpiX; 
             if (dpi == 0) dpi = 100; // when monitors are duplicated
             return dpi;
         }
@@ -124,7 +133,7 @@ public class Monitor
     { 
         get 
         {
-            var dpi = Lib.GetDpiY(id); 
+            var dpi = info.dpiY; 
             if (dpi == 0) dpi = 100; // when monitors are duplicated
             return dpi;
         }
@@ -132,7 +141,7 @@ public class Monitor
 
     public bool isHDR
     {
-        get { return Lib.IsHDR(id); }
+        get { return info.isHDR != 0; }
     }
 
     public float widthMeter
@@ -147,7 +156,7 @@ public class Monitor
 
     public MonitorRotation rotation
     { 
-        get { return Lib.GetRotation(id); }
+        get { return info.rotation; }
     }
 
     public float aspect
@@ -177,17 +186,17 @@ public class Monitor
 
     public bool isCursorVisible
     { 
-        get { return Lib.IsCursorVisible(); }
+        get { return Manager.isCursorVisible; }
     }
 
     public int cursorX
     { 
-        get { return Lib.GetCursorMonitorId() == id ? Lib.GetCursorX() : -1; }
+        get { return Manager.cursorMonitorId == id ? Manager.cursorX : -1; }
     }
 
     public int cursorY
     { 
-        get { return Lib.GetCursorMonitorId() == id ? Lib.GetCursorY() : -1; }
+        get { return Manager.cursorMonitorId == id ? Manager.cursorY : -1; }
     }
 
     public int systemCursorX
@@ -210,22 +219,71 @@ public class Monitor
 
     public int cursorShapeWidth
     { 
-        get { return Lib.GetCursorShapeWidth(); }
+        get { return Manager.cursorShapeWidth; }
     }
 
     public int cursorShapeHeight
     { 
-        get { return Lib.GetCursorShapeHeight(); }
+        get { return Manager.cursorShapeHeight; }
     }
 
     public CursorShapeType cursorShapeType
     { 
-        get { return Lib.GetCursorShapeType(); }
+        get { return Manager.cursorShapeType; }
+    }
+
+    // The id of the latest frame published by the capture thread (from FrameReady events).
+    public uint frameSequence
+    {
+        get;
+        private set;
+    }
+
+    // The bounds of the areas changed in the latest published frame.
+    public RectInt damageRect
+    {
+        get;
+        private set;
+    }
+
+    // Fetched at most once per frame.
+    FrameInfo frameInfo_;
+    int frameInfoFrameCount_ = -1;
+    public FrameInfo frameInfo
+    {
+        get
+        {
+            if (frameInfoFrameCount_ != Time.frameCount) {
+                UpdateFrameInfo();
+                frameInfoFrameCount_ = Time.frameCount;
+            }
+            return frameInfo_;
+        }
+    }
+
+    // Set when the plugin is older than these scripts and does not export GetFrameInfo().
+    static bool isFrameInfoMissing_ = false;
+
+    void UpdateFrameInfo()
+    {
+        if (!isFrameInfoMissing_) {
+            try {
+                Lib.GetFrameInfo(id, out frameInfo_);
+                return;
+            } catch (System.EntryPointNotFoundException) {
+                isFrameInfoMissing_ = true;
+            }
+        }
+
+        frameInfo_ = new FrameInfo();
+        frameInfo_.moveRectCount = Lib.GetMoveRectCount(id);
+        frameInfo_.dirtyRectCount = Lib.GetDirtyRectCount(id);
+        frameInfo_.hasBeenUpdated = Lib.HasBeenUpdated(id) ? 1 : 0;
     }
 
     public int moveRectCount
     { 
-        get { return Lib.GetMoveRectCount(id); }
+        get { return frameInfo.moveRectCount; }
     }
 
     public DXGI_OUTDUPL_MOVE_RECT[] moveRects
@@ -235,7 +293,7 @@ public class Monitor
 
     public int dirtyRectCount
     { 
-        get { return Lib.GetDirtyRectCount(id); }
+        get { return frameInfo.dirtyRectCount; }
     }
 
     public RECT[] dirtyRects
@@ -243,14 +301,50 @@ public class Monitor
         get { return Lib.GetDirtyRects(id); }
     }
 
+    // Allocation-free versions of moveRects / dirtyRects. They copy the rects of one frame
+    // (identified by frameSeq) into the given buffer and return the total number of rects,
+    // which can be larger than the buffer.
+    public int GetMoveRects(DXGI_OUTDUPL_MOVE_RECT[] rects, out ulong frameSeq)
+    {
+        return Lib.CopyMoveRects(id, rects, rects.Length, out frameSeq);
+    }
+
+    public int GetMoveRects(NativeArray<DXGI_OUTDUPL_MOVE_RECT> rects, out ulong frameSeq)
+    {
+        return Lib.CopyMoveRects(id, rects, out frameSeq);
+    }
+
+    public int GetDirtyRects(RECT[] rects, out ulong frameSeq)
+    {
+        return Lib.CopyDirtyRects(id, rects, rects.Length, out frameSeq);
+    }
+
+    public int GetDirtyRects(NativeArray<RECT> rects, out ulong frameSeq)
+    {
+        return Lib.CopyDirtyRects(id, rects, out frameSeq);
+    }
+
+    [System.Obsolete("The render thread writes and reallocates the buffer at any time. Use CopyBuffer() instead.")]
     public System.IntPtr buffer
     {
         get { return Lib.GetBuffer(id); }
     }
 
+    // Copies the last GetPixels() readback (BGRA32 in the orientation of the desktop image) and
+    // returns its whole size in bytes, which can be larger than output (0 before the first readback).
+    public int CopyBuffer(byte[] output)
+    {
+        return Lib.CopyBuffer(id, output, output.Length);
+    }
+
+    public int CopyBuffer(NativeArray<byte> output)
+    {
+        return Lib.CopyBuffer(id, output);
+    }
+
     public bool hasBeenUpdated
     {
-        get { return Lib.HasBeenUpdated(id); }
+        get { return frameInfo.hasBeenUpdated != 0; }
     }
 
     bool useGetPixels_ = false;
@@ -267,6 +361,199 @@ public class Monitor
         }
     }
 
+    // Part of the monitor to capture in monitor coordinates (null captures the whole monitor).
+    // The texture, GetPixels() coordinates and move / dirty rects are all relative to the crop,
+    // and the cost of the copies scales with its area. Streaming has to be restarted after changing it.
+    RectInt? cropRect_ = null;
+    public RectInt? cropRect
+    {
+        get
+        {
+            return cropRect_;
+        }
+        set
+        {
+            if (value.HasValue) {
+                var rect = value.Value;
+                if (!Lib.SetCropRect(id, rect.x, rect.y, rect.width, rect.height)) return;
+            } else {
+                Lib.ClearCropRect(id);
+            }
+            cropRect_ = value;
+            CreateTextureIfNeeded();
+        }
+    }
+
+    // Frame rate this monitor asks for (0 follows the global frame rate). The effective rate can be
+    // lower when the QoS budget is exceeded, and the monitor holding the cursor is always high priority.
+    uint targetFrameRate_ = 0;
+    public uint targetFrameRate
+    {
+        get { return targetFrameRate_; }
+        set
+        {
+            targetFrameRate_ = value;
+            Lib.SetTargetFrameRate(id, value);
+        }
+    }
+
+    QosPriority qosPriority_ = QosPriority.Normal;
+    public QosPriority qosPriority
+    {
+        get { return qosPriority_; }
+        set
+        {
+            qosPriority_ = value;
+            Lib.SetQosPriority(id, value);
+        }
+    }
+
+    public QosInfo qosInfo
+    {
+        get
+        {
+            QosInfo info;
+            Lib.GetQosInfo(id, out info);
+            return info;
+        }
+    }
+
+    // Regions in monitor coordinates whose changes are reported by Manager.onWatchRegionChanged.
+    // Dirty and move rects are matched against them natively, so thousands of regions cost
+    // well under a millisecond per frame. Registering an existing id replaces its rect.
+    Dictionary<int, RectInt> watchRegions_ = new Dictionary<int, RectInt>();
+    public bool RegisterWatchRegion(int regionId, RectInt rect)
+    {
+        if (!Lib.RegisterWatchRegion(id, regionId, rect.x, rect.y, rect.width, rect.height)) return false;
+        watchRegions_[regionId] = rect;
+        return true;
+    }
+
+    public bool UnregisterWatchRegion(int regionId)
+    {
+        watchRegions_.Remove(regionId);
+        return Lib.UnregisterWatchRegion(id, regionId);
+    }
+
+    public void ClearWatchRegions()
+    {
+        watchRegions_.Clear();
+        Lib.ClearWatchRegions(id);
+    }
+
+    public int watchRegionCount
+    {
+        get { return Lib.GetWatchRegionCount(id); }
+    }
+
+    public int captureWidth
+    {
+        get { return cropRect_.HasValue ? cropRect_.Value.width : width; }
+    }
+
+    public int captureHeight
+    {
+        get { return cropRect_.HasValue ? cropRect_.Value.height : height; }
+    }
+
+    public bool isRecording
+    {
+        get { return Lib.IsRecording(id); }
+    }
+
+    public bool isReplaying
+    {
+        get { return Lib.IsReplaying(id); }
+    }
+
+    public bool isSharedMemoryExportEnabled
+    {
+        get { return Lib.IsSharedMemoryExportEnabled(id); }
+    }
+
+    public bool isStreaming
+    {
+        get { return Lib.IsStreaming(id); }
+    }
+
+    public int streamingClientCount
+    {
+        get { return Lib.GetStreamingClientCount(id); }
+    }
+
+    // Mean colors of the edge zones and the regions and the luma histogram of the captured area,
+    // updated natively from the changed rects of each frame (see EnableRegionStats()).
+    int regionStatsCellSize_ = 0;
+    public bool isRegionStatsEnabled
+    {
+        get { return Lib.IsRegionStatsEnabled(id); }
+    }
+
+    // A box around the cursor copied on every frame and cursor move, which costs far less than
+    // useGetPixels for magnifiers (see EnableCursorRegion()).
+    int cursorRegionWidth_ = 0;
+    int cursorRegionHeight_ = 0;
+    public bool isCursorRegionEnabled
+    {
+        get { return Lib.IsCursorRegionEnabled(id); }
+    }
+
+    // The last frames kept in memory to be exported on demand (see EnableReplayRing()).
+    long replayRingMaxBytes_ = 0;
+    float replayRingDurationSec_ = 0f;
+    float replayRingKeyFrameIntervalSec_ = 0f;
+    public bool isReplayRingEnabled
+    {
+        get { return Lib.IsReplayRingEnabled(id); }
+    }
+
+    public ReplayExportState replayExportState
+    {
+        get { return Lib.GetReplayExportState(id); }
+    }
+
+    public ReplayRingInfo replayRingInfo
+    {
+        get
+        {
+            ReplayRingInfo info;
+            Lib.GetReplayRingInfo(id, out info);
+            return info;
+        }
+    }
+
+    // Draws a frame counter into replayed frames and finds it in the CPU readback
+    // (needs useGetPixels or another CPU consumer) to measure LatencyStage.ProbeToReadback.
+    public bool latencyProbeEnabled
+    {
+        get { return Lib.IsLatencyProbeEnabled(id); }
+        set { Lib.SetLatencyProbeEnabled(id, value); }
+    }
+
+    // Captures right before each expected render instead of free-running, so the texture is at most
+    // about a capture time old when it is used (see phaseLockInfo and LatencyStage.FrameAge).
+    // The capture free-runs as usual while the render cadence is too irregular to lock to.
+    bool phaseLockEnabled_ = false;
+    public bool phaseLockEnabled
+    {
+        get { return phaseLockEnabled_; }
+        set
+        {
+            phaseLockEnabled_ = value;
+            Lib.SetPhaseLockEnabled(id, value);
+        }
+    }
+
+    public PhaseLockInfo phaseLockInfo
+    {
+        get
+        {
+            PhaseLockInfo info;
+            Lib.GetPhaseLockInfo(id, out info);
+            return info;
+        }
+    }
+
     public bool shouldBeUpdated
     {
         get; 
@@ -313,8 +600,8 @@ public class Monitor
     {
         if (!available) return;
 
-        var w = isHorizontal ? width : height;
-        var h = isHorizontal ? height : width;
+        var w = isHorizontal ? captureWidth : captureHeight;
+        var h = isHorizontal ? captureHeight : captureWidth;
         bool shouldCreate = true;
 
         if (texture_ && texture_.width == w && texture_.height == h) {
@@ -333,8 +620,8 @@ public class Monitor
     void CreateTexture()
     {
         DestroyTexture();
-        var w = isHorizontal ? width : height;
-        var h = isHorizontal ? height : width;
+        var w = isHorizontal ? captureWidth : captureHeight;
+        var h = isHorizontal ? captureHeight : captureWidth;
         texture_ = new Texture2D(w, h, TextureFormat.BGRA32, false);
         texturePtr_ = texture_.GetNativeTexturePtr();
     }
@@ -350,9 +637,63 @@ public class Monitor
 
     public void Reinitialize()
     {
+        frameInfoFrameCount_ = -1;
+
+        // Monitors are created again on the native side, so the crop, the QoS settings, the region stats,
+        // the cursor region, the replay ring and the watch regions are set again (the crop and the regions which do not fit in the new size are dropped).
+        // Only the settings changed from their defaults are sent, so that plugins built before these
+        // functions keep working as long as they are not used.
+        if (cropRect_.HasValue) {
+            var rect = cropRect_.Value;
+            if (!Lib.SetCropRect(id, rect.x, rect.y, rect.width, rect.height)) {
+                cropRect_ = null;
+            }
+        }
+        if (targetFrameRate_ != 0) {
+            Lib.SetTargetFrameRate(id, targetFrameRate_);
+        }
+        if (qosPriority_ != QosPriority.Normal) {
+            Lib.SetQosPriority(id, qosPriority_);
+        }
+        if (phaseLockEnabled_) {
+            Lib.SetPhaseLockEnabled(id, phaseLockEnabled_);
+        }
+        if (regionStatsCellSize_ > 0) {
+            Lib.EnableRegionStats(id, regionStatsCellSize_);
+        }
+        if (edgeZoneHorizontalCount_ > 0 || edgeZoneVerticalCount_ > 0) {
+            Lib.SetRegionStatsEdgeZones(id, edgeZoneHorizontalCount_, edgeZoneVerticalCount_, edgeZoneDepth_);
+        }
+        if (regionStatsRects_.Length > 0) {
+            Lib.SetRegionStatsRects(id, regionStatsRects_, regionStatsRects_.Length);
+        }
+        if (cursorRegionWidth_ > 0) {
+            Lib.EnableCursorRegion(id, cursorRegionWidth_, cursorRegionHeight_);
+        }
+        if (replayRingMaxBytes_ > 0) {
+            Lib.EnableReplayRing(id, replayRingMaxBytes_, replayRingDurationSec_, replayRingKeyFrameIntervalSec_);
+        }
+
+        var lostRegions = new List<int>();
+        foreach (var pair in watchRegions_) {
+            var rect = pair.Value;
+            if (!Lib.RegisterWatchRegion(id, pair.Key, rect.x, rect.y, rect.width, rect.height)) {
+                lostRegions.Add(pair.Key);
+            }
+        }
+        foreach (var regionId in lostRegions) {
+            watchRegions_.Remove(regionId);
+        }
+
         CreateTextureIfNeeded();
     }
 
+    public void OnFrameReady(DesktopEvent e)
+    {
+        frameSequence = e.seq;
+        damageRect = new RectInt(e.x, e.y, e.width, e.height);
+    }
+
     public Color32[] GetPixels(int x, int y, int width, int height)
     {
         if (!useGetPixels_) {
@@ -371,6 +712,273 @@ public class Monitor
         return Lib.GetPixels(id, colors, x, y, width, height);
     }
 
+    public bool GetPixels(NativeArray<Color32> colors, int x, int y, int width, int height)
+    {
+        if (!useGetPixels_) {
+            Debug.LogErrorFormat("Please set Monitor[{0}].useGetPixels as true.", id);
+            return false;
+        }
+        return Lib.GetPixels(id, colors, x, y, width, height);
+    }
+
+    // Reads the pixels on a worker thread. colors must be kept alive until the task completes.
+    public Task<bool> GetPixelsAsync(NativeArray<Color32> colors, int x, int y, int width, int height)
+    {
+        if (!useGetPixels_) {
+            Debug.LogErrorFormat("Please set Monitor[{0}].useGetPixels as true.", id);
+            return Task.FromResult(false);
+        }
+        return Lib.GetPixelsAsync(id, colors, x, y, width, height);
+    }
+
+    // The result is rented from PixelBufferPool, so give it back with PixelBufferPool.Return()
+    // after use. An array which has not been created is returned when reading fails.
+    public async Task<NativeArray<Color32>> GetPixelsAsync(int x, int y, int width, int height)
+    {
+        var colors = PixelBufferPool.Rent(width * height);
+        if (await GetPixelsAsync(colors, x, y, width, height)) {
+            return colors;
+        }
+        PixelBufferPool.Return(colors);
+        return default(NativeArray<Color32>);
+    }
+
+    // Finds a template in the GetPixels() buffer and writes the top-left corners of the matches in
+    // monitor coordinates to results, best first. pixels have the layout of GetPixels() (e.g. from
+    // Texture2D.GetPixels32()), and threshold is the normalized cross-correlation to reach (1 is identical).
+    // For tracking, keep frameId between calls starting from 0: only positions overlapping what changed
+    // after the frame searched last time are searched again, so no match means the previous ones still hold.
+    // Templates smaller than 16 pixels are searched without the pyramid, so give them a small searchRect.
+    public int FindTemplate(Color32[] pixels, int width, int height, RectInt searchRect, float threshold, ref uint frameId, TemplateMatch[] results)
+    {
+        if (!useGetPixels_) {
+            Debug.LogErrorFormat("Please set Monitor[{0}].useGetPixels as true.", id);
+            return 0;
+        }
+        var rect = ToRECT(searchRect);
+        return Lib.FindTemplate(id, pixels, width, height, ref rect, threshold, ref frameId, results, results.Length);
+    }
+
+    public TemplateMatch[] FindTemplate(Color32[] pixels, int width, int height, float threshold = 0.9f, int maxCount = 8)
+    {
+        uint frameId = 0;
+        var results = new TemplateMatch[maxCount];
+        var count = FindTemplate(pixels, width, height, new RectInt(0, 0, captureWidth, captureHeight), threshold, ref frameId, results);
+        System.Array.Resize(ref results, count);
+        return results;
+    }
+
+    // Searches on a worker thread, so that several templates or monitors are searched in parallel.
+    // pixels must not be modified until the task completes.
+    public Task<TemplateMatch[]> FindTemplateAsync(Color32[] pixels, int width, int height, float threshold = 0.9f, int maxCount = 8)
+    {
+        if (!useGetPixels_) {
+            Debug.LogErrorFormat("Please set Monitor[{0}].useGetPixels as true.", id);
+            return Task.FromResult(new TemplateMatch[0]);
+        }
+        var monitorId = id;
+        var rect = ToRECT(new RectInt(0, 0, captureWidth, captureHeight));
+        return Task.Run(() => {
+            uint frameId = 0;
+            var results = new TemplateMatch[maxCount];
+            var count = Lib.FindTemplate(monitorId, pixels, width, height, ref rect, threshold, ref frameId, results, results.Length);
+            System.Array.Resize(ref results, count);
+            return results;
+        });
+    }
+
+    static RECT ToRECT(RectInt rect)
+    {
+        return new RECT {
+            left = rect.x,
+            top = rect.y,
+            right = rect.x + rect.width,
+            bottom = rect.y + rect.height,
+        };
+    }
+
+    public bool StartRecording(string path)
+    {
+        return Lib.StartRecording(id, path);
+    }
+
+    public void StopRecording()
+    {
+        Lib.StopRecording(id);
+    }
+
+    public bool StartReplay(string path, ReplaySpeed speed = ReplaySpeed.Recorded, bool loop = false)
+    {
+        return Lib.StartReplay(id, path, speed, loop);
+    }
+
+    public void StopReplay()
+    {
+        Lib.StopReplay(id);
+    }
+
+    // Keeps about the last durationSec seconds in memory: a key frame every keyFrameIntervalSec and
+    // the changed tiles of the frames in between. The oldest frames are dropped earlier when maxBytes
+    // is reached (a 720p video playing takes about 100 MB/s while office work takes less than 1 MB/s).
+    public bool EnableReplayRing(long maxBytes = 256L * 1024 * 1024, float durationSec = 30f, float keyFrameIntervalSec = 10f)
+    {
+        if (!Lib.EnableReplayRing(id, maxBytes, durationSec, keyFrameIntervalSec)) return false;
+        replayRingMaxBytes_ = maxBytes;
+        replayRingDurationSec_ = durationSec;
+        replayRingKeyFrameIntervalSec_ = keyFrameIntervalSec;
+        return true;
+    }
+
+    public void DisableReplayRing()
+    {
+        replayRingMaxBytes_ = 0;
+        Lib.DisableReplayRing(id);
+    }
+
+    // Writes the frames kept so far on a background thread, as a session file for StartReplay()
+    // or as path_000000.qoi, path_000001.qoi, ... in monitor orientation. See replayExportState.
+    public bool ExportReplayRing(string path, ReplayExportFormat format = ReplayExportFormat.Session)
+    {
+        return Lib.ExportReplayRing(id, path, format);
+    }
+
+    public async Task<bool> ExportReplayRingAsync(string path, ReplayExportFormat format = ReplayExportFormat.Session)
+    {
+        if (!ExportReplayRing(path, format)) return false;
+        while (replayExportState == ReplayExportState.Exporting) {
+            await Task.Delay(100);
+        }
+        return replayExportState == ReplayExportState.Completed;
+    }
+
+    public bool EnableSharedMemoryExport(int slotCount = 3)
+    {
+        return Lib.EnableSharedMemoryExport(id, slotCount);
+    }
+
+    public void DisableSharedMemoryExport()
+    {
+        Lib.DisableSharedMemoryExport(id);
+    }
+
+    public bool StartStreaming(int port)
+    {
+        return Lib.StartStreaming(id, port);
+    }
+
+    public void StopStreaming()
+    {
+        Lib.StopStreaming(id);
+    }
+
+    // Zones and regions have their edges snapped to cells of cellSize pixels, so 1 is exact
+    // and larger cells use less memory (about 38 bytes per pixel at 1 and 3.3 at 4).
+    public bool EnableRegionStats(int cellSize = 4)
+    {
+        if (!Lib.EnableRegionStats(id, cellSize)) return false;
+        regionStatsCellSize_ = cellSize;
+        return true;
+    }
+
+    public void DisableRegionStats()
+    {
+        regionStatsCellSize_ = 0;
+        Lib.DisableRegionStats(id);
+    }
+
+    // Zones of depth pixels along the edges of the captured area, returned clockwise from the top left
+    // corner: horizontalCount on the top (left to right), verticalCount on the right (top to bottom),
+    // then the bottom (right to left) and the left (bottom to top). Depth 0 removes them.
+    int edgeZoneHorizontalCount_ = 0;
+    int edgeZoneVerticalCount_ = 0;
+    int edgeZoneDepth_ = 0;
+    public bool SetRegionStatsEdgeZones(int horizontalCount, int verticalCount, int depth)
+    {
+        if (!Lib.SetRegionStatsEdgeZones(id, horizontalCount, verticalCount, depth)) return false;
+        edgeZoneHorizontalCount_ = horizontalCount;
+        edgeZoneVerticalCount_ = verticalCount;
+        edgeZoneDepth_ = depth;
+        return true;
+    }
+
+    // Regions in captured area coordinates whose means follow the edge zones.
+    RECT[] regionStatsRects_ = new RECT[0];
+    public void SetRegionStatsRects(RectInt[] rects)
+    {
+        regionStatsRects_ = new RECT[rects.Length];
+        for (int i = 0; i < rects.Length; ++i) {
+            regionStatsRects_[i] = ToRECT(rects[i]);
+        }
+        Lib.SetRegionStatsRects(id, regionStatsRects_, regionStatsRects_.Length);
+    }
+
+    // Fills means with the edge zones and then the regions, and histogram (256 bins, can be null)
+    // with the luma of the whole captured area. Returns the number of means, which can be more than
+    // means.Length. Everything comes from the last frame read back, so one call per frame is enough.
+    public int GetRegionStats(out RegionStatsInfo info, RegionMean[] means, uint[] histogram = null)
+    {
+        if (histogram != null && histogram.Length < 256) {
+            Debug.LogError("histogram needs 256 bins.");
+            info = new RegionStatsInfo();
+            return 0;
+        }
+        return Lib.GetRegionStats(id, out info, means, means != null ? means.Length : 0, histogram);
+    }
+
+    // width and height are in monitor orientation. The box is centered on the hot spot of the cursor
+    // while it is on this monitor and kept inside the captured area, and it works without useGetPixels.
+    public bool EnableCursorRegion(int width, int height)
+    {
+        if (!Lib.EnableCursorRegion(id, width, height)) return false;
+        cursorRegionWidth_ = width;
+        cursorRegionHeight_ = height;
+        return true;
+    }
+
+    public void DisableCursorRegion()
+    {
+        cursorRegionWidth_ = 0;
+        cursorRegionHeight_ = 0;
+        Lib.DisableCursorRegion(id);
+    }
+
+    // Writes the last copied region to pixels with the layout of GetPixels() (e.g. for Texture2D.SetPixels32()).
+    // info.sequence tells whether it changed since the last call, and info is filled even when pixels
+    // (can be null) is smaller than info.width * info.height, which is less than the requested size
+    // only when the captured area is smaller.
+    public bool GetCursorRegion(out CursorRegionInfo info, Color32[] pixels)
+    {
+        return Lib.GetCursorRegion(id, out info, pixels, pixels != null ? pixels.Length : 0);
+    }
+
+    public LatencyStats GetLatencyStats(LatencyStage stage)
+    {
+        LatencyStats stats;
+        Lib.GetLatencyStats(id, stage, out stats);
+        return stats;
+    }
+
+    public void ResetLatencyStats()
+    {
+        Lib.ResetLatencyStats(id);
+    }
+
+    public MemoryStats memoryStats
+    {
+        get
+        {
+            MemoryStats stats;
+            Lib.GetMemoryStats(id, out stats);
+            return stats;
+        }
+    }
+
+    // Releases the staging texture and the CPU copy now. They are created again by the next readback.
+    public long ReleaseReadback()
+    {
+        return Lib.ReleaseReadback(id);
+    }
+
     public Color32 GetPixel(int x, int y)
     {
         if (!useGetPixels_) {
@@ -0,0 +1,53 @@
+﻿using UnityEngine;
+using System.Collections.Generic;
+using Unity.Collections;
+
+namespace uDesktopDuplication
+{
+
+// Reuses NativeArray<Color32> buffers for GetPixels() so that per-frame sampling does not
+// produce garbage. Rented buffers must be given back with Return().
+public static class PixelBufferPool
+{
+    static readonly Dictionary<int, Stack<NativeArray<Color32>>> buffers_ = new Dictionary<int, Stack<NativeArray<Color32>>>();
+    static readonly object lock_ = new object();
+
+    public static NativeArray<Color32> Rent(int length)
+    {
+        lock (lock_) {
+            Stack<NativeArray<Color32>> stack;
+            if (buffers_.TryGetValue(length, out stack) && stack.Count > 0) {
+                return stack.Pop();
+            }
+        }
+        return new NativeArray<Color32>(length, Allocator.Persistent, NativeArrayOptions.UninitializedMemory);
+    }
+
+    public static void Return(NativeArray<Color32> buffer)
+    {
+        if (!buffer.IsCreated) return;
+
+        lock (lock_) {
+            Stack<NativeArray<Color32>> stack;
+            if (!buffers_.TryGetValue(buffer.Length, out stack)) {
+                stack = new Stack<NativeArray<Color32>>();
+                buffers_.Add(buffer.Length, stack);
+            }
+            stack.Push(buffer);
+        }
+    }
+
+    public static void Clear()
+    {
+        lock (lock_) {
+            foreach (var stack in buffers_.Values) {
+                while (stack.Count > 0) {
+                    stack.Pop().Dispose();
+                }
+            }
+            buffers_.Clear();
+        }
+    }
+}
+
+}
@@ -1,6 +1,4 @@
 ﻿using UnityEngine;
-using System;
-using System.Runtime.InteropServices;
 
 public class BufferExample : MonoBehaviour
 {
@@ -8,12 +6,6 @@ public class BufferExample : MonoBehaviour
     uDesktopDuplication.Texture uddTexture;
 
     Texture2D texture_;
-    Color32[] pixels_;
-    GCHandle handle_;
-    IntPtr ptr_ = IntPtr.Zero;
-
-    [DllImport("msvcrt.dll", CallingConvention = CallingConvention.Cdecl, SetLastError = false)]
-    public static extern IntPtr memcpy(IntPtr dest, IntPtr src, int count);
 
     void Start()
     {
@@ -23,13 +15,6 @@ public class BufferExample : MonoBehaviour
         UpdateTexture();
     }
 
-    void OnDestroy()
-    {
-        if (ptr_ != IntPtr.Zero) {
-            handle_.Free();
-        }
-    }
-
     void Update()
     {
         if (!uddTexture) return;
@@ -50,23 +35,16 @@ public class BufferExample : MonoBehaviour
         // TextureFormat.BGRA32 should be set but it causes an error now.
         texture_ = new Texture2D(width, height, TextureFormat.RGBA32, false);
         texture_.filterMode = FilterMode.Bilinear;
-        pixels_ = texture_.GetPixels32();
-        handle_ = GCHandle.Alloc(pixels_, GCHandleType.Pinned);
-        ptr_ = handle_.AddrOfPinnedObject();
 
         GetComponent<Renderer>().material.mainTexture = texture_;
     }
 
     void CopyTexture()
     {
-        var buffer = uddTexture.monitor.buffer;
-        if (buffer == IntPtr.Zero) return;
-
-        var width = uddTexture.monitor.width;
-        var height = uddTexture.monitor.height;
-        memcpy(ptr_, buffer, width * height * sizeof(Byte) * 4);
+        // The copy is made while the render thread cannot update the buffer.
+        var size = uddTexture.monitor.CopyBuffer(texture_.GetRawTextureData<byte>());
+        if (size == 0) return;
 
-        texture_.SetPixels32(pixels_);
         texture_.Apply();
     }
 }
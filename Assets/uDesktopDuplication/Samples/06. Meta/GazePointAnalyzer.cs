@@ -21,6 +21,12 @@ public class GazePointAnalyzer : MonoBehaviour
     }
     private Vector2 preCursorCoord_ = Vector2.zero;
 
+    // Reused every frame to avoid allocations.
+    private uDesktopDuplication.DXGI_OUTDUPL_MOVE_RECT[] moveRects_ = new uDesktopDuplication.DXGI_OUTDUPL_MOVE_RECT[16];
+    private uDesktopDuplication.RECT[] dirtyRects_ = new uDesktopDuplication.RECT[64];
+    private int moveRectCount_ = 0;
+    private int dirtyRectCount_ = 0;
+
     [Header("Filters")]
     [Range(0f, 1f)] public float moveRectFilter = 0.05f;
     [Range(0f, 1f)] public float mouseFilter = 0.05f;
@@ -55,15 +61,15 @@ public class GazePointAnalyzer : MonoBehaviour
         var filter = 0f;
 
         // move rect
-        if (monitor.moveRectCount > 0) {
-            foreach (var rects in monitor.moveRects) {
-                var rect = rects.destination;
+        if (moveRectCount_ > 0) {
+            for (int i = 0; i < moveRectCount_; ++i) {
+                var rect = moveRects_[i].destination;
                 var center = new Vector2(
                     (rect.right  + rect.left) / 2, 
                     (rect.bottom + rect.top)  / 2);
                 coord += center;
             }
-            coord /= monitor.moveRectCount;
+            coord /= moveRectCount_;
             filter = moveRectFilter;
         } 
         // mouse
@@ -78,9 +84,10 @@ public class GazePointAnalyzer : MonoBehaviour
             filter = mouseFilter;
         } 
         // dirty rect
-        else if (monitor.dirtyRectCount > 0) {
+        else if (dirtyRectCount_ > 0) {
             var totalWeights = 0f;
-            foreach (var rect in monitor.dirtyRects) {
+            for (int i = 0; i < dirtyRectCount_; ++i) {
+                var rect = dirtyRects_[i];
                 var center = new Vector2(
                     (rect.right  + rect.left) / 2, 
                     (rect.bottom + rect.top)  / 2);
@@ -113,8 +120,27 @@ public class GazePointAnalyzer : MonoBehaviour
         preCursorCoord_ = cursorCoord;
     }
 
+    void UpdateRects()
+    {
+        var monitor = uddTexture_.monitor;
+        ulong frameSeq;
+
+        moveRectCount_ = monitor.GetMoveRects(moveRects_, out frameSeq);
+        if (moveRectCount_ > moveRects_.Length) {
+            moveRects_ = new uDesktopDuplication.DXGI_OUTDUPL_MOVE_RECT[moveRectCount_ * 2];
+            moveRectCount_ = Mathf.Min(monitor.GetMoveRects(moveRects_, out frameSeq), moveRects_.Length);
+        }
+
+        dirtyRectCount_ = monitor.GetDirtyRects(dirtyRects_, out frameSeq);
+        if (dirtyRectCount_ > dirtyRects_.Length) {
+            dirtyRects_ = new uDesktopDuplication.RECT[dirtyRectCount_ * 2];
+            dirtyRectCount_ = Mathf.Min(monitor.GetDirtyRects(dirtyRects_, out frameSeq), dirtyRects_.Length);
+        }
+    }
+
     void Update()
     {
+        UpdateRects();
         CalcAveragePos();
         DebugDraw();
     }
@@ -152,16 +178,16 @@ public class GazePointAnalyzer : MonoBehaviour
 
     void DrawMoveRects()
     {
-        foreach (var rect in uddTexture_.monitor.moveRects) {
-            DrawRect(rect.source, Color.blue);
-            DrawRect(rect.destination, Color.green);
+        for (int i = 0; i < moveRectCount_; ++i) {
+            DrawRect(moveRects_[i].source, Color.blue);
+            DrawRect(moveRects_[i].destination, Color.green);
         }
     }
 
     void DrawDirtyRects()
     {
-        foreach (var rect in uddTexture_.monitor.dirtyRects) {
-            DrawRect(rect, Color.red);
+        for (int i = 0; i < dirtyRectCount_; ++i) {
+            DrawRect(dirtyRects_[i], Color.red);
         }
     }
 }
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "uDesktopDuplicationShm.h"
+
+#ifdef _WIN32
+#define UDD_SHM_ACQUIRE_FENCE() MemoryBarrier()
+#else
+#define UDD_SHM_ACQUIRE_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
+
+
+struct UddShmRing
+{
+#ifdef _WIN32
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+    uint8_t* view;
+    size_t size;
+};
+
+
+static void udd_shm_sleep(uint32_t ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+
+static uint64_t udd_shm_now_ms(void)
+{
+#ifdef _WIN32
+    return GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+#endif
+}
+
+
+static int udd_shm_validate(const UddShmRing* ring)
+{
+    const UddShmRingHeader* header = (const UddShmRingHeader*)ring->view;
+    uint64_t required;
+
+    if (ring->size < sizeof(UddShmRingHeader)) return 0;
+    if (header->magic != UDD_SHM_MAGIC || header->version != UDD_SHM_VERSION) return 0;
+    if (header->slotCount == 0 || header->slotHeaderSize < sizeof(UddShmSlotHeader)) return 0;
+    if (header->slotStride < header->slotHeaderSize + header->maxFrameSize) return 0;
+
+    required = header->slotOffset + header->slotStride * header->slotCount;
+    return required <= ring->size;
+}
+
+
+static const UddShmSlotHeader* udd_shm_get_slot(const UddShmRing* ring, uint32_t index)
+{
+    const UddShmRingHeader* header = (const UddShmRingHeader*)ring->view;
+    return (const UddShmSlotHeader*)(ring->view + header->slotOffset + header->slotStride * index);
+}
+
+
+UddShmRing* udd_shm_open(int monitorId)
+{
+    char name[64];
+    UddShmRing* ring;
+
+    snprintf(name, sizeof(name), UDD_SHM_NAME_FORMAT, monitorId);
+
+    ring = (UddShmRing*)calloc(1, sizeof(UddShmRing));
+    if (!ring) return NULL;
+
+#ifdef _WIN32
+    {
+        MEMORY_BASIC_INFORMATION info;
+
+        ring->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+        if (!ring->mapping)
+        {
+            free(ring);
+            return NULL;
+        }
+
+        ring->view = (uint8_t*)MapViewOfFile(ring->mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!ring->view || !VirtualQuery(ring->view, &info, sizeof(info)))
+        {
+            udd_shm_close(ring);
+            return NULL;
+        }
+        ring->size = info.RegionSize;
+    }
+#else
+    {
+        struct stat st;
+
+        ring->fd = shm_open(name, O_RDONLY, 0);
+        if (ring->fd < 0)
+        {
+            free(ring);
+            return NULL;
+        }
+
+        if (fstat(ring->fd, &st) != 0 || st.st_size <= 0)
+        {
+            udd_shm_close(ring);
+            return NULL;
+        }
+        ring->size = (size_t)st.st_size;
+
+        ring->view = (uint8_t*)mmap(NULL, ring->size, PROT_READ, MAP_SHARED, ring->fd, 0);
+        if (ring->view == MAP_FAILED)
+        {
+            ring->view = NULL;
+            udd_shm_close(ring);
+            return NULL;
+        }
+    }
+#endif
+
+    if (!udd_shm_validate(ring))
+    {
+        udd_shm_close(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+
+void udd_shm_close(UddShmRing* ring)
+{
+    if (!ring) return;
+
+#ifdef _WIN32
+    if (ring->view) UnmapViewOfFile(ring->view);
+    if (ring->mapping) CloseHandle(ring->mapping);
+#else
+    if (ring->view) munmap(ring->view, ring->size);
+    if (ring->fd >= 0) close(ring->fd);
+#endif
+
+    free(ring);
+}
+
+
+const UddShmRingHeader* udd_shm_get_header(const UddShmRing* ring)
+{
+    return ring ? (const UddShmRingHeader*)ring->view : NULL;
+}
+
+
+uint64_t udd_shm_get_latest_frame_id(const UddShmRing* ring)
+{
+    uint64_t id;
+    if (!ring) return 0;
+    id = ((const UddShmRingHeader*)ring->view)->latestFrameId;
+    UDD_SHM_ACQUIRE_FENCE();
+    return id;
+}
+
+
+int udd_shm_wait(const UddShmRing* ring, uint64_t lastFrameId, uint32_t timeoutMs)
+{
+    const uint64_t start = udd_shm_now_ms();
+
+    if (!ring) return 0;
+
+    /* The producer never waits on readers, so readers poll instead of using a kernel event. */
+    for (;;)
+    {
+        if (udd_shm_get_latest_frame_id(ring) > lastFrameId) return 1;
+        if (udd_shm_now_ms() - start >= timeoutMs) return 0;
+        udd_shm_sleep(1);
+    }
+}
+
+
+int udd_shm_begin_read(const UddShmRing* ring, UddShmFrameView* view)
+{
+    const UddShmRingHeader* header;
+    const UddShmSlotHeader* slot;
+    uint32_t index;
+    int retry;
+
+    if (!ring || !view) return -1;
+
+    header = (const UddShmRingHeader*)ring->view;
+
+    for (retry = 0; retry < 16; ++retry)
+    {
+        if (udd_shm_get_latest_frame_id(ring) == 0) return 0;
+
+        index = header->latestSlot;
+        if (index >= header->slotCount) return -1;
+
+        slot = udd_shm_get_slot(ring, index);
+        view->sequence = slot->sequence;
+        UDD_SHM_ACQUIRE_FENCE();
+
+        /* An odd sequence means the producer has wrapped around and is overwriting this slot. */
+        if (view->sequence & 1u) continue;
+
+        view->header = slot;
+        view->pixels = (const uint8_t*)slot + header->slotHeaderSize;
+        return 1;
+    }
+
+    return -1;
+}
+
+
+int udd_shm_end_read(const UddShmRing* ring, const UddShmFrameView* view)
+{
+    if (!ring || !view || !view->header) return 0;
+    UDD_SHM_ACQUIRE_FENCE();
+    return view->header->sequence == view->sequence;
+}
+
+
+int udd_shm_read_latest(UddShmRing* ring, void* dst, size_t dstSize, UddShmSlotHeader* info)
+{
+    UddShmFrameView view;
+    UddShmSlotHeader header;
+    uint32_t y;
+    int retry, result;
+
+    if (!ring || !dst) return -1;
+
+    for (retry = 0; retry < 16; ++retry)
+    {
+        result = udd_shm_begin_read(ring, &view);
+        if (result <= 0) return result;
+
+        memcpy(&header, view.header, sizeof(header));
+        if (!udd_shm_end_read(ring, &view)) continue;
+
+        if (header.pitch < header.width * 4u ||
+            (uint64_t)header.pitch * header.height > udd_shm_get_header(ring)->maxFrameSize)
+        {
+            return -1;
+        }
+        if ((size_t)header.width * 4u * header.height > dstSize) return -1;
+
+        for (y = 0; y < header.height; ++y)
+        {
+            memcpy(
+                (uint8_t*)dst + (size_t)y * header.width * 4u,
+                view.pixels + (size_t)y * header.pitch,
+                (size_t)header.width * 4u);
+        }
+
+        if (!udd_shm_end_read(ring, &view)) continue;
+
+        if (info) *info = header;
+        return 1;
+    }
+
+    return -1;
+}
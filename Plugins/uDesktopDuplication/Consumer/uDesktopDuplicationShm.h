@@ -0,0 +1,120 @@
+#pragma once
+
+/*
+ * Shared-memory frame export of uDesktopDuplication.
+ *
+ * The plugin publishes the CPU mirror of each exported monitor into a named
+ * shared-memory object that holds a ring of slots. Every slot is guarded by a
+ * sequence counter (seqlock): the producer makes it odd while writing and even
+ * again when the slot is complete, so readers never block the capture thread and
+ * simply retry when they raced with a write.
+ *
+ * This header describes the memory layout (shared with the plugin) and a small
+ * consumer API implemented in uDesktopDuplicationShm.c.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UDD_SHM_MAGIC 0x4D534455u /* "UDSM" */
+#define UDD_SHM_VERSION 1u
+#define UDD_SHM_MAX_DIRTY_RECTS 64u
+#define UDD_SHM_DIRTY_RECTS_OVERFLOW 0xFFFFFFFFu
+#define UDD_SHM_SLOT_ALIGNMENT 4096u
+
+#ifdef _WIN32
+#define UDD_SHM_NAME_FORMAT "Local\\uDesktopDuplication.Monitor%d"
+#else
+#define UDD_SHM_NAME_FORMAT "/uDesktopDuplication.Monitor%d"
+#endif
+
+typedef struct UddShmRect
+{
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+} UddShmRect;
+
+typedef struct UddShmSlotHeader
+{
+    volatile uint32_t sequence;  /* odd while the producer is writing the slot */
+    uint32_t format;             /* DXGI_FORMAT (87 = B8G8R8A8_UNORM) */
+    uint64_t frameId;            /* capture frame id + 1; a gap means frames were skipped */
+    int64_t captureTime;         /* [us] steady clock of the producer */
+    int64_t presentTime;         /* DXGI LastPresentTime (QPC ticks), 0 if unknown */
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t dirtyRectCount;     /* UDD_SHM_DIRTY_RECTS_OVERFLOW when the whole frame should be treated as dirty */
+    UddShmRect dirtyRects[UDD_SHM_MAX_DIRTY_RECTS]; /* changes since frameId - 1, in desktop image coordinates */
+} UddShmSlotHeader;
+
+typedef struct UddShmRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotHeaderSize;     /* pixels of a slot begin at this offset from the slot */
+    uint64_t slotStride;
+    uint64_t slotOffset;         /* offset of the first slot from the beginning of the mapping */
+    uint64_t maxFrameSize;
+    volatile uint64_t latestFrameId; /* 0 until the first frame is published */
+    volatile uint32_t latestSlot;
+    uint32_t reserved;
+} UddShmRingHeader;
+
+static inline size_t udd_shm_slot_header_size(void)
+{
+    return (sizeof(UddShmSlotHeader) + 63u) & ~(size_t)63u;
+}
+
+static inline size_t udd_shm_slot_stride(uint64_t maxFrameSize)
+{
+    const size_t size = udd_shm_slot_header_size() + (size_t)maxFrameSize;
+    return (size + UDD_SHM_SLOT_ALIGNMENT - 1u) & ~(size_t)(UDD_SHM_SLOT_ALIGNMENT - 1u);
+}
+
+static inline size_t udd_shm_slot_offset(void)
+{
+    return (sizeof(UddShmRingHeader) + UDD_SHM_SLOT_ALIGNMENT - 1u) & ~(size_t)(UDD_SHM_SLOT_ALIGNMENT - 1u);
+}
+
+
+
+/* Consumer API */
+
+typedef struct UddShmRing UddShmRing;
+
+typedef struct UddShmFrameView
+{
+    const UddShmSlotHeader* header;
+    const uint8_t* pixels;
+    uint32_t sequence;
+} UddShmFrameView;
+
+/* Opens the ring exported for the given monitor id. Returns NULL if it does not exist. */
+UddShmRing* udd_shm_open(int monitorId);
+void udd_shm_close(UddShmRing* ring);
+const UddShmRingHeader* udd_shm_get_header(const UddShmRing* ring);
+uint64_t udd_shm_get_latest_frame_id(const UddShmRing* ring);
+
+/* Waits until a frame newer than lastFrameId is published. Returns 1 if so, 0 on timeout. */
+int udd_shm_wait(const UddShmRing* ring, uint64_t lastFrameId, uint32_t timeoutMs);
+
+/* Copies the latest frame into dst (tightly packed rows of width * 4 bytes).
+ * Returns 1 on success, 0 if no frame has been published yet and -1 on error. */
+int udd_shm_read_latest(UddShmRing* ring, void* dst, size_t dstSize, UddShmSlotHeader* info);
+
+/* Zero-copy access: the view points into shared memory and is only valid if
+ * udd_shm_end_read() returns 1 after the caller is done with the pixels. */
+int udd_shm_begin_read(const UddShmRing* ring, UddShmFrameView* view);
+int udd_shm_end_read(const UddShmRing* ring, const UddShmFrameView* view);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,306 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "uDesktopDuplicationStream.h"
+
+
+
+struct UddStreamDecoder
+{
+    uint8_t* pending;
+    size_t pendingSize;
+    size_t pendingCapacity;
+
+    int hasHello;
+    UddStreamHello hello;
+    uint8_t* image;
+
+    int inFrame;
+    UddStreamFrameBegin frame;
+    UddStreamFrameBegin lastFrame;
+    uint32_t copiesLeft;
+    uint32_t tilesLeft;
+};
+
+
+static int udd_stream_decode_rle(
+    const uint8_t* src, size_t size,
+    uint8_t* dst, uint32_t width, uint32_t height, size_t pitch)
+{
+    const uint8_t* end = src + size;
+    uint32_t x, y, i, count;
+
+    for (y = 0; y < height; ++y)
+    {
+        uint8_t* row = dst + y * pitch;
+
+        x = 0;
+        while (x < width)
+        {
+            uint32_t header;
+            if (src >= end) return 0;
+            header = *src++;
+
+            if (header >= 128u)
+            {
+                count = header - 126u;
+                if (x + count > width || src + 4 > end) return 0;
+                for (i = 0; i < count; ++i)
+                {
+                    memcpy(row + (x + i) * 4u, src, 4);
+                }
+                src += 4;
+            }
+            else
+            {
+                count = header + 1u;
+                if (x + count > width || src + count * 4u > end) return 0;
+                memcpy(row + x * 4u, src, count * 4u);
+                src += count * 4u;
+            }
+            x += count;
+        }
+    }
+
+    return src == end;
+}
+
+
+static int udd_stream_apply_copy(UddStreamDecoder* decoder, const UddStreamCopy* copy)
+{
+    const int32_t width = (int32_t)decoder->hello.width;
+    const int32_t height = (int32_t)decoder->hello.height;
+    const size_t pitch = (size_t)width * 4u;
+    const int32_t w = copy->right - copy->left;
+    const int32_t h = copy->bottom - copy->top;
+    int32_t row;
+
+    if (w <= 0 || h <= 0 ||
+        copy->left < 0 || copy->top < 0 || copy->right > width || copy->bottom > height ||
+        copy->srcX < 0 || copy->srcY < 0 || copy->srcX + w > width || copy->srcY + h > height)
+    {
+        return 0;
+    }
+
+    /* Source and destination may overlap, so rows are walked away from the destination. */
+    for (row = 0; row < h; ++row)
+    {
+        const int32_t r = (copy->top > copy->srcY) ? (h - 1 - row) : row;
+        memmove(
+            decoder->image + (size_t)(copy->top + r) * pitch + (size_t)copy->left * 4u,
+            decoder->image + (size_t)(copy->srcY + r) * pitch + (size_t)copy->srcX * 4u,
+            (size_t)w * 4u);
+    }
+
+    return 1;
+}
+
+
+static int udd_stream_apply_tile(UddStreamDecoder* decoder, const uint8_t* data, size_t size)
+{
+    UddStreamTile tile;
+    const uint8_t* payload = data + sizeof(tile);
+    const size_t payloadSize = size - sizeof(tile);
+    const size_t pitch = (size_t)decoder->hello.width * 4u;
+    uint8_t* dst;
+    uint32_t x, y;
+
+    if (size < sizeof(tile)) return 0;
+    memcpy(&tile, data, sizeof(tile));
+
+    if (tile.width == 0 || tile.height == 0 ||
+        (uint32_t)tile.x + tile.width > decoder->hello.width ||
+        (uint32_t)tile.y + tile.height > decoder->hello.height)
+    {
+        return 0;
+    }
+
+    dst = decoder->image + (size_t)tile.y * pitch + (size_t)tile.x * 4u;
+
+    switch (tile.encoding)
+    {
+        case UDD_STREAM_TILE_SOLID:
+            if (payloadSize != 4) return 0;
+            for (y = 0; y < tile.height; ++y)
+            {
+                for (x = 0; x < tile.width; ++x)
+                {
+                    memcpy(dst + y * pitch + x * 4u, payload, 4);
+                }
+            }
+            return 1;
+        case UDD_STREAM_TILE_RLE:
+            return udd_stream_decode_rle(payload, payloadSize, dst, tile.width, tile.height, pitch);
+        case UDD_STREAM_TILE_RAW:
+            if (payloadSize != (size_t)tile.width * tile.height * 4u) return 0;
+            for (y = 0; y < tile.height; ++y)
+            {
+                memcpy(dst + y * pitch, payload + (size_t)y * tile.width * 4u, (size_t)tile.width * 4u);
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+
+/* Returns 1 when a frame was completed, 0 otherwise and -1 on error. */
+static int udd_stream_handle_message(UddStreamDecoder* decoder, uint32_t type, const uint8_t* data, size_t size)
+{
+    if (type == UDD_STREAM_MESSAGE_HELLO)
+    {
+        size_t imageSize;
+
+        if (size < sizeof(UddStreamHello) || decoder->inFrame) return -1;
+        memcpy(&decoder->hello, data, sizeof(UddStreamHello));
+        if (decoder->hello.magic != UDD_STREAM_MAGIC || decoder->hello.version != UDD_STREAM_VERSION) return -1;
+        if (decoder->hello.width == 0 || decoder->hello.height == 0) return -1;
+
+        imageSize = (size_t)decoder->hello.width * decoder->hello.height * 4u;
+        free(decoder->image);
+        decoder->image = (uint8_t*)calloc(1, imageSize);
+        if (!decoder->image) return -1;
+
+        decoder->hasHello = 1;
+        return 0;
+    }
+
+    if (!decoder->hasHello) return -1;
+
+    switch (type)
+    {
+        case UDD_STREAM_MESSAGE_FRAME_BEGIN:
+            if (decoder->inFrame || size < sizeof(UddStreamFrameBegin)) return -1;
+            memcpy(&decoder->frame, data, sizeof(UddStreamFrameBegin));
+            decoder->copiesLeft = decoder->frame.copyCount;
+            decoder->tilesLeft = decoder->frame.tileCount;
+            decoder->inFrame = 1;
+            return 0;
+        case UDD_STREAM_MESSAGE_COPY:
+        {
+            UddStreamCopy copy;
+            if (!decoder->inFrame || decoder->copiesLeft == 0 || size < sizeof(copy)) return -1;
+            memcpy(&copy, data, sizeof(copy));
+            if (!udd_stream_apply_copy(decoder, &copy)) return -1;
+            --decoder->copiesLeft;
+            return 0;
+        }
+        case UDD_STREAM_MESSAGE_TILE:
+            if (!decoder->inFrame || decoder->copiesLeft != 0 || decoder->tilesLeft == 0) return -1;
+            if (!udd_stream_apply_tile(decoder, data, size)) return -1;
+            --decoder->tilesLeft;
+            return 0;
+        case UDD_STREAM_MESSAGE_FRAME_END:
+            if (!decoder->inFrame || decoder->copiesLeft != 0 || decoder->tilesLeft != 0) return -1;
+            decoder->inFrame = 0;
+            decoder->lastFrame = decoder->frame;
+            return 1;
+        default:
+            /* Unknown messages are skipped for forward compatibility. */
+            return 0;
+    }
+}
+
+
+UddStreamDecoder* udd_stream_decoder_create(void)
+{
+    return (UddStreamDecoder*)calloc(1, sizeof(UddStreamDecoder));
+}
+
+
+void udd_stream_decoder_destroy(UddStreamDecoder* decoder)
+{
+    if (!decoder) return;
+    free(decoder->pending);
+    free(decoder->image);
+    free(decoder);
+}
+
+
+int udd_stream_decoder_feed(UddStreamDecoder* decoder, const void* data, size_t size)
+{
+    const uint8_t* src = (const uint8_t*)data;
+    const uint8_t* end = src + size;
+    int frames = 0;
+
+    if (!decoder || (!data && size > 0)) return -1;
+
+    while (src < end)
+    {
+        UddStreamMessageHeader header;
+        size_t needed, chunk;
+        int result;
+
+        /* Messages are handled in place when they are complete in the given data. */
+        if (decoder->pendingSize == 0 && (size_t)(end - src) >= sizeof(header))
+        {
+            memcpy(&header, src, sizeof(header));
+            if (header.size > UDD_STREAM_MAX_MESSAGE_SIZE) return -1;
+            if ((size_t)(end - src) >= sizeof(header) + header.size)
+            {
+                result = udd_stream_handle_message(decoder, header.type, src + sizeof(header), header.size);
+                if (result < 0) return -1;
+                frames += result;
+                src += sizeof(header) + header.size;
+                continue;
+            }
+        }
+
+        /* Otherwise the partial message is accumulated until the rest arrives. */
+        needed = sizeof(header);
+        if (decoder->pendingSize >= sizeof(header))
+        {
+            memcpy(&header, decoder->pending, sizeof(header));
+            if (header.size > UDD_STREAM_MAX_MESSAGE_SIZE) return -1;
+            needed += header.size;
+        }
+
+        if (decoder->pendingCapacity < needed)
+        {
+            const size_t capacity = sizeof(header) + UDD_STREAM_MAX_MESSAGE_SIZE;
+            uint8_t* pending = (uint8_t*)realloc(decoder->pending, capacity);
+            if (!pending) return -1;
+            decoder->pending = pending;
+            decoder->pendingCapacity = capacity;
+        }
+
+        chunk = needed - decoder->pendingSize;
+        if (chunk > (size_t)(end - src)) chunk = (size_t)(end - src);
+        memcpy(decoder->pending + decoder->pendingSize, src, chunk);
+        decoder->pendingSize += chunk;
+        src += chunk;
+
+        if (decoder->pendingSize >= sizeof(header))
+        {
+            memcpy(&header, decoder->pending, sizeof(header));
+            if (header.size > UDD_STREAM_MAX_MESSAGE_SIZE) return -1;
+            if (decoder->pendingSize == sizeof(header) + header.size)
+            {
+                result = udd_stream_handle_message(decoder, header.type, decoder->pending + sizeof(header), header.size);
+                decoder->pendingSize = 0;
+                if (result < 0) return -1;
+                frames += result;
+            }
+        }
+    }
+
+    return frames;
+}
+
+
+const UddStreamHello* udd_stream_decoder_get_hello(const UddStreamDecoder* decoder)
+{
+    return (decoder && decoder->hasHello) ? &decoder->hello : NULL;
+}
+
+
+const uint8_t* udd_stream_decoder_get_image(const UddStreamDecoder* decoder)
+{
+    return decoder ? decoder->image : NULL;
+}
+
+
+const UddStreamFrameBegin* udd_stream_decoder_get_last_frame(const UddStreamDecoder* decoder)
+{
+    return decoder ? &decoder->lastFrame : NULL;
+}
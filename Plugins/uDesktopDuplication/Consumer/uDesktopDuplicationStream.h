@@ -0,0 +1,120 @@
+#pragma once
+
+/*
+ * Tile-delta streaming protocol of uDesktopDuplication.
+ *
+ * The plugin's stream server sends a Hello message once a client connects and
+ * then a sequence of frames. Every frame is FrameBegin, Copy x copyCount,
+ * Tile x tileCount and FrameEnd. Copies must be applied in order before the
+ * tiles, exactly like DXGI move rects. All values are little endian and every
+ * message starts with a UddStreamMessageHeader whose size excludes itself.
+ *
+ * Pixels are B8G8R8A8 in the unrotated desktop image. Tiles are encoded as
+ *   SOLID : one pixel repeated over the whole tile
+ *   RLE   : PackBits-like runs in pixel units, one header byte per token;
+ *           0-127 means (header + 1) literal pixels follow, 128-255 means the
+ *           following pixel is repeated (header - 126) times. Runs never cross rows.
+ *   RAW   : tightly packed rows
+ *
+ * This header also declares a small decoder implemented in uDesktopDuplicationStream.c
+ * which reconstructs the desktop image from the received byte stream.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UDD_STREAM_MAGIC 0x54534455u /* "UDST" */
+#define UDD_STREAM_VERSION 1u
+#define UDD_STREAM_TILE_SIZE 64u
+#define UDD_STREAM_MAX_MESSAGE_SIZE (UDD_STREAM_TILE_SIZE * UDD_STREAM_TILE_SIZE * 4u + 64u)
+
+enum
+{
+    UDD_STREAM_MESSAGE_HELLO = 1,
+    UDD_STREAM_MESSAGE_FRAME_BEGIN = 2,
+    UDD_STREAM_MESSAGE_COPY = 3,
+    UDD_STREAM_MESSAGE_TILE = 4,
+    UDD_STREAM_MESSAGE_FRAME_END = 5,
+};
+
+enum
+{
+    UDD_STREAM_TILE_SOLID = 0,
+    UDD_STREAM_TILE_RLE = 1,
+    UDD_STREAM_TILE_RAW = 2,
+};
+
+#pragma pack(push, 1)
+typedef struct UddStreamMessageHeader
+{
+    uint32_t type;
+    uint32_t size;
+} UddStreamMessageHeader;
+
+typedef struct UddStreamHello
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;   /* DXGI_FORMAT (87 = B8G8R8A8_UNORM) */
+    uint32_t rotation; /* DXGI_MODE_ROTATION of the monitor */
+    uint32_t tileSize;
+} UddStreamHello;
+
+typedef struct UddStreamFrameBegin
+{
+    uint64_t frameId;
+    int64_t captureTime; /* [us] steady clock of the server when the frame was rendered */
+    uint32_t copyCount;
+    uint32_t tileCount;
+} UddStreamFrameBegin;
+
+typedef struct UddStreamCopy
+{
+    int32_t srcX;
+    int32_t srcY;
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+} UddStreamCopy;
+
+typedef struct UddStreamTile
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint32_t encoding;
+    /* followed by the encoded pixels */
+} UddStreamTile;
+#pragma pack(pop)
+
+
+
+/* Decoder API */
+
+typedef struct UddStreamDecoder UddStreamDecoder;
+
+UddStreamDecoder* udd_stream_decoder_create(void);
+void udd_stream_decoder_destroy(UddStreamDecoder* decoder);
+
+/* Consumes received bytes (any split is allowed).
+ * Returns the number of frames completed by this call or -1 on a protocol error. */
+int udd_stream_decoder_feed(UddStreamDecoder* decoder, const void* data, size_t size);
+
+/* Returns NULL until Hello has been received. */
+const UddStreamHello* udd_stream_decoder_get_hello(const UddStreamDecoder* decoder);
+
+/* Image updated in place (rows of width * 4 bytes); it is consistent whenever no frame is in progress. */
+const uint8_t* udd_stream_decoder_get_image(const UddStreamDecoder* decoder);
+const UddStreamFrameBegin* udd_stream_decoder_get_last_frame(const UddStreamDecoder* decoder);
+
+#ifdef __cplusplus
+}
+#endif
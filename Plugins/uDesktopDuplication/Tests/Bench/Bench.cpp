@@ -0,0 +1,601 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+
+#include "Common.h"
+#include "Crop.h"
+#include "FramePool.h"
+#include "Kernels.h"
+
+
+
+// Benchmarks of the CPU paths of the plugin which do not need a D3D11 device.
+//
+// Usage: uDesktopDuplicationBench [options]
+//   --filter <text>        run only the benchmarks whose name contains text
+//   --quick                short runs (smoke test)
+//   --list                 print the benchmark names and exit
+//   --json <path>          write the results as JSON
+//   --compare <path>       compare with a JSON file written by --json before; returns 1 when a
+//                          benchmark got slower than the baseline by more than the threshold
+//   --threshold <ratio>    allowed slowdown for --compare (default 0.15 = 15%)
+
+namespace
+{
+
+
+struct Benchmark
+{
+    std::string name;
+    double bytesPerOp; // 0 if throughput is meaningless
+    std::function<void()> run;
+};
+
+
+struct Result
+{
+    std::string name;
+    double nsPerOp;
+    double mbPerSec;
+    UINT64 iterations;
+};
+
+
+struct Options
+{
+    std::string filter;
+    bool isQuick = false;
+    bool isList = false;
+    std::string jsonPath;
+    std::string comparePath;
+    double threshold = 0.15;
+};
+
+
+// Keeps the compiler from dropping work whose result is never read.
+void Touch(const void* p)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "g"(p) : "memory");
+#else
+    static volatile const void* sink;
+    sink = p;
+#endif
+}
+
+
+// The batch size is doubled until a batch takes minBatchTime, then the median of sampleCount
+// batches is taken so that a single preemption does not move the result.
+Result Run(const Benchmark& benchmark, const Options& options)
+{
+    using namespace std::chrono;
+
+    const auto minBatchTime = options.isQuick ? microseconds(500) : microseconds(20000);
+    const auto sampleCount = options.isQuick ? 3 : 7;
+
+    const auto runBatch = [&](UINT64 count)
+    {
+        const auto start = steady_clock::now();
+        for (UINT64 i = 0; i < count; ++i)
+        {
+            benchmark.run();
+        }
+        return duration<double, std::nano>(steady_clock::now() - start).count();
+    };
+
+    UINT64 count = 1;
+    while (runBatch(count) < duration<double, std::nano>(minBatchTime).count() && count < (1ull << 40))
+    {
+        count *= 2;
+    }
+
+    std::vector<double> samples;
+    for (int i = 0; i < sampleCount; ++i)
+    {
+        samples.push_back(runBatch(count) / count);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = benchmark.name;
+    result.nsPerOp = samples[samples.size() / 2];
+    result.mbPerSec = (benchmark.bytesPerOp > 0.0) ? benchmark.bytesPerOp / result.nsPerOp * 1e3 : 0.0;
+    result.iterations = count * sampleCount;
+    return result;
+}
+
+
+
+// Benchmarks
+
+const char* GetRotationName(uint32_t rotation)
+{
+    switch (rotation)
+    {
+        case Kernels::Rotation90: return "Rotate90";
+        case Kernels::Rotation180: return "Rotate180";
+        case Kernels::Rotation270: return "Rotate270";
+        default: return "Identity";
+    }
+}
+
+
+const uint32_t kRotations[] =
+{
+    Kernels::RotationIdentity,
+    Kernels::Rotation90,
+    Kernels::Rotation180,
+    Kernels::Rotation270,
+};
+
+
+std::vector<uint8_t> MakeNoise(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    for (auto& value : data)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        value = static_cast<uint8_t>(seed);
+    }
+    return data;
+}
+
+
+// Kernels::CompositeCursor() per pointer shape type and rotation (Cursor::UpdateTexture())
+void AddCompositeCursor(std::vector<Benchmark>& benchmarks)
+{
+    constexpr int kSize = 64;
+
+    struct ShapeType
+    {
+        uint32_t type;
+        const char* name;
+        uint32_t pitch;
+        int bufferHeight;
+    };
+    const ShapeType shapeTypes[] =
+    {
+        { Kernels::PointerShapeMonochrome, "Monochrome", kSize / 8, kSize * 2 }, // AND + XOR masks
+        { Kernels::PointerShapeColor, "Color", kSize * 4, kSize },
+        { Kernels::PointerShapeMaskedColor, "MaskedColor", kSize * 4, kSize },
+    };
+
+    const auto desktop = std::make_shared<std::vector<uint8_t>>(MakeNoise(kSize * kSize * 4, 1));
+    const auto output = std::make_shared<std::vector<uint8_t>>(kSize * kSize * 4);
+
+    for (const auto& shapeType : shapeTypes)
+    {
+        const auto shape = std::make_shared<std::vector<uint8_t>>(MakeNoise(shapeType.pitch * shapeType.bufferHeight, 2));
+        for (const auto rotation : kRotations)
+        {
+            const auto type = shapeType.type;
+            const auto pitch = shapeType.pitch;
+            benchmarks.push_back({
+                std::string("CompositeCursor/") + shapeType.name + "/" + GetRotationName(rotation) + "/64x64",
+                kSize * kSize * 4.0,
+                [=]
+                {
+                    Kernels::CompositeCursor(
+                        type, rotation, desktop->data(), kSize * 4, shape->data(), pitch,
+                        kSize, kSize, 0, 0, kSize, kSize, output->data());
+                    Touch(output->data());
+                },
+            });
+        }
+    }
+}
+
+
+// Kernels::CopyPixelsToRgba() per rotation and region size (Monitor::GetPixels()).
+// The region is placed the way Monitor::GetPixels() maps (x, y) = (8, 8) on a 1920x1080 monitor.
+void AddCopyPixelsToRgba(std::vector<Benchmark>& benchmarks)
+{
+    constexpr int kMonitorWidth = 1920;
+    constexpr int kMonitorHeight = 1080;
+
+    const auto image = std::make_shared<std::vector<uint8_t>>(MakeNoise(kMonitorWidth * kMonitorHeight * 4, 3));
+    const auto output = std::make_shared<std::vector<uint8_t>>(kMonitorWidth * kMonitorHeight * 4);
+
+    const int sizes[][2] = { { 64, 64 }, { 512, 512 }, { 1280, 720 }, { 1904, 1064 } };
+    for (const auto rotation : kRotations)
+    {
+        const auto isVertical = rotation == Kernels::Rotation90 || rotation == Kernels::Rotation270;
+        const auto imageWidth = isVertical ? kMonitorHeight : kMonitorWidth;
+        const auto monitorWidth = kMonitorWidth;
+        const auto monitorHeight = kMonitorHeight;
+
+        for (const auto& size : sizes)
+        {
+            const int x = 8, y = 8, width = size[0], height = size[1];
+            int left, top, right, bottom;
+            switch (rotation)
+            {
+                case Kernels::Rotation90:
+                    left = y; top = monitorWidth - x - width; right = y + width - 1; bottom = monitorWidth - x - 1;
+                    break;
+                case Kernels::Rotation180:
+                    left = monitorWidth - x - width; top = monitorHeight - y - height;
+                    right = monitorWidth - x - 1; bottom = monitorHeight - y - 1;
+                    break;
+                case Kernels::Rotation270:
+                    left = monitorHeight - y - height; top = x; right = monitorHeight - y - 1; bottom = x + width - 1;
+                    break;
+                default:
+                    left = x; top = y; right = x + width - 1; bottom = y + height - 1;
+                    break;
+            }
+
+            benchmarks.push_back({
+                std::string("CopyPixelsToRgba/") + GetRotationName(rotation) + "/" +
+                    std::to_string(width) + "x" + std::to_string(height),
+                width * height * 4.0,
+                [=]
+                {
+                    Kernels::CopyPixelsToRgba(
+                        image->data(), imageWidth * 4, rotation, left, top, right, bottom, width, height, output->data());
+                    Touch(output->data());
+                },
+            });
+        }
+    }
+}
+
+
+// Buffer<T> (Common.h) growth from 1 KB to 16 MB and copies
+void AddBuffer(std::vector<Benchmark>& benchmarks)
+{
+    benchmarks.push_back({
+        "Buffer/Grow/1KB-16MB",
+        0.0,
+        []
+        {
+            Buffer<BYTE> buffer;
+            for (UINT size = 1024; size <= 16u * 1024 * 1024; size *= 2)
+            {
+                buffer.ExpandIfNeeded(size);
+            }
+            Touch(buffer.Get());
+        },
+    });
+
+    // The per-frame path of Duplicator::Publish(): the buffer is already large enough.
+    const auto buffer = std::make_shared<Buffer<BYTE>>();
+    buffer->ExpandIfNeeded(4096);
+    benchmarks.push_back({
+        "Buffer/ExpandIfNeeded/NoGrowth",
+        0.0,
+        [=]
+        {
+            buffer->ExpandIfNeeded(2048);
+            Touch(buffer->Get());
+        },
+    });
+
+    for (const UINT size : { 4096u, 1024u * 1024u, 8u * 1024u * 1024u })
+    {
+        const auto source = std::make_shared<Buffer<BYTE>>();
+        const auto destination = std::make_shared<Buffer<BYTE>>();
+        source->ExpandIfNeeded(size);
+        benchmarks.push_back({
+            "Buffer/CopyAssign/" + std::to_string(size / 1024) + "KB",
+            static_cast<double>(size),
+            [=]
+            {
+                *destination = *source;
+                Touch(destination->Get());
+            },
+        });
+    }
+}
+
+
+// Move / dirty rect metadata as Duplicator::Publish() copies it into a FramePool slot and
+// Duplicator::CopyMoveRects() / CopyDirtyRects() copy it out for C#.
+void AddMetadata(std::vector<Benchmark>& benchmarks)
+{
+    // Same layout as Duplicator::Metadata and Duplicator::Frame
+    struct Metadata
+    {
+        Buffer<BYTE> buffer;
+        UINT moveRectSize = 0;
+        UINT dirtyRectSize = 0;
+    };
+
+    struct Frame
+    {
+        UINT id = 0;
+        Metadata metaData;
+    };
+
+    for (const UINT count : { 4u, 64u, 512u })
+    {
+        const auto source = std::make_shared<Metadata>();
+        source->moveRectSize = count / 4 * sizeof(DXGI_OUTDUPL_MOVE_RECT);
+        source->dirtyRectSize = (count - count / 4) * sizeof(RECT);
+        source->buffer.ExpandIfNeeded(source->moveRectSize + source->dirtyRectSize);
+
+        const auto pool = std::make_shared<FramePool<Frame>>(3);
+        const auto moveRects = std::make_shared<std::vector<DXGI_OUTDUPL_MOVE_RECT>>(count);
+        const auto dirtyRects = std::make_shared<std::vector<RECT>>(count);
+
+        benchmarks.push_back({
+            "Metadata/PublishAndCopy/" + std::to_string(count) + "Rects",
+            static_cast<double>(source->moveRectSize + source->dirtyRectSize) * 2.0,
+            [=]
+            {
+                const auto slot = pool->BeginWrite();
+                auto& frame = pool->GetResource(slot);
+                const UINT size = source->moveRectSize + source->dirtyRectSize;
+                frame.metaData.buffer.ExpandIfNeeded(size);
+                std::memcpy(frame.metaData.buffer.Get(), source->buffer.Get(), size);
+                frame.metaData.moveRectSize = source->moveRectSize;
+                frame.metaData.dirtyRectSize = source->dirtyRectSize;
+                ++frame.id;
+                pool->EndWrite(slot);
+
+                const auto lease = pool->AcquireLatest();
+                const auto& metaData = lease->metaData;
+                std::memcpy(moveRects->data(), metaData.buffer.Get(), metaData.moveRectSize);
+                std::memcpy(dirtyRects->data(), metaData.buffer.Get(metaData.moveRectSize), metaData.dirtyRectSize);
+                Touch(moveRects->data());
+                Touch(dirtyRects->data());
+            },
+        });
+    }
+}
+
+
+// Crop::CropRects() as Duplicator::CropMetadata() runs it for every cropped frame
+void AddCropRects(std::vector<Benchmark>& benchmarks)
+{
+    const RECT crop = { 320, 180, 1600, 900 };
+
+    for (const size_t count : { 4u, 64u, 512u })
+    {
+        const auto moves = std::make_shared<std::vector<DXGI_OUTDUPL_MOVE_RECT>>(count / 4);
+        const auto dirties = std::make_shared<std::vector<RECT>>(count - count / 4);
+        uint32_t seed = 4;
+        const auto next = [&](int max)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            return static_cast<LONG>(seed % static_cast<uint32_t>(max));
+        };
+        for (auto& move : *moves)
+        {
+            const auto left = next(1700), top = next(900);
+            move.DestinationRect = { left, top, left + 1 + next(200), top + 1 + next(160) };
+            move.SourcePoint = { left + next(40) - 20, top + next(40) - 20 };
+        }
+        for (auto& dirty : *dirties)
+        {
+            const auto left = next(1800), top = next(1000);
+            dirty = { left, top, left + 1 + next(120), top + 1 + next(80) };
+        }
+
+        const auto outMoves = std::make_shared<std::vector<DXGI_OUTDUPL_MOVE_RECT>>(count);
+        const auto outDirties = std::make_shared<std::vector<RECT>>(count);
+        benchmarks.push_back({
+            "CropRects/" + std::to_string(count) + "Rects",
+            0.0,
+            [=]
+            {
+                size_t moveCount = 0, dirtyCount = 0;
+                Crop::CropRects(
+                    crop, moves->data(), moves->size(), dirties->data(), dirties->size(),
+                    outMoves->data(), &moveCount, outDirties->data(), &dirtyCount);
+                Touch(outMoves->data());
+                Touch(outDirties->data());
+            },
+        });
+    }
+}
+
+
+
+// JSON
+
+std::string Escape(const std::string& text)
+{
+    std::string result;
+    for (const auto c : text)
+    {
+        if (c == '"' || c == '\\') result += '\\';
+        result += c;
+    }
+    return result;
+}
+
+
+bool WriteJson(const std::string& path, const std::vector<Result>& results)
+{
+    std::ofstream fs(path, std::ios::trunc);
+    fs << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& result = results[i];
+        char line[512];
+        std::snprintf(line, sizeof(line),
+            "    { \"name\": \"%s\", \"ns_per_op\": %.3f, \"mb_per_s\": %.1f, \"iterations\": %llu }%s\n",
+            Escape(result.name).c_str(), result.nsPerOp, result.mbPerSec,
+            static_cast<unsigned long long>(result.iterations), (i + 1 < results.size()) ? "," : "");
+        fs << line;
+    }
+    fs << "  ]\n}\n";
+    return fs.good();
+}
+
+
+// Reads what WriteJson() writes: every "name" is paired with the following "ns_per_op".
+bool ReadJson(const std::string& path, std::map<std::string, double>& nsPerOp)
+{
+    std::ifstream fs(path);
+    if (!fs) return false;
+    std::stringstream ss;
+    ss << fs.rdbuf();
+    const auto text = ss.str();
+
+    size_t position = 0;
+    while ((position = text.find("\"name\"", position)) != std::string::npos)
+    {
+        const auto begin = text.find('"', text.find(':', position) + 1);
+        std::string name;
+        size_t i = begin + 1;
+        for (; i < text.size() && text[i] != '"'; ++i)
+        {
+            if (text[i] == '\\' && i + 1 < text.size()) ++i;
+            name += text[i];
+        }
+
+        const auto key = text.find("\"ns_per_op\"", i);
+        if (begin == std::string::npos || key == std::string::npos) return false;
+        nsPerOp[name] = std::strtod(text.c_str() + text.find(':', key) + 1, nullptr);
+        position = key;
+    }
+    return !nsPerOp.empty();
+}
+
+
+// Returns the number of regressions.
+int Compare(const std::vector<Result>& results, const std::map<std::string, double>& baseline, double threshold)
+{
+    int regressionCount = 0;
+    std::printf("\n%-48s %12s %12s %8s\n", "Comparison", "Baseline", "Current", "Change");
+    for (const auto& result : results)
+    {
+        const auto it = baseline.find(result.name);
+        if (it == baseline.end())
+        {
+            std::printf("%-48s %12s %10.1fns %8s\n", result.name.c_str(), "-", result.nsPerOp, "new");
+            continue;
+        }
+
+        const auto ratio = result.nsPerOp / it->second;
+        const char* verdict = "";
+        if (ratio > 1.0 + threshold)
+        {
+            verdict = "  REGRESSION";
+            ++regressionCount;
+        }
+        else if (ratio < 1.0 - threshold)
+        {
+            verdict = "  improved";
+        }
+        std::printf("%-48s %10.1fns %10.1fns %+7.1f%%%s\n",
+            result.name.c_str(), it->second, result.nsPerOp, (ratio - 1.0) * 100.0, verdict);
+    }
+    return regressionCount;
+}
+
+
+bool ParseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto hasValue = i + 1 < argc;
+        if (arg == "--quick") options.isQuick = true;
+        else if (arg == "--list") options.isList = true;
+        else if (arg == "--filter" && hasValue) options.filter = argv[++i];
+        else if (arg == "--json" && hasValue) options.jsonPath = argv[++i];
+        else if (arg == "--compare" && hasValue) options.comparePath = argv[++i];
+        else if (arg == "--threshold" && hasValue) options.threshold = std::atof(argv[++i]);
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+
+}
+
+
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) return 2;
+
+    std::map<std::string, double> baseline;
+    if (!options.comparePath.empty() && !ReadJson(options.comparePath, baseline))
+    {
+        std::fprintf(stderr, "Could not read the baseline %s.\n", options.comparePath.c_str());
+        return 2;
+    }
+
+    std::vector<Benchmark> benchmarks;
+    AddCompositeCursor(benchmarks);
+    AddCopyPixelsToRgba(benchmarks);
+    AddBuffer(benchmarks);
+    AddMetadata(benchmarks);
+    AddCropRects(benchmarks);
+
+    std::vector<Result> results;
+    for (const auto& benchmark : benchmarks)
+    {
+        if (benchmark.name.find(options.filter) == std::string::npos) continue;
+
+        if (options.isList)
+        {
+            std::printf("%s\n", benchmark.name.c_str());
+            continue;
+        }
+
+        const auto result = Run(benchmark, options);
+        results.push_back(result);
+        if (result.mbPerSec > 0.0)
+        {
+            std::printf("%-48s %12.1f ns/op %10.1f MB/s\n", result.name.c_str(), result.nsPerOp, result.mbPerSec);
+        }
+        else
+        {
+            std::printf("%-48s %12.1f ns/op\n", result.name.c_str(), result.nsPerOp);
+        }
+        std::fflush(stdout);
+    }
+
+    if (options.isList) return 0;
+
+    if (results.empty())
+    {
+        std::fprintf(stderr, "No benchmark matched.\n");
+        return 2;
+    }
+
+    if (!options.jsonPath.empty() && !WriteJson(options.jsonPath, results))
+    {
+        std::fprintf(stderr, "Could not write %s.\n", options.jsonPath.c_str());
+        return 2;
+    }
+
+    if (!baseline.empty())
+    {
+        const auto regressionCount = Compare(results, baseline, options.threshold);
+        if (regressionCount > 0)
+        {
+            std::printf("\n%d benchmark(s) are slower than the baseline by more than %.0f%%.\n",
+                regressionCount, options.threshold * 100.0);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,465 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Test.h"
+#include "Codec.h"
+#include "Kernels.h"
+
+
+
+namespace
+{
+
+
+struct Image
+{
+    Image(UINT width, UINT height, UINT padding = 0)
+        : width(width)
+        , height(height)
+        , pitch((width + padding) * 4)
+        , pixels(pitch * height, 0xCD)
+    {
+    }
+
+    uint32_t& At(UINT x, UINT y)
+    {
+        return reinterpret_cast<uint32_t*>(&pixels[y * pitch])[x];
+    }
+
+    UINT width;
+    UINT height;
+    UINT pitch;
+    std::vector<BYTE> pixels;
+};
+
+
+// Decoder written from the QOI specification (https://qoiformat.org/qoi-specification.pdf),
+// independent of the encoder. Outputs RGB triplets.
+bool DecodeQoi(const std::vector<BYTE>& data, UINT& width, UINT& height, std::vector<BYTE>& rgb)
+{
+    const auto readU32 = [&](size_t offset)
+    {
+        return (static_cast<UINT>(data[offset]) << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) | data[offset + 3];
+    };
+
+    if (data.size() < 14 + 8 || std::memcmp(data.data(), "qoif", 4) != 0) return false;
+    width = readU32(4);
+    height = readU32(8);
+    if (data[12] != 3 && data[12] != 4) return false;
+
+    struct Rgba { BYTE r, g, b, a; };
+    Rgba index[64] = {};
+    Rgba px = { 0, 0, 0, 255 };
+    int run = 0;
+
+    const auto end = data.size() - 8;
+    size_t p = 14;
+    rgb.clear();
+    rgb.reserve(static_cast<size_t>(width) * height * 3);
+
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i)
+    {
+        if (run > 0)
+        {
+            --run;
+        }
+        else
+        {
+            if (p >= end) return false;
+            const BYTE b1 = data[p++];
+            if (b1 == 0xFE)
+            {
+                if (p + 3 > end) return false;
+                px.r = data[p++];
+                px.g = data[p++];
+                px.b = data[p++];
+            }
+            else if (b1 == 0xFF)
+            {
+                if (p + 4 > end) return false;
+                px.r = data[p++];
+                px.g = data[p++];
+                px.b = data[p++];
+                px.a = data[p++];
+            }
+            else if ((b1 & 0xC0) == 0x00)
+            {
+                px = index[b1];
+            }
+            else if ((b1 & 0xC0) == 0x40)
+            {
+                px.r += ((b1 >> 4) & 0x03) - 2;
+                px.g += ((b1 >> 2) & 0x03) - 2;
+                px.b += (b1 & 0x03) - 2;
+            }
+            else if ((b1 & 0xC0) == 0x80)
+            {
+                if (p >= end) return false;
+                const BYTE b2 = data[p++];
+                const int vg = (b1 & 0x3F) - 32;
+                px.r += vg - 8 + ((b2 >> 4) & 0x0F);
+                px.g += vg;
+                px.b += vg - 8 + (b2 & 0x0F);
+            }
+            else
+            {
+                run = b1 & 0x3F;
+            }
+            index[(px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64] = px;
+        }
+
+        rgb.push_back(px.r);
+        rgb.push_back(px.g);
+        rgb.push_back(px.b);
+    }
+
+    static const BYTE kEndMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    return p == end && std::memcmp(data.data() + end, kEndMarker, 8) == 0;
+}
+
+
+// Alpha and the row padding of the source must not affect the output.
+bool RoundTrip(const Image& image, size_t* encodedSize = nullptr)
+{
+    std::vector<BYTE> data;
+    Codec::EncodeQoi(image.pixels.data(), image.width, image.height, image.pitch, data);
+    if (encodedSize) *encodedSize = data.size();
+
+    UINT width = 0, height = 0;
+    std::vector<BYTE> rgb;
+    if (!DecodeQoi(data, width, height, rgb)) return false;
+    if (width != image.width || height != image.height) return false;
+
+    for (UINT y = 0; y < height; ++y)
+    {
+        const auto row = &image.pixels[y * image.pitch];
+        for (UINT x = 0; x < width; ++x)
+        {
+            const auto out = &rgb[(y * width + x) * 3];
+            if (out[0] != row[x * 4 + 2] || out[1] != row[x * 4 + 1] || out[2] != row[x * 4 + 0]) return false;
+        }
+    }
+    return true;
+}
+
+
+// Windows with title bars, text-like strokes and a gradient wallpaper
+void DrawDesktop(Image& image, Test::Random& random)
+{
+    for (UINT y = 0; y < image.height; ++y)
+    {
+        for (UINT x = 0; x < image.width; ++x)
+        {
+            image.At(x, y) = 0xFF000000u | ((x * 255 / image.width) << 16) | ((y * 255 / image.height) << 8) | 0x60;
+        }
+    }
+
+    for (int w = 0; w < 6; ++w)
+    {
+        const auto left = random.Range(0, image.width / 2);
+        const auto top = random.Range(0, image.height / 2);
+        const auto right = (std::min)(image.width, static_cast<UINT>(left + random.Range(64, image.width / 2)));
+        const auto bottom = (std::min)(image.height, static_cast<UINT>(top + random.Range(48, image.height / 2)));
+        for (UINT y = top; y < bottom; ++y)
+        {
+            for (UINT x = left; x < right; ++x)
+            {
+                const auto isTitle = y < static_cast<UINT>(top + 20);
+                const auto isText = !isTitle && (y % 14) < 9 && ((x * 7 + y * 3) % 11) < 3;
+                image.At(x, y) = isTitle ? 0xFF2B579Au : isText ? 0xFF101010u : 0xFFFFFFFFu;
+            }
+        }
+    }
+}
+
+
+// Decodes into a poisoned image with another padding to catch writes outside of the rect.
+bool RoundTripRle(const Image& image, size_t* encodedSize = nullptr)
+{
+    std::vector<BYTE> data;
+    Codec::EncodeRle(image.pixels.data(), image.width, image.height, image.pitch, data);
+    if (encodedSize) *encodedSize = data.size();
+
+    Image decoded(image.width, image.height, 3);
+    if (!Codec::DecodeRle(data.data(), static_cast<UINT>(data.size()), decoded.pixels.data(), image.width, image.height, decoded.pitch))
+    {
+        return false;
+    }
+
+    for (UINT y = 0; y < image.height; ++y)
+    {
+        if (std::memcmp(&image.pixels[y * image.pitch], &decoded.pixels[y * decoded.pitch], image.width * 4) != 0) return false;
+        for (UINT i = image.width * 4; i < decoded.pitch; ++i)
+        {
+            if (decoded.pixels[y * decoded.pitch + i] != 0xCD) return false;
+        }
+    }
+    return true;
+}
+
+
+}
+
+
+
+// Runs and literals around the token limits (128 literals, 129 repeats)
+UDD_TEST(RleTokenLimits)
+{
+    for (UINT length = 1; length <= 300; ++length)
+    {
+        Image run(length, 2);
+        Image literal(length, 2);
+        Image mixed(length, 2);
+        for (UINT x = 0; x < length; ++x)
+        {
+            run.At(x, 0) = run.At(x, 1) = 0xFF123456u;
+            literal.At(x, 0) = x;
+            literal.At(x, 1) = ~x;
+            mixed.At(x, 0) = (x / 3) % 2 ? x : 7u;
+            mixed.At(x, 1) = x % 130 < 2 ? 1u : x;
+        }
+
+        size_t runSize = 0;
+        UDD_CHECK(RoundTripRle(run, &runSize));
+        UDD_CHECK(RoundTripRle(literal));
+        UDD_CHECK(RoundTripRle(mixed));
+
+        // A run costs 5 bytes per 129 pixels (a single pixel is a literal).
+        UDD_CHECK_EQUAL(runSize, 2u * ((length + 128) / 129) * 5);
+    }
+}
+
+
+UDD_TEST(RleDesktops)
+{
+    Test::Random random(7);
+    for (int i = 0; i < 4; ++i)
+    {
+        Image image(random.Range(1, 400), random.Range(1, 300), random.Range(0, 8));
+        DrawDesktop(image, random);
+        for (int n = 0; n < 200; ++n)
+        {
+            image.At(random.Range(0, image.width - 1), random.Range(0, image.height - 1)) = random.Next();
+        }
+
+        size_t size = 0;
+        UDD_CHECK(RoundTripRle(image, &size));
+        UDD_CHECK(size < static_cast<size_t>(image.width) * image.height * 4);
+    }
+
+    Image noise(97, 31);
+    for (auto& value : noise.pixels) value = static_cast<BYTE>(random.Next());
+    UDD_CHECK(RoundTripRle(noise));
+}
+
+
+UDD_TEST(RleRejectsBrokenData)
+{
+    Image image(64, 8);
+    Test::Random random(8);
+    DrawDesktop(image, random);
+
+    std::vector<BYTE> data;
+    Codec::EncodeRle(image.pixels.data(), image.width, image.height, image.pitch, data);
+
+    std::vector<BYTE> out(image.pitch * image.height);
+    const auto size = static_cast<UINT>(data.size());
+    UDD_CHECK(Codec::DecodeRle(data.data(), size, out.data(), image.width, image.height, image.pitch));
+    UDD_CHECK(!Codec::DecodeRle(data.data(), size - 1, out.data(), image.width, image.height, image.pitch));
+    UDD_CHECK(!Codec::DecodeRle(data.data(), size, out.data(), image.width, image.height - 1, image.pitch));
+    UDD_CHECK(!Codec::DecodeRle(data.data(), size, out.data(), image.width / 2, image.height, image.pitch));
+
+    // A run longer than the row must not be written past it.
+    const BYTE longRun[] = { 255, 1, 2, 3, 4 };
+    UDD_CHECK(!Codec::DecodeRle(longRun, sizeof(longRun), out.data(), 128, 1, image.pitch));
+    UDD_CHECK(Codec::DecodeRle(longRun, sizeof(longRun), out.data(), 129, 1, 129 * 4 * 2));
+}
+
+
+UDD_TEST(RegionsRoundTrip)
+{
+    Test::Random random(9);
+    Image image(200, 120);
+    DrawDesktop(image, random);
+
+    const RECT rects[] = { { 0, 0, 200, 1 }, { 10, 20, 42, 52 }, { 199, 119, 200, 120 }, { 50, 60, 150, 100 } };
+    std::vector<BYTE> data;
+    Codec::EncodeRegions(image.pixels.data(), image.pitch, rects, 4, data);
+
+    // Only the regions are written.
+    Image decoded(200, 120);
+    UDD_CHECK(Codec::DecodeRegions(data.data(), data.size(), 4, decoded.pixels.data(), 200, 120, decoded.pitch));
+    for (UINT y = 0; y < 120; ++y)
+    {
+        for (UINT x = 0; x < 200; ++x)
+        {
+            bool isInside = false;
+            for (const auto& rect : rects)
+            {
+                isInside |= static_cast<LONG>(x) >= rect.left && static_cast<LONG>(x) < rect.right &&
+                            static_cast<LONG>(y) >= rect.top && static_cast<LONG>(y) < rect.bottom;
+            }
+            UDD_CHECK_EQUAL(decoded.At(x, y), isInside ? image.At(x, y) : 0xCDCDCDCDu);
+        }
+    }
+
+    // Missing data, more regions than stored, and regions outside of the image fail.
+    UDD_CHECK(!Codec::DecodeRegions(data.data(), data.size() - 1, 4, decoded.pixels.data(), 200, 120, decoded.pitch));
+    UDD_CHECK(!Codec::DecodeRegions(data.data(), data.size(), 5, decoded.pixels.data(), 200, 120, decoded.pitch));
+    UDD_CHECK(!Codec::DecodeRegions(data.data(), data.size(), 4, decoded.pixels.data(), 199, 120, decoded.pitch));
+    UDD_CHECK(Codec::DecodeRegions(data.data(), data.size(), 0, decoded.pixels.data(), 200, 120, decoded.pitch));
+}
+
+
+UDD_TEST(QoiSmallImages)
+{
+    Test::Random random(1);
+
+    Image single(1, 1);
+    single.At(0, 0) = 0x00123456u;
+    UDD_CHECK(RoundTrip(single));
+
+    // The first pixel equals the initial previous pixel (black), so the image starts with a run.
+    Image black(3, 2);
+    for (UINT y = 0; y < 2; ++y) for (UINT x = 0; x < 3; ++x) black.At(x, y) = 0x7F000000u;
+    UDD_CHECK(RoundTrip(black));
+
+    Image column(1, 97, 3);
+    for (UINT y = 0; y < 97; ++y) column.At(0, y) = random.Next();
+    UDD_CHECK(RoundTrip(column));
+}
+
+
+UDD_TEST(QoiOperations)
+{
+    // Runs longer than 62 pixels, crossing rows
+    Image solid(100, 7, 5);
+    for (UINT y = 0; y < solid.height; ++y) for (UINT x = 0; x < solid.width; ++x) solid.At(x, y) = 0xFF336699u;
+    UDD_CHECK(RoundTrip(solid));
+
+    // Small and medium differences (QOI_OP_DIFF / QOI_OP_LUMA), including wrap-around of 255 -> 0
+    Image gradient(256, 16);
+    for (UINT y = 0; y < gradient.height; ++y)
+    {
+        for (UINT x = 0; x < gradient.width; ++x)
+        {
+            gradient.At(x, y) = (x << 16) | (((x * (y + 1)) & 0xFF) << 8) | ((255 - x) & 0xFF);
+        }
+    }
+    UDD_CHECK(RoundTrip(gradient));
+
+    // A few colors alternating hit the index (QOI_OP_INDEX)
+    Test::Random random(2);
+    const uint32_t palette[] = { 0xFFFF0000u, 0xFF00FF00u, 0xFF0000FFu, 0xFFFFFFFFu, 0xFF808080u };
+    Image indexed(64, 64, 1);
+    for (UINT y = 0; y < indexed.height; ++y)
+    {
+        for (UINT x = 0; x < indexed.width; ++x)
+        {
+            indexed.At(x, y) = palette[random.Next() % 5];
+        }
+    }
+    UDD_CHECK(RoundTrip(indexed));
+
+    // Noise needs QOI_OP_RGB; random alpha must be ignored
+    Image noise(77, 33, 2);
+    for (UINT y = 0; y < noise.height; ++y) for (UINT x = 0; x < noise.width; ++x) noise.At(x, y) = random.Next();
+    UDD_CHECK(RoundTrip(noise));
+}
+
+
+UDD_TEST(QoiSyntheticDesktops)
+{
+    Test::Random random(3);
+    for (int i = 0; i < 8; ++i)
+    {
+        Image image(random.Range(100, 640), random.Range(80, 480), random.Range(0, 16));
+        DrawDesktop(image, random);
+        UDD_CHECK(RoundTrip(image));
+    }
+}
+
+
+// The same calls as Snapshot::Blit() and Snapshot::Encode(): a landscape monitor and a
+// portrait monitor (rotated 90 degrees, so its desktop image is landscape) on one canvas.
+UDD_TEST(QoiSnapshotLayout)
+{
+    constexpr UINT kCanvasWidth = 160 + 48;
+    constexpr UINT kCanvasHeight = 120;
+
+    Test::Random random(4);
+    Image left(160, 90);
+    Image right(120, 48); // desktop image of a 48x120 portrait monitor
+    for (UINT y = 0; y < left.height; ++y) for (UINT x = 0; x < left.width; ++x) left.At(x, y) = random.Next() | 0xFF000000u;
+    for (UINT y = 0; y < right.height; ++y) for (UINT x = 0; x < right.width; ++x) right.At(x, y) = random.Next() | 0xFF000000u;
+
+    Image canvas(kCanvasWidth, kCanvasHeight);
+    std::fill(canvas.pixels.begin(), canvas.pixels.end(), 0);
+    Kernels::BlitRotatedRect(left.pixels.data(), left.pitch, canvas.pixels.data(), canvas.pitch,
+        Kernels::RotationIdentity, 160, 90, 0, 0, 160, 90);
+    Kernels::BlitRotatedRect(right.pixels.data(), right.pitch, canvas.pixels.data() + 160 * 4, canvas.pitch,
+        Kernels::Rotation90, 48, 120, 0, 0, 120, 48);
+
+    std::vector<BYTE> data;
+    Codec::EncodeQoi(canvas.pixels.data(), canvas.width, canvas.height, canvas.pitch, data);
+    UINT width = 0, height = 0;
+    std::vector<BYTE> rgb;
+    UDD_CHECK(DecodeQoi(data, width, height, rgb));
+    UDD_CHECK_EQUAL(width, kCanvasWidth);
+    UDD_CHECK_EQUAL(height, kCanvasHeight);
+    if (rgb.size() != kCanvasWidth * kCanvasHeight * 3) return;
+
+    const auto rgbAt = [&](UINT x, UINT y)
+    {
+        const auto p = &rgb[(y * kCanvasWidth + x) * 3];
+        return static_cast<uint32_t>(p[0] << 16 | p[1] << 8 | p[2]);
+    };
+
+    int mismatchCount = 0;
+    for (UINT y = 0; y < kCanvasHeight; ++y)
+    {
+        for (UINT x = 0; x < kCanvasWidth; ++x)
+        {
+            uint32_t expected = 0;
+            if (x < 160 && y < 90)
+            {
+                expected = left.At(x, y);
+            }
+            else if (x >= 160)
+            {
+                // Rotated 90 degrees clockwise: monitor (x, y) shows desktop (y, width - 1 - x).
+                expected = right.At(y, 48 - 1 - (x - 160));
+            }
+            if (rgbAt(x, y) != (expected & 0x00FFFFFFu)) ++mismatchCount;
+        }
+    }
+    UDD_CHECK_EQUAL(mismatchCount, 0);
+}
+
+
+UDD_TEST(QoiThroughput)
+{
+    Test::Random random(5);
+    Image image(1920, 1080, 0);
+    DrawDesktop(image, random);
+
+    size_t size = 0;
+    UDD_CHECK(RoundTrip(image, &size));
+
+    constexpr int kIterationCount = 5;
+    std::vector<BYTE> data;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterationCount; ++i)
+    {
+        data.clear();
+        Codec::EncodeQoi(image.pixels.data(), image.width, image.height, image.pitch, data);
+    }
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("QOI 1920x1080 synthetic desktop: %.1f ms/frame, %.0f MB/s, %.1f%% of raw RGB\n",
+        seconds * 1000.0 / kIterationCount,
+        image.width * image.height * 4.0 * kIterationCount / seconds / 1e6,
+        size * 100.0 / (image.width * image.height * 3.0));
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Subset of the D3D11 declarations used by the units built into the tests and benchmarks
+// (non-Windows only). Interfaces are only declared since no test touches a device.
+
+#include "windows.h"
+#include "dxgi1_2.h"
+
+
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Texture2D;
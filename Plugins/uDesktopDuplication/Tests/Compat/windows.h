@@ -0,0 +1,267 @@
+#pragma once
+
+// Subset of the Windows API used by the units built into the tests and benchmarks.
+// It is only on the include path of non-Windows builds; named file mappings are
+// emulated with POSIX shared memory so that the shared-memory ring can be tested
+// across processes with the consumer library.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cwchar>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+
+typedef unsigned char BYTE;
+typedef unsigned short USHORT;
+typedef unsigned short WORD;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef int LONG;
+typedef unsigned int ULONG;
+typedef unsigned int DWORD;
+typedef int32_t INT32;
+typedef uint32_t UINT32;
+typedef int64_t INT64;
+typedef uint64_t UINT64;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef uintptr_t UINT_PTR;
+typedef float FLOAT;
+typedef wchar_t WCHAR;
+typedef long HRESULT;
+typedef void* HANDLE;
+
+#define TRUE 1
+#define FALSE 0
+#define S_OK ((HRESULT)0L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define PAGE_READWRITE 0x04
+#define FILE_MAP_READ 0x0004
+#define FILE_MAP_ALL_ACCESS 0xF001F
+#define ERROR_SUCCESS 0
+#define ERROR_ALREADY_EXISTS 183
+
+typedef struct tagRECT
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+} RECT;
+
+typedef struct tagPOINT
+{
+    LONG x;
+    LONG y;
+} POINT;
+
+typedef union _LARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _LUID
+{
+    DWORD LowPart;
+    LONG HighPart;
+} LUID;
+
+typedef struct _SECURITY_ATTRIBUTES SECURITY_ATTRIBUTES;
+
+
+
+inline int wcstombs_s(size_t* converted, char* dst, const wchar_t* src, size_t size)
+{
+    const auto result = wcstombs(dst, src, size);
+    if (result == static_cast<size_t>(-1)) return EINVAL;
+    if (size > 0) dst[(result < size) ? result : size - 1] = '\0';
+    if (converted) *converted = result;
+    return 0;
+}
+
+
+template <size_t N>
+inline int wcstombs_s(size_t* converted, char (&dst)[N], const wchar_t* src, size_t size)
+{
+    return wcstombs_s(converted, dst, src, (size < N) ? size : N);
+}
+
+
+inline int localtime_s(tm* result, const time_t* time)
+{
+    return localtime_r(time, result) ? 0 : EINVAL;
+}
+
+
+#define sprintf_s snprintf
+
+
+inline int memcpy_s(void* dst, size_t dstSize, const void* src, size_t count)
+{
+    if (count > dstSize) return ERANGE;
+    if (count > 0) memcpy(dst, src, count);
+    return 0;
+}
+
+
+inline DWORD GetCurrentThreadId()
+{
+    return static_cast<DWORD>(syscall(SYS_gettid));
+}
+
+
+inline DWORD GetCurrentProcessId()
+{
+    return static_cast<DWORD>(getpid());
+}
+
+
+inline void Sleep(DWORD ms)
+{
+    usleep(ms * 1000u);
+}
+
+
+
+// Named file mappings on top of shm_open(). The creator unlinks the name when it closes
+// the handle, which is when a pagefile-backed mapping loses its name on Windows.
+namespace UddCompat
+{
+    struct FileMapping
+    {
+        int fd = -1;
+        bool isCreator = false;
+        std::string name;
+    };
+
+    inline DWORD& LastError()
+    {
+        thread_local DWORD error = ERROR_SUCCESS;
+        return error;
+    }
+
+    inline std::mutex& ViewMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    inline std::map<const void*, size_t>& Views()
+    {
+        static std::map<const void*, size_t> views;
+        return views;
+    }
+}
+
+
+inline DWORD GetLastError()
+{
+    return UddCompat::LastError();
+}
+
+
+inline HANDLE CreateFileMappingA(
+    HANDLE file,
+    SECURITY_ATTRIBUTES*,
+    DWORD,
+    DWORD sizeHigh,
+    DWORD sizeLow,
+    const char* name)
+{
+    UddCompat::LastError() = ERROR_SUCCESS;
+    if (file != INVALID_HANDLE_VALUE || !name) return nullptr;
+
+    auto mapping = new UddCompat::FileMapping();
+    mapping->name = name;
+    mapping->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (mapping->fd >= 0)
+    {
+        mapping->isCreator = true;
+        const auto size = (static_cast<uint64_t>(sizeHigh) << 32) | sizeLow;
+        if (ftruncate(mapping->fd, static_cast<off_t>(size)) != 0)
+        {
+            close(mapping->fd);
+            shm_unlink(name);
+            delete mapping;
+            return nullptr;
+        }
+        return mapping;
+    }
+
+    if (errno == EEXIST)
+    {
+        mapping->fd = shm_open(name, O_RDWR, 0600);
+        if (mapping->fd >= 0)
+        {
+            UddCompat::LastError() = ERROR_ALREADY_EXISTS;
+            return mapping;
+        }
+    }
+
+    delete mapping;
+    return nullptr;
+}
+
+
+inline void* MapViewOfFile(HANDLE handle, DWORD access, DWORD, DWORD, size_t)
+{
+    auto mapping = static_cast<UddCompat::FileMapping*>(handle);
+    struct stat st;
+    if (!mapping || fstat(mapping->fd, &st) != 0 || st.st_size <= 0) return nullptr;
+
+    const auto size = static_cast<size_t>(st.st_size);
+    const int protection = (access == FILE_MAP_READ) ? PROT_READ : (PROT_READ | PROT_WRITE);
+    const auto view = mmap(nullptr, size, protection, MAP_SHARED, mapping->fd, 0);
+    if (view == MAP_FAILED) return nullptr;
+
+    std::lock_guard<std::mutex> lock(UddCompat::ViewMutex());
+    UddCompat::Views()[view] = size;
+    return view;
+}
+
+
+inline BOOL UnmapViewOfFile(const void* view)
+{
+    std::lock_guard<std::mutex> lock(UddCompat::ViewMutex());
+    auto& views = UddCompat::Views();
+    const auto it = views.find(view);
+    if (it == views.end()) return FALSE;
+
+    munmap(const_cast<void*>(view), it->second);
+    views.erase(it);
+    return TRUE;
+}
+
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+    auto mapping = static_cast<UddCompat::FileMapping*>(handle);
+    if (!mapping) return FALSE;
+
+    close(mapping->fd);
+    if (mapping->isCreator) shm_unlink(mapping->name.c_str());
+    delete mapping;
+    return TRUE;
+}
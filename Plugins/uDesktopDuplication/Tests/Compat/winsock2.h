@@ -0,0 +1,76 @@
+#pragma once
+
+// Subset of Winsock mapped onto BSD sockets (non-Windows only), for the stream server tests.
+
+#include <cerrno>
+#include <csignal>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "windows.h"
+
+
+
+typedef int SOCKET;
+typedef unsigned long u_long;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define WSAEWOULDBLOCK EWOULDBLOCK
+#define MAKEWORD(a, b) ((WORD)(((BYTE)(a)) | (((WORD)((BYTE)(b))) << 8)))
+
+typedef struct WSAData
+{
+    WORD wVersion;
+    WORD wHighVersion;
+} WSADATA;
+
+
+// Winsock never raises signals, while send() to a closed peer raises SIGPIPE on POSIX.
+inline int WSAStartup(WORD version, WSADATA* data)
+{
+    std::signal(SIGPIPE, SIG_IGN);
+    data->wVersion = version;
+    data->wHighVersion = version;
+    return 0;
+}
+
+
+inline int WSACleanup()
+{
+    return 0;
+}
+
+
+inline int WSAGetLastError()
+{
+    return errno;
+}
+
+
+inline int closesocket(SOCKET socket)
+{
+    return close(socket);
+}
+
+
+inline int ioctlsocket(SOCKET socket, unsigned long command, u_long* argument)
+{
+    int value = static_cast<int>(*argument);
+    return ioctl(socket, command, &value);
+}
+
+
+// The first argument of select() is ignored by Winsock, which is why callers pass 0.
+inline int UddCompatSelect(int, fd_set* readSet, fd_set* writeSet, fd_set* exceptSet, timeval* timeout)
+{
+    return ::select(FD_SETSIZE, readSet, writeSet, exceptSet, timeout);
+}
+
+#define select UddCompatSelect
@@ -0,0 +1,25 @@
+#pragma once
+
+// Declaration-only stand-in of Microsoft::WRL::ComPtr (non-Windows only).
+// Headers built into the tests mention ComPtr in signatures, but no test creates COM objects.
+
+#include <windows.h>
+
+namespace Microsoft
+{
+namespace WRL
+{
+    template <class T>
+    class ComPtr
+    {
+    public:
+        ComPtr() = default;
+        T* Get() const { return ptr_; }
+        T* operator->() const { return ptr_; }
+        explicit operator bool() const { return ptr_ != nullptr; }
+
+    private:
+        T* ptr_ = nullptr;
+    };
+}
+}
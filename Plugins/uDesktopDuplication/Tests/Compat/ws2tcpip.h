@@ -0,0 +1,5 @@
+#pragma once
+
+// See winsock2.h (non-Windows only).
+
+#include "winsock2.h"
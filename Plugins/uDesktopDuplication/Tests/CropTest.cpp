@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <vector>
+
+#include <windows.h>
+#include <dxgi1_2.h>
+
+#include "Test.h"
+#include "Crop.h"
+#include "Kernels.h"
+
+
+
+namespace
+{
+
+
+const uint32_t kRotations[] =
+{
+    Kernels::RotationIdentity,
+    Kernels::Rotation90,
+    Kernels::Rotation180,
+    Kernels::Rotation270,
+};
+
+
+bool IsVertical(uint32_t rotation)
+{
+    return rotation == Kernels::Rotation90 || rotation == Kernels::Rotation270;
+}
+
+
+RECT RandomRect(Test::Random& random, int width, int height)
+{
+    RECT rect;
+    rect.left = random.Range(0, width - 1);
+    rect.top = random.Range(0, height - 1);
+    rect.right = random.Range(rect.left + 1, width);
+    rect.bottom = random.Range(rect.top + 1, height);
+    return rect;
+}
+
+
+std::vector<uint32_t> CollectPixels(const std::vector<uint32_t>& image, int width, const RECT& rect)
+{
+    std::vector<uint32_t> pixels;
+    for (LONG y = rect.top; y < rect.bottom; ++y)
+    {
+        for (LONG x = rect.left; x < rect.right; ++x)
+        {
+            pixels.push_back(image[y * width + x]);
+        }
+    }
+    std::sort(pixels.begin(), pixels.end());
+    return pixels;
+}
+
+
+size_t FindDirty(const std::vector<RECT>& rects, size_t count, const RECT& rect)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (Crop::IsEqual(rects[i], rect)) return i;
+    }
+    return count;
+}
+
+
+}
+
+
+
+// The rect conversions must agree with how Kernels::BlitRotatedRect() draws the desktop image on
+// the monitor: a monitor rect shows exactly the pixels of its desktop image rect.
+UDD_TEST(RotationRoundTrip)
+{
+    constexpr int kMonitorWidth = 13;
+    constexpr int kMonitorHeight = 7;
+
+    Test::Random random(1);
+    for (const auto rotation : kRotations)
+    {
+        const auto imageWidth = IsVertical(rotation) ? kMonitorHeight : kMonitorWidth;
+        const auto imageHeight = IsVertical(rotation) ? kMonitorWidth : kMonitorHeight;
+
+        std::vector<uint32_t> image(imageWidth * imageHeight);
+        for (size_t i = 0; i < image.size(); ++i) image[i] = static_cast<uint32_t>(i);
+
+        std::vector<uint32_t> monitor(kMonitorWidth * kMonitorHeight);
+        Kernels::BlitRotatedRect(
+            reinterpret_cast<const uint8_t*>(image.data()), imageWidth * 4,
+            reinterpret_cast<uint8_t*>(monitor.data()), kMonitorWidth * 4,
+            rotation, kMonitorWidth, kMonitorHeight, 0, 0, imageWidth, imageHeight);
+
+        for (int i = 0; i < 200; ++i)
+        {
+            const auto rect = RandomRect(random, kMonitorWidth, kMonitorHeight);
+            const auto imageRect = Crop::ToDesktopImage(rect, rotation, kMonitorWidth, kMonitorHeight);
+            const RECT imageBounds = { 0, 0, imageWidth, imageHeight };
+            UDD_CHECK(Crop::Contains(imageBounds, imageRect));
+            UDD_CHECK(CollectPixels(monitor, kMonitorWidth, rect) == CollectPixels(image, imageWidth, imageRect));
+
+            const auto back = Crop::FromDesktopImage(imageRect, rotation, kMonitorWidth, kMonitorHeight);
+            UDD_CHECK(Crop::IsEqual(back, rect));
+        }
+    }
+}
+
+
+UDD_TEST(MoveRectsLeavingCrop)
+{
+    const RECT crop = { 100, 50, 300, 150 };
+
+    const DXGI_OUTDUPL_MOVE_RECT moves[] =
+    {
+        { { 120, 70 }, { 110, 60, 150, 90 } },    // inside -> inside: translated
+        { { 20, 70 }, { 110, 60, 150, 90 } },     // from outside the crop: dirty
+        { { 120, 70 }, { 280, 140, 320, 170 } },  // partly out of the crop: dirty, clipped
+        { { 120, 70 }, { 400, 60, 440, 90 } },    // out of the crop: dropped
+    };
+    const RECT dirty = { 0, 0, 10, 10 };          // out of the crop: dropped
+
+    std::vector<DXGI_OUTDUPL_MOVE_RECT> outMoves(4);
+    std::vector<RECT> outDirties(5);
+    size_t moveCount = 0, dirtyCount = 0;
+    Crop::CropRects(crop, moves, 4, &dirty, 1, outMoves.data(), &moveCount, outDirties.data(), &dirtyCount);
+
+    UDD_CHECK_EQUAL(moveCount, 1u);
+    UDD_CHECK_EQUAL(outMoves[0].SourcePoint.x, 20);
+    UDD_CHECK_EQUAL(outMoves[0].SourcePoint.y, 20);
+    UDD_CHECK(Crop::IsEqual(outMoves[0].DestinationRect, RECT { 10, 10, 50, 40 }));
+
+    UDD_CHECK_EQUAL(dirtyCount, 2u);
+    UDD_CHECK(FindDirty(outDirties, dirtyCount, { 10, 10, 50, 40 }) < dirtyCount);
+    UDD_CHECK(FindDirty(outDirties, dirtyCount, { 180, 90, 200, 100 }) < dirtyCount);
+}
+
+
+UDD_TEST(ClippedDirtyRects)
+{
+    const RECT crop = { 100, 50, 300, 150 };
+
+    const RECT dirties[] =
+    {
+        { 150, 60, 160, 70 },   // inside
+        { 50, 40, 120, 60 },    // overlaps the top-left corner
+        { 0, 0, 1000, 1000 },   // covers the crop
+        { 300, 60, 310, 70 },   // touches the right edge only
+        { 100, 20, 300, 50 },   // touches the top edge only
+        { 500, 500, 600, 600 }, // far away
+        { 120, 60, 120, 80 },   // empty
+    };
+
+    std::vector<RECT> outDirties(7);
+    size_t moveCount = 0, dirtyCount = 0;
+    Crop::CropRects<DXGI_OUTDUPL_MOVE_RECT>(
+        crop, nullptr, 0, dirties, 7, nullptr, &moveCount, outDirties.data(), &dirtyCount);
+
+    UDD_CHECK_EQUAL(moveCount, 0u);
+    UDD_CHECK_EQUAL(dirtyCount, 3u);
+    UDD_CHECK(Crop::IsEqual(outDirties[0], RECT { 50, 10, 60, 20 }));
+    UDD_CHECK(Crop::IsEqual(outDirties[1], RECT { 0, 0, 20, 10 }));
+    UDD_CHECK(Crop::IsEqual(outDirties[2], RECT { 0, 0, 200, 100 }));
+
+    // Random rects: every output lies in the crop and every input overlapping it gives one.
+    Test::Random random(2);
+    outDirties.resize(32);
+    for (int i = 0; i < 100; ++i)
+    {
+        std::vector<RECT> rects(32);
+        size_t overlapCount = 0;
+        for (auto& rect : rects)
+        {
+            rect = RandomRect(random, 400, 200);
+            auto clipped = rect;
+            if (Crop::Clip(crop, &clipped)) ++overlapCount;
+        }
+
+        Crop::CropRects<DXGI_OUTDUPL_MOVE_RECT>(
+            crop, nullptr, 0, rects.data(), rects.size(), nullptr, &moveCount, outDirties.data(), &dirtyCount);
+
+        UDD_CHECK_EQUAL(dirtyCount, overlapCount);
+        const RECT bounds = { 0, 0, crop.right - crop.left, crop.bottom - crop.top };
+        for (size_t j = 0; j < dirtyCount; ++j)
+        {
+            UDD_CHECK(Crop::Contains(bounds, outDirties[j]));
+            UDD_CHECK(!Crop::IsEmpty(outDirties[j]));
+        }
+    }
+}
+
+
+// Crop widths are arbitrary, so the mapped staging texture usually has padded rows: the packed
+// copy must not shear the image and must stop at the width of the last row.
+UDD_TEST(CopyRowsOfPaddedPitch)
+{
+    Test::Random random(3);
+    for (const int width : { 333, 1, 64, 1001 })
+    {
+        constexpr int kHeight = 17;
+        const size_t rowBytes = width * 4;
+        const size_t pitch = (rowBytes + 255) / 256 * 256;
+
+        // The source ends right after the last row, as a mapped surface may.
+        std::vector<uint8_t> src(pitch * (kHeight - 1) + rowBytes);
+        for (auto& value : src) value = static_cast<uint8_t>(random.Next());
+
+        std::vector<uint8_t> dst(rowBytes * kHeight + 4, 0xCD);
+        Crop::CopyRows(src.data(), pitch, dst.data(), rowBytes, kHeight);
+
+        int mismatchCount = 0;
+        for (int y = 0; y < kHeight; ++y)
+        {
+            if (!std::equal(src.begin() + y * pitch, src.begin() + y * pitch + rowBytes, dst.begin() + y * rowBytes)) ++mismatchCount;
+        }
+        UDD_CHECK_EQUAL(mismatchCount, 0);
+        UDD_CHECK(std::all_of(dst.end() - 4, dst.end(), [](uint8_t value) { return value == 0xCD; }));
+    }
+}
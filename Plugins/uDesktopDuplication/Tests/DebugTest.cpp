@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Test.h"
+#include "Debug.h"
+
+
+
+namespace
+{
+
+
+std::mutex g_linesMutex;
+std::vector<std::string> g_lines;
+
+
+void UNITY_INTERFACE_API Capture(const char* line)
+{
+    std::lock_guard<std::mutex> lock(g_linesMutex);
+    g_lines.push_back(line);
+}
+
+
+// Without Debug::Initialize() there is no writer thread, so messages are flushed by the caller.
+void Reset()
+{
+    Debug::SetMode(Debug::Mode::UnityLog);
+    Debug::SetLevel(Debug::Level::Log);
+    Debug::SetLogFunc(Capture);
+    Debug::SetErrorFunc(Capture);
+
+    std::lock_guard<std::mutex> lock(g_linesMutex);
+    g_lines.clear();
+}
+
+
+size_t CountLines(const std::string& text)
+{
+    std::lock_guard<std::mutex> lock(g_linesMutex);
+    return std::count_if(g_lines.begin(), g_lines.end(),
+        [&](const std::string& line) { return line.find(text) != std::string::npos; });
+}
+
+
+std::string FindLine(const std::string& text)
+{
+    std::lock_guard<std::mutex> lock(g_linesMutex);
+    const auto it = std::find_if(g_lines.begin(), g_lines.end(),
+        [&](const std::string& line) { return line.find(text) != std::string::npos; });
+    return (it != g_lines.end()) ? *it : std::string();
+}
+
+
+// Every instantiation is a new call site, so each round races for a fresh slot.
+template <int Round>
+size_t LogConcurrently()
+{
+    Reset();
+
+    std::vector<std::thread> threads;
+    std::atomic<int> readyCount = { 0 };
+    for (int t = 0; t < 8; ++t)
+    {
+        threads.emplace_back([&]
+        {
+            ++readyCount;
+            while (readyCount < 8) {}
+            for (int i = 0; i < 50; ++i)
+            {
+                UDD_LOG("Concurrent => ", Round);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Call sites of earlier rounds report their suppressed messages once their period has passed,
+    // which takes a few rounds when the machine is busy. Those reports are not messages of this round,
+    // but each has to count exactly the other 390.
+    const auto reportCount = CountLines("\"Concurrent => \" (DebugTest.cpp:");
+    UDD_CHECK_EQUAL(CountLines("was suppressed 390 times."), reportCount);
+
+    return CountLines("Concurrent => " + std::to_string(Round));
+}
+
+
+template <int Round>
+void CheckConcurrentRounds()
+{
+    CheckConcurrentRounds<Round - 1>();
+    UDD_CHECK_EQUAL(LogConcurrently<Round>(), 10u);
+}
+
+
+template <>
+void CheckConcurrentRounds<0>()
+{
+}
+
+
+}
+
+
+
+UDD_TEST(CallSiteIsRateLimited)
+{
+    Reset();
+    for (int i = 0; i < 100; ++i)
+    {
+        UDD_ERROR("Limited => ", i);
+    }
+    UDD_CHECK_EQUAL(CountLines("Limited => "), 10u);
+}
+
+
+// Identical literals may share one address after string pooling; they are still two call sites.
+UDD_TEST(SameTextFromTwoCallSites)
+{
+    Reset();
+    for (int i = 0; i < 20; ++i)
+    {
+        UDD_LOG("Same text");
+    }
+    for (int i = 0; i < 20; ++i)
+    {
+        UDD_LOG("Same text");
+    }
+    UDD_CHECK_EQUAL(CountLines("Same text"), 20u);
+}
+
+
+UDD_TEST(NonLiteralMessages)
+{
+    Reset();
+    for (int i = 0; i < 20; ++i)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "Formatted %d", i);
+        UDD_LOG(buf);
+        UDD_LOG(std::string("String ") + std::to_string(i));
+    }
+    UDD_CHECK_EQUAL(CountLines("Formatted "), 10u);
+    UDD_CHECK_EQUAL(CountLines("String "), 10u);
+}
+
+
+// Threads logging from one call site at the same time race to claim its slot; the losers must
+// join the slot of the winner rather than claim another one, which would double the budget.
+UDD_TEST(ConcurrentCallSite)
+{
+    CheckConcurrentRounds<32>();
+}
+
+
+UDD_TEST(SuppressedCountIsReported)
+{
+    Reset();
+    for (int i = 0; i < 25; ++i)
+    {
+        UDD_ERROR("Reported => ", i);
+    }
+
+    // The count is written once the period of the call site has passed.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    UDD_LOG("Flush");
+
+    const auto line = FindLine("\"Reported => \" (DebugTest.cpp:");
+    UDD_CHECK(line.find(") was suppressed 15 times.") != std::string::npos);
+    UDD_CHECK_EQUAL(CountLines("\"Reported => \" (DebugTest.cpp:"), 1u);
+}
@@ -0,0 +1,190 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Test.h"
+#include "FramePool.h"
+
+
+
+namespace
+{
+
+
+// Stands in for a frame texture: every value is the generation it was written for, so a
+// consumer which sees mixed values has read a slot while it was being overwritten.
+struct Frame
+{
+    uint64_t generation = 0;
+    std::vector<uint64_t> pixels = std::vector<uint64_t>(1024);
+};
+
+
+void Write(FramePool<Frame>& pool, int slot)
+{
+    // There is a single producer, so the generation EndWrite() assigns is known in advance.
+    auto& frame = pool.GetResource(slot);
+    frame.generation = pool.GetLatestGeneration() + 1;
+    for (auto& pixel : frame.pixels)
+    {
+        pixel = frame.generation;
+    }
+    UDD_CHECK_EQUAL(pool.EndWrite(slot), frame.generation);
+}
+
+
+bool IsConsistent(const FramePool<Frame>::Lease& lease)
+{
+    if (lease->generation != lease.GetGeneration()) return false;
+    for (const auto pixel : lease->pixels)
+    {
+        if (pixel != lease.GetGeneration()) return false;
+    }
+    return true;
+}
+
+
+}
+
+
+
+UDD_TEST(NothingBeforeFirstFrame)
+{
+    FramePool<Frame> pool(3);
+    UDD_CHECK(!pool.AcquireLatest());
+    UDD_CHECK_EQUAL(pool.GetLatestSlot(), FramePool<Frame>::kInvalidSlot);
+
+    // A cancelled write publishes nothing and frees the slot again.
+    const auto slot = pool.BeginWrite();
+    UDD_CHECK(slot != FramePool<Frame>::kInvalidSlot);
+    pool.CancelWrite(slot);
+    UDD_CHECK(!pool.AcquireLatest());
+    UDD_CHECK_EQUAL(pool.GetLatestGeneration(), 0u);
+
+    // Fewer than two slots cannot keep a complete frame while writing the next one.
+    FramePool<Frame> small(1);
+    UDD_CHECK_EQUAL(small.GetSlotCount(), 2);
+}
+
+
+UDD_TEST(ProducerFasterThanConsumer)
+{
+    FramePool<Frame> pool(3);
+
+    // The consumer only looks at every 10th frame and always gets the latest one.
+    for (int i = 1; i <= 100; ++i)
+    {
+        const auto slot = pool.BeginWrite();
+        UDD_CHECK(slot != FramePool<Frame>::kInvalidSlot);
+        UDD_CHECK(slot != pool.GetLatestSlot());
+        Write(pool, slot);
+
+        if (i % 10 == 0)
+        {
+            const auto lease = pool.AcquireLatest();
+            UDD_CHECK(static_cast<bool>(lease));
+            UDD_CHECK_EQUAL(lease.GetGeneration(), static_cast<uint64_t>(i));
+            UDD_CHECK(IsConsistent(lease));
+        }
+    }
+    UDD_CHECK_EQUAL(pool.GetStarvedCount(), 0u);
+
+    // Slots are reused in publication order, so the oldest frame is overwritten first.
+    const auto next = pool.BeginWrite();
+    UDD_CHECK_EQUAL(pool.GetResource(next).generation, 98u);
+    pool.CancelWrite(next);
+}
+
+
+UDD_TEST(ConsumerHoldsLease)
+{
+    FramePool<Frame> pool(3);
+    Write(pool, pool.BeginWrite());
+
+    // While a lease is held, its slot is neither written nor handed out, however many frames come.
+    auto held = pool.AcquireLatest();
+    const auto heldSlot = held.GetSlot();
+    for (int i = 0; i < 50; ++i)
+    {
+        const auto slot = pool.BeginWrite();
+        UDD_CHECK(slot != FramePool<Frame>::kInvalidSlot);
+        UDD_CHECK(slot != heldSlot);
+        Write(pool, slot);
+    }
+    UDD_CHECK_EQUAL(held.GetGeneration(), 1u);
+    UDD_CHECK(IsConsistent(held));
+
+    // A newer lease does not free the older one.
+    auto latest = pool.AcquireLatest();
+    UDD_CHECK_EQUAL(latest.GetGeneration(), 51u);
+
+    // With the held slot and the latest slot taken, a two-slot pool has nothing to write into.
+    FramePool<Frame> pair(2);
+    Write(pair, pair.BeginWrite());
+    auto lease = pair.AcquireLatest();
+    Write(pair, pair.BeginWrite());
+    UDD_CHECK_EQUAL(pair.BeginWrite(), FramePool<Frame>::kInvalidSlot);
+    UDD_CHECK_EQUAL(pair.BeginWrite(), FramePool<Frame>::kInvalidSlot);
+    UDD_CHECK_EQUAL(pair.GetStarvedCount(), 2u);
+
+    // Returning the lease (also through a move) frees the slot.
+    auto moved = std::move(lease);
+    UDD_CHECK(!lease);
+    moved.Release();
+    const auto slot = pair.BeginWrite();
+    UDD_CHECK(slot != FramePool<Frame>::kInvalidSlot);
+    pair.CancelWrite(slot);
+}
+
+
+UDD_TEST(ConcurrentProducerAndConsumers)
+{
+    constexpr uint64_t kFrameCount = 20000;
+
+    FramePool<Frame> pool(3);
+    std::atomic<bool> isDone = { false };
+    std::atomic<int> inconsistentCount = { 0 };
+    std::atomic<int> backwardCount = { 0 };
+
+    // Consumers hold their leases for a while, as a render thread does while it copies the texture.
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 2; ++c)
+    {
+        consumers.emplace_back([&]
+        {
+            uint64_t lastGeneration = 0;
+            while (!isDone)
+            {
+                const auto lease = pool.AcquireLatest();
+                if (!lease) continue;
+                if (!IsConsistent(lease)) ++inconsistentCount;
+                if (lease.GetGeneration() < lastGeneration) ++backwardCount;
+                lastGeneration = lease.GetGeneration();
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    // The producer never waits; a frame with no free slot is skipped and counted.
+    uint64_t skippedCount = 0;
+    for (uint64_t i = 0; i < kFrameCount; ++i)
+    {
+        const auto slot = pool.BeginWrite();
+        if (slot == FramePool<Frame>::kInvalidSlot)
+        {
+            ++skippedCount;
+            continue;
+        }
+        Write(pool, slot);
+    }
+    isDone = true;
+    for (auto& consumer : consumers)
+    {
+        consumer.join();
+    }
+
+    UDD_CHECK_EQUAL(inconsistentCount.load(), 0);
+    UDD_CHECK_EQUAL(backwardCount.load(), 0);
+    UDD_CHECK_EQUAL(pool.GetStarvedCount(), skippedCount);
+    UDD_CHECK_EQUAL(pool.GetLatestGeneration(), kFrameCount - skippedCount);
+}
@@ -0,0 +1,210 @@
+#include <cmath>
+#include <cstdio>
+
+#include "Test.h"
+#include "PhaseLock.h"
+
+
+
+namespace
+{
+
+
+constexpr double kPeriod60Hz = 1000000.0 / 60.0;
+constexpr double kPeriod30Hz = 1000000.0 / 30.0;
+
+
+// Render thread of a simulated consumer: renders are due every period from start and come
+// up to jitter microseconds early or late.
+class Consumer
+{
+public:
+    Consumer(double period, double jitter, uint32_t seed)
+        : period_(period), jitter_(jitter), random_(seed)
+    {
+    }
+
+    // Ideal time of the render index
+    double GetDueTime(int64_t index) const
+    {
+        return start_ + index * period_;
+    }
+
+    // Renders the next frame (skipping some when a hitch is given) and returns its time.
+    int64_t Render(PhaseLock& phaseLock, int skippedCount = 0)
+    {
+        index_ += 1 + skippedCount;
+        const auto offset = (random_.Next() % 20001 / 10000.0 - 1.0) * jitter_;
+        const auto time = static_cast<int64_t>(std::llround(GetDueTime(index_) + offset));
+        phaseLock.AddRenderTime(time);
+        return time;
+    }
+
+    // Continues at another rate from the last render.
+    void SetPeriod(double period)
+    {
+        start_ = GetDueTime(index_);
+        index_ = 0;
+        period_ = period;
+    }
+
+    int64_t GetIndex() const { return index_; }
+
+private:
+    double start_ = 1000000.0;
+    double period_;
+    double jitter_;
+    Test::Random random_;
+    int64_t index_ = 0;
+};
+
+
+}
+
+
+
+UDD_TEST(ConvergesToSteadyConsumer)
+{
+    PhaseLock phaseLock;
+    UDD_CHECK(!phaseLock.IsLocked());
+    UDD_CHECK_EQUAL(phaseLock.GetNextRenderTime(0), -1);
+
+    // 60 Hz with +-0.2 ms of jitter; the first interval is a poor estimate of the period.
+    Consumer consumer(kPeriod60Hz, 200.0, 1);
+    int lockedAt = -1;
+    for (int i = 0; i < 600; ++i)
+    {
+        consumer.Render(phaseLock);
+        if (lockedAt < 0 && phaseLock.IsLocked()) lockedAt = i;
+    }
+
+    std::printf("Locked after %d renders, period %.1f us (jitter %.1f us)\n",
+        lockedAt, phaseLock.GetPeriod(), phaseLock.GetStats().jitterUs);
+    UDD_CHECK(lockedAt >= 0 && lockedAt < 16);
+    UDD_CHECK(std::abs(phaseLock.GetPeriod() - kPeriod60Hz) < 20.0);
+
+    // Predictions for any time land on the next due render, also a few periods ahead.
+    const auto last = consumer.GetIndex();
+    for (int k = 1; k <= 4; ++k)
+    {
+        const auto due = consumer.GetDueTime(last + k);
+        const auto predicted = phaseLock.GetNextRenderTime(static_cast<int64_t>(due - kPeriod60Hz / 2));
+        UDD_CHECK(std::abs(predicted - due) < 300.0);
+    }
+}
+
+
+// Renders scattered by +-1.5 ms around a 60 Hz cadence: the filtered prediction has to be much
+// closer to the cadence than the renders themselves.
+UDD_TEST(RejectsJitter)
+{
+    constexpr double kJitter = 1500.0;
+
+    PhaseLock phaseLock;
+    Consumer consumer(kPeriod60Hz, kJitter, 2);
+    for (int i = 0; i < 300; ++i)
+    {
+        consumer.Render(phaseLock);
+    }
+    UDD_CHECK(phaseLock.IsLocked());
+
+    double renderError = 0.0;
+    double predictionError = 0.0;
+    constexpr int kSampleCount = 1000;
+    for (int i = 0; i < kSampleCount; ++i)
+    {
+        const auto due = consumer.GetDueTime(consumer.GetIndex() + 1);
+        const auto predicted = phaseLock.GetNextRenderTime(static_cast<int64_t>(due - kPeriod60Hz / 2));
+        const auto time = consumer.Render(phaseLock);
+        renderError += std::abs(time - due);
+        predictionError += std::abs(predicted - due);
+        UDD_CHECK(phaseLock.IsLocked());
+    }
+    renderError /= kSampleCount;
+    predictionError /= kSampleCount;
+
+    std::printf("Mean distance from the cadence: renders %.1f us, predictions %.1f us\n", renderError, predictionError);
+    UDD_CHECK(predictionError < renderError * 0.6);
+    UDD_CHECK(std::abs(phaseLock.GetPeriod() - kPeriod60Hz) < 50.0);
+}
+
+
+UDD_TEST(HitchKeepsLock)
+{
+    PhaseLock phaseLock;
+    Consumer consumer(kPeriod60Hz, 100.0, 3);
+    for (int i = 0; i < 200; ++i)
+    {
+        consumer.Render(phaseLock);
+    }
+    UDD_CHECK(phaseLock.IsLocked());
+
+    // Three frames are dropped once; the render is matched to its period and the phase is kept.
+    consumer.Render(phaseLock, 3);
+    UDD_CHECK(phaseLock.IsLocked());
+    UDD_CHECK(std::abs(phaseLock.GetStats().lastErrorUs) < 300.0);
+    UDD_CHECK(std::abs(phaseLock.GetPeriod() - kPeriod60Hz) < 20.0);
+
+    const auto due = consumer.GetDueTime(consumer.GetIndex() + 1);
+    UDD_CHECK(std::abs(phaseLock.GetNextRenderTime(static_cast<int64_t>(due - 2000)) - due) < 300.0);
+}
+
+
+UDD_TEST(RelocksAfterRateChange)
+{
+    PhaseLock phaseLock;
+    Consumer consumer(kPeriod60Hz, 100.0, 4);
+    for (int i = 0; i < 200; ++i)
+    {
+        consumer.Render(phaseLock);
+    }
+    UDD_CHECK(phaseLock.IsLocked());
+
+    // At half the rate every render skips one period, which is a new rate rather than hitches.
+    consumer.SetPeriod(kPeriod30Hz);
+    int relockedAt = -1;
+    for (int i = 0; i < 400; ++i)
+    {
+        consumer.Render(phaseLock);
+        if (relockedAt < 0 && std::abs(phaseLock.GetPeriod() - kPeriod30Hz) < 100.0 && phaseLock.IsLocked())
+        {
+            relockedAt = i;
+        }
+    }
+    std::printf("Relocked to 30 Hz after %d renders\n", relockedAt);
+    UDD_CHECK(relockedAt >= 0 && relockedAt < 32);
+    UDD_CHECK(std::abs(phaseLock.GetPeriod() - kPeriod30Hz) < 30.0);
+
+    // A long pause (the application lost focus) also starts over.
+    consumer.Render(phaseLock, 20);
+    UDD_CHECK(!phaseLock.IsLocked());
+}
+
+
+UDD_TEST(IrregularConsumerDoesNotLock)
+{
+    PhaseLock phaseLock;
+    Test::Random random(5);
+    int64_t time = 1000000;
+    int lockedCount = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        time += random.Range(4000, 40000);
+        phaseLock.AddRenderTime(time);
+        if (phaseLock.IsLocked()) ++lockedCount;
+    }
+    std::printf("Locked for %d of 1000 irregular renders\n", lockedCount);
+    UDD_CHECK(lockedCount < 10);
+
+    // Times going backwards (another clock) are ignored.
+    PhaseLock steady;
+    Consumer consumer(kPeriod60Hz, 0.0, 6);
+    for (int i = 0; i < 100; ++i)
+    {
+        consumer.Render(steady);
+    }
+    const auto period = steady.GetPeriod();
+    steady.AddRenderTime(0);
+    UDD_CHECK(steady.IsLocked());
+    UDD_CHECK_EQUAL(steady.GetPeriod(), period);
+}
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Test.h"
+#include "RegionStats.h"
+
+
+
+namespace
+{
+
+
+using Rect = RegionStats::Rect;
+
+
+class Image
+{
+public:
+    Image(int width, int height) : width_(width), height_(height), pixels_(width * height * 4) {}
+
+    void Fill(Test::Random& random, const Rect& rect)
+    {
+        for (int y = rect.top; y < rect.bottom; ++y)
+        {
+            for (int x = rect.left; x < rect.right; ++x)
+            {
+                const auto value = random.Next();
+                auto pixel = &pixels_[(y * width_ + x) * 4];
+                pixel[0] = static_cast<uint8_t>(value);
+                pixel[1] = static_cast<uint8_t>(value >> 8);
+                pixel[2] = static_cast<uint8_t>(value >> 16);
+                pixel[3] = 255;
+            }
+        }
+    }
+
+    void Update(RegionStats& stats, uint32_t frameId, const std::vector<Rect>& rects) const
+    {
+        stats.Update(frameId, pixels_.data(), width_ * 4, width_, height_, rects.data(), rects.size());
+    }
+
+    // Reference: the mean of every pixel in the rect
+    RegionMean GetMean(const Rect& rect) const
+    {
+        double sums[3] = {};
+        for (int y = rect.top; y < rect.bottom; ++y)
+        {
+            for (int x = rect.left; x < rect.right; ++x)
+            {
+                const auto pixel = &pixels_[(y * width_ + x) * 4];
+                for (int channel = 0; channel < 3; ++channel) sums[channel] += pixel[channel];
+            }
+        }
+        const double count = static_cast<double>(rect.right - rect.left) * (rect.bottom - rect.top);
+        RegionMean mean = {};
+        mean.b = static_cast<float>(sums[0] / count);
+        mean.g = static_cast<float>(sums[1] / count);
+        mean.r = static_cast<float>(sums[2] / count);
+        return mean;
+    }
+
+    std::vector<uint32_t> GetHistogram() const
+    {
+        std::vector<uint32_t> histogram(RegionStats::kHistogramBinCount);
+        for (size_t i = 0; i < pixels_.size(); i += 4)
+        {
+            ++histogram[(pixels_[i] * 19 + pixels_[i + 1] * 183 + pixels_[i + 2] * 54) >> 8];
+        }
+        return histogram;
+    }
+
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+
+private:
+    int width_;
+    int height_;
+    std::vector<uint8_t> pixels_;
+};
+
+
+Rect RandomRect(Test::Random& random, int width, int height)
+{
+    Rect rect;
+    rect.left = random.Range(0, width - 1);
+    rect.top = random.Range(0, height - 1);
+    rect.right = random.Range(rect.left + 1, width);
+    rect.bottom = random.Range(rect.top + 1, height);
+    return rect;
+}
+
+
+bool IsNear(const RegionMean& a, const RegionMean& b)
+{
+    constexpr float kTolerance = 0.001f;
+    return std::abs(a.r - b.r) < kTolerance && std::abs(a.g - b.g) < kTolerance && std::abs(a.b - b.b) < kTolerance;
+}
+
+
+bool HasHistogram(const RegionStats& stats, const Image& image)
+{
+    const auto expected = image.GetHistogram();
+    return std::equal(expected.begin(), expected.end(), stats.GetHistogram());
+}
+
+
+}
+
+
+
+UDD_TEST(ExactWithOnePixelCells)
+{
+    Test::Random random(1);
+    Image image(97, 61);
+    image.Fill(random, { 0, 0, 97, 61 });
+
+    RegionStats stats(1);
+    UDD_CHECK(!stats.HasImage());
+    image.Update(stats, 1, {});
+    UDD_CHECK(stats.HasImage());
+
+    for (int i = 0; i < 500; ++i)
+    {
+        const auto rect = RandomRect(random, image.GetWidth(), image.GetHeight());
+        UDD_CHECK(IsNear(stats.GetMean(rect), image.GetMean(rect)));
+    }
+
+    // Rects are clipped to the image.
+    UDD_CHECK(IsNear(stats.GetMean({ -10, -10, 200, 200 }), image.GetMean({ 0, 0, 97, 61 })));
+    UDD_CHECK_EQUAL(stats.GetMean({ 100, 0, 120, 10 }).r, 0.f);
+
+    // The luma of the whole image comes from the histogram, which is checked against the same weights.
+    UDD_CHECK(HasHistogram(stats, image));
+    double lumaSum = 0.0;
+    const auto histogram = image.GetHistogram();
+    for (int i = 0; i < RegionStats::kHistogramBinCount; ++i) lumaSum += static_cast<double>(i) * histogram[i];
+    UDD_CHECK(std::abs(stats.GetMeanLuma() - lumaSum / (97 * 61)) < 0.001);
+}
+
+
+UDD_TEST(SnapsToCells)
+{
+    // 100 x 70 with 16 pixel cells leaves narrower cells on the right and bottom edges.
+    Test::Random random(2);
+    Image image(100, 70);
+    image.Fill(random, { 0, 0, 100, 70 });
+
+    RegionStats stats(16);
+    image.Update(stats, 1, {});
+
+    // Rects on cell edges (the image border is one) are exact, also over the partial edge cells.
+    const int edges[] = { 0, 16, 32, 48, 64, 80, 96, 100 };
+    for (int i = 0; i < 300; ++i)
+    {
+        Rect rect;
+        rect.left = edges[random.Range(0, 6)];
+        rect.right = edges[random.Range(1, 7)];
+        rect.top = edges[random.Range(0, 4)];
+        rect.bottom = (std::min)(edges[random.Range(1, 5)], 70);
+        if (rect.right <= rect.left || rect.bottom <= rect.top) continue;
+        UDD_CHECK(IsNear(stats.GetMean(rect), image.GetMean(rect)));
+    }
+
+    // Other edges go to the nearest cell edge, and a rect in a single cell still gets that cell.
+    UDD_CHECK(IsNear(stats.GetMean({ 7, 9, 41, 55 }), image.GetMean({ 0, 16, 48, 48 })));
+    UDD_CHECK(IsNear(stats.GetMean({ 90, 66, 99, 69 }), image.GetMean({ 96, 64, 100, 70 })));
+    UDD_CHECK(IsNear(stats.GetMean({ 20, 20, 21, 21 }), image.GetMean({ 16, 16, 32, 32 })));
+}
+
+
+// Random frames only repaint their dirty rects: the incremental tables have to match a full update
+// of the same image every frame.
+UDD_TEST(IncrementalMatchesFull)
+{
+    Test::Random random(3);
+    Image image(300, 200);
+    image.Fill(random, { 0, 0, 300, 200 });
+
+    for (const auto cellSize : { 1, 8, 32 })
+    {
+        RegionStats stats(cellSize);
+        uint32_t frameId = 1;
+        image.Update(stats, frameId, {});
+
+        int mismatchCount = 0;
+        for (int frame = 0; frame < 100; ++frame)
+        {
+            std::vector<Rect> rects;
+            const auto rectCount = random.Range(0, 6);
+            for (int i = 0; i < rectCount; ++i)
+            {
+                const auto left = random.Range(0, 299);
+                const auto top = random.Range(0, 199);
+                const Rect rect = { left, top, (std::min)(left + random.Range(1, 40), 300), (std::min)(top + random.Range(1, 40), 200) };
+                image.Fill(random, rect);
+                rects.push_back(rect);
+            }
+
+            // Rects reaching past the image (a cursor at the edge) are clipped and repeated rects are read once.
+            rects.push_back({ 290, 190, 320, 230 });
+            image.Fill(random, { 290, 190, 300, 200 });
+            rects.push_back(rects.front());
+
+            image.Update(stats, ++frameId, rects);
+
+            RegionStats full(cellSize);
+            image.Update(full, 1, {});
+            if (!HasHistogram(stats, image)) ++mismatchCount;
+            if (stats.GetMeanLuma() != full.GetMeanLuma()) ++mismatchCount;
+            for (int i = 0; i < 20; ++i)
+            {
+                const auto rect = RandomRect(random, 300, 200);
+                if (!IsNear(stats.GetMean(rect), full.GetMean(rect))) ++mismatchCount;
+            }
+        }
+        UDD_CHECK_EQUAL(mismatchCount, 0);
+        UDD_CHECK_EQUAL(stats.GetFrameId(), frameId);
+    }
+}
+
+
+UDD_TEST(SkippedFramesTakeWholeImage)
+{
+    Test::Random random(4);
+    Image image(64, 48);
+    image.Fill(random, { 0, 0, 64, 48 });
+
+    RegionStats stats(4);
+    image.Update(stats, 10, {});
+
+    // Frame 11 was never seen, so the rects of frame 12 do not cover what has changed.
+    image.Fill(random, { 0, 0, 32, 48 });
+    image.Fill(random, { 40, 10, 50, 20 });
+    image.Update(stats, 12, { { 40, 10, 50, 20 } });
+    UDD_CHECK(HasHistogram(stats, image));
+    UDD_CHECK(IsNear(stats.GetMean({ 0, 0, 32, 48 }), image.GetMean({ 0, 0, 32, 48 })));
+
+    // A size change (rotation) also starts over.
+    Image rotated(48, 64);
+    rotated.Fill(random, { 0, 0, 48, 64 });
+    rotated.Update(stats, 13, {});
+    UDD_CHECK_EQUAL(stats.GetWidth(), 48);
+    UDD_CHECK_EQUAL(stats.GetHeight(), 64);
+    UDD_CHECK(HasHistogram(stats, rotated));
+    UDD_CHECK(IsNear(stats.GetMean({ 0, 0, 48, 64 }), rotated.GetMean({ 0, 0, 48, 64 })));
+}
+
+
+UDD_TEST(UpdateCost)
+{
+    Test::Random random(5);
+    Image image(1920, 1080);
+    image.Fill(random, { 0, 0, 1920, 1080 });
+
+    RegionStats stats(8);
+    image.Update(stats, 1, {});
+    const auto fullMs = stats.GetUpdateMs();
+
+    // A typing frame: a caret and a few glyphs plus the cursor.
+    const std::vector<Rect> rects = { { 400, 300, 480, 320 }, { 481, 300, 483, 320 }, { 900, 500, 932, 532 } };
+    double dirtyMs = 0.0;
+    for (uint32_t frameId = 2; frameId < 102; ++frameId)
+    {
+        image.Update(stats, frameId, rects);
+        dirtyMs += stats.GetUpdateMs();
+    }
+    dirtyMs /= 100;
+
+    constexpr int kQueryCount = 100000;
+    const auto start = std::chrono::steady_clock::now();
+    float sum = 0.f;
+    for (int i = 0; i < kQueryCount; ++i)
+    {
+        sum += stats.GetMean({ i % 1000, i % 500, i % 1000 + 900, i % 500 + 500 }).r;
+    }
+    const auto queryNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / kQueryCount;
+
+    std::printf("1920x1080, 8 px cells: full update %.3f ms, dirty update %.3f ms, mean query %.1f ns (%.0f)\n",
+        fullMs, dirtyMs, queryNs, sum / kQueryCount);
+    UDD_CHECK(dirtyMs < fullMs);
+}
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Test.h"
+#include "Codec.h"
+#include "ReplayTiles.h"
+
+
+
+namespace
+{
+
+
+constexpr int kTileSize = 32;
+
+
+struct Image
+{
+    Image(int width, int height) : width(width), height(height), pixels(width * height, 0) {}
+
+    BYTE* GetData() { return reinterpret_cast<BYTE*>(pixels.data()); }
+    UINT GetPitch() const { return width * 4; }
+
+    int width;
+    int height;
+    std::vector<uint32_t> pixels;
+};
+
+
+RECT RandomRect(Test::Random& random, int width, int height, int maxSize)
+{
+    // Rects may reach past the image, as the cursor area does on the edges.
+    const LONG left = random.Range(-8, width - 1);
+    const LONG top = random.Range(-8, height - 1);
+    return { left, top, left + random.Range(1, maxSize), top + random.Range(1, maxSize) };
+}
+
+
+void Paint(Image* image, Test::Random& random, const RECT& rect)
+{
+    // Flat areas and noise, so that both RLE tokens are used.
+    const auto color = random.Next();
+    const bool isNoise = random.Next() % 2 == 0;
+    for (int y = (std::max)(static_cast<int>(rect.top), 0); y < (std::min)(static_cast<int>(rect.bottom), image->height); ++y)
+    {
+        for (int x = (std::max)(static_cast<int>(rect.left), 0); x < (std::min)(static_cast<int>(rect.right), image->width); ++x)
+        {
+            image->pixels[y * image->width + x] = isNoise ? random.Next() : color;
+        }
+    }
+}
+
+
+// Reference: the tile of every pixel under the rects
+std::vector<BYTE> MarkTiles(const std::vector<RECT>& rects, int width, int height)
+{
+    const auto columnCount = (width + kTileSize - 1) / kTileSize;
+    const auto rowCount = (height + kTileSize - 1) / kTileSize;
+    std::vector<BYTE> tiles(columnCount * rowCount, 0);
+    for (const auto& rect : rects)
+    {
+        for (int y = (std::max)(static_cast<int>(rect.top), 0); y < (std::min)(static_cast<int>(rect.bottom), height); ++y)
+        {
+            for (int x = (std::max)(static_cast<int>(rect.left), 0); x < (std::min)(static_cast<int>(rect.right), width); ++x)
+            {
+                tiles[(y / kTileSize) * columnCount + x / kTileSize] = 1;
+            }
+        }
+    }
+    return tiles;
+}
+
+
+// Regions have to cover exactly the marked tiles, once, within the image and one tile row high.
+bool CoversTiles(const std::vector<RECT>& regions, const std::vector<BYTE>& expected, int width, int height)
+{
+    const auto columnCount = (width + kTileSize - 1) / kTileSize;
+    std::vector<BYTE> covered(expected.size(), 0);
+    for (const auto& region : regions)
+    {
+        if (region.left < 0 || region.top < 0 || region.right > width || region.bottom > height) return false;
+        if (region.left % kTileSize != 0 || region.top % kTileSize != 0) return false;
+        if (region.right <= region.left || (region.bottom - 1) / kTileSize != region.top / kTileSize) return false;
+
+        for (auto x = region.left; x < region.right; x += kTileSize)
+        {
+            auto& tile = covered[(region.top / kTileSize) * columnCount + x / kTileSize];
+            if (tile) return false;
+            tile = 1;
+        }
+    }
+    return covered == expected;
+}
+
+
+}
+
+
+
+UDD_TEST(CollectsMarkedTiles)
+{
+    // 333 x 217 leaves partial tiles on the right and bottom edges.
+    ReplayTiles tiles(kTileSize);
+    tiles.Reset(333, 217);
+
+    std::vector<RECT> regions;
+    tiles.Collect(&regions);
+    UDD_CHECK(regions.empty());
+
+    // Adjacent tiles in a row become one region, clipped to the image.
+    tiles.Mark({ 10, 10, 70, 20 });
+    tiles.Mark({ 320, 200, 400, 300 });
+    tiles.Mark({ -50, -50, -1, -1 });
+    tiles.Mark({ 40, 40, 40, 80 });
+    tiles.Collect(&regions);
+    UDD_CHECK_EQUAL(regions.size(), 2u);
+    UDD_CHECK(regions.size() == 2 &&
+        regions[0].left == 0 && regions[0].top == 0 && regions[0].right == 96 && regions[0].bottom == 32 &&
+        regions[1].left == 320 && regions[1].top == 192 && regions[1].right == 333 && regions[1].bottom == 217);
+
+    // Collecting clears the marks.
+    regions.clear();
+    tiles.Collect(&regions);
+    UDD_CHECK(regions.empty());
+
+    Test::Random random(1);
+    for (int frame = 0; frame < 200; ++frame)
+    {
+        std::vector<RECT> rects;
+        const auto rectCount = random.Range(0, 30);
+        for (int i = 0; i < rectCount; ++i)
+        {
+            rects.push_back(RandomRect(random, 333, 217, (i % 8 == 0) ? 200 : 20));
+            tiles.Mark(rects.back());
+        }
+        regions.clear();
+        tiles.Collect(&regions);
+        UDD_CHECK(CoversTiles(regions, MarkTiles(rects, 333, 217), 333, 217));
+    }
+}
+
+
+// A ring's frames decoded in order have to rebuild every captured image exactly: a key frame
+// holds the whole image and the deltas in between hold the tiles under the changed rects.
+UDD_TEST(ReplayRoundTrip)
+{
+    constexpr int kWidth = 333;
+    constexpr int kHeight = 217;
+    constexpr int kKeyFrameInterval = 20;
+
+    Test::Random random(2);
+    Image desktop(kWidth, kHeight);
+    Image replay(kWidth, kHeight);
+    Paint(&desktop, random, { 0, 0, kWidth, kHeight });
+
+    ReplayTiles tiles(kTileSize);
+    tiles.Reset(kWidth, kHeight);
+
+    int mismatchCount = 0, failureCount = 0;
+    size_t keyFrameBytes = 0, deltaBytes = 0;
+    for (int frame = 0; frame < 200; ++frame)
+    {
+        std::vector<RECT> regions;
+        if (frame % kKeyFrameInterval == 0)
+        {
+            // Deltas never reach the replay image before the key frame does.
+            std::fill(replay.pixels.begin(), replay.pixels.end(), 0xDEADBEEFu);
+            regions.push_back({ 0, 0, kWidth, kHeight });
+        }
+        else
+        {
+            const auto rectCount = random.Range(1, 12);
+            for (int i = 0; i < rectCount; ++i)
+            {
+                const auto rect = RandomRect(random, kWidth, kHeight, 60);
+                Paint(&desktop, random, rect);
+                tiles.Mark(rect);
+            }
+            tiles.Collect(&regions);
+        }
+
+        std::vector<BYTE> data;
+        Codec::EncodeRegions(desktop.GetData(), desktop.GetPitch(), regions.data(), regions.size(), data);
+        (frame % kKeyFrameInterval == 0 ? keyFrameBytes : deltaBytes) += data.size();
+
+        if (!Codec::DecodeRegions(
+            data.data(), data.size(), static_cast<UINT>(regions.size()),
+            replay.GetData(), kWidth, kHeight, replay.GetPitch()))
+        {
+            ++failureCount;
+        }
+        if (replay.pixels != desktop.pixels) ++mismatchCount;
+    }
+
+    UDD_CHECK_EQUAL(failureCount, 0);
+    UDD_CHECK_EQUAL(mismatchCount, 0);
+    std::printf("333x217: key frames %zu bytes, deltas %zu bytes on average\n",
+        keyFrameBytes / 10, deltaBytes / 190);
+}
+
+
+UDD_TEST(DeltaCost)
+{
+    constexpr int kWidth = 1920;
+    constexpr int kHeight = 1080;
+
+    Test::Random random(3);
+    Image desktop(kWidth, kHeight);
+    Paint(&desktop, random, { 0, 0, kWidth, kHeight });
+    std::fill(desktop.pixels.begin(), desktop.pixels.end() - kWidth * 200, 0xFFFFFFFFu);
+
+    ReplayTiles tiles(kTileSize);
+    tiles.Reset(kWidth, kHeight);
+
+    // A typing frame: some glyphs, the caret and the cursor
+    const RECT rects[] = { { 400, 300, 480, 320 }, { 481, 300, 483, 320 }, { 900, 500, 932, 532 } };
+    constexpr int kFrameCount = 200;
+    size_t bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < kFrameCount; ++frame)
+    {
+        for (const auto& rect : rects)
+        {
+            tiles.Mark(rect);
+        }
+        std::vector<RECT> regions;
+        tiles.Collect(&regions);
+
+        std::vector<BYTE> data;
+        Codec::EncodeRegions(desktop.GetData(), desktop.GetPitch(), regions.data(), regions.size(), data);
+        bytes += data.size();
+    }
+    const auto us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / kFrameCount;
+
+    std::printf("1920x1080 typing frame: %.1f us and %zu bytes per delta\n", us, bytes / kFrameCount);
+    UDD_CHECK(bytes / kFrameCount < 16 * 1024);
+}
@@ -0,0 +1,298 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Test.h"
+#include "SharedFrameRing.h"
+#include "../Consumer/uDesktopDuplicationShm.h"
+
+
+
+namespace
+{
+
+
+constexpr UINT kWidth = 96;
+constexpr UINT kHeight = 64;
+
+
+// Every frame has its own pattern, so a read which raced with the producer is detected.
+uint32_t GetPixel(UINT64 frameId, UINT x, UINT y)
+{
+    return static_cast<uint32_t>(frameId * 2654435761u) ^ (y * kWidth + x);
+}
+
+
+// Monitor ids are derived from the pid so that concurrent test runs do not share a ring.
+int GetMonitorId(int index)
+{
+    return 10000 + (static_cast<int>(getpid()) % 10000) * 10 + index;
+}
+
+
+struct Source
+{
+    explicit Source(UINT pitch = kWidth * 4) : pitch(pitch), pixels(pitch * kHeight) {}
+
+    CpuFrame Draw(UINT id)
+    {
+        for (UINT y = 0; y < kHeight; ++y)
+        {
+            auto row = reinterpret_cast<uint32_t*>(&pixels[y * pitch]);
+            for (UINT x = 0; x < kWidth; ++x)
+            {
+                row[x] = GetPixel(id + 1ull, x, y);
+            }
+        }
+
+        CpuFrame frame = {};
+        frame.id = id;
+        frame.presentTime.QuadPart = 1000 + id;
+        frame.pixels = pixels.data();
+        frame.pitch = pitch;
+        frame.width = kWidth;
+        frame.height = kHeight;
+        return frame;
+    }
+
+    UINT pitch;
+    std::vector<BYTE> pixels;
+};
+
+
+bool MatchesFrame(const uint8_t* pixels, UINT pitch, UINT64 frameId)
+{
+    for (UINT y = 0; y < kHeight; ++y)
+    {
+        auto row = reinterpret_cast<const uint32_t*>(pixels + y * pitch);
+        for (UINT x = 0; x < kWidth; ++x)
+        {
+            if (row[x] != GetPixel(frameId, x, y)) return false;
+        }
+    }
+    return true;
+}
+
+
+// Runs in the child process; the exit code tells the parent what went wrong.
+int RunConsumer(int monitorId, UINT64 lastFrameId)
+{
+    UddShmRing* ring = nullptr;
+    for (int i = 0; i < 1000 && !ring; ++i)
+    {
+        ring = udd_shm_open(monitorId);
+        if (!ring) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!ring) return 2;
+
+    std::vector<uint8_t> pixels(kWidth * kHeight * 4);
+    UINT64 frameId = 0;
+    int frameCount = 0;
+    int retryCount = 0;
+    int exitCode = 0;
+
+    while (frameId < lastFrameId)
+    {
+        if (!udd_shm_wait(ring, frameId, 5000))
+        {
+            exitCode = 3;
+            break;
+        }
+
+        UddShmSlotHeader info;
+        const auto result = udd_shm_read_latest(ring, pixels.data(), pixels.size(), &info);
+        if (result < 0)
+        {
+            // The producer lapped the reader on every retry; this must not be reported as a frame.
+            ++retryCount;
+            continue;
+        }
+
+        if (info.frameId <= frameId || info.width != kWidth || info.height != kHeight)
+        {
+            exitCode = 4;
+            break;
+        }
+        if (!MatchesFrame(pixels.data(), kWidth * 4, info.frameId))
+        {
+            exitCode = 5;
+            break;
+        }
+
+        frameId = info.frameId;
+        ++frameCount;
+    }
+
+    std::printf("consumer: %d frames read, %d reads exhausted their retries\n", frameCount, retryCount);
+    std::fflush(stdout);
+    udd_shm_close(ring);
+    return exitCode;
+}
+
+
+}
+
+
+
+UDD_TEST(ProducerAndConsumerProcesses)
+{
+    const auto monitorId = GetMonitorId(0);
+    constexpr UINT kFrameCount = 2000;
+
+    SharedFrameRing ring;
+    UDD_CHECK(ring.Create(monitorId, 3, kWidth, kHeight));
+    if (!ring.IsCreated()) return;
+
+    std::fflush(stdout);
+    const auto pid = fork();
+    UDD_CHECK(pid >= 0);
+    if (pid < 0) return;
+
+    if (pid == 0)
+    {
+        // The child must not run destructors which would unlink the ring of the parent.
+        _exit(RunConsumer(monitorId, kFrameCount));
+    }
+
+    // The producer is much faster than the reader and never waits for it, except for
+    // a short pause now and then so that the reader gets frames before the last one.
+    Source source;
+    for (UINT id = 0; id < kFrameCount; ++id)
+    {
+        ring.Write(source.Draw(id));
+        if (id % 16 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    int status = 0;
+    UDD_CHECK(waitpid(pid, &status, 0) == pid);
+    UDD_CHECK(WIFEXITED(status));
+    UDD_CHECK_EQUAL(WEXITSTATUS(status), 0);
+}
+
+
+UDD_TEST(SecondProducerIsRejected)
+{
+    const auto monitorId = GetMonitorId(1);
+
+    SharedFrameRing first;
+    UDD_CHECK(first.Create(monitorId, 2, kWidth, kHeight));
+
+    SharedFrameRing second;
+    UDD_CHECK(!second.Create(monitorId, 2, kWidth, kHeight));
+    UDD_CHECK(!second.IsCreated());
+
+    // The name is released with the first producer.
+    first.Destroy();
+    UDD_CHECK(udd_shm_open(monitorId) == nullptr);
+    UDD_CHECK(second.Create(monitorId, 2, kWidth, kHeight));
+}
+
+
+UDD_TEST(ReadBeforeFirstFrame)
+{
+    const auto monitorId = GetMonitorId(2);
+    UDD_CHECK(udd_shm_open(monitorId) == nullptr);
+
+    SharedFrameRing ring;
+    UDD_CHECK(ring.Create(monitorId, 2, kWidth, kHeight));
+
+    auto reader = udd_shm_open(monitorId);
+    UDD_CHECK(reader != nullptr);
+    if (!reader) return;
+
+    std::vector<uint8_t> pixels(kWidth * kHeight * 4);
+    UDD_CHECK_EQUAL(udd_shm_get_latest_frame_id(reader), 0u);
+    UDD_CHECK_EQUAL(udd_shm_read_latest(reader, pixels.data(), pixels.size(), nullptr), 0);
+    UDD_CHECK_EQUAL(udd_shm_wait(reader, 0, 10), 0);
+
+    // Too small a destination is an error, not a partial copy.
+    Source source;
+    ring.Write(source.Draw(0));
+    UDD_CHECK_EQUAL(udd_shm_read_latest(reader, pixels.data(), pixels.size() - 4, nullptr), -1);
+    UDD_CHECK_EQUAL(udd_shm_read_latest(reader, pixels.data(), pixels.size(), nullptr), 1);
+
+    udd_shm_close(reader);
+}
+
+
+UDD_TEST(PaddedRowsAndDirtyRects)
+{
+    const auto monitorId = GetMonitorId(3);
+
+    SharedFrameRing ring;
+    UDD_CHECK(ring.Create(monitorId, 2, kWidth, kHeight));
+    auto reader = udd_shm_open(monitorId);
+    UDD_CHECK(reader != nullptr);
+    if (!reader) return;
+
+    Source source(kWidth * 4 + 64);
+    auto frame = source.Draw(41);
+
+    const DXGI_OUTDUPL_MOVE_RECT moves[] = { { { 0, 0 }, { 8, 8, 24, 24 } } };
+    const RECT dirties[] = { { 1, 2, 3, 4 }, { 50, 40, 96, 64 } };
+    frame.moveRects = moves;
+    frame.moveRectCount = 1;
+    frame.dirtyRects = dirties;
+    frame.dirtyRectCount = 2;
+    ring.Write(frame);
+
+    std::vector<uint8_t> pixels(kWidth * kHeight * 4);
+    UddShmSlotHeader info;
+    UDD_CHECK_EQUAL(udd_shm_read_latest(reader, pixels.data(), pixels.size(), &info), 1);
+    UDD_CHECK_EQUAL(info.frameId, 42u);
+    UDD_CHECK_EQUAL(info.pitch, kWidth * 4);
+    UDD_CHECK_EQUAL(info.presentTime, 1041);
+    UDD_CHECK(MatchesFrame(pixels.data(), kWidth * 4, info.frameId));
+
+    // Move destinations come first, then dirty rects.
+    UDD_CHECK_EQUAL(info.dirtyRectCount, 3u);
+    UDD_CHECK_EQUAL(info.dirtyRects[0].left, 8);
+    UDD_CHECK_EQUAL(info.dirtyRects[0].bottom, 24);
+    UDD_CHECK_EQUAL(info.dirtyRects[1].top, 2);
+    UDD_CHECK_EQUAL(info.dirtyRects[2].right, 96);
+
+    // More rects than a slot holds means "everything changed".
+    std::vector<RECT> manyRects(UDD_SHM_MAX_DIRTY_RECTS + 1, RECT { 0, 0, 1, 1 });
+    frame = source.Draw(42);
+    frame.dirtyRects = manyRects.data();
+    frame.dirtyRectCount = static_cast<UINT>(manyRects.size());
+    ring.Write(frame);
+
+    UDD_CHECK_EQUAL(udd_shm_read_latest(reader, pixels.data(), pixels.size(), &info), 1);
+    UDD_CHECK_EQUAL(info.dirtyRectCount, UDD_SHM_DIRTY_RECTS_OVERFLOW);
+
+    udd_shm_close(reader);
+}
+
+
+UDD_TEST(ZeroCopyViewDetectsOverwrite)
+{
+    const auto monitorId = GetMonitorId(4);
+
+    SharedFrameRing ring;
+    UDD_CHECK(ring.Create(monitorId, 2, kWidth, kHeight));
+    auto reader = udd_shm_open(monitorId);
+    UDD_CHECK(reader != nullptr);
+    if (!reader) return;
+
+    Source source;
+    ring.Write(source.Draw(0));
+
+    UddShmFrameView view;
+    UDD_CHECK_EQUAL(udd_shm_begin_read(reader, &view), 1);
+    UDD_CHECK(MatchesFrame(view.pixels, view.header->pitch, 1));
+    UDD_CHECK_EQUAL(udd_shm_end_read(reader, &view), 1);
+
+    // With two slots, the second write after this one reuses the slot of the view.
+    UDD_CHECK_EQUAL(udd_shm_begin_read(reader, &view), 1);
+    ring.Write(source.Draw(1));
+    UDD_CHECK_EQUAL(udd_shm_end_read(reader, &view), 1);
+    ring.Write(source.Draw(2));
+    UDD_CHECK_EQUAL(udd_shm_end_read(reader, &view), 0);
+
+    udd_shm_close(reader);
+}
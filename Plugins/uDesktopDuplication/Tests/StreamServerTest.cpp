@@ -0,0 +1,369 @@
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Test.h"
+#include "StreamServer.h"
+#include "../Consumer/uDesktopDuplicationStream.h"
+
+
+
+namespace
+{
+
+
+constexpr UINT kWidth = 200; // not a multiple of the tile size
+constexpr UINT kHeight = 150;
+constexpr int kTimeoutMs = 5000;
+
+
+// Desktop image the frames given to the server are taken from
+struct Desktop
+{
+    Desktop() : pixels(kWidth * kHeight) {}
+
+    void Fill(const RECT& rect, uint32_t color)
+    {
+        for (LONG y = rect.top; y < rect.bottom; ++y)
+        {
+            for (LONG x = rect.left; x < rect.right; ++x)
+            {
+                pixels[y * kWidth + x] = color;
+            }
+        }
+    }
+
+    // Noise does not compress, so these tiles are sent raw.
+    void Noise(const RECT& rect, Test::Random& random)
+    {
+        for (LONG y = rect.top; y < rect.bottom; ++y)
+        {
+            for (LONG x = rect.left; x < rect.right; ++x)
+            {
+                pixels[y * kWidth + x] = random.Next();
+            }
+        }
+    }
+
+    // Stripes give RLE tiles.
+    void Stripes(const RECT& rect, uint32_t seed)
+    {
+        for (LONG y = rect.top; y < rect.bottom; ++y)
+        {
+            for (LONG x = rect.left; x < rect.right; ++x)
+            {
+                pixels[y * kWidth + x] = seed + static_cast<uint32_t>(x / 7);
+            }
+        }
+    }
+
+    // Same semantics as a DXGI move rect: the destination takes the previous pixels at the source.
+    void Move(const DXGI_OUTDUPL_MOVE_RECT& move)
+    {
+        const auto previous = pixels;
+        const auto& dst = move.DestinationRect;
+        for (LONG y = dst.top; y < dst.bottom; ++y)
+        {
+            for (LONG x = dst.left; x < dst.right; ++x)
+            {
+                const auto srcX = move.SourcePoint.x + (x - dst.left);
+                const auto srcY = move.SourcePoint.y + (y - dst.top);
+                pixels[y * kWidth + x] = previous[srcY * kWidth + srcX];
+            }
+        }
+    }
+
+    CpuFrame GetFrame(UINT id) const
+    {
+        CpuFrame frame = {};
+        frame.id = id;
+        frame.pixels = reinterpret_cast<const BYTE*>(pixels.data());
+        frame.pitch = kWidth * 4;
+        frame.width = kWidth;
+        frame.height = kHeight;
+        return frame;
+    }
+
+    std::vector<uint32_t> pixels;
+};
+
+
+class Client
+{
+public:
+    Client() : decoder_(udd_stream_decoder_create()) {}
+
+    ~Client()
+    {
+        if (socket_ >= 0) close(socket_);
+        udd_stream_decoder_destroy(decoder_);
+    }
+
+    bool Connect(USHORT port)
+    {
+        socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (socket_ < 0) return false;
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        return connect(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    }
+
+    // Receives until the decoder has completed the frame of the given server id (id + 1).
+    bool WaitForFrame(UINT64 frameId)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kTimeoutMs);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            const auto last = udd_stream_decoder_get_last_frame(decoder_);
+            if (last && last->frameId >= frameId) return true;
+
+            pollfd fd = { socket_, POLLIN, 0 };
+            if (poll(&fd, 1, 10) <= 0) continue;
+
+            const auto size = recv(socket_, buffer_, sizeof(buffer_), 0);
+            if (size <= 0) return false;
+
+            // The decoder accepts any split of the stream, so it is fed in uneven pieces.
+            for (ssize_t offset = 0; offset < size;)
+            {
+                const auto piece = std::min<ssize_t>(size - offset, 1 + (offset % 977));
+                if (udd_stream_decoder_feed(decoder_, buffer_ + offset, static_cast<size_t>(piece)) < 0) return false;
+                offset += piece;
+            }
+        }
+        return false;
+    }
+
+    bool Matches(const Desktop& desktop) const
+    {
+        const auto image = udd_stream_decoder_get_image(decoder_);
+        return image && std::memcmp(image, desktop.pixels.data(), desktop.pixels.size() * 4) == 0;
+    }
+
+    void Disconnect()
+    {
+        close(socket_);
+        socket_ = -1;
+    }
+
+    const UddStreamDecoder* GetDecoder() const { return decoder_; }
+
+private:
+    int socket_ = -1;
+    UddStreamDecoder* decoder_;
+    uint8_t buffer_[64 * 1024];
+};
+
+
+// Ports are derived from the pid so that concurrent test runs do not collide.
+USHORT Start(StreamServer& server)
+{
+    for (int i = 0; i < 32; ++i)
+    {
+        const auto port = static_cast<USHORT>(40000 + (getpid() * 37 + i * 101) % 20000);
+        if (server.Start(port, kWidth, kHeight, DXGI_MODE_ROTATION_ROTATE90)) return port;
+    }
+    return 0;
+}
+
+
+bool WaitForClients(const StreamServer& server, UINT count)
+{
+    for (int i = 0; i < kTimeoutMs && server.GetClientCount() != count; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return server.GetClientCount() == count;
+}
+
+
+void DrawInitialDesktop(Desktop& desktop)
+{
+    Test::Random random(7);
+    desktop.Fill({ 0, 0, kWidth, kHeight }, 0xFF202020u);
+    desktop.Stripes({ 0, 0, 128, 64 }, 0xFF000000u);
+    desktop.Noise({ 128, 64, 200, 150 }, random);
+}
+
+
+}
+
+
+
+UDD_TEST(HelloAndFirstFrame)
+{
+    StreamServer server;
+    const auto port = Start(server);
+    UDD_CHECK(port != 0);
+    if (!port) return;
+
+    Client client;
+    UDD_CHECK(client.Connect(port));
+    UDD_CHECK(WaitForClients(server, 1));
+
+    Desktop desktop;
+    DrawInitialDesktop(desktop);
+    server.Update(desktop.GetFrame(0));
+    UDD_CHECK(client.WaitForFrame(1));
+
+    const auto hello = udd_stream_decoder_get_hello(client.GetDecoder());
+    UDD_CHECK(hello != nullptr);
+    if (!hello) return;
+    UDD_CHECK_EQUAL(hello->magic, UDD_STREAM_MAGIC);
+    UDD_CHECK_EQUAL(hello->width, kWidth);
+    UDD_CHECK_EQUAL(hello->height, kHeight);
+    UDD_CHECK_EQUAL(hello->rotation, static_cast<uint32_t>(DXGI_MODE_ROTATION_ROTATE90));
+    UDD_CHECK_EQUAL(hello->tileSize, UDD_STREAM_TILE_SIZE);
+    UDD_CHECK(client.Matches(desktop));
+}
+
+
+UDD_TEST(MovesAndDirtyRects)
+{
+    StreamServer server;
+    const auto port = Start(server);
+    UDD_CHECK(port != 0);
+    if (!port) return;
+
+    Client client;
+    UDD_CHECK(client.Connect(port));
+    UDD_CHECK(WaitForClients(server, 1));
+
+    Desktop desktop;
+    DrawInitialDesktop(desktop);
+    server.Update(desktop.GetFrame(0));
+    UDD_CHECK(client.WaitForFrame(1));
+
+    // Scrolls a window up by 9 pixels and draws a new line at its bottom, then some dirty rects.
+    Test::Random random(11);
+    for (UINT id = 1; id < 40; ++id)
+    {
+        const DXGI_OUTDUPL_MOVE_RECT move = { { 10, 19 }, { 10, 10, 150, 120 } };
+        RECT rects[2] = { { 10, 120, 150, 129 } };
+        rects[1].left = random.Range(0, 100);
+        rects[1].top = random.Range(0, 100);
+        rects[1].right = rects[1].left + random.Range(1, 100);
+        rects[1].bottom = rects[1].top + random.Range(1, 50);
+
+        desktop.Move(move);
+        desktop.Stripes(rects[0], id * 1000);
+        if (id % 3 == 0)
+        {
+            desktop.Noise(rects[1], random);
+        }
+        else
+        {
+            desktop.Fill(rects[1], random.Next());
+        }
+
+        auto frame = desktop.GetFrame(id);
+        frame.moveRects = &move;
+        frame.moveRectCount = 1;
+        frame.dirtyRects = rects;
+        frame.dirtyRectCount = 2;
+        server.Update(frame);
+
+        UDD_CHECK(client.WaitForFrame(id + 1));
+        UDD_CHECK(client.Matches(desktop));
+    }
+}
+
+
+UDD_TEST(SlowClientCatchesUp)
+{
+    StreamServer server;
+    const auto port = Start(server);
+    UDD_CHECK(port != 0);
+    if (!port) return;
+
+    Client client;
+    UDD_CHECK(client.Connect(port));
+    UDD_CHECK(WaitForClients(server, 1));
+
+    // The client reads nothing while frames are produced, so moves pile up and are merged
+    // into damage; whatever the server sent, the final image must be the last frame.
+    Desktop desktop;
+    DrawInitialDesktop(desktop);
+    server.Update(desktop.GetFrame(0));
+
+    Test::Random random(5);
+    UINT id = 1;
+    for (; id < 400; ++id)
+    {
+        const DXGI_OUTDUPL_MOVE_RECT move = { { 0, 1 }, { 0, 0, kWidth, kHeight - 1 } };
+        const RECT dirty = { 0, kHeight - 1, kWidth, kHeight };
+        desktop.Move(move);
+        desktop.Noise(dirty, random);
+
+        auto frame = desktop.GetFrame(id);
+        frame.moveRects = &move;
+        frame.moveRectCount = 1;
+        frame.dirtyRects = &dirty;
+        frame.dirtyRectCount = 1;
+        server.Update(frame);
+    }
+
+    UDD_CHECK(client.WaitForFrame(id));
+    UDD_CHECK(client.Matches(desktop));
+}
+
+
+UDD_TEST(SkippedFramesAndLateClient)
+{
+    StreamServer server;
+    const auto port = Start(server);
+    UDD_CHECK(port != 0);
+    if (!port) return;
+
+    Client first;
+    UDD_CHECK(first.Connect(port));
+    UDD_CHECK(WaitForClients(server, 1));
+
+    Desktop desktop;
+    DrawInitialDesktop(desktop);
+    server.Update(desktop.GetFrame(0));
+    UDD_CHECK(first.WaitForFrame(1));
+
+    // A gap in frame ids means the rects do not describe the whole change, so the dirty rect
+    // given here (which misses the change) must not be trusted.
+    desktop.Fill({ 0, 0, kWidth, kHeight / 2 }, 0xFF336699u);
+    auto frame = desktop.GetFrame(5);
+    const RECT dirty = { 0, 0, 1, 1 };
+    frame.dirtyRects = &dirty;
+    frame.dirtyRectCount = 1;
+    server.Update(frame);
+    UDD_CHECK(first.WaitForFrame(6));
+    UDD_CHECK(first.Matches(desktop));
+
+    // A client connecting later gets the whole current image.
+    Client second;
+    UDD_CHECK(second.Connect(port));
+    UDD_CHECK(WaitForClients(server, 2));
+    UDD_CHECK(second.WaitForFrame(6));
+    UDD_CHECK(second.Matches(desktop));
+
+    // A disconnected client is dropped when sending to it fails, without affecting the other one.
+    first.Disconnect();
+    for (UINT id = 6; id < 100 && server.GetClientCount() > 1; ++id)
+    {
+        const RECT corner = { 0, 0, 8, 8 };
+        desktop.Fill(corner, 0xFF000000u + id);
+        frame = desktop.GetFrame(id);
+        frame.dirtyRects = &corner;
+        frame.dirtyRectCount = 1;
+        server.Update(frame);
+        UDD_CHECK(second.WaitForFrame(id + 1));
+        UDD_CHECK(second.Matches(desktop));
+    }
+    UDD_CHECK_EQUAL(server.GetClientCount(), 1u);
+}
@@ -0,0 +1,27 @@
+#include "Common.h"
+#include "Debug.h"
+
+
+
+// Parts of Common.cpp that the units built into the tests and benchmarks depend on.
+// Common.cpp itself needs the Unity and D3D11 interfaces, so it is not built here.
+
+void OutputBufferIndexError(UINT index, UINT size)
+{
+    UDD_ERROR("Array index out of range: ", index, size);
+}
+
+
+ScopedTimer::ScopedTimer(TimerFuncType&& func)
+    : func_(func)
+    , start_(std::chrono::steady_clock::now())
+{
+}
+
+
+ScopedTimer::~ScopedTimer()
+{
+    const auto end = std::chrono::steady_clock::now();
+    const auto time = std::chrono::duration_cast<microseconds>(end - start_);
+    func_(time);
+}
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Test.h"
+#include "TemplateMatch.h"
+
+
+
+namespace
+{
+
+
+using Rect = TemplateMatcher::Rect;
+
+
+struct Plane
+{
+    Plane(int width, int height) : width(width), height(height), pixels(width * height) {}
+
+    uint8_t& At(int x, int y) { return pixels[y * width + x]; }
+    uint8_t At(int x, int y) const { return pixels[y * width + x]; }
+
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+};
+
+
+// A desktop-like luma image: flat blocks of random gray (windows, panels) with some noise on top.
+Plane MakeDesktop(Test::Random& random, int width, int height)
+{
+    Plane desktop(width, height);
+    std::vector<int> blocks((width / 16 + 1) * (height / 16 + 1));
+    for (auto& block : blocks) block = random.Range(30, 220);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            desktop.At(x, y) = static_cast<uint8_t>(blocks[(y / 16) * (width / 16 + 1) + x / 16] + random.Range(-8, 8));
+        }
+    }
+    return desktop;
+}
+
+
+// An icon-like pattern with sharp edges
+Plane MakeIcon(Test::Random& random, int width, int height)
+{
+    Plane icon(width, height);
+    std::vector<uint8_t> cells((width / 3 + 1) * (height / 3 + 1));
+    for (auto& cell : cells) cell = static_cast<uint8_t>(random.Next() % 2 ? 240 : 20);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            icon.At(x, y) = cells[(y / 3) * (width / 3 + 1) + x / 3];
+        }
+    }
+    return icon;
+}
+
+
+// Draws the template with its brightness and contrast changed, which must not change the score.
+void Paste(Plane* desktop, const Plane& icon, int left, int top, double gain = 1.0, double offset = 0.0)
+{
+    for (int y = 0; y < icon.height; ++y)
+    {
+        for (int x = 0; x < icon.width; ++x)
+        {
+            const auto value = std::lround(icon.At(x, y) * gain + offset);
+            desktop->At(left + x, top + y) = static_cast<uint8_t>((std::min)((std::max)(value, 0L), 255L));
+        }
+    }
+}
+
+
+// Reference: normalized cross-correlation of the template at one position
+double Correlate(const Plane& image, const Plane& icon, int left, int top)
+{
+    const double count = static_cast<double>(icon.width) * icon.height;
+    double imageMean = 0.0, iconMean = 0.0;
+    for (int y = 0; y < icon.height; ++y)
+    {
+        for (int x = 0; x < icon.width; ++x)
+        {
+            imageMean += image.At(left + x, top + y);
+            iconMean += icon.At(x, y);
+        }
+    }
+    imageMean /= count;
+    iconMean /= count;
+
+    double covariance = 0.0, imageDeviation = 0.0, iconDeviation = 0.0;
+    for (int y = 0; y < icon.height; ++y)
+    {
+        for (int x = 0; x < icon.width; ++x)
+        {
+            const auto a = image.At(left + x, top + y) - imageMean;
+            const auto b = icon.At(x, y) - iconMean;
+            covariance += a * b;
+            imageDeviation += a * a;
+            iconDeviation += b * b;
+        }
+    }
+    if (imageDeviation < count) return 0.0;
+    return covariance / std::sqrt(imageDeviation * iconDeviation);
+}
+
+
+int Find(const TemplateMatcher& matcher, const Plane& image, std::vector<Rect> rects, float threshold, std::vector<TemplateMatch>* matches)
+{
+    if (rects.empty()) rects.push_back({ 0, 0, image.width, image.height });
+    matches->resize(16);
+    const auto count = matcher.Find(
+        image.pixels.data(), image.width, image.height, rects.data(), rects.size(), threshold, matches->data(), 16);
+    matches->resize(count);
+    return count;
+}
+
+
+bool HasMatchAt(const std::vector<TemplateMatch>& matches, int x, int y)
+{
+    for (const auto& match : matches)
+    {
+        if (match.x == x && match.y == y) return true;
+    }
+    return false;
+}
+
+
+}
+
+
+
+// Every score has to be the exact correlation at its position.
+UDD_TEST(ScoresAreExact)
+{
+    Test::Random random(1);
+    auto desktop = MakeDesktop(random, 200, 120);
+    const auto icon = MakeIcon(random, 24, 18);
+    Paste(&desktop, icon, 77, 41);
+    Paste(&desktop, icon, 150, 90, 0.5, 60.0);
+
+    TemplateMatcher matcher(icon.pixels.data(), icon.width, icon.height);
+    UDD_CHECK_EQUAL(matcher.GetWidth(), 24);
+    UDD_CHECK_EQUAL(matcher.GetHeight(), 18);
+
+    std::vector<TemplateMatch> matches;
+    UDD_CHECK(Find(matcher, desktop, {}, 0.3f, &matches) >= 2);
+    for (const auto& match : matches)
+    {
+        UDD_CHECK(std::abs(match.score - Correlate(desktop, icon, match.x, match.y)) < 1e-4);
+    }
+
+    // Sorted by score, and the brightness and contrast of the second copy do not matter.
+    UDD_CHECK(matches.size() >= 2 && matches[0].score > 0.999f && matches[1].score > 0.99f);
+    UDD_CHECK(HasMatchAt(matches, 77, 41));
+    UDD_CHECK(HasMatchAt(matches, 150, 90));
+    for (size_t i = 1; i < matches.size(); ++i)
+    {
+        UDD_CHECK(matches[i - 1].score >= matches[i].score);
+    }
+}
+
+
+// A pyramid search only looks at a few positions at full resolution, so compare it with an
+// exhaustive search for templates planted at odd positions on a desktop.
+UDD_TEST(AgreesWithExhaustiveSearch)
+{
+    constexpr int kWidth = 640;
+    constexpr int kHeight = 360;
+
+    Test::Random random(2);
+    int missCount = 0, extraCount = 0;
+    double pyramidMs = 0.0, exhaustiveMs = 0.0;
+    for (int trial = 0; trial < 4; ++trial)
+    {
+        auto desktop = MakeDesktop(random, kWidth, kHeight);
+        const auto icon = MakeIcon(random, random.Range(16, 48), random.Range(16, 48));
+        std::vector<TemplateMatch> planted;
+        for (int i = 0; i < 3; ++i)
+        {
+            // Copies keep apart so that each is one match.
+            const int x = i * (kWidth / 3) + random.Range(0, kWidth / 3 - icon.width);
+            const int y = random.Range(0, kHeight - icon.height);
+            Paste(&desktop, icon, x, y, 1.0 - 0.2 * i, 20.0 * i);
+            planted.push_back({ x, y, 1.f });
+        }
+
+        TemplateMatcher matcher(icon.pixels.data(), icon.width, icon.height);
+        std::vector<TemplateMatch> matches;
+        auto start = std::chrono::steady_clock::now();
+        Find(matcher, desktop, {}, 0.9f, &matches);
+        pyramidMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Exhaustive: every position above the threshold which is the best in its neighborhood
+        start = std::chrono::steady_clock::now();
+        std::vector<TemplateMatch> expected;
+        for (int y = 0; y + icon.height <= kHeight; ++y)
+        {
+            for (int x = 0; x + icon.width <= kWidth; ++x)
+            {
+                const auto score = Correlate(desktop, icon, x, y);
+                if (score >= 0.9) expected.push_back({ x, y, static_cast<float>(score) });
+            }
+        }
+        exhaustiveMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        for (const auto& match : planted)
+        {
+            if (!HasMatchAt(matches, match.x, match.y)) ++missCount;
+        }
+        for (const auto& match : matches)
+        {
+            if (!HasMatchAt(expected, match.x, match.y)) ++extraCount;
+        }
+        if (matches.size() != planted.size()) ++extraCount;
+    }
+
+    std::printf("640x360, 3 copies: pyramid %.2f ms, exhaustive %.2f ms per search\n", pyramidMs / 4, exhaustiveMs / 4);
+    UDD_CHECK_EQUAL(missCount, 0);
+    UDD_CHECK_EQUAL(extraCount, 0);
+}
+
+
+UDD_TEST(SearchesOnlyPositionRects)
+{
+    Test::Random random(3);
+    auto desktop = MakeDesktop(random, 320, 200);
+    const auto icon = MakeIcon(random, 32, 24);
+    Paste(&desktop, icon, 20, 30);
+    Paste(&desktop, icon, 250, 150);
+
+    TemplateMatcher matcher(icon.pixels.data(), icon.width, icon.height);
+    std::vector<TemplateMatch> matches;
+
+    // Only the top-left corners in the rects are tested, also with rects reaching past the image.
+    UDD_CHECK_EQUAL(Find(matcher, desktop, { { 200, 100, 400, 300 } }, 0.9f, &matches), 1);
+    UDD_CHECK(HasMatchAt(matches, 250, 150));
+    UDD_CHECK_EQUAL(Find(matcher, desktop, { { 20, 30, 21, 31 } }, 0.9f, &matches), 1);
+    UDD_CHECK(HasMatchAt(matches, 20, 30));
+    UDD_CHECK_EQUAL(Find(matcher, desktop, { { 21, 30, 100, 100 } }, 0.9f, &matches), 0);
+    UDD_CHECK_EQUAL(Find(matcher, desktop, { { 0, 0, 10, 10 }, { 240, 140, 260, 160 } }, 0.9f, &matches), 1);
+    UDD_CHECK_EQUAL(Find(matcher, desktop, { { 300, 190, 400, 300 } }, 0.9f, &matches), 0);
+
+    // A template larger than the image is never found.
+    TemplateMatcher large(desktop.pixels.data(), desktop.width, desktop.height);
+    UDD_CHECK_EQUAL(Find(large, icon, {}, 0.f, &matches), 0);
+}
+
+
+UDD_TEST(OverlappingMatchesAreMerged)
+{
+    // Stripes match a striped template at every period, but results overlap by less than half of it.
+    Plane image(200, 100);
+    for (int y = 0; y < image.height; ++y)
+    {
+        for (int x = 0; x < image.width; ++x) image.At(x, y) = static_cast<uint8_t>((x / 4) % 2 ? 200 : 40);
+    }
+    Plane icon(16, 16);
+    for (int y = 0; y < icon.height; ++y)
+    {
+        for (int x = 0; x < icon.width; ++x) icon.At(x, y) = image.At(x, y);
+    }
+
+    TemplateMatcher matcher(icon.pixels.data(), icon.width, icon.height);
+    std::vector<TemplateMatch> matches;
+    const auto count = Find(matcher, image, {}, 0.99f, &matches);
+    UDD_CHECK(count > 1);
+    for (int i = 0; i < count; ++i)
+    {
+        UDD_CHECK_EQUAL(matches[i].x % 8, 0);
+        for (int j = 0; j < i; ++j)
+        {
+            UDD_CHECK(std::abs(matches[i].x - matches[j].x) * 2 >= icon.width ||
+                      std::abs(matches[i].y - matches[j].y) * 2 >= icon.height);
+        }
+    }
+
+    // The capacity limits the results.
+    Rect all = { 0, 0, image.width, image.height };
+    TemplateMatch one[1];
+    UDD_CHECK_EQUAL(matcher.Find(image.pixels.data(), image.width, image.height, &all, 1, 0.99f, one, 1), 1);
+}
+
+
+UDD_TEST(UniformTemplateUsesDifference)
+{
+    Test::Random random(4);
+    auto desktop = MakeDesktop(random, 160, 120);
+    Plane icon(20, 20);
+    std::fill(icon.pixels.begin(), icon.pixels.end(), static_cast<uint8_t>(250));
+    Paste(&desktop, icon, 61, 47);
+
+    TemplateMatcher matcher(icon.pixels.data(), icon.width, icon.height);
+    std::vector<TemplateMatch> matches;
+    UDD_CHECK_EQUAL(Find(matcher, desktop, {}, 0.99f, &matches), 1);
+    UDD_CHECK(HasMatchAt(matches, 61, 47));
+    UDD_CHECK(matches.size() == 1 && matches[0].score == 1.f);
+}
+
+
+UDD_TEST(SearchCost)
+{
+    Test::Random random(5);
+    auto desktop = MakeDesktop(random, 1920, 1080);
+    const auto icon = MakeIcon(random, 48, 48);
+    Paste(&desktop, icon, 1501, 833);
+
+    TemplateMatcher matcher(icon.pixels.data(), icon.width, icon.height);
+    std::vector<TemplateMatch> matches;
+    constexpr int kSearchCount = 5;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kSearchCount; ++i)
+    {
+        Find(matcher, desktop, {}, 0.9f, &matches);
+    }
+    const auto fullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / kSearchCount;
+    UDD_CHECK(HasMatchAt(matches, 1501, 833));
+
+    // Tracking only searches the positions where a changed rect could have moved the template.
+    const auto trackStart = std::chrono::steady_clock::now();
+    Find(matcher, desktop, { { 1501 - 47, 833 - 47, 1501 + 64, 833 + 32 } }, 0.9f, &matches);
+    const auto trackMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - trackStart).count();
+    UDD_CHECK(HasMatchAt(matches, 1501, 833));
+
+    std::printf("1920x1080, 48x48 template: full search %.2f ms, tracking search %.3f ms\n", fullMs, trackMs);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+
+// Minimal test harness; every test executable links TestMain.cpp, which runs all registered
+// cases and returns non-zero when a check failed so that ctest reports it.
+namespace Test
+{
+    using Function = void (*)();
+
+    struct Case
+    {
+        const char* name;
+        Function function;
+    };
+
+    std::vector<Case>& GetCases();
+    void Fail(const char* file, int line, const std::string& message);
+
+    struct Registrar
+    {
+        Registrar(const char* name, Function function)
+        {
+            GetCases().push_back({ name, function });
+        }
+    };
+
+    template <class A, class B>
+    void CheckEqual(const A& a, const B& b, const char* expression, const char* file, int line)
+    {
+        if (a == b) return;
+
+        std::ostringstream ss;
+        ss << expression << " (" << a << " != " << b << ")";
+        Fail(file, line, ss.str());
+    }
+
+    // Deterministic generator for synthetic images (xorshift32)
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : state_(seed ? seed : 1u) {}
+
+        uint32_t Next()
+        {
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 17;
+            state_ ^= state_ << 5;
+            return state_;
+        }
+
+        int Range(int min, int max)
+        {
+            return min + static_cast<int>(Next() % static_cast<uint32_t>(max - min + 1));
+        }
+
+    private:
+        uint32_t state_;
+    };
+}
+
+
+#define UDD_TEST(Name) \
+    static void Name(); \
+    static const Test::Registrar Name##_registrar(#Name, Name); \
+    static void Name()
+
+#define UDD_CHECK(Expression) \
+    do { if (!(Expression)) Test::Fail(__FILE__, __LINE__, #Expression); } while (false)
+
+#define UDD_CHECK_EQUAL(A, B) \
+    Test::CheckEqual((A), (B), #A " == " #B, __FILE__, __LINE__)
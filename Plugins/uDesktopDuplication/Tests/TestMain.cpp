@@ -0,0 +1,55 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "Test.h"
+
+
+
+namespace
+{
+    int g_failureCount = 0;
+}
+
+
+std::vector<Test::Case>& Test::GetCases()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+
+void Test::Fail(const char* file, int line, const std::string& message)
+{
+    ++g_failureCount;
+    std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, message.c_str());
+}
+
+
+// Usage: <test> [case name]
+int main(int argc, char** argv)
+{
+    const char* filter = (argc > 1) ? argv[1] : nullptr;
+
+    int count = 0;
+    for (const auto& testCase : Test::GetCases())
+    {
+        if (filter && std::strcmp(filter, testCase.name) != 0) continue;
+
+        const auto failureCount = g_failureCount;
+        const auto start = std::chrono::steady_clock::now();
+        testCase.function();
+        const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("[%s] %s (%.1f ms)\n", (g_failureCount == failureCount) ? " OK " : "FAIL", testCase.name, ms);
+        ++count;
+    }
+
+    if (count == 0)
+    {
+        std::fprintf(stderr, "No test case matched.\n");
+        return 1;
+    }
+
+    return (g_failureCount == 0) ? 0 : 1;
+}
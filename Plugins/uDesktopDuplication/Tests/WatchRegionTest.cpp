@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "Test.h"
+#include "WatchRegion.h"
+
+
+
+namespace
+{
+
+
+using Rect = WatchRegionIndex::Rect;
+using Hit = WatchRegionIndex::Hit;
+
+
+bool operator==(const Rect& a, const Rect& b)
+{
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+
+std::vector<Hit> RunFrame(WatchRegionIndex& index, const std::vector<Rect>& changes)
+{
+    std::vector<Hit> hits;
+    index.BeginFrame();
+    for (const auto& change : changes)
+    {
+        index.AddChange(change);
+    }
+    index.EndFrame(&hits);
+    std::sort(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) { return a.regionId < b.regionId; });
+    return hits;
+}
+
+
+const Hit* FindHit(const std::vector<Hit>& hits, int regionId)
+{
+    for (const auto& hit : hits)
+    {
+        if (hit.regionId == regionId) return &hit;
+    }
+    return nullptr;
+}
+
+
+// Reference: every region against every change
+class BruteForce
+{
+public:
+    BruteForce(int width, int height) : width_(width), height_(height) {}
+
+    void Add(int regionId, const Rect& rect) { regions_[regionId] = rect; }
+    void Remove(int regionId) { regions_.erase(regionId); }
+
+    std::vector<Hit> RunFrame(const std::vector<Rect>& changes) const
+    {
+        std::vector<Hit> hits;
+        for (const auto& pair : regions_)
+        {
+            bool isHit = false;
+            Rect changed = {};
+            for (auto change : changes)
+            {
+                change.left = (std::max)(change.left, 0);
+                change.top = (std::max)(change.top, 0);
+                change.right = (std::min)(change.right, width_);
+                change.bottom = (std::min)(change.bottom, height_);
+
+                const auto& region = pair.second;
+                const Rect overlap =
+                {
+                    (std::max)(region.left, change.left),
+                    (std::max)(region.top, change.top),
+                    (std::min)(region.right, change.right),
+                    (std::min)(region.bottom, change.bottom),
+                };
+                if (overlap.left >= overlap.right || overlap.top >= overlap.bottom) continue;
+
+                if (!isHit)
+                {
+                    changed = overlap;
+                    isHit = true;
+                    continue;
+                }
+                changed.left = (std::min)(changed.left, overlap.left);
+                changed.top = (std::min)(changed.top, overlap.top);
+                changed.right = (std::max)(changed.right, overlap.right);
+                changed.bottom = (std::max)(changed.bottom, overlap.bottom);
+            }
+            if (isHit) hits.push_back({ pair.first, changed });
+        }
+        return hits;
+    }
+
+private:
+    int width_;
+    int height_;
+    std::map<int, Rect> regions_;
+};
+
+
+Rect RandomRect(Test::Random& random, int width, int height, int maxSize)
+{
+    const auto left = random.Range(0, width - 1);
+    const auto top = random.Range(0, height - 1);
+    return { left, top, left + random.Range(1, maxSize), top + random.Range(1, maxSize) };
+}
+
+
+bool IsSame(const std::vector<Hit>& a, const std::vector<Hit>& b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].regionId != b[i].regionId || !(a[i].changedRect == b[i].changedRect)) return false;
+    }
+    return true;
+}
+
+
+}
+
+
+
+UDD_TEST(ReportsEachRegionOnce)
+{
+    WatchRegionIndex index(64);
+    index.SetBounds(1000, 500);
+
+    UDD_CHECK(index.Add(1, { 100, 100, 200, 150 }));
+    UDD_CHECK(index.Add(2, { 180, 100, 400, 300 }));  // spans several cells
+    UDD_CHECK(index.Add(3, { 900, 400, 1200, 600 })); // partly outside: kept
+    UDD_CHECK(!index.Add(4, { 1000, 0, 1100, 10 }));  // entirely outside: rejected
+    UDD_CHECK_EQUAL(index.GetCount(), 3);
+
+    // Two changes in region 1 are merged into their bounds; region 2 is hit by both as well.
+    auto hits = RunFrame(index, { { 110, 110, 120, 120 }, { 190, 130, 210, 140 } });
+    UDD_CHECK_EQUAL(hits.size(), 2u);
+    const auto hit1 = FindHit(hits, 1);
+    const auto hit2 = FindHit(hits, 2);
+    UDD_CHECK(hit1 && hit1->changedRect == Rect({ 110, 110, 200, 140 }));
+    UDD_CHECK(hit2 && hit2->changedRect == Rect({ 190, 130, 210, 140 }));
+
+    // Edges are exclusive, and nothing is reported without changes.
+    UDD_CHECK(RunFrame(index, { { 0, 0, 100, 100 }, { 400, 300, 500, 400 } }).empty());
+    UDD_CHECK(RunFrame(index, {}).empty());
+
+    // Changes outside of the bounds are clipped away.
+    hits = RunFrame(index, { { 950, 450, 2000, 2000 } });
+    UDD_CHECK_EQUAL(hits.size(), 1u);
+    UDD_CHECK(hits.size() == 1 && hits[0].changedRect == Rect({ 950, 450, 1000, 500 }));
+
+    // Replacing moves the region, removing and clearing forget it.
+    UDD_CHECK(index.Add(1, { 0, 0, 10, 10 }));
+    UDD_CHECK_EQUAL(index.GetCount(), 3);
+    UDD_CHECK(RunFrame(index, { { 110, 110, 120, 120 } }).empty());
+    UDD_CHECK_EQUAL(RunFrame(index, { { 5, 5, 6, 6 } }).size(), 1u);
+    UDD_CHECK(index.Remove(1));
+    UDD_CHECK(!index.Remove(1));
+    UDD_CHECK(RunFrame(index, { { 5, 5, 6, 6 } }).empty());
+    index.Clear();
+    UDD_CHECK_EQUAL(index.GetCount(), 0);
+    UDD_CHECK(RunFrame(index, { { 0, 0, 1000, 500 } }).empty());
+}
+
+
+UDD_TEST(BoundsChange)
+{
+    WatchRegionIndex index(32);
+    index.SetBounds(400, 300);
+    UDD_CHECK(index.Add(7, { 300, 200, 350, 250 }));
+
+    // After the desktop shrinks the region is not watched, but it comes back when it grows.
+    index.SetBounds(200, 150);
+    UDD_CHECK(RunFrame(index, { { 0, 0, 1000, 1000 } }).empty());
+    UDD_CHECK_EQUAL(index.GetCount(), 1);
+    index.SetBounds(400, 300);
+    const auto hits = RunFrame(index, { { 320, 220, 330, 230 } });
+    UDD_CHECK(hits.size() == 1 && hits[0].changedRect == Rect({ 320, 220, 330, 230 }));
+
+    // Removing a region while it is out of the bounds must not leave it in a cell.
+    index.SetBounds(200, 150);
+    UDD_CHECK(index.Remove(7));
+    index.SetBounds(400, 300);
+    UDD_CHECK(RunFrame(index, { { 0, 0, 400, 300 } }).empty());
+}
+
+
+// Thousands of regions on a 4K desktop with regions added, replaced and removed between frames.
+UDD_TEST(MatchesBruteForce)
+{
+    constexpr int kWidth = 3840;
+    constexpr int kHeight = 2160;
+
+    WatchRegionIndex index;
+    index.SetBounds(kWidth, kHeight);
+    BruteForce reference(kWidth, kHeight);
+
+    Test::Random random(1);
+    int nextId = 0;
+    for (int i = 0; i < 4000; ++i)
+    {
+        // Mostly small regions (buttons, text fields) and some large ones (windows)
+        const auto rect = RandomRect(random, kWidth, kHeight, (i % 20 == 0) ? 1500 : 120);
+        if (index.Add(nextId, rect)) reference.Add(nextId, rect);
+        ++nextId;
+    }
+
+    double totalMs = 0.0, worstMs = 0.0;
+    int mismatchCount = 0;
+    constexpr int kFrameCount = 200;
+    for (int frame = 0; frame < kFrameCount; ++frame)
+    {
+        for (int i = 0; i < 40; ++i)
+        {
+            const auto regionId = random.Range(0, nextId - 1);
+            if (random.Next() % 3 == 0)
+            {
+                index.Remove(regionId);
+                reference.Remove(regionId);
+                continue;
+            }
+            const auto rect = RandomRect(random, kWidth, kHeight, 200);
+            if (index.Add(regionId, rect)) reference.Add(regionId, rect);
+        }
+
+        std::vector<Rect> changes;
+        const auto changeCount = (frame % 50 == 0) ? 1 : random.Range(1, 200);
+        for (int i = 0; i < changeCount; ++i)
+        {
+            // The first frame of a capture is one full update, also larger than the desktop.
+            changes.push_back((frame % 50 == 0) ?
+                Rect({ -10, -10, kWidth + 10, kHeight + 10 }) :
+                RandomRect(random, kWidth, kHeight, (i % 10 == 0) ? 800 : 64));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto hits = RunFrame(index, changes);
+        const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        totalMs += ms;
+        worstMs = (std::max)(worstMs, ms);
+
+        if (!IsSame(hits, reference.RunFrame(changes))) ++mismatchCount;
+    }
+
+    std::printf("%d regions, up to 200 changes per frame: %.3f ms per frame on average, %.3f ms at worst\n",
+        index.GetCount(), totalMs / kFrameCount, worstMs);
+    UDD_CHECK_EQUAL(mismatchCount, 0);
+}
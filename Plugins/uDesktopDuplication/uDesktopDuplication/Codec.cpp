@@ -0,0 +1,293 @@
+#include <cstring>
+
+#include "Codec.h"
+#include "Record.h"
+
+namespace
+{
+    constexpr UINT kMaxLiteralCount = 128;
+    constexpr UINT kMaxRepeatCount = 129;
+    constexpr UINT kRepeatOffset = 126;
+}
+
+
+
+void Codec::EncodeRle(
+    const BYTE* src,
+    UINT width,
+    UINT height,
+    UINT pitch,
+    std::vector<BYTE>& output)
+{
+    // Runs never cross rows so that each row can be decoded into a pitched destination.
+    for (UINT y = 0; y < height; ++y)
+    {
+        const auto row = reinterpret_cast<const UINT*>(src + y * pitch);
+
+        UINT x = 0;
+        while (x < width)
+        {
+            UINT run = 1;
+            while (x + run < width && run < kMaxRepeatCount && row[x + run] == row[x])
+            {
+                ++run;
+            }
+
+            if (run >= 2)
+            {
+                const auto pixel = reinterpret_cast<const BYTE*>(&row[x]);
+                output.push_back(static_cast<BYTE>(run + kRepeatOffset));
+                output.insert(output.end(), pixel, pixel + sizeof(UINT));
+                x += run;
+                continue;
+            }
+
+            const auto start = x;
+            UINT count = 0;
+            while (x < width && count < kMaxLiteralCount)
+            {
+                if (x + 1 < width && row[x + 1] == row[x]) break;
+                ++x;
+                ++count;
+            }
+
+            const auto pixels = reinterpret_cast<const BYTE*>(&row[start]);
+            output.push_back(static_cast<BYTE>(count - 1));
+            output.insert(output.end(), pixels, pixels + count * sizeof(UINT));
+        }
+    }
+}
+
+
+bool Codec::DecodeRle(
+    const BYTE* src,
+    UINT size,
+    BYTE* dst,
+    UINT width,
+    UINT height,
+    UINT pitch)
+{
+    const auto end = src + size;
+
+    for (UINT y = 0; y < height; ++y)
+    {
+        auto row = reinterpret_cast<UINT*>(dst + y * pitch);
+
+        UINT x = 0;
+        while (x < width)
+        {
+            if (src >= end) return false;
+            const UINT header = *src++;
+
+            if (header >= kMaxLiteralCount)
+            {
+                const auto count = header - kRepeatOffset;
+                if (x + count > width || src + sizeof(UINT) > end) return false;
+
+                UINT pixel;
+                std::memcpy(&pixel, src, sizeof(UINT));
+                src += sizeof(UINT);
+                for (UINT i = 0; i < count; ++i)
+                {
+                    row[x + i] = pixel;
+                }
+                x += count;
+            }
+            else
+            {
+                const auto count = header + 1;
+                const auto bytes = count * sizeof(UINT);
+                if (x + count > width || src + bytes > end) return false;
+
+                std::memcpy(&row[x], src, bytes);
+                src += bytes;
+                x += count;
+            }
+        }
+    }
+
+    return src == end;
+}
+
+
+void Codec::EncodeRegions(
+    const BYTE* image,
+    UINT pitch,
+    const RECT* rects,
+    size_t rectCount,
+    std::vector<BYTE>& output)
+{
+    for (size_t i = 0; i < rectCount; ++i)
+    {
+        const auto& rect = rects[i];
+        const auto offset = output.size();
+        Record::RegionHeader region = { rect, 0 };
+        const auto header = reinterpret_cast<const BYTE*>(&region);
+        output.insert(output.end(), header, header + sizeof(region));
+
+        EncodeRle(
+            image + rect.top * pitch + rect.left * sizeof(UINT),
+            rect.right - rect.left,
+            rect.bottom - rect.top,
+            pitch,
+            output);
+
+        region.size = static_cast<UINT>(output.size() - offset - sizeof(region));
+        std::memcpy(output.data() + offset, &region, sizeof(region));
+    }
+}
+
+
+bool Codec::DecodeRegions(
+    const BYTE* src,
+    size_t size,
+    UINT regionCount,
+    BYTE* image,
+    UINT width,
+    UINT height,
+    UINT pitch)
+{
+    const auto end = src + size;
+
+    for (UINT i = 0; i < regionCount; ++i)
+    {
+        if (static_cast<size_t>(end - src) < sizeof(Record::RegionHeader)) return false;
+
+        Record::RegionHeader region;
+        std::memcpy(&region, src, sizeof(region));
+        src += sizeof(region);
+
+        const auto& rect = region.rect;
+        if (rect.left < 0 || rect.top < 0 ||
+            rect.right > static_cast<LONG>(width) || rect.bottom > static_cast<LONG>(height) ||
+            rect.left >= rect.right || rect.top >= rect.bottom ||
+            region.size > static_cast<size_t>(end - src))
+        {
+            return false;
+        }
+
+        if (!DecodeRle(
+            src,
+            region.size,
+            image + rect.top * pitch + rect.left * sizeof(UINT),
+            rect.right - rect.left,
+            rect.bottom - rect.top,
+            pitch))
+        {
+            return false;
+        }
+        src += region.size;
+    }
+
+    return true;
+}
+
+
+void Codec::EncodeQoi(
+    const BYTE* src,
+    UINT width,
+    UINT height,
+    UINT pitch,
+    std::vector<BYTE>& output)
+{
+    enum : BYTE
+    {
+        QOI_OP_INDEX = 0x00,
+        QOI_OP_DIFF  = 0x40,
+        QOI_OP_LUMA  = 0x80,
+        QOI_OP_RUN   = 0xc0,
+        QOI_OP_RGB   = 0xfe,
+    };
+
+    const auto pushU32 = [&](UINT value)
+    {
+        output.push_back(static_cast<BYTE>(value >> 24));
+        output.push_back(static_cast<BYTE>(value >> 16));
+        output.push_back(static_cast<BYTE>(value >> 8));
+        output.push_back(static_cast<BYTE>(value));
+    };
+
+    // Worst case is 4 bytes per pixel, so reserving it keeps push_back() from reallocating.
+    output.reserve(output.size() + 14 + static_cast<size_t>(width) * height * 4 + 8);
+
+    output.insert(output.end(), { 'q', 'o', 'i', 'f' });
+    pushU32(width);
+    pushU32(height);
+    output.push_back(3); // channels
+    output.push_back(0); // sRGB with linear alpha
+
+    struct Rgb { BYTE r, g, b; };
+    Rgb index[64] = {};
+    bool isIndexed[64] = {};
+    Rgb prev = { 0, 0, 0 };
+    UINT run = 0;
+
+    for (UINT y = 0; y < height; ++y)
+    {
+        const auto row = src + y * pitch;
+        for (UINT x = 0; x < width; ++x)
+        {
+            // BGRA -> RGB
+            const Rgb px = { row[x * 4 + 2], row[x * 4 + 1], row[x * 4 + 0] };
+
+            if (px.r == prev.r && px.g == prev.g && px.b == prev.b)
+            {
+                if (++run == 62)
+                {
+                    output.push_back(static_cast<BYTE>(QOI_OP_RUN | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                output.push_back(static_cast<BYTE>(QOI_OP_RUN | (run - 1)));
+                run = 0;
+            }
+
+            // The hash includes alpha (always 255 here): (r * 3 + g * 5 + b * 7 + a * 11) % 64
+            const auto hash = (px.r * 3 + px.g * 5 + px.b * 7 + 255 * 11) % 64;
+            if (isIndexed[hash] && index[hash].r == px.r && index[hash].g == px.g && index[hash].b == px.b)
+            {
+                output.push_back(static_cast<BYTE>(QOI_OP_INDEX | hash));
+                prev = px;
+                continue;
+            }
+            index[hash] = px;
+            isIndexed[hash] = true;
+
+            const int dr = static_cast<signed char>(px.r - prev.r);
+            const int dg = static_cast<signed char>(px.g - prev.g);
+            const int db = static_cast<signed char>(px.b - prev.b);
+            const int drg = dr - dg;
+            const int dbg = db - dg;
+
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+            {
+                output.push_back(static_cast<BYTE>(QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+            }
+            else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+            {
+                output.push_back(static_cast<BYTE>(QOI_OP_LUMA | (dg + 32)));
+                output.push_back(static_cast<BYTE>(((drg + 8) << 4) | (dbg + 8)));
+            }
+            else
+            {
+                output.push_back(QOI_OP_RGB);
+                output.push_back(px.r);
+                output.push_back(px.g);
+                output.push_back(px.b);
+            }
+
+            prev = px;
+        }
+    }
+
+    if (run > 0)
+    {
+        output.push_back(static_cast<BYTE>(QOI_OP_RUN | (run - 1)));
+    }
+
+    output.insert(output.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <d3d11.h>
+
+
+// Lossless codecs for 32-bit BGRA pixel blocks
+namespace Codec
+{
+    // PackBits-like run-length encoding in pixel units.
+    // Each token begins with a header byte: 0-127 means (header + 1) literal pixels follow,
+    // 128-255 means the following single pixel is repeated (header - 126) times.
+    void EncodeRle(
+        const BYTE* src,
+        UINT width,
+        UINT height,
+        UINT pitch,
+        std::vector<BYTE>& output);
+
+    bool DecodeRle(
+        const BYTE* src,
+        UINT size,
+        BYTE* dst,
+        UINT width,
+        UINT height,
+        UINT pitch);
+
+    // Regions of a session file Frame chunk (see Record.h): a RegionHeader and the RLE encoded
+    // pixels for each rect of the image.
+    void EncodeRegions(
+        const BYTE* image,
+        UINT pitch,
+        const RECT* rects,
+        size_t rectCount,
+        std::vector<BYTE>& output);
+
+    // Fails when the regions run past size or out of the width x height image.
+    bool DecodeRegions(
+        const BYTE* src,
+        size_t size,
+        UINT regionCount,
+        BYTE* image,
+        UINT width,
+        UINT height,
+        UINT pitch);
+
+    // QOI image (https://qoiformat.org) with 3 channels; the alpha of the source is ignored.
+    void EncodeQoi(
+        const BYTE* src,
+        UINT width,
+        UINT height,
+        UINT pitch,
+        std::vector<BYTE>& output);
+}
@@ -1,12 +1,12 @@
 #pragma once
 
-#include <queue>
 #include <d3d11.h>
 
 #include "IUnityInterface.h"
 #include "IUnityGraphicsD3D11.h"
 #include "Common.h"
 #include "Debug.h"
+#include "Event.h"
 
 using namespace Microsoft::WRL;
 
@@ -14,7 +14,6 @@ using namespace Microsoft::WRL;
 
 extern IUnityInterfaces* g_unity;
 extern std::unique_ptr<MonitorManager> g_manager;
-extern std::queue<Message> g_messages;
 
 
 void OutputWindowsInformation()
@@ -32,9 +31,9 @@ void OutputWindowsInformation()
 		OSVERSIONINFOEXW os = { sizeof(os) };
 		if (!FAILED(RtlGetVersion(&os)))
 		{
-			Debug::Log("OS Version    : ", os.dwMajorVersion, ".", os.dwMinorVersion);
-			Debug::Log("Build Number  : ", os.dwBuildNumber);
-			Debug::Log("Service Pack  : ", os.szCSDVersion);
+			UDD_LOG("OS Version    : ", os.dwMajorVersion, ".", os.dwMinorVersion);
+			UDD_LOG("Build Number  : ", os.dwBuildNumber);
+			UDD_LOG("Service Pack  : ", os.szCSDVersion);
 		}
 	}
 }
@@ -66,13 +65,13 @@ LUID GetUnityAdapterLuid()
 
     Microsoft::WRL::ComPtr<IDXGIDevice1> dxgiDevice;
     if (FAILED(device->QueryInterface(IID_PPV_ARGS(&dxgiDevice)))){
-        Debug::Error("QueryInterface from IUnityGraphicsD3D11 to IDXGIDevice1 failed.");
+        UDD_ERROR("QueryInterface from IUnityGraphicsD3D11 to IDXGIDevice1 failed.");
         return LUID();
     }
 
     Microsoft::WRL::ComPtr<IDXGIAdapter> dxgiAdapter;
     if (FAILED(dxgiDevice->GetAdapter(&dxgiAdapter))) {
-        Debug::Error("QueryInterface from IDXGIDevice1 to IDXGIAdapter failed.");
+        UDD_ERROR("QueryInterface from IDXGIDevice1 to IDXGIAdapter failed.");
         return LUID();
     }
 
@@ -83,9 +82,19 @@ LUID GetUnityAdapterLuid()
 }
 
 
+void OutputBufferIndexError(UINT index, UINT size)
+{
+    UDD_ERROR("Array index out of range: ", index, size);
+}
+
+
 void SendMessageToUnity(Message message)
 {
-    g_messages.push(message);
+    Event event = {};
+    event.type = EventType::Message;
+    event.id = -1;
+    event.value = static_cast<int>(message);
+    EventQueue::Push(event);
 }
 
 
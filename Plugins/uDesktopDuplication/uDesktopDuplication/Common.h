@@ -63,6 +63,8 @@ enum class Message
     None = -1,
     Reinitialized = 0,
     TextureSizeChanged = 1,
+    SnapshotCompleted = 2,
+    SnapshotFailed = 3,
 };
 
 void SendMessageToUnity(Message message);
@@ -70,6 +72,9 @@ void SendMessageToUnity(Message message);
 
 
 // Buffer
+// Out-of-range accesses are logged through this function so that this header does not need Debug.h.
+void OutputBufferIndexError(UINT index, UINT size);
+
 template <class T>
 class Buffer final
 {
@@ -158,7 +163,7 @@ public:
     {
         if (index >= size_)
         {
-            Debug::Error("Array index out of range: ", index, size_);
+            OutputBufferIndexError(index, size_);
             return T(0);
         }
         return value_[index];
@@ -168,7 +173,7 @@ public:
     {
         if (index >= size_)
         {
-            Debug::Error("Array index out of range: ", index, size_);
+            OutputBufferIndexError(index, size_);
             return value_[0];
         }
         return value_[index];
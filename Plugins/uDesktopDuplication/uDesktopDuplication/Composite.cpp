@@ -0,0 +1,106 @@
+#include <algorithm>
+
+#include "Composite.h"
+#include "Kernels.h"
+#include "Monitor.h"
+#include "Debug.h"
+
+
+
+Composite::Composite(int left, int top, UINT width, UINT height)
+    : left_(left)
+    , top_(top)
+    , width_(width)
+    , height_(height)
+    , buffer_(static_cast<size_t>(width) * height * sizeof(UINT), 0)
+{
+}
+
+
+UINT64 Composite::GetUpdateCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return updateCount_;
+}
+
+
+bool Composite::Blit(const Monitor* monitor, const BYTE* pixels, UINT pitch, const RECT* rects, UINT rectCount)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(monitor->GetRotation());
+    const auto monitorWidth = monitor->GetWidth();
+    const auto monitorHeight = monitor->GetHeight();
+    const auto isVertical =
+        rot == DXGI_MODE_ROTATION_ROTATE90 ||
+        rot == DXGI_MODE_ROTATION_ROTATE270;
+    const auto imageWidth = !isVertical ? monitorWidth : monitorHeight;
+    const auto imageHeight = !isVertical ? monitorHeight : monitorWidth;
+    const auto offsetX = monitor->GetLeft() - left_;
+    const auto offsetY = monitor->GetTop() - top_;
+
+    if (offsetX < 0 || offsetY < 0 ||
+        offsetX + monitorWidth > static_cast<int>(width_) ||
+        offsetY + monitorHeight > static_cast<int>(height_))
+    {
+        UDD_ERROR("Composite::Blit() => Monitor ", monitor->GetId(), " does not fit in the composite buffer.");
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (isLocked_) return false;
+        ++blitCount_;
+    }
+
+    const auto dst = buffer_.data() + offsetY * GetPitch() + offsetX * sizeof(UINT);
+    for (UINT i = 0; i < rectCount; ++i)
+    {
+        RECT rect = rects[i];
+        rect.left   = std::max<LONG>(rect.left, 0);
+        rect.top    = std::max<LONG>(rect.top, 0);
+        rect.right  = std::min<LONG>(rect.right, imageWidth);
+        rect.bottom = std::min<LONG>(rect.bottom, imageHeight);
+        if (rect.left >= rect.right || rect.top >= rect.bottom) continue;
+
+        Kernels::BlitRotatedRect(
+            pixels, pitch, dst, GetPitch(), rot, monitorWidth, monitorHeight,
+            rect.left, rect.top, rect.right, rect.bottom);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --blitCount_;
+        ++updateCount_;
+    }
+    condition_.notify_all();
+
+    return true;
+}
+
+
+BYTE* Composite::Lock(UINT* pitch)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (isLocked_)
+    {
+        UDD_ERROR("Composite::Lock() => The buffer is already locked.");
+        return nullptr;
+    }
+
+    // New blits are refused from here, so this only waits for the ones in flight.
+    isLocked_ = true;
+    condition_.wait(lock, [this] { return blitCount_ == 0; });
+
+    if (pitch) *pitch = GetPitch();
+    return buffer_.data();
+}
+
+
+void Composite::Unlock()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    isLocked_ = false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+
+class Monitor;
+
+
+// CPU image of the whole virtual desktop which capture threads update in their changed regions.
+// Monitors blit in parallel since their regions do not overlap, and readers lease the buffer
+// with Lock() / Unlock() while no blit is in flight.
+class Composite final
+{
+public:
+    Composite(int left, int top, UINT width, UINT height);
+    int GetLeft() const { return left_; }
+    int GetTop() const { return top_; }
+    UINT GetWidth() const { return width_; }
+    UINT GetHeight() const { return height_; }
+    UINT GetPitch() const { return width_ * sizeof(UINT); }
+    UINT64 GetUpdateCount() const;
+
+    // Returns false without blocking while the buffer is leased; the caller retries later.
+    bool Blit(const Monitor* monitor, const BYTE* pixels, UINT pitch, const RECT* rects, UINT rectCount);
+
+    BYTE* Lock(UINT* pitch);
+    void Unlock();
+
+private:
+    const int left_;
+    const int top_;
+    const UINT width_;
+    const UINT height_;
+    std::vector<BYTE> buffer_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    UINT blitCount_ = 0;
+    bool isLocked_ = false;
+    UINT64 updateCount_ = 0;
+};
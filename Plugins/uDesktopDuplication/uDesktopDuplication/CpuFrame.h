@@ -0,0 +1,21 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+
+
+
+// Desktop image mapped on the CPU in Monitor::Render() and what changed since the previous frame
+struct CpuFrame
+{
+    UINT id;
+    LARGE_INTEGER presentTime;
+    const BYTE* pixels; // B8G8R8A8, not rotated
+    UINT pitch;
+    UINT width;
+    UINT height;
+    const DXGI_OUTDUPL_MOVE_RECT* moveRects;
+    UINT moveRectCount;
+    const RECT* dirtyRects; // includes areas where the cursor was drawn
+    UINT dirtyRectCount;
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Kernels.h"
+
+
+
+// Rect math of the capture crop (see Monitor::SetCropRect()).
+// The functions are templated on the rect types, which only need left / top / right / bottom
+// (and SourcePoint / DestinationRect for move rects). RECT and DXGI_OUTDUPL_MOVE_RECT are used
+// in the plugin, while the logic itself does not depend on any Windows header.
+namespace Crop
+{
+    template <class TRect>
+    bool IsEmpty(const TRect& rect)
+    {
+        return rect.left >= rect.right || rect.top >= rect.bottom;
+    }
+
+    template <class TRect>
+    bool IsEqual(const TRect& a, const TRect& b)
+    {
+        return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+    }
+
+    template <class TRect>
+    bool Contains(const TRect& outer, const TRect& inner)
+    {
+        return
+            inner.left >= outer.left && inner.right <= outer.right &&
+            inner.top >= outer.top && inner.bottom <= outer.bottom;
+    }
+
+    // Intersects rect with bounds and returns false when nothing is left.
+    template <class TRect>
+    bool Clip(const TRect& bounds, TRect* rect)
+    {
+        rect->left   = (std::max)(rect->left,   bounds.left);
+        rect->top    = (std::max)(rect->top,    bounds.top);
+        rect->right  = (std::min)(rect->right,  bounds.right);
+        rect->bottom = (std::min)(rect->bottom, bounds.bottom);
+        return !IsEmpty(*rect);
+    }
+
+    // Clips rect to the crop and makes it relative to the crop origin.
+    template <class TRect>
+    bool ToCropSpace(const TRect& crop, TRect* rect)
+    {
+        if (!Clip(crop, rect)) return false;
+        rect->left   -= crop.left;
+        rect->top    -= crop.top;
+        rect->right  -= crop.left;
+        rect->bottom -= crop.top;
+        return true;
+    }
+
+    // Converts a rect in monitor coordinates (as displayed) into coordinates of the desktop image,
+    // which always has the unrotated orientation of the output. monitorWidth and monitorHeight
+    // are the displayed size, so they are swapped compared to the image for 90 and 270 degrees.
+    template <class TRect>
+    TRect ToDesktopImage(const TRect& rect, int rotation, int monitorWidth, int monitorHeight)
+    {
+        TRect result = rect;
+        switch (rotation)
+        {
+            case Kernels::Rotation90:
+            {
+                result.left   = rect.top;
+                result.top    = monitorWidth - rect.right;
+                result.right  = rect.bottom;
+                result.bottom = monitorWidth - rect.left;
+                break;
+            }
+            case Kernels::Rotation180:
+            {
+                result.left   = monitorWidth - rect.right;
+                result.top    = monitorHeight - rect.bottom;
+                result.right  = monitorWidth - rect.left;
+                result.bottom = monitorHeight - rect.top;
+                break;
+            }
+            case Kernels::Rotation270:
+            {
+                result.left   = monitorHeight - rect.bottom;
+                result.top    = rect.left;
+                result.right  = monitorHeight - rect.top;
+                result.bottom = rect.right;
+                break;
+            }
+            case Kernels::RotationIdentity:
+            case Kernels::RotationUnspecified:
+            default:
+            {
+                break;
+            }
+        }
+        return result;
+    }
+
+    // Inverse of ToDesktopImage().
+    template <class TRect>
+    TRect FromDesktopImage(const TRect& rect, int rotation, int monitorWidth, int monitorHeight)
+    {
+        TRect result = rect;
+        switch (rotation)
+        {
+            case Kernels::Rotation90:
+            {
+                result.left   = monitorWidth - rect.bottom;
+                result.top    = rect.left;
+                result.right  = monitorWidth - rect.top;
+                result.bottom = rect.right;
+                break;
+            }
+            case Kernels::Rotation180:
+            {
+                result = ToDesktopImage(rect, rotation, monitorWidth, monitorHeight);
+                break;
+            }
+            case Kernels::Rotation270:
+            {
+                result.left   = rect.top;
+                result.top    = monitorHeight - rect.right;
+                result.right  = rect.bottom;
+                result.bottom = monitorHeight - rect.left;
+                break;
+            }
+            case Kernels::RotationIdentity:
+            case Kernels::RotationUnspecified:
+            default:
+            {
+                break;
+            }
+        }
+        return result;
+    }
+
+    // Rewrites the rects of a frame for the crop (all in desktop image coordinates).
+    // Move rects whose source and destination are both inside the crop are translated. The others
+    // become dirty rects of their clipped destination since their pixels come from outside of it.
+    // Dirty rects are clipped and translated, and the ones outside of the crop are dropped.
+    // outMoveRects needs room for moveRectCount rects and outDirtyRects for moveRectCount + dirtyRectCount.
+    template <class TMoveRect, class TRect>
+    void CropRects(
+        const TRect& crop,
+        const TMoveRect* moveRects,
+        size_t moveRectCount,
+        const TRect* dirtyRects,
+        size_t dirtyRectCount,
+        TMoveRect* outMoveRects,
+        size_t* outMoveRectCount,
+        TRect* outDirtyRects,
+        size_t* outDirtyRectCount)
+    {
+        size_t moveCount = 0;
+        size_t dirtyCount = 0;
+
+        for (size_t i = 0; i < moveRectCount; ++i)
+        {
+            const auto& move = moveRects[i];
+            const auto& dest = move.DestinationRect;
+
+            TRect source = dest;
+            source.left   = move.SourcePoint.x;
+            source.top    = move.SourcePoint.y;
+            source.right  = move.SourcePoint.x + (dest.right - dest.left);
+            source.bottom = move.SourcePoint.y + (dest.bottom - dest.top);
+
+            if (Contains(crop, source) && Contains(crop, dest))
+            {
+                auto& out = outMoveRects[moveCount++];
+                out = move;
+                out.SourcePoint.x -= crop.left;
+                out.SourcePoint.y -= crop.top;
+                ToCropSpace(crop, &out.DestinationRect);
+                continue;
+            }
+
+            TRect rect = dest;
+            if (ToCropSpace(crop, &rect))
+            {
+                outDirtyRects[dirtyCount++] = rect;
+            }
+        }
+
+        for (size_t i = 0; i < dirtyRectCount; ++i)
+        {
+            TRect rect = dirtyRects[i];
+            if (ToCropSpace(crop, &rect))
+            {
+                outDirtyRects[dirtyCount++] = rect;
+            }
+        }
+
+        *outMoveRectCount = moveCount;
+        *outDirtyRectCount = dirtyCount;
+    }
+
+    // Copies a mapped image of rowCount rows into a packed buffer. The row pitch of a mapped
+    // texture is padded for most crop widths, so rows are read one by one and only rowBytes of
+    // the last row are touched.
+    inline void CopyRows(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t rowBytes, size_t rowCount)
+    {
+        for (size_t y = 0; y < rowCount; ++y)
+        {
+            std::memcpy(dst + y * rowBytes, src + y * srcPitch, rowBytes);
+        }
+    }
+}
@@ -4,6 +4,8 @@
 #include "Debug.h"
 #include "Monitor.h"
 #include "Duplicator.h"
+#include "Kernels.h"
+#include "Event.h"
 
 using namespace Microsoft::WRL;
 
@@ -28,9 +30,26 @@ void Cursor::UpdateBuffer(Duplicator* duplicator, const DXGI_OUTDUPL_FRAME_INFO&
         return;
     }
 
-    isVisible_ = frameInfo.PointerPosition.Visible != 0;
-    x_ = frameInfo.PointerPosition.Position.x;
-    y_ = frameInfo.PointerPosition.Position.y;
+    const auto id = duplicator->GetMonitor()->GetId();
+    const bool isVisible = frameInfo.PointerPosition.Visible != 0;
+    const int x = frameInfo.PointerPosition.Position.x;
+    const int y = frameInfo.PointerPosition.Position.y;
+
+    if (isVisible != isVisible_ || x != x_ || y != y_ || id != monitorId_)
+    {
+        Event event = {};
+        event.type = EventType::CursorMoved;
+        event.id = id;
+        event.value = isVisible ? 1 : 0;
+        event.x = x;
+        event.y = y;
+        EventQueue::Push(event);
+    }
+
+    isVisible_ = isVisible;
+    x_ = x;
+    y_ = y;
+    monitorId_ = id;
     timestamp_ = frameInfo.LastMouseUpdateTime;
 
     if (frameInfo.PointerShapeBufferSize == 0)
@@ -43,11 +62,12 @@ void Cursor::UpdateBuffer(Duplicator* duplicator, const DXGI_OUTDUPL_FRAME_INFO&
     {
         return;
     }
+    memoryAccount_.Set(MemoryCategory::Cursor, buffer_.Size() + bgraBuffer_.Size());
 
     // Get mouse pointer information
     UINT bufferSize;
     DXGI_OUTDUPL_POINTER_SHAPE_INFO shapeInfo;
-    const auto hr = duplicator->GetDuplication()->GetFramePointerShape(
+    const auto hr = duplicator->GetFramePointerShape(
         buffer_.Size(),
         buffer_.Get(),
         &bufferSize,
@@ -55,18 +75,27 @@ void Cursor::UpdateBuffer(Duplicator* duplicator, const DXGI_OUTDUPL_FRAME_INFO&
 
     if (FAILED(hr))
     {
-        Debug::Error("Cursor::UpdateBuffer() => GetFramePointerShape() failed.");
+        UDD_ERROR("Cursor::UpdateBuffer() => GetFramePointerShape() failed.");
         buffer_.Reset();
         return;
     }
 
     shapeInfo_ = shapeInfo;
+
+    Event event = {};
+    event.type = EventType::CursorShapeChanged;
+    event.id = id;
+    event.value = GetType();
+    event.width = GetWidth();
+    event.height = GetHeight();
+    EventQueue::Push(event);
 }
 
 
 void Cursor::UpdateTexture(
     Duplicator* duplicator, 
-    const ComPtr<ID3D11Texture2D>& desktopTexture)
+    const ComPtr<ID3D11Texture2D>& desktopTexture,
+    const RECT& captureArea)
 {
     UDD_FUNCTION_SCOPE_TIMER
 
@@ -75,7 +104,7 @@ void Cursor::UpdateTexture(
     // Check desktop texure
     if (desktopTexture == nullptr) 
     {
-        Debug::Error("Cursor::UpdateTexture() => Desktop texture is null.");
+        UDD_ERROR("Cursor::UpdateTexture() => Desktop texture is null.");
         return;
     }
 
@@ -97,11 +126,12 @@ void Cursor::UpdateTexture(
     // Convert the buffer given by API into BGRA32
     const UINT bgraBufferSize = cursorImageWidth * cursorImageHeight * 4;
     bgraBuffer_.ExpandIfNeeded(bgraBufferSize);
+    memoryAccount_.Set(MemoryCategory::Cursor, buffer_.Size() + bgraBuffer_.Size());
     
     // Check buffers
     if (!bgraBuffer_ || !buffer_)
     {
-        Debug::Error("Cursor::UpdateTexture() => no buffer.");
+        UDD_ERROR("Cursor::UpdateTexture() => no buffer.");
         return;
     }
 
@@ -144,6 +174,22 @@ void Cursor::UpdateTexture(
         }
     }
 
+    // The desktop texture only has the captured area of the image (see Monitor::SetCropRect()).
+    desktopX -= captureArea.left;
+    desktopY -= captureArea.top;
+    const int captureWidth  = captureArea.right - captureArea.left;
+    const int captureHeight = captureArea.bottom - captureArea.top;
+    if (desktopX >= captureWidth || 
+        desktopY >= captureHeight || 
+        desktopX + capturedImageWidth <= 0 || 
+        desktopY + capturedImageHeight <= 0)
+    {
+        // Monitors erase the cursor drawn last time when the sequence changes.
+        capturedImageArea_ = {};
+        ++sequence_;
+        return;
+    }
+
     // Calculate information to capture desktop image under cursor.
     int cursorOffsetX = 0;
     int cursorOffsetY = 0;
@@ -159,10 +205,10 @@ void Cursor::UpdateTexture(
         capturedImageLeft = 0;
     }
 
-    if (capturedImageRight >= desktopImageWidth) 
+    if (capturedImageRight >= captureWidth) 
     {
-        capturedImageWidth -= capturedImageRight - desktopImageWidth + 1;
-        capturedImageRight = desktopImageWidth - 1;
+        capturedImageWidth -= capturedImageRight - captureWidth + 1;
+        capturedImageRight = captureWidth - 1;
     }
 
     if (capturedImageTop < 0)
@@ -172,24 +218,24 @@ void Cursor::UpdateTexture(
         capturedImageTop = 0;
     }
 
-    if (capturedImageBottom >= desktopImageHeight) 
+    if (capturedImageBottom >= captureHeight) 
     {
-        capturedImageHeight -= capturedImageBottom - desktopImageHeight + 1;
-        capturedImageBottom = desktopImageHeight - 1;
+        capturedImageHeight -= capturedImageBottom - captureHeight + 1;
+        capturedImageBottom = captureHeight - 1;
     }
 
     // Check if box is inner desktop area
     if (capturedImageLeft   < 0 || 
         capturedImageTop    < 0 || 
-        capturedImageRight  >= desktopImageWidth || 
-        capturedImageBottom >= desktopImageHeight)
+        capturedImageRight  >= captureWidth || 
+        capturedImageBottom >= captureHeight)
     {
-        Debug::Error("Cursor::UpdateTexture() => box is out of area.");
-        Debug::Error(
+        UDD_ERROR("Cursor::UpdateTexture() => box is out of area.");
+        UDD_ERROR(
             "    ",
             "(", capturedImageLeft, ", ", capturedImageTop, ")", 
             " ~ (", capturedImageRight, ", ", capturedImageBottom, ") > ",
-            "(", desktopImageWidth, ", ", desktopImageHeight, ")");
+            "(", captureWidth, ", ", captureHeight, ")");
         return;
     }
 
@@ -226,7 +272,7 @@ void Cursor::UpdateTexture(
 
         if (FAILED(duplicator->GetDevice()->CreateTexture2D(&desc, nullptr, &texture)))
         {
-            Debug::Error("Cursor::UpdateTexture() => GetDevice()->CreateTexture2D() failed.");
+            UDD_ERROR("Cursor::UpdateTexture() => GetDevice()->CreateTexture2D() failed.");
             return;
         }
     }
@@ -242,126 +288,42 @@ void Cursor::UpdateTexture(
     ComPtr<IDXGISurface> surface;
     if (FAILED(texture.As(&surface)))
     {
-        Debug::Error("Cursor::UpdateTexture() => texture.As() failed.");
+        UDD_ERROR("Cursor::UpdateTexture() => texture.As() failed.");
         return;
     }
 
     DXGI_MAPPED_RECT mappedSurface;
     if (FAILED(surface->Map(&mappedSurface, DXGI_MAP_READ)))
     {
-        Debug::Error("Cursor::UpdateTexture() => surface->Map() failed.");
+        UDD_ERROR("Cursor::UpdateTexture() => surface->Map() failed.");
         return;
     }
 
     // Finally, get the desktop texture under the mouse cursor.
-    const auto desktop32 = reinterpret_cast<UINT*>(mappedSurface.pBits);
-    const UINT desktopPitch = mappedSurface.Pitch / sizeof(UINT);
-
-    for (int y = 0; y < capturedImageHeight; ++y)
+    if (!Kernels::CompositeCursor(
+            GetType(),
+            monitorRot,
+            reinterpret_cast<const BYTE*>(mappedSurface.pBits),
+            mappedSurface.Pitch,
+            buffer_.Get(),
+            cursorImagePitch,
+            cursorImageWidth,
+            cursorImageHeight,
+            cursorOffsetX,
+            cursorOffsetY,
+            capturedImageWidth,
+            capturedImageHeight,
+            bgraBuffer_.Get()))
     {
-        for (int x = 0; x < capturedImageWidth; ++x)
-        {
-            // Cursor coordinates
-            int cursorX, cursorY;
-
-            switch (monitorRot)
-            {
-                case DXGI_MODE_ROTATION_ROTATE90:
-                {
-                    cursorX = (cursorImageWidth - 1) - (y + cursorOffsetY);
-                    cursorY = (x + cursorOffsetX);
-                    break;
-                }
-                case DXGI_MODE_ROTATION_ROTATE180:
-                {
-                    cursorX = (cursorImageWidth  - 1) - (x + cursorOffsetX);
-                    cursorY = (cursorImageHeight - 1) - (y + cursorOffsetY);
-                    break;
-                }
-                case DXGI_MODE_ROTATION_ROTATE270:
-                {
-                    cursorX = (y + cursorOffsetY);
-                    cursorY = (cursorImageHeight - 1) - (x + cursorOffsetX);
-                    break;
-                }
-                case DXGI_MODE_ROTATION_IDENTITY:
-                case DXGI_MODE_ROTATION_UNSPECIFIED:
-                default:
-                {
-                    cursorX = (x + cursorOffsetX);
-                    cursorY = (y + cursorOffsetY);
-                    break;
-                }
-            }
-
-            const auto outputIndex = y * capturedImageWidth + x;
-            const auto desktopIndex = y * desktopPitch + x;
-            const auto cursorIndex = cursorY * cursorImageWidth + cursorX;
-            const auto buffer32 = buffer_.As<UINT>();
-            auto output32 = bgraBuffer_.As<UINT>();
-
-            switch (GetType())
-            {
-                case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME:
-                {
-                    BYTE mask = 0b10000000 >> (cursorX % 8);
-                    const BYTE andMask = buffer_[cursorX / 8 + cursorY * cursorImagePitch] & mask;
-                    const BYTE xorMask = buffer_[cursorX / 8 + (cursorY + cursorImageHeight) * cursorImagePitch] & mask;
-                    const UINT andMask32 = andMask ? 0xFFFFFFFF : 0x00000000;
-                    const UINT xorMask32 = xorMask ? 0xFFFFFFFF : 0x00000000;
-                    output32[outputIndex] = (desktop32[desktopIndex] & andMask32) ^ xorMask32;
-                    break;
-                }
-                case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR:
-                {
-                    UINT mask = 0xFF000000 & buffer32[cursorIndex];
-                    if (mask)
-                    {
-                        output32[outputIndex] = (desktop32[desktopIndex] ^ buffer32[cursorIndex]) | 0xFF000000;
-                    }
-                    else
-                    {
-                        output32[outputIndex] = buffer32[cursorIndex] | 0xFF000000;
-                    }
-                    break;
-                }
-                case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR:
-                {
-                    const auto desktop = reinterpret_cast<BYTE*>(&desktop32[desktopIndex]);
-                    const auto desktopB = desktop[0];
-                    const auto desktopG = desktop[1];
-                    const auto desktopR = desktop[2];
-                    const auto desktopA = desktop[3];
-
-                    const auto cursor = buffer_.Get(cursorIndex * 4);
-                    const auto cursorB = cursor[0];
-                    const auto cursorG = cursor[1];
-                    const auto cursorR = cursor[2];
-                    const auto cursorA = cursor[3];
-
-                    const auto a0 = cursorA / 255.f;
-                    const auto a1 = 1.f - a0;
-
-                    auto output = reinterpret_cast<BYTE*>(&output32[outputIndex]);
-                    output[0] = static_cast<BYTE>(cursorB * a0 + desktopB * a1);
-                    output[1] = static_cast<BYTE>(cursorG * a0 + desktopG * a1);
-                    output[2] = static_cast<BYTE>(cursorR * a0 + desktopR * a1);
-                    output[3] = desktopA;
-
-                    break;
-                }
-                default:
-                {
-                    Debug::Error("Cursor::UpdateTexture() => Unknown cursor type");
-                    return;
-                }
-            }
-        }
+        UDD_ERROR("Cursor::UpdateTexture() => Unknown cursor type");
     }
 
+    // Tells monitors to redraw the cursor even if the desktop image has not changed.
+    ++sequence_;
+
     if (FAILED(surface->Unmap()))
     {
-        Debug::Error("Cursor::UpdateTexture() => surface->Unmap() failed.");
+        UDD_ERROR("Cursor::UpdateTexture() => surface->Unmap() failed.");
         return;
     }
 }
@@ -373,7 +335,7 @@ void Cursor::Draw(const Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture)
 
     if (texture == nullptr) 
     {
-        Debug::Error("Cursor::UpdateTexture() => Desktop texture is null.");
+        UDD_ERROR("Cursor::UpdateTexture() => Desktop texture is null.");
         return;
     }
 
@@ -392,13 +354,13 @@ void Cursor::GetTexture(ID3D11Texture2D* texture)
 
     if (!bgraBuffer_)
     {
-        Debug::Error("Cursor::GetTexture() => bgra32Buffer is null.");
+        UDD_ERROR("Cursor::GetTexture() => bgra32Buffer is null.");
         return;
     }
 
     if (texture == nullptr)
     {
-        Debug::Error("Cursor::GetTexture() => The given texture is null.");
+        UDD_ERROR("Cursor::GetTexture() => The given texture is null.");
         return;
     }
 
@@ -411,7 +373,7 @@ void Cursor::GetTexture(ID3D11Texture2D* texture)
             "Cursor::GetTexture() => The given texture has smaller width / height.\n"
             "Given => (%d, %d)  Buffer => (%d, %d)",
             desc.Width, desc.Height, GetWidth(), GetHeight());
-        Debug::Error(buf);
+        UDD_ERROR(buf);
         return;
     }
 
@@ -474,4 +436,34 @@ int Cursor::GetHotSpotX() const
 int Cursor::GetHotSpotY() const 
 { 
     return shapeInfo_.HotSpot.y;
+}
+
+
+const Buffer<BYTE>& Cursor::GetShapeBuffer() const
+{
+    return buffer_;
+}
+
+
+const DXGI_OUTDUPL_POINTER_SHAPE_INFO& Cursor::GetShapeInfo() const
+{
+    return shapeInfo_;
+}
+
+
+const D3D11_BOX& Cursor::GetCapturedImageArea() const
+{
+    return capturedImageArea_;
+}
+
+
+UINT Cursor::GetSequence() const
+{
+    return sequence_;
+}
+
+
+const MemoryAccount& Cursor::GetMemoryAccount() const
+{
+    return memoryAccount_;
 }
\ No newline at end of file
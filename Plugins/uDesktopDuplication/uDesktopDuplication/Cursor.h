@@ -4,8 +4,10 @@
 #include <dxgi1_2.h>
 #include <wrl/client.h>
 #include <memory>
+#include <atomic>
 
 #include "Common.h"
+#include "Memory.h"
 
 class Duplicator;
 
@@ -19,7 +21,8 @@ public:
         const DXGI_OUTDUPL_FRAME_INFO& frameInfo);
     void UpdateTexture(
         Duplicator* duplicator,
-        const Microsoft::WRL::ComPtr<ID3D11Texture2D>& desktopTexture);
+        const Microsoft::WRL::ComPtr<ID3D11Texture2D>& desktopTexture,
+        const RECT& captureArea);
     void Draw(const Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture);
     void GetTexture(ID3D11Texture2D* texture);
 
@@ -32,14 +35,22 @@ public:
     int GetType() const;
     int GetHotSpotX() const;
     int GetHotSpotY() const;
+    const Buffer<BYTE>& GetShapeBuffer() const;
+    const DXGI_OUTDUPL_POINTER_SHAPE_INFO& GetShapeInfo() const;
+    const D3D11_BOX& GetCapturedImageArea() const;
+    UINT GetSequence() const;
+    const MemoryAccount& GetMemoryAccount() const;
 
 private:
     bool isVisible_ = false;
     int x_ = -1;
     int y_ = -1;
+    int monitorId_ = -1;
     Buffer<BYTE> buffer_;
     Buffer<BYTE> bgraBuffer_;
     DXGI_OUTDUPL_POINTER_SHAPE_INFO shapeInfo_ = {};
     LARGE_INTEGER timestamp_ = {};
     D3D11_BOX capturedImageArea_ = {};
+    std::atomic<UINT> sequence_ { 0 };
+    MemoryAccount memoryAccount_;
 };
\ No newline at end of file
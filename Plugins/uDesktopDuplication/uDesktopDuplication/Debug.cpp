@@ -5,13 +5,22 @@
 
 
 
-decltype(Debug::isInitialized_) Debug::isInitialized_ = false;
-decltype(Debug::mode_)          Debug::mode_ = Debug::Mode::File;
-decltype(Debug::logFunc_)       Debug::logFunc_ = nullptr;
-decltype(Debug::errFunc_)       Debug::errFunc_ = nullptr;
-decltype(Debug::fs_)            Debug::fs_;
-decltype(Debug::ss_)            Debug::ss_;
-decltype(Debug::mutex_)         Debug::mutex_;
+decltype(Debug::isInitialized_)    Debug::isInitialized_ = false;
+decltype(Debug::mode_)             Debug::mode_ = Debug::Mode::File;
+#ifdef UDD_DEBUG_ON
+decltype(Debug::level_)            Debug::level_ = Debug::Level::Verbose;
+#else
+decltype(Debug::level_)            Debug::level_ = Debug::Level::Log;
+#endif
+decltype(Debug::logFunc_)          Debug::logFunc_ = nullptr;
+decltype(Debug::errFunc_)          Debug::errFunc_ = nullptr;
+decltype(Debug::fs_)               Debug::fs_;
+decltype(Debug::head_)             Debug::head_ = { nullptr };
+decltype(Debug::callSites_)        Debug::callSites_;
+decltype(Debug::thread_)           Debug::thread_;
+decltype(Debug::writerMutex_)      Debug::writerMutex_;
+decltype(Debug::writerCondition_)  Debug::writerCondition_;
+decltype(Debug::isWriterRunning_)  Debug::isWriterRunning_ = { false };
 
 
 void Debug::Initialize()
@@ -22,8 +31,12 @@ void Debug::Initialize()
     if (mode_ == Mode::File)
     {
         fs_.open("uDesktopDuplication.log");
-        Debug::Log("Start");
     }
+
+    isWriterRunning_ = true;
+    thread_ = std::thread(Run);
+
+    UDD_LOG("Start");
 }
 
 
@@ -32,9 +45,21 @@ void Debug::Finalize()
     if (!isInitialized_) return;
     isInitialized_ = false;
 
-    if (mode_ == Mode::File)
+    UDD_LOG("Stop");
+
+    // The writer drains the remaining messages before it exits.
+    {
+        std::lock_guard<std::mutex> lock(writerMutex_);
+        isWriterRunning_ = false;
+    }
+    writerCondition_.notify_one();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+
+    if (fs_.is_open())
     {
-        Debug::Log("Stop");
         fs_.close();
     }
     Debug::SetLogFunc(nullptr);
@@ -42,15 +67,208 @@ void Debug::Finalize()
 }
 
 
+bool Debug::CheckRateLimit(Level level, const CallSiteToken* token, const char* name)
+{
+    using namespace std::chrono;
+
+    // Open addressing on the token address; when the table is full, the call is not limited.
+    // A failed claim returns the key of the winner, which is this call site if another thread
+    // logged from it at the same time, so one call site never ends up in two slots.
+    const auto hash = reinterpret_cast<UINT_PTR>(token) >> 3;
+    CallSite* site = nullptr;
+    for (UINT i = 0; i < 8; ++i)
+    {
+        auto& candidate = callSites_[(hash + i) % kCallSiteCount];
+        const CallSiteToken* key = nullptr;
+        if (candidate.key.compare_exchange_strong(key, token) || key == token)
+        {
+            site = &candidate;
+            break;
+        }
+    }
+    if (!site) return true;
+
+    if (!site->name.load(std::memory_order_relaxed))
+    {
+        site->name.store(name, std::memory_order_relaxed);
+    }
+
+    // The start of the period and the count are one value, so the call starting a new period
+    // counts itself in the same exchange and no other call's count is lost by the reset.
+    const INT64 now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    auto period = site->period.load();
+    for (;;)
+    {
+        const auto periodStart = static_cast<INT64>(period >> kRateLimitCountBits);
+        const auto count = static_cast<UINT>(period & ((1u << kRateLimitCountBits) - 1));
+
+        UINT64 next;
+        if (now - periodStart >= kRateLimitPeriodMs)
+        {
+            next = (static_cast<UINT64>(now) << kRateLimitCountBits) | 1;
+        }
+        else if (count < kRateLimitCount)
+        {
+            next = period + 1;
+        }
+        else
+        {
+            break;
+        }
+
+        if (site->period.compare_exchange_weak(period, next)) return true;
+    }
+
+    site->level = level;
+    ++site->suppressedCount;
+    return false;
+}
+
+
+std::ostringstream& Debug::GetThreadStream()
+{
+    thread_local std::ostringstream ss;
+    ss.str("");
+    ss.clear(std::stringstream::goodbit);
+    return ss;
+}
+
+
+void Debug::Push(Level level, std::string&& text)
+{
+    auto entry = new Entry();
+    entry->level = level;
+    entry->time = time(nullptr);
+    entry->text = std::move(text);
+
+    entry->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(entry->next, entry, std::memory_order_release, std::memory_order_relaxed));
+
+    // Before Initialize() and after Finalize() there is no writer, so the caller writes it out.
+    if (!isWriterRunning_)
+    {
+        std::lock_guard<std::mutex> lock(writerMutex_);
+        Drain();
+    }
+}
+
+
+void Debug::Run()
+{
+    Trace::SetThreadName("Log Writer Thread");
+
+    std::unique_lock<std::mutex> lock(writerMutex_);
+    while (isWriterRunning_)
+    {
+        writerCondition_.wait_for(lock, std::chrono::milliseconds(50));
+        Drain();
+    }
+    Drain();
+}
+
+
+void Debug::Drain()
+{
+    // The queue is a LIFO stack, so it is reversed to keep the order of messages.
+    auto entry = head_.exchange(nullptr, std::memory_order_acquire);
+    Entry* ordered = nullptr;
+    while (entry)
+    {
+        const auto next = entry->next;
+        entry->next = ordered;
+        ordered = entry;
+        entry = next;
+    }
+
+    while (ordered)
+    {
+        const auto next = ordered->next;
+        Flush(*ordered);
+        delete ordered;
+        ordered = next;
+    }
+
+    DrainSuppressedCallSites();
+
+    if (mode_ == Mode::File && fs_.good())
+    {
+        fs_.flush();
+    }
+}
+
+
+void Debug::DrainSuppressedCallSites()
+{
+    using namespace std::chrono;
+
+    const INT64 now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    for (auto& site : callSites_)
+    {
+        if (site.suppressedCount == 0) continue;
+        if (now - static_cast<INT64>(site.period >> kRateLimitCountBits) < kRateLimitPeriodMs) continue;
+
+        const auto count = site.suppressedCount.exchange(0);
+        if (count == 0) continue;
+
+        const auto token = site.key.load();
+        const auto name = site.name.load();
+        std::string file = token->file;
+        file = file.substr(file.find_last_of("/\\") + 1);
+
+        Entry entry;
+        entry.level = site.level;
+        entry.time = time(nullptr);
+        entry.text =
+            (name ? "\"" + std::string(name) + "\" (" : "(") +
+            file + ":" + std::to_string(token->line) + ") was suppressed " + std::to_string(count) + " times.";
+        Flush(entry);
+    }
+}
+
+
+void Debug::Flush(const Entry& entry)
+{
+    tm tm;
+    localtime_s(&tm, &entry.time);
+    char buf[64];
+    strftime(buf, 64, "%F %T", &tm);
+
+    const auto prefix = (entry.level == Level::Error) ? "[uDD::Err][" : "[uDD::Log][";
+    const auto line = prefix + std::string(buf) + "] " + entry.text;
+
+    switch (mode_)
+    {
+        case Mode::None:
+        {
+            break;
+        }
+        case Mode::File:
+        {
+            if (fs_.good())
+            {
+                fs_ << line << "\n";
+            }
+            break;
+        }
+        case Mode::UnityLog:
+        {
+            const auto func = (entry.level == Level::Error) ? errFunc_ : logFunc_;
+            if (func) func(line.c_str());
+            break;
+        }
+    }
+}
+
+
 decltype(DebugFunctionScopedTimer::currentId) DebugFunctionScopedTimer::currentId = 0;
 
 
 DebugFunctionScopedTimer::DebugFunctionScopedTimer(const char* name)
     : ScopedTimer([this](std::chrono::microseconds us) { 
-        Debug::Log("<< [", id_, "]", name_,  " : ", us.count(), "[us]"); 
+        Debug::Verbose("<< [", id_, "]", name_,  " : ", us.count(), "[us]"); 
     })
     , name_(name)
     , id_(currentId++)
 {
-    Debug::Log(">> [", id_, "]", name_);
+    Debug::Verbose(">> [", id_, "]", name_);
 }
\ No newline at end of file
@@ -1,11 +1,17 @@
 #pragma once
 
 #include <time.h>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <thread>
 #include <mutex>
+#include <condition_variable>
 
 #include "Common.h"
+#include "Trace.h"
 #include "IUnityInterface.h"
 
 
@@ -16,6 +22,9 @@
 
 
 // Logging
+// Messages are formatted on the calling thread and pushed to a lock-free queue, and a background
+// thread writes them out, so callers never wait for file I/O or the Unity log.
+// Log and Error are called through UDD_LOG() / UDD_ERROR(), which give each call site a token.
 class Debug
 {
 public:
@@ -26,135 +35,151 @@ public:
         UnityLog = 2,
     };
 
+    enum class Level
+    {
+        Verbose = 0,
+        Log = 1,
+        Error = 2,
+    };
+
     using DebugLogFuncPtr = void(UNITY_INTERFACE_API *)(const char*);
 
+    // A static instance per call site, created by UDD_LOG() / UDD_ERROR()
+    struct CallSiteToken
+    {
+        const char* file;
+        int line;
+    };
+
     static void SetMode(Mode mode) { mode_ = mode; }
+    static void SetLevel(Level level) { level_ = level; }
+    static bool IsEnabled(Level level) { return mode_ != Mode::None && level >= level_; }
     static void Initialize();
     static void Finalize();
     static void SetLogFunc(DebugLogFuncPtr func) { logFunc_ = func; }
     static void SetErrorFunc(DebugLogFuncPtr func) { errFunc_ = func; }
 
 private:
-    enum class Level
+    struct Entry
     {
-        Log,
-        Error
+        Entry* next = nullptr;
+        Level level = Level::Log;
+        time_t time = 0;
+        std::string text;
+    };
+
+    // A call site is identified by the address of its CallSiteToken.
+    // Each one may output kRateLimitCount messages per kRateLimitPeriodMs.
+    struct CallSite
+    {
+        std::atomic<const CallSiteToken*> key = { nullptr };
+        std::atomic<const char*> name = { nullptr }; // first argument if it is a string literal
+        std::atomic<Level> level = { Level::Log };
+        std::atomic<UINT64> period = { 0 }; // start [ms] << kRateLimitCountBits | count, updated together
+        std::atomic<UINT> suppressedCount = { 0 };
     };
 
     template <class T>
-    static void Output(const T& arg)
+    static void Output(std::ostringstream& ss, const T& arg)
+    {
+        ss << arg;
+    }
+
+    static void Output(std::ostringstream& ss, const WCHAR* arg)
     {
-        if (mode_ == Mode::None) return;
-        if (ss_.good())
-        {
-            ss_ << arg;
-        }
+        char buf[256];
+        size_t size;
+        wcstombs_s(&size, buf, arg, 256);
+        ss << buf;
     }
 
-    static void Output(const WCHAR* arg)
+    template <class Arg, class... RestArgs>
+    static void Format(std::ostringstream& ss, const Arg& arg, const RestArgs&... restArgs)
     {
-        if (mode_ == Mode::None) return;
-        if (ss_.good())
-        {
-            char buf[256];
-            size_t size;
-            wcstombs_s(&size, buf, arg, 256);
-            ss_ << buf;
-        }
+        Output(ss, arg);
+        Format(ss, restArgs...);
     }
 
-    static void Flush(Level level)
-    {
-        switch (mode_)
-        {
-            case Mode::None:
-            {
-                return;
-            }
-            case Mode::File:
-            {
-                if (fs_.good() && ss_.good())
-                {
-                    const auto str = ss_.str();
-                    fs_ << str << std::endl;
-                    fs_.flush();
-                }
-                break;
-            }
-            case Mode::UnityLog:
-            {
-                if (ss_.good())
-                {
-                    switch (level)
-                    {
-                        case Level::Log   : 
-                            if (logFunc_) logFunc_(ss_.str().c_str()); 
-                            break;
-                        case Level::Error : 
-                            if (errFunc_) errFunc_(ss_.str().c_str()); 
-                            break;
-                    }
-                }
-                break;
-            }
-        }
-        ss_.str("");
-        ss_.clear(std::stringstream::goodbit);
+    static void Format(std::ostringstream&)
+    {
     }
 
-    template <class Arg, class... RestArgs>
-    static void _Log(Level level, const Arg& arg, const RestArgs&... restArgs)
+    template <size_t N>
+    static const char* GetCallSiteName(const char (&arg)[N])
     {
-        Output(arg);
-        _Log(level, restArgs...);
+        return arg;
     }
 
-    static void _Log(Level level)
+    // A char buffer on the stack is not valid when the suppressed count is reported.
+    template <size_t N>
+    static const char* GetCallSiteName(char (&)[N])
     {
-        Flush(level);
+        return nullptr;
     }
 
-    static void OutputTime()
+    template <class T>
+    static const char* GetCallSiteName(const T&)
     {
-        auto t = time(nullptr);
-        tm tm;
-        localtime_s(&tm, &t);
-        char buf[64];
-        strftime(buf, 64, "%F %T", &tm);
-        Output("[");;
-        Output(buf);
-        Output("]");
+        return nullptr;
     }
 
+    template <class Arg, class... RestArgs>
+    static void Write(Level level, const CallSiteToken* token, const Arg& arg, const RestArgs&... restArgs)
+    {
+        if (!IsEnabled(level)) return;
+        if (token && !CheckRateLimit(level, token, GetCallSiteName(arg))) return;
+
+        auto& ss = GetThreadStream();
+        Format(ss, arg, restArgs...);
+        Push(level, ss.str());
+    }
+
+    static bool CheckRateLimit(Level level, const CallSiteToken* token, const char* name);
+    static std::ostringstream& GetThreadStream();
+    static void Push(Level level, std::string&& text);
+    static void Run();
+    static void Drain();
+    static void DrainSuppressedCallSites();
+    static void Flush(const Entry& entry);
+
 public:
+    // Function scope timers; not rate-limited and only output when the level is Verbose.
     template <class Arg, class... RestArgs>
-    static void Log(Arg&& arg, RestArgs&&... restArgs)
+    static void Verbose(const Arg& arg, const RestArgs&... restArgs)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        Output("[uDD::Log]");
-        OutputTime();
-        Output(" ");
-        _Log(Level::Log, std::forward<Arg>(arg), std::forward<RestArgs>(restArgs)...);
+        Write(Level::Verbose, nullptr, arg, restArgs...);
     }
 
     template <class Arg, class... RestArgs>
-    static void Error(Arg&& arg, RestArgs&&... restArgs)
+    static void Log(const CallSiteToken& token, const Arg& arg, const RestArgs&... restArgs)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        Output("[uDD::Err]");
-        OutputTime();
-        Output(" ");
-        _Log(Level::Error, std::forward<Arg>(arg), std::forward<RestArgs>(restArgs)...);
+        Write(Level::Log, &token, arg, restArgs...);
+    }
+
+    template <class Arg, class... RestArgs>
+    static void Error(const CallSiteToken& token, const Arg& arg, const RestArgs&... restArgs)
+    {
+        Write(Level::Error, &token, arg, restArgs...);
     }
 
 private:
+    static constexpr UINT kRateLimitCount = 10;
+    static constexpr INT64 kRateLimitPeriodMs = 1000;
+    static constexpr UINT kRateLimitCountBits = 16;
+    static constexpr UINT kCallSiteCount = 256;
+
     static bool isInitialized_;
     static Mode mode_;
+    static Level level_;
     static std::ofstream fs_;
-    static std::ostringstream ss_;
     static DebugLogFuncPtr logFunc_;
     static DebugLogFuncPtr errFunc_;
-    static std::mutex mutex_;
+    static std::atomic<Entry*> head_;
+    static CallSite callSites_[kCallSiteCount];
+    static std::thread thread_;
+    static std::mutex writerMutex_;
+    static std::condition_variable writerCondition_;
+    static std::atomic<bool> isWriterRunning_;
 };
 
 
@@ -170,15 +195,31 @@ private:
 };
 
 
+// Rate-limited logging; the token is constant-initialized, so it costs nothing at run time.
+#define UDD_DEBUG_WRITE(Func, ...) \
+    do \
+    { \
+        static const Debug::CallSiteToken _udd_call_site = { __FILE__, __LINE__ }; \
+        Debug::Func(_udd_call_site, __VA_ARGS__); \
+    } while (false)
+#define UDD_LOG(...) UDD_DEBUG_WRITE(Log, __VA_ARGS__)
+#define UDD_ERROR(...) UDD_DEBUG_WRITE(Error, __VA_ARGS__)
+
+
+// Trace events are recorded in all builds (see Trace.h), the log output only in debug builds.
 #ifdef UDD_DEBUG_ON
 #define UDD_FUNCTION_SCOPE_TIMER \
+    UDD_TRACE_SCOPE(__FUNCTION__) \
     DebugFunctionScopedTimer _timer_##__COUNTER__(__FUNCTION__);
 #define UDD_SCOPE_TIMER(Name) \
+    UDD_TRACE_SCOPE(#Name) \
     ScopedTimer _timer_##__COUNTER__([](std::chrono::microseconds us) \
     { \
-        Debug::Log(#Name, " : ", us.count(), " [us]"); \
+        Debug::Verbose(#Name, " : ", us.count(), " [us]"); \
     });
 #else
-#define UDD_FUNCTION_SCOPE_TIMER
-#define UDD_SCOPE_TIMER(Name)
+#define UDD_FUNCTION_SCOPE_TIMER \
+    UDD_TRACE_SCOPE(__FUNCTION__)
+#define UDD_SCOPE_TIMER(Name) \
+    UDD_TRACE_SCOPE(#Name)
 #endif
\ No newline at end of file
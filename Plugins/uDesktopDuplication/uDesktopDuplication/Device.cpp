@@ -68,34 +68,67 @@ ComPtr<ID3D11Device> IsolatedD3D11Device::GetDevice()
 
 
 Microsoft::WRL::ComPtr<ID3D11Texture2D> IsolatedD3D11Device::GetCompatibleSharedTexture(
-    const ComPtr<ID3D11Texture2D>& src)
+    const ComPtr<ID3D11Texture2D>& src,
+    const ComPtr<ID3D11Texture2D>& current)
 {
     UDD_FUNCTION_SCOPE_TIMER
 
     D3D11_TEXTURE2D_DESC srcDesc;
     src->GetDesc(&srcDesc);
 
+    return GetSharedTexture(srcDesc, current);
+}
+
+
+Microsoft::WRL::ComPtr<ID3D11Texture2D> IsolatedD3D11Device::GetSharedTexture(
+    UINT width, UINT height, DXGI_FORMAT format,
+    const ComPtr<ID3D11Texture2D>& current)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    D3D11_TEXTURE2D_DESC desc;
+    desc.Width              = width;
+    desc.Height             = height;
+    desc.MipLevels          = 1;
+    desc.ArraySize          = 1;
+    desc.Format             = format;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Usage              = D3D11_USAGE_DEFAULT;
+    desc.BindFlags          = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    desc.CPUAccessFlags     = 0;
+    desc.MiscFlags          = 0;
+
+    return GetSharedTexture(desc, current);
+}
+
+
+Microsoft::WRL::ComPtr<ID3D11Texture2D> IsolatedD3D11Device::GetSharedTexture(
+    D3D11_TEXTURE2D_DESC desc,
+    const ComPtr<ID3D11Texture2D>& current)
+{
     // check if the format and size of the current texture are same as the source one
-    if (cachedSharedTexture_) 
+    if (current) 
     {
         D3D11_TEXTURE2D_DESC targetDesc;
-        cachedSharedTexture_->GetDesc(&targetDesc);
-        if (targetDesc.Format == srcDesc.Format && 
-            targetDesc.Width  == srcDesc.Width  && 
-            targetDesc.Height == srcDesc.Height)
+        current->GetDesc(&targetDesc);
+        if (targetDesc.Format == desc.Format && 
+            targetDesc.Width  == desc.Width  && 
+            targetDesc.Height == desc.Height)
         {
-            return cachedSharedTexture_;
+            return current;
         }
     }
 
     // for sharing this texture with unity device
-    srcDesc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
 
-    if (FAILED(device_->CreateTexture2D(&srcDesc, nullptr, &cachedSharedTexture_)))
+    ComPtr<ID3D11Texture2D> texture;
+    if (FAILED(device_->CreateTexture2D(&desc, nullptr, &texture)))
     {
-        Debug::Error("IsolatedD3D11Device::GetCompatibleSharedTexture() => Creating shared texture failed.");
+        UDD_ERROR("IsolatedD3D11Device::GetSharedTexture() => Creating shared texture failed.");
         return nullptr;
     }
 
-    return cachedSharedTexture_;
+    return texture;
 }
\ No newline at end of file
@@ -16,10 +16,19 @@ public:
 
     HRESULT Create(const Microsoft::WRL::ComPtr<IDXGIAdapter>& adapter);
     Microsoft::WRL::ComPtr<ID3D11Device> GetDevice();
+    // These return `current` as is when its size and format already match, so that each frame
+    // pool slot keeps its own shared texture (and shared handle) as long as the desktop does not change.
     Microsoft::WRL::ComPtr<ID3D11Texture2D> GetCompatibleSharedTexture(
-        const Microsoft::WRL::ComPtr<ID3D11Texture2D>& src);
+        const Microsoft::WRL::ComPtr<ID3D11Texture2D>& src,
+        const Microsoft::WRL::ComPtr<ID3D11Texture2D>& current);
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> GetSharedTexture(
+        UINT width, UINT height, DXGI_FORMAT format,
+        const Microsoft::WRL::ComPtr<ID3D11Texture2D>& current);
 
 private:
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> GetSharedTexture(
+        D3D11_TEXTURE2D_DESC desc,
+        const Microsoft::WRL::ComPtr<ID3D11Texture2D>& current);
+
     Microsoft::WRL::ComPtr<ID3D11Device> device_;
-    Microsoft::WRL::ComPtr<ID3D11Texture2D> cachedSharedTexture_;
 };
@@ -1,12 +1,21 @@
 #pragma once
 
 #include <chrono>
+#include <climits>
 
 #include "Duplicator.h"
 #include "Monitor.h"
 #include "MonitorManager.h"
 #include "Cursor.h"
 #include "Device.h"
+#include "Recorder.h"
+#include "ReplayRing.h"
+#include "Codec.h"
+#include "Snapshot.h"
+#include "Composite.h"
+#include "Event.h"
+#include "Memory.h"
+#include "Crop.h"
 #include "Debug.h"
 
 #include "IUnityInterface.h"
@@ -18,6 +27,7 @@ using namespace Microsoft::WRL;
 
 Duplicator::Duplicator(Monitor* monitor)
     : monitor_(monitor)
+    , recorder_(std::make_unique<Recorder>())
 {
     InitializeDevice();
     InitializeDuplication();
@@ -39,8 +49,8 @@ void Duplicator::InitializeDevice()
 
     if (FAILED(device_->Create(monitor_->GetAdapter())))
     {
-        Debug::Error("Duplicator::InitializeDevice() => IsolatedD3D11Device::Create() failed.");
-        state_ = State::Unknown;
+        UDD_ERROR("Duplicator::InitializeDevice() => IsolatedD3D11Device::Create() failed.");
+        SetState(State::Unknown);
     }
 }
 
@@ -60,49 +70,49 @@ void Duplicator::InitializeDuplication()
 	{
 		case S_OK:
 		{
-			state_ = State::Ready;
-			Debug::Log("Duplicator::Initialize() => OK.");
+			SetState(State::Ready);
+			UDD_LOG("Duplicator::Initialize() => OK.");
 			break;
 		}
 		case E_INVALIDARG:
 		{
-			state_ = State::InvalidArg;
-			Debug::Error("Duplicator::Initialize() => Invalid arguments.");
+			SetState(State::InvalidArg);
+			UDD_ERROR("Duplicator::Initialize() => Invalid arguments.");
 			break;
 		}
 		case E_ACCESSDENIED:
 		{
 			// For example, when the user presses Ctrl + Alt + Delete and the screen
 			// switches to admin screen, this error occurs. 
-			state_ = State::AccessDenied;
-			Debug::Error("Duplicator::Initialize() => Access denied.");
+			SetState(State::AccessDenied);
+			UDD_ERROR("Duplicator::Initialize() => Access denied.");
 			break;
 		}
 		case DXGI_ERROR_UNSUPPORTED:
 		{
 			// If the display adapter on the computer is running under the Microsoft Hybrid system,
 			// this error occurs.
-			state_ = State::Unsupported;
-			Debug::Error("Duplicator::Initialize() => Unsupported display.");
+			SetState(State::Unsupported);
+			UDD_ERROR("Duplicator::Initialize() => Unsupported display.");
 			break;
 		}
 		case DXGI_ERROR_NOT_CURRENTLY_AVAILABLE:
 		{
 			// When other application use Desktop Duplication API, this error occurs.
-			state_ = State::CurrentlyNotAvailable;
-			Debug::Error("Duplicator::Initialize() => Currently not available.");
+			SetState(State::CurrentlyNotAvailable);
+			UDD_ERROR("Duplicator::Initialize() => Currently not available.");
 			break;
 		}
 		case DXGI_ERROR_SESSION_DISCONNECTED:
 		{
-			state_ = State::SessionDisconnected;
-			Debug::Error("Duplicator::Initialize() => Session disconnected.");
+			SetState(State::SessionDisconnected);
+			UDD_ERROR("Duplicator::Initialize() => Session disconnected.");
 			break;
 		}
 		default:
 		{
-			state_ = State::Unknown;
-			Debug::Error("Duplicator::Render() => Unknown Error.");
+			SetState(State::Unknown);
+			UDD_ERROR("Duplicator::Render() => Unknown Error.");
 			break;
 		}
 	}
@@ -123,8 +133,8 @@ void Duplicator::CheckUnityAdapter()
 
     if (!isUnityAdapter)
     {
-        Debug::Error("Duplicator::CheckUnityAdapter() => The adapter is not same as Unity, and now this case is not supported.");
-        state_ = State::Unsupported;
+        UDD_ERROR("Duplicator::CheckUnityAdapter() => The adapter is not same as Unity, and now this case is not supported.");
+        SetState(State::Unsupported);
     }
 }
 
@@ -141,15 +151,33 @@ void Duplicator::Start()
     {
         using namespace std::chrono;
 
-        state_ = State::Running;
+        Trace::SetThreadName("Capture Thread " + std::to_string(monitor_->GetId()));
+        SetState(State::Running);
 
         shouldRun_ = true;
         while (shouldRun_)
         {
-            const auto frameRate = GetMonitorManager()->GetFrameRate();
+            ServeSnapshot();
+
+            if (replayer_)
+            {
+                // Replayed frames are paced by their recorded timestamps instead of the frame rate.
+                Replay();
+                if (state_ != State::Running) break;
+                continue;
+            }
+
+            // The rate is chosen per monitor by the QoS scheduler in MonitorManager::Update().
+            const auto frameRate = monitor_->GetEffectiveFrameRate();
             const UINT frameMicroSeconds = 1000000 / frameRate;
             const UINT frameMilliSeconds = 1000 / frameRate;
 
+            if (monitor_->IsPhaseLockEnabled() && DuplicateInPhase(frameMicroSeconds))
+            {
+                if (state_ != State::Running) break;
+                continue;
+            }
+
             ScopedTimer timer([frameMicroSeconds] (microseconds us)
             {
                 const auto waitTime = microseconds(frameMicroSeconds) - us;
@@ -170,7 +198,7 @@ void Duplicator::Start()
 
         if (state_ == State::Running)
         {
-            state_ = State::Ready;
+            SetState(State::Ready);
         }
     });
 }
@@ -186,6 +214,9 @@ void Duplicator::Stop()
     {
         thread_.join();
     }
+
+    // A snapshot requested while the thread was stopping is served here so that it always finishes.
+    ServeSnapshot();
 }
 
 
@@ -209,6 +240,18 @@ Duplicator::State Duplicator::GetState() const
 }
 
 
+void Duplicator::SetState(State state)
+{
+    if (state_.exchange(state) == state) return;
+
+    Event event = {};
+    event.type = EventType::StateChanged;
+    event.id = monitor_->GetId();
+    event.value = static_cast<int>(state);
+    EventQueue::Push(event);
+}
+
+
 Monitor* Duplicator::GetMonitor() const
 {
     return monitor_;
@@ -227,10 +270,233 @@ ComPtr<IDXGIOutputDuplication> Duplicator::GetDuplication()
 }
 
 
-const Duplicator::Frame& Duplicator::GetLastFrame() const
+Duplicator::FrameLease Duplicator::AcquireLastFrame() const
+{
+    return framePool_.AcquireLatest();
+}
+
+
+void Duplicator::GetFrameInfo(FrameInfo* info) const
+{
+    const auto frame = AcquireLastFrame();
+    if (!frame)
+    {
+        *info = {};
+        return;
+    }
+
+    info->presentTime = frame->info.LastPresentTime.QuadPart;
+    info->id = frame->id;
+    info->accumulatedFrames = frame->info.AccumulatedFrames;
+    info->moveRectCount = static_cast<int>(frame->metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT));
+    info->dirtyRectCount = static_cast<int>(frame->metaData.dirtyRectSize / sizeof(RECT));
+}
+
+
+int Duplicator::CopyMoveRects(DXGI_OUTDUPL_MOVE_RECT* output, int capacity, UINT64* frameSeq) const
+{
+    const auto frame = AcquireLastFrame();
+    if (!frame)
+    {
+        if (frameSeq) *frameSeq = 0;
+        return 0;
+    }
+
+    const auto& metaData = frame->metaData;
+    const auto count = static_cast<int>(metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT));
+    if (frameSeq) *frameSeq = frame->id;
+
+    const auto copyCount = std::min(count, capacity);
+    if (output && copyCount > 0)
+    {
+        memcpy(output, metaData.buffer.Get(), sizeof(DXGI_OUTDUPL_MOVE_RECT) * copyCount);
+    }
+
+    return count;
+}
+
+
+int Duplicator::CopyDirtyRects(RECT* output, int capacity, UINT64* frameSeq) const
+{
+    const auto frame = AcquireLastFrame();
+    if (!frame)
+    {
+        if (frameSeq) *frameSeq = 0;
+        return 0;
+    }
+
+    const auto& metaData = frame->metaData;
+    const auto count = static_cast<int>(metaData.dirtyRectSize / sizeof(RECT));
+    if (frameSeq) *frameSeq = frame->id;
+
+    const auto copyCount = std::min(count, capacity);
+    if (output && copyCount > 0)
+    {
+        memcpy(output, metaData.buffer.Get(metaData.moveRectSize), sizeof(RECT) * copyCount);
+    }
+
+    return count;
+}
+
+
+HRESULT Duplicator::GetFramePointerShape(
+    UINT bufferSize,
+    void* buffer,
+    UINT* requiredBufferSize,
+    DXGI_OUTDUPL_POINTER_SHAPE_INFO* shapeInfo)
+{
+    if (!replayer_)
+    {
+        return dupl_->GetFramePointerShape(bufferSize, buffer, requiredBufferSize, shapeInfo);
+    }
+
+    if (!replayFrame_.pointerShape)
+    {
+        return DXGI_ERROR_NOT_FOUND;
+    }
+
+    const auto& header = *replayFrame_.pointerShape;
+    *requiredBufferSize = header.size;
+    if (bufferSize < header.size)
+    {
+        return DXGI_ERROR_MORE_DATA;
+    }
+
+    std::memcpy(buffer, replayFrame_.pointerShapeData, header.size);
+    *shapeInfo = header.info;
+
+    return S_OK;
+}
+
+
+bool Duplicator::StartRecording(const std::string& path)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    return recorder_->Start(path);
+}
+
+
+void Duplicator::StopRecording()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    recorder_->Stop();
+}
+
+
+bool Duplicator::IsRecording() const
+{
+    return recorder_->IsRecording();
+}
+
+
+bool Duplicator::StartReplay(const std::string& path, ReplaySpeed speed, bool loop)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    auto replayer = std::make_unique<Replayer>();
+    if (!replayer->Open(path, speed, loop))
+    {
+        return false;
+    }
+
+    const auto& header = replayer->GetFileHeader();
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(monitor_->GetRotation());
+    const auto isVertical = 
+        rot == DXGI_MODE_ROTATION_ROTATE90 || 
+        rot == DXGI_MODE_ROTATION_ROTATE270;
+    const auto desktopImageWidth  = !isVertical ? monitor_->GetWidth()  : monitor_->GetHeight();
+    const auto desktopImageHeight = !isVertical ? monitor_->GetHeight() : monitor_->GetWidth();
+    if (static_cast<int>(header.width)  != desktopImageWidth ||
+        static_cast<int>(header.height) != desktopImageHeight)
+    {
+        UDD_ERROR("Duplicator::StartReplay() => The session size is different from the monitor.");
+        UDD_ERROR("    Session : (", header.width, ", ", header.height, ")");
+        UDD_ERROR("    Monitor : (", desktopImageWidth, ", ", desktopImageHeight, ")");
+        return false;
+    }
+
+    Stop();
+    Release();
+
+    if (!replayer_)
+    {
+        stateBeforeReplay_ = state_;
+    }
+
+    replayer_ = std::move(replayer);
+    replayFrame_ = Replayer::Frame();
+    SetState(State::Ready);
+    Start();
+
+    return true;
+}
+
+
+void Duplicator::StopReplay()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (!replayer_) return;
+
+    Stop();
+    replayer_.reset();
+    replayFrame_ = Replayer::Frame();
+    replayBuffer_.Reset();
+
+    SetState(stateBeforeReplay_);
+    Start();
+}
+
+
+bool Duplicator::IsReplaying() const
+{
+    return replayer_ != nullptr;
+}
+
+
+void Duplicator::RequestSnapshot(const std::shared_ptr<Snapshot>& snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshot_ = snapshot;
+    }
+
+    // The device context belongs to the capture thread while it runs.
+    if (!IsRunning())
+    {
+        ServeSnapshot();
+    }
+}
+
+
+void Duplicator::SetComposite(const std::shared_ptr<Composite>& composite)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    composite_ = composite;
+    isCompositeChanged_ = true;
+}
+
+
+void Duplicator::SetReplayRing(const std::shared_ptr<ReplayRing>& replayRing)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    return lastFrame_;
+    replayRing_ = replayRing;
+}
+
+
+void Duplicator::SetCrop(const RECT* rect)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    isCropEnabled_ = rect != nullptr;
+    cropRect_ = rect ? *rect : RECT {};
+}
+
+
+INT64 Duplicator::GetCaptureLead() const
+{
+    return captureLeadUs_;
 }
 
 
@@ -254,30 +520,30 @@ void Duplicator::Duplicate(UINT timeout)
             {
                 // If any monitor setting has changed (e.g. monitor size has changed),
                 // it is necessary to re-initialize monitors.
-                Debug::Log("Duplicator::Duplicate() => DXGI_ERROR_ACCESS_LOST.");
-                state_ = State::AccessLost;
+                UDD_LOG("Duplicator::Duplicate() => DXGI_ERROR_ACCESS_LOST.");
+                SetState(State::AccessLost);
                 break;
             }
             case DXGI_ERROR_WAIT_TIMEOUT:
             {
                 // This often occurs when timeout value is small and it is not problem. 
-                // Debug::Log("Duplicator::Duplicate() => DXGI_ERROR_WAIT_TIMEOUT.");
+                // UDD_LOG("Duplicator::Duplicate() => DXGI_ERROR_WAIT_TIMEOUT.");
                 break;
             }
             case DXGI_ERROR_INVALID_CALL:
             {
-                Debug::Error("Duplicator::Duplicate() => DXGI_ERROR_INVALID_CALL.");
+                UDD_ERROR("Duplicator::Duplicate() => DXGI_ERROR_INVALID_CALL.");
                 break;
             }
             case E_INVALIDARG:
             {
-                Debug::Error("Duplicator::Duplicate() => E_INVALIDARG.");
+                UDD_ERROR("Duplicator::Duplicate() => E_INVALIDARG.");
                 break;
             }
             default:
             {
-                state_ = State::Unknown;
-                Debug::Error("Duplicator::Duplicate() => Unknown Error.");
+                SetState(State::Unknown);
+                UDD_ERROR("Duplicator::Duplicate() => Unknown Error.");
                 break;
             }
         }
@@ -286,50 +552,487 @@ void Duplicator::Duplicate(UINT timeout)
 
     isFrameAcquired_ = true;
 
+    // Only the work on an acquired frame counts for the CPU budget, not the wait for it.
+    ScopedTimer costTimer([this](ScopedTimer::microseconds us)
+    {
+        monitor_->GetQosAccount().AddFrame(us.count());
+    });
+
+    // When only the pointer has moved, the desktop image is the same as the last frame, so the
+    // copy and the publication of a new frame are skipped and only the cursor is updated.
+    // Monitors notice the change through Cursor::GetSequence() and redraw just the cursor.
+    if (frameInfo.LastPresentTime.QuadPart == 0 && 
+        frameInfo.AccumulatedFrames == 0 &&
+        lastFrame_)
+    {
+        UpdateCursor(*lastFrame_, frameInfo);
+        return;
+    }
+
+    timestamps_ = FrameTimestamps();
+    timestamps_.present = frameInfo.LastPresentTime.QuadPart;
+    timestamps_.acquired = GetLatencyTimestamp();
+
     ComPtr<ID3D11Texture2D> texture;
     if (FAILED(resource.As(&texture))) 
     {
-        Debug::Error("Duplicator::Duplicate() => IDXGIResource could not be converted to ID3D11Texture2D.");
+        UDD_ERROR("Duplicator::Duplicate() => IDXGIResource could not be converted to ID3D11Texture2D.");
+        return;
+    }
+
+    D3D11_TEXTURE2D_DESC srcDesc;
+    texture->GetDesc(&srcDesc);
+    const auto area = GetCaptureArea(srcDesc.Width, srcDesc.Height);
+    const auto areaWidth = static_cast<UINT>(area.right - area.left);
+    const auto areaHeight = static_cast<UINT>(area.bottom - area.top);
+    const bool isCropped = areaWidth != srcDesc.Width || areaHeight != srcDesc.Height;
+    const bool isAreaChanged = !lastFrame_ || !Crop::IsEqual(lastFrame_->area, area);
+
+    // Rects are read before the copy so that frames which change nothing in the crop cost no copy.
+    UpdateMetadata(frameInfo.TotalMetadataBufferSize);
+    const auto& metaData = (isCropped || isAreaChanged) ? CropMetadata(area, isAreaChanged) : metaData_;
+    if (isCropped && !isAreaChanged && metaData.moveRectSize == 0 && metaData.dirtyRectSize == 0)
+    {
+        UpdateCursor(*lastFrame_, frameInfo);
         return;
     }
 
-    auto sharedTexture = device_->GetCompatibleSharedTexture(texture);
-    if (!sharedTexture)
+    // Every slot is leased only when consumers hold old frames for a long time,
+    // and then this frame is dropped rather than overwriting one of them.
+    const int slot = framePool_.BeginWrite();
+    if (slot == FramePool<Frame>::kInvalidSlot) return;
+
+    auto& frame = framePool_.GetResource(slot);
+    const auto sharedTexture = isCropped ?
+        device_->GetSharedTexture(areaWidth, areaHeight, srcDesc.Format, frame.texture) :
+        device_->GetCompatibleSharedTexture(texture, frame.texture);
+    if (!SetFrameTexture(&frame, sharedTexture))
     {
-        Debug::Error("Duplicator::Duplicate() => Shared texture is null.");
+        framePool_.CancelWrite(slot);
         return;
     }
+    frame.area = area;
+    frame.isCropped = isCropped;
 
     {
         ComPtr<ID3D11DeviceContext> context;
         device_->GetDevice()->GetImmediateContext(&context);
-        context->CopyResource(sharedTexture.Get(), texture.Get());
+        if (isCropped)
+        {
+            const D3D11_BOX box =
+            {
+                static_cast<UINT>(area.left),
+                static_cast<UINT>(area.top),
+                0,
+                static_cast<UINT>(area.right),
+                static_cast<UINT>(area.bottom),
+                1
+            };
+            context->CopySubresourceRegion(frame.texture.Get(), 0, 0, 0, 0, texture.Get(), 0, &box);
+        }
+        else
+        {
+            context->CopyResource(frame.texture.Get(), texture.Get());
+        }
+        timestamps_.copied = GetLatencyTimestamp();
+    }
+
+
+    UpdateCursor(frame, frameInfo);
+    Publish(slot, frameInfo, metaData);
+}
+
+
+RECT Duplicator::GetCaptureArea(UINT width, UINT height) const
+{
+    RECT area = { 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (isCropEnabled_)
+    {
+        // The crop is checked when it is set, but the desktop may have been resized since then.
+        RECT crop = cropRect_;
+        if (Crop::Clip(area, &crop))
+        {
+            area = crop;
+        }
     }
 
+    return area;
+}
+
+
+const Duplicator::Metadata& Duplicator::CropMetadata(const RECT& area, bool isFullUpdate)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    auto& metaData = croppedMetaData_;
+
+    // Consumers of the rects cannot relate them to the previous frame when the area has changed.
+    if (isFullUpdate)
+    {
+        metaData.buffer.ExpandIfNeeded(sizeof(RECT));
+        *metaData.buffer.As<RECT>() = { 0, 0, area.right - area.left, area.bottom - area.top };
+        metaData.moveRectSize = 0;
+        metaData.dirtyRectSize = sizeof(RECT);
+        return metaData;
+    }
+
+    // Move rects which do not fit in the crop turn into dirty rects, so they may need the room of both.
+    const auto moveRectCount = metaData_.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    const auto dirtyRectCount = metaData_.dirtyRectSize / sizeof(RECT);
+    const auto moveRectSize = metaData_.moveRectSize;
+    metaData.buffer.ExpandIfNeeded(static_cast<UINT>(moveRectSize + (moveRectCount + dirtyRectCount) * sizeof(RECT)));
+
+    size_t croppedMoveRectCount = 0;
+    size_t croppedDirtyRectCount = 0;
+    Crop::CropRects(
+        area,
+        metaData_.buffer.As<DXGI_OUTDUPL_MOVE_RECT>(),
+        moveRectCount,
+        metaData_.buffer.As<RECT>(moveRectSize),
+        dirtyRectCount,
+        metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>(),
+        &croppedMoveRectCount,
+        metaData.buffer.As<RECT>(moveRectSize),
+        &croppedDirtyRectCount);
+
+    // Dirty rects follow move rects in the buffer, so they are packed after the ones kept.
+    const auto croppedMoveRectSize = static_cast<UINT>(croppedMoveRectCount * sizeof(DXGI_OUTDUPL_MOVE_RECT));
+    const auto croppedDirtyRectSize = static_cast<UINT>(croppedDirtyRectCount * sizeof(RECT));
+    if (croppedMoveRectSize < moveRectSize && croppedDirtyRectSize > 0)
+    {
+        std::memmove(metaData.buffer.Get(croppedMoveRectSize), metaData.buffer.Get(moveRectSize), croppedDirtyRectSize);
+    }
+    metaData.moveRectSize = croppedMoveRectSize;
+    metaData.dirtyRectSize = croppedDirtyRectSize;
+
+    return metaData;
+}
+
+
+// Captures so that a frame is published right before the next expected Render() of the monitor
+// instead of up to a whole capture interval earlier. Returns false while the render cadence is
+// not locked, and then the caller falls back to the free-running capture.
+bool Duplicator::DuplicateInPhase(UINT frameMicroSeconds)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    const auto& phaseLock = monitor_->GetPhaseLock();
+    const auto now = GetLatencyTimestampMicroseconds();
+    const auto lead = captureLeadUs_.load();
+
+    // Renders closer than the lead cannot be met. Renders before the frame interval has passed are
+    // skipped to keep the QoS rate, with half a render period of slack so that jitter does not make
+    // a capture at the render rate skip every other render.
+    const auto slack = static_cast<INT64>(phaseLock.GetPeriod() / 2);
+    const auto earliest = (std::max)(now, lastPhaseCaptureTime_ + frameMicroSeconds - slack) + lead;
+    const auto renderTime = phaseLock.GetNextRenderTime(earliest);
+    if (renderTime < 0) return false;
+
+    // Sleep in short slices as Replay() does, since a render period can be up to 250 ms and
+    // Stop() waits for this thread.
+    const auto startTime = renderTime - lead;
+    for (auto time = now; time < startTime; time = GetLatencyTimestampMicroseconds())
+    {
+        if (!shouldRun_) return true;
+        std::this_thread::sleep_for(std::chrono::microseconds((std::min<INT64>)(startTime - time, 10000)));
+    }
+
+    // Everything the desktop accumulated until now is acquired without waiting for another update.
+    const auto begin = GetLatencyTimestampMicroseconds();
+    lastPhaseCaptureTime_ = begin;
+    Duplicate(0);
+    const auto end = GetLatencyTimestampMicroseconds();
+
+    const auto cost = static_cast<double>(end - begin);
+    const auto oversleep = static_cast<double>((std::max<INT64>)(begin - startTime, 0));
+    captureCostUs_ += (cost - captureCostUs_) * 0.1;
+    oversleepUs_ += (oversleep - oversleepUs_) * 0.1;
+    captureLeadUs_ = static_cast<INT64>(captureCostUs_ + oversleepUs_) + kCaptureLeadMarginUs;
+
+    return true;
+}
+
+
+void Duplicator::Replay()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    using namespace std::chrono;
+
+    if (!replayer_->Next(&replayFrame_))
+    {
+        UDD_LOG("Duplicator::Replay() => Reached the end of the session.");
+        shouldRun_ = false;
+        return;
+    }
+
+    if (replayer_->GetSpeed() == ReplaySpeed::Recorded)
+    {
+        // Sleep in short slices so that Stop() does not wait for a long idle period.
+        const auto dueTime = replayer_->GetDueTime(replayFrame_);
+        while (shouldRun_)
+        {
+            const auto now = steady_clock::now();
+            if (now >= dueTime) break;
+            std::this_thread::sleep_for(std::min<steady_clock::duration>(dueTime - now, milliseconds(10)));
+        }
+        if (!shouldRun_) return;
+    }
+
+    // The recorded present time belongs to another session, so it is not used as a timestamp.
+    timestamps_ = FrameTimestamps();
+    timestamps_.acquired = GetLatencyTimestamp();
+
+    const int slot = framePool_.BeginWrite();
+    if (slot == FramePool<Frame>::kInvalidSlot) return;
+
+    // Regions only cover what changed, so the slot starts from the latest frame.
+    const auto& fileHeader = replayer_->GetFileHeader();
+    auto& frame = framePool_.GetResource(slot);
+    const auto sharedTexture = device_->GetSharedTexture(
+        fileHeader.width, 
+        fileHeader.height, 
+        static_cast<DXGI_FORMAT>(fileHeader.format),
+        frame.texture);
+    if (!SetFrameTexture(&frame, sharedTexture))
+    {
+        framePool_.CancelWrite(slot);
+        return;
+    }
+
+    // Recorded frames already have the size they were captured with, so the crop is not applied.
+    frame.area = { 0, 0, static_cast<LONG>(fileHeader.width), static_cast<LONG>(fileHeader.height) };
+    frame.isCropped = false;
+
+    {
+        ComPtr<ID3D11DeviceContext> context;
+        device_->GetDevice()->GetImmediateContext(&context);
+
+        if (lastFrame_ && lastFrame_->texture)
+        {
+            D3D11_TEXTURE2D_DESC lastDesc;
+            lastFrame_->texture->GetDesc(&lastDesc);
+            if (lastDesc.Width == fileHeader.width && lastDesc.Height == fileHeader.height)
+            {
+                context->CopyResource(sharedTexture.Get(), lastFrame_->texture.Get());
+            }
+        }
+
+        for (const auto& region : replayFrame_.regions)
+        {
+            const auto& rect = region.header->rect;
+            const UINT width = rect.right - rect.left;
+            const UINT height = rect.bottom - rect.top;
+            const UINT pitch = width * sizeof(UINT);
+
+            replayBuffer_.ExpandIfNeeded(pitch * height);
+            if (!Codec::DecodeRle(region.data, region.header->size, replayBuffer_.Get(), width, height, pitch))
+            {
+                UDD_ERROR("Duplicator::Replay() => Failed to decode a region.");
+                continue;
+            }
+
+            const D3D11_BOX box =
+            {
+                static_cast<UINT>(rect.left),
+                static_cast<UINT>(rect.top),
+                0,
+                static_cast<UINT>(rect.right),
+                static_cast<UINT>(rect.bottom),
+                1
+            };
+            context->UpdateSubresource(sharedTexture.Get(), 0, &box, replayBuffer_.Get(), pitch, 0);
+        }
+
+        timestamps_.copied = GetLatencyTimestamp();
+    }
+
+    auto& probe = monitor_->GetLatencyProbe();
+    const auto drawsProbe = probe.IsEnabled() && fileHeader.width >= LatencyProbe::kWidth;
+    if (drawsProbe)
+    {
+        UINT pixels[LatencyProbe::kWidth];
+        timestamps_.probe = GetLatencyTimestamp();
+        probe.Draw(reinterpret_cast<BYTE*>(pixels), timestamps_.probe);
+
+        ComPtr<ID3D11DeviceContext> context;
+        device_->GetDevice()->GetImmediateContext(&context);
+        const D3D11_BOX box = { 0, 0, 0, LatencyProbe::kWidth, 1, 1 };
+        context->UpdateSubresource(sharedTexture.Get(), 0, &box, pixels, sizeof(pixels), 0);
+    }
+
+    const auto& frameHeader = *replayFrame_.header;
+    const UINT moveRectSize = frameHeader.moveRectCount * sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    UINT dirtyRectSize = frameHeader.dirtyRectCount * sizeof(RECT);
+    metaData_.buffer.ExpandIfNeeded(moveRectSize + dirtyRectSize + (drawsProbe ? sizeof(RECT) : 0));
+    if (moveRectSize > 0)
+    {
+        std::memcpy(metaData_.buffer.Get(), replayFrame_.moveRects, moveRectSize);
+    }
+    if (dirtyRectSize > 0)
+    {
+        std::memcpy(metaData_.buffer.Get(moveRectSize), replayFrame_.dirtyRects, dirtyRectSize);
+    }
+    if (drawsProbe)
+    {
+        *metaData_.buffer.As<RECT>(moveRectSize + dirtyRectSize) = { 0, 0, LatencyProbe::kWidth, 1 };
+        dirtyRectSize += sizeof(RECT);
+    }
+    metaData_.moveRectSize = moveRectSize;
+    metaData_.dirtyRectSize = dirtyRectSize;
+
+    UpdateCursor(frame, frameHeader.info);
+    Publish(slot, frameHeader.info, metaData_);
+}
+
+
+bool Duplicator::SetFrameTexture(Frame* frame, const ComPtr<ID3D11Texture2D>& texture)
+{
+    if (!texture)
+    {
+        UDD_ERROR("Duplicator::SetFrameTexture() => Shared texture is null.");
+        return false;
+    }
+
+    // The shared handle stays valid as long as the texture does, so it is looked up only when
+    // the slot gets a new texture, and consumers can keep the resources they opened from it.
+    if (frame->texture == texture) return true;
 
     HANDLE sharedHandle;
     ComPtr<IDXGIResource> dxgiResource;
-    sharedTexture.As(&dxgiResource);
+    texture.As(&dxgiResource);
     if (FAILED(dxgiResource->GetSharedHandle(&sharedHandle)))
     {
-        Debug::Error("Duplicator::Duplicate() => Failed to get shared handle.");
-        return;
+        UDD_ERROR("Duplicator::SetFrameTexture() => Failed to get shared handle.");
+        return false;
     }
 
-    UpdateCursor(sharedTexture, frameInfo);
-    UpdateMetadata(frameInfo.TotalMetadataBufferSize);
+    frame->texture = texture;
+    frame->textureHandle = sharedHandle;
 
+    INT64 bytes = 0;
+    for (int i = 0; i < framePool_.GetSlotCount(); ++i)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        lastFrame_ = Frame
+        if (const auto& slotTexture = framePool_.GetResource(i).texture)
         {
-            lastFrameId_++,
-            sharedTexture,
-            sharedHandle,
-            frameInfo,
-            metaData_
-        };
+            D3D11_TEXTURE2D_DESC desc;
+            slotTexture->GetDesc(&desc);
+            bytes += GetTextureByteSize(desc);
+        }
     }
+    monitor_->GetMemoryAccount().Set(MemoryCategory::SharedTexture, bytes);
+
+    return true;
+}
+
+
+void Duplicator::Publish(int slot, const DXGI_OUTDUPL_FRAME_INFO& frameInfo, const Metadata& metaData)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    // Metadata is copied into the buffer the slot already has, so publishing does not allocate.
+    auto& frame = framePool_.GetResource(slot);
+    const UINT metaDataSize = metaData.moveRectSize + metaData.dirtyRectSize;
+    frame.metaData.buffer.ExpandIfNeeded(metaDataSize);
+    if (metaDataSize > 0)
+    {
+        std::memcpy(frame.metaData.buffer.Get(), metaData.buffer.Get(), metaDataSize);
+    }
+    frame.metaData.moveRectSize = metaData.moveRectSize;
+    frame.metaData.dirtyRectSize = metaData.dirtyRectSize;
+    frame.id = lastFrameId_++;
+    frame.info = frameInfo;
+
+    INT64 metaDataBytes = metaData_.buffer.Size() + croppedMetaData_.buffer.Size();
+    for (int i = 0; i < framePool_.GetSlotCount(); ++i)
+    {
+        metaDataBytes += framePool_.GetResource(i).metaData.buffer.Size();
+    }
+    monitor_->GetMemoryAccount().Set(MemoryCategory::Metadata, metaDataBytes);
+
+    timestamps_.published = GetLatencyTimestamp();
+    frame.timestamps = timestamps_;
+
+    framePool_.EndWrite(slot);
+    lastFrame_ = &frame;
+
+    // The latest slot is never written by anyone else, so it can be read here without a lease.
+    recorder_->Record(this, *lastFrame_);
+
+    std::shared_ptr<ReplayRing> replayRing;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        replayRing = replayRing_;
+    }
+    if (replayRing)
+    {
+        replayRing->Add(this, *lastFrame_);
+    }
+    else if (monitor_->GetMemoryAccount().Get(MemoryCategory::ReplayRing) > 0)
+    {
+        // Set here too since a disabled ring can still be adding its last frame while the monitor clears it.
+        monitor_->GetMemoryAccount().Set(MemoryCategory::ReplayRing, 0);
+    }
+
+    UpdateComposite();
+    NotifyFrameReady();
+}
+
+
+void Duplicator::NotifyFrameReady()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    const auto& metaData = lastFrame_->metaData;
+    const auto moveRectCount = metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    const auto dirtyRectCount = metaData.dirtyRectSize / sizeof(RECT);
+
+    RECT bounds = { LONG_MAX, LONG_MAX, LONG_MIN, LONG_MIN };
+    const auto extend = [&bounds](const RECT& rect)
+    {
+        bounds.left   = std::min<LONG>(bounds.left,   rect.left);
+        bounds.top    = std::min<LONG>(bounds.top,    rect.top);
+        bounds.right  = std::max<LONG>(bounds.right,  rect.right);
+        bounds.bottom = std::max<LONG>(bounds.bottom, rect.bottom);
+    };
+
+    const auto moveRects = metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>();
+    for (UINT i = 0; i < moveRectCount; ++i)
+    {
+        extend(moveRects[i].DestinationRect);
+    }
+
+    const auto dirtyRects = metaData.buffer.As<RECT>(metaData.moveRectSize);
+    for (UINT i = 0; i < dirtyRectCount; ++i)
+    {
+        extend(dirtyRects[i]);
+    }
+
+    Event event = {};
+    event.type = EventType::FrameReady;
+    event.id = monitor_->GetId();
+    event.seq = lastFrame_->id;
+    event.moveRectCount = static_cast<UINT>(moveRectCount);
+    event.dirtyRectCount = static_cast<UINT>(dirtyRectCount);
+    if (bounds.left < bounds.right && bounds.top < bounds.bottom)
+    {
+        event.x = bounds.left;
+        event.y = bounds.top;
+        event.width = bounds.right - bounds.left;
+        event.height = bounds.bottom - bounds.top;
+    }
+    EventQueue::Push(event);
+
+    // Watch region events follow the FrameReady event of the frame which changed them.
+    monitor_->NotifyWatchRegions(
+        lastFrame_->id,
+        lastFrame_->area,
+        moveRects,
+        static_cast<UINT>(moveRectCount),
+        dirtyRects,
+        static_cast<UINT>(dirtyRectCount));
 }
 
 
@@ -346,19 +1049,19 @@ void Duplicator::Release()
         {
             case DXGI_ERROR_ACCESS_LOST:
             {
-                Debug::Log("Duplicator::Duplicate() => DXGI_ERROR_ACCESS_LOST.");
-                state_ = State::AccessLost;
+                UDD_LOG("Duplicator::Duplicate() => DXGI_ERROR_ACCESS_LOST.");
+                SetState(State::AccessLost);
                 break;
             }
             case DXGI_ERROR_INVALID_CALL:
             {
-                Debug::Error("Duplicator::Duplicate() => DXGI_ERROR_INVALID_CALL.");
+                UDD_ERROR("Duplicator::Duplicate() => DXGI_ERROR_INVALID_CALL.");
                 break;
             }
             default:
             {
-                state_ = State::Unknown;
-                Debug::Error("Duplicator::Duplicate() => Unknown Error.");
+                SetState(State::Unknown);
+                UDD_ERROR("Duplicator::Duplicate() => Unknown Error.");
                 break;
             }
         }
@@ -368,8 +1071,202 @@ void Duplicator::Release()
 }
 
 
+void Duplicator::ServeSnapshot()
+{
+    std::shared_ptr<Snapshot> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshot.swap(snapshot_);
+    }
+    if (!snapshot) return;
+
+    UDD_FUNCTION_SCOPE_TIMER
+
+    // Snapshots show whole monitors, which a cropped frame does not have.
+    if (!lastFrame_ || !lastFrame_->texture || lastFrame_->isCropped)
+    {
+        snapshot->Skip(monitor_);
+        return;
+    }
+
+    const auto& texture = lastFrame_->texture;
+
+    D3D11_TEXTURE2D_DESC srcDesc;
+    texture->GetDesc(&srcDesc);
+
+    D3D11_TEXTURE2D_DESC desc;
+    desc.Width              = srcDesc.Width;
+    desc.Height             = srcDesc.Height;
+    desc.MipLevels          = 1;
+    desc.ArraySize          = 1;
+    desc.Format             = srcDesc.Format;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Usage              = D3D11_USAGE_STAGING;
+    desc.BindFlags          = 0;
+    desc.CPUAccessFlags     = D3D11_CPU_ACCESS_READ;
+    desc.MiscFlags          = 0;
+
+    ComPtr<ID3D11Texture2D> stagingTexture;
+    if (srcDesc.Format != DXGI_FORMAT_B8G8R8A8_UNORM ||
+        FAILED(GetDevice()->CreateTexture2D(&desc, nullptr, &stagingTexture)))
+    {
+        UDD_ERROR("Duplicator::ServeSnapshot() => Could not create a staging texture.");
+        snapshot->Skip(monitor_);
+        return;
+    }
+
+    ComPtr<ID3D11DeviceContext> context;
+    GetDevice()->GetImmediateContext(&context);
+    context->CopyResource(stagingTexture.Get(), texture.Get());
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (FAILED(context->Map(stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+    {
+        UDD_ERROR("Duplicator::ServeSnapshot() => Map() failed.");
+        snapshot->Skip(monitor_);
+        return;
+    }
+
+    snapshot->Blit(monitor_, static_cast<const BYTE*>(mapped.pData), mapped.RowPitch, desc.Width, desc.Height);
+    context->Unmap(stagingTexture.Get(), 0);
+}
+
+
+void Duplicator::UpdateComposite()
+{
+    std::shared_ptr<Composite> composite;
+    bool needsFullUpdate = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        composite = composite_;
+        needsFullUpdate = isCompositeChanged_;
+        isCompositeChanged_ = false;
+    }
+
+    if (!composite)
+    {
+        compositeRects_.clear();
+        compositeTexture_.Reset();
+        return;
+    }
+
+    // A cropped frame does not cover the monitor, so the composite keeps the last whole image.
+    // The first frame after the crop is removed has the full area as dirty (see CropMetadata()).
+    if (lastFrame_->isCropped) return;
+
+    UDD_FUNCTION_SCOPE_TIMER
+
+    const auto& texture = lastFrame_->texture;
+    D3D11_TEXTURE2D_DESC srcDesc;
+    texture->GetDesc(&srcDesc);
+    if (srcDesc.Format != DXGI_FORMAT_B8G8R8A8_UNORM) return;
+
+    // Rects which could not be blitted while the buffer was leased are kept until the next frame.
+    constexpr size_t maxRectCount = 256;
+    const auto& metaData = lastFrame_->metaData;
+    const auto moveRects = metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>();
+    const auto moveRectCount = metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    const auto dirtyRects = metaData.buffer.As<RECT>(metaData.moveRectSize);
+    const auto dirtyRectCount = metaData.dirtyRectSize / sizeof(RECT);
+    if (compositeRects_.size() + moveRectCount + dirtyRectCount > maxRectCount)
+    {
+        needsFullUpdate = true;
+    }
+
+    if (needsFullUpdate)
+    {
+        compositeRects_.assign(1, RECT { 0, 0, static_cast<LONG>(srcDesc.Width), static_cast<LONG>(srcDesc.Height) });
+    }
+    else
+    {
+        // The destination of a move rect already has the moved pixels in the texture.
+        for (UINT i = 0; i < moveRectCount; ++i)
+        {
+            compositeRects_.push_back(moveRects[i].DestinationRect);
+        }
+        for (UINT i = 0; i < dirtyRectCount; ++i)
+        {
+            compositeRects_.push_back(dirtyRects[i]);
+        }
+    }
+
+    if (compositeRects_.empty()) return;
+
+    D3D11_TEXTURE2D_DESC desc;
+    if (compositeTexture_)
+    {
+        compositeTexture_->GetDesc(&desc);
+    }
+    if (!compositeTexture_ || desc.Width != srcDesc.Width || desc.Height != srcDesc.Height)
+    {
+        desc.Width              = srcDesc.Width;
+        desc.Height             = srcDesc.Height;
+        desc.MipLevels          = 1;
+        desc.ArraySize          = 1;
+        desc.Format             = srcDesc.Format;
+        desc.SampleDesc.Count   = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Usage              = D3D11_USAGE_STAGING;
+        desc.BindFlags          = 0;
+        desc.CPUAccessFlags     = D3D11_CPU_ACCESS_READ;
+        desc.MiscFlags          = 0;
+
+        compositeTexture_.Reset();
+        if (FAILED(GetDevice()->CreateTexture2D(&desc, nullptr, &compositeTexture_)))
+        {
+            UDD_ERROR("Duplicator::UpdateComposite() => Could not create a staging texture.");
+            return;
+        }
+    }
+
+    ComPtr<ID3D11DeviceContext> context;
+    GetDevice()->GetImmediateContext(&context);
+
+    for (auto& rect : compositeRects_)
+    {
+        rect.left   = std::max<LONG>(rect.left, 0);
+        rect.top    = std::max<LONG>(rect.top, 0);
+        rect.right  = std::min<LONG>(rect.right, srcDesc.Width);
+        rect.bottom = std::min<LONG>(rect.bottom, srcDesc.Height);
+        if (rect.left >= rect.right || rect.top >= rect.bottom) continue;
+
+        const D3D11_BOX box =
+        {
+            static_cast<UINT>(rect.left),
+            static_cast<UINT>(rect.top),
+            0,
+            static_cast<UINT>(rect.right),
+            static_cast<UINT>(rect.bottom),
+            1
+        };
+        context->CopySubresourceRegion(compositeTexture_.Get(), 0, box.left, box.top, 0, texture.Get(), 0, &box);
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (FAILED(context->Map(compositeTexture_.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+    {
+        UDD_ERROR("Duplicator::UpdateComposite() => Map() failed.");
+        return;
+    }
+
+    const auto isBlitted = composite->Blit(
+        monitor_,
+        static_cast<const BYTE*>(mapped.pData),
+        mapped.RowPitch,
+        compositeRects_.data(),
+        static_cast<UINT>(compositeRects_.size()));
+    context->Unmap(compositeTexture_.Get(), 0);
+
+    if (isBlitted)
+    {
+        compositeRects_.clear();
+    }
+}
+
+
 void Duplicator::UpdateCursor(
-    const ComPtr<ID3D11Texture2D>& texture,
+    const Frame& frame,
     const DXGI_OUTDUPL_FRAME_INFO& frameInfo)
 {
     UDD_FUNCTION_SCOPE_TIMER
@@ -385,7 +1282,7 @@ void Duplicator::UpdateCursor(
     {
         auto cursor = manager->GetCursor();
         cursor->UpdateBuffer(this, frameInfo);
-        cursor->UpdateTexture(this, texture);
+        cursor->UpdateTexture(this, frame.texture, frame.area);
     }
 }
 
@@ -418,27 +1315,27 @@ void Duplicator::UpdateMoveRects()
         {
             case DXGI_ERROR_ACCESS_LOST:
             {
-                Debug::Log("Duplicator::UpdateMoveRects() => DXGI_ERROR_ACCESS_LOST.");
+                UDD_LOG("Duplicator::UpdateMoveRects() => DXGI_ERROR_ACCESS_LOST.");
                 break;
             }
             case DXGI_ERROR_MORE_DATA:
             {
-                Debug::Error("Duplicator::UpdateMoveRects() => DXGI_ERROR_MORE_DATA.");
+                UDD_ERROR("Duplicator::UpdateMoveRects() => DXGI_ERROR_MORE_DATA.");
                 break;
             }
             case DXGI_ERROR_INVALID_CALL:
             {
-                Debug::Error("Duplicator::UpdateMoveRects() => DXGI_ERROR_INVALID_CALL.");
+                UDD_ERROR("Duplicator::UpdateMoveRects() => DXGI_ERROR_INVALID_CALL.");
                 break;
             }
             case E_INVALIDARG:
             {
-                Debug::Error("Duplicator::UpdateMoveRects() => E_INVALIDARG.");
+                UDD_ERROR("Duplicator::UpdateMoveRects() => E_INVALIDARG.");
                 break;
             }
             default:
             {
-                Debug::Error("Duplicator::UpdateMoveRects() => Unknown Error.");
+                UDD_ERROR("Duplicator::UpdateMoveRects() => Unknown Error.");
                 break;
             }
         }
@@ -462,27 +1359,27 @@ void Duplicator::UpdateDirtyRects()
         {
             case DXGI_ERROR_ACCESS_LOST:
             {
-                Debug::Log("Duplicator::UpdateDirtyRects() => DXGI_ERROR_ACCESS_LOST.");
+                UDD_LOG("Duplicator::UpdateDirtyRects() => DXGI_ERROR_ACCESS_LOST.");
                 break;
             }
             case DXGI_ERROR_MORE_DATA:
             {
-                Debug::Error("Duplicator::UpdateDirtyRects() => DXGI_ERROR_MORE_DATA.");
+                UDD_ERROR("Duplicator::UpdateDirtyRects() => DXGI_ERROR_MORE_DATA.");
                 break;
             }
             case DXGI_ERROR_INVALID_CALL:
             {
-                Debug::Error("Duplicator::UpdateDirtyRects() => DXGI_ERROR_INVALID_CALL.");
+                UDD_ERROR("Duplicator::UpdateDirtyRects() => DXGI_ERROR_INVALID_CALL.");
                 break;
             }
             case E_INVALIDARG:
             {
-                Debug::Error("Duplicator::UpdateDirtyRects() => E_INVALIDARG.");
+                UDD_ERROR("Duplicator::UpdateDirtyRects() => E_INVALIDARG.");
                 break;
             }
             default:
             {
-                Debug::Error("Duplicator::UpdateDirtyRects() => Unknown Error.");
+                UDD_ERROR("Duplicator::UpdateDirtyRects() => Unknown Error.");
                 break;
             }
         }
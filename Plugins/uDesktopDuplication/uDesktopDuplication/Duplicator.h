@@ -6,9 +6,14 @@
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <string>
+#include <vector>
 #include <wrl/client.h>
 
 #include "Common.h"
+#include "FramePool.h"
+#include "Replayer.h"
+#include "Latency.h"
 
 
 class Monitor;
@@ -47,10 +52,16 @@ public:
         UINT id = 0;
         Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = nullptr;
         HANDLE textureHandle = nullptr;
+        RECT area = {}; // part of the desktop image copied into the texture
+        bool isCropped = false;
         DXGI_OUTDUPL_FRAME_INFO info;
         Metadata metaData;
+        FrameTimestamps timestamps;
     };
 
+    using FrameLease = FramePool<Frame>::Lease;
+    static constexpr int kFrameSlotCount = 3;
+
     explicit Duplicator(Monitor* monitor);
     ~Duplicator();
     void Start();
@@ -61,7 +72,27 @@ public:
     Monitor* GetMonitor() const;
     Microsoft::WRL::ComPtr<ID3D11Device> GetDevice();
     Microsoft::WRL::ComPtr<IDXGIOutputDuplication> GetDuplication();
-    const Frame& GetLastFrame() const;
+    FrameLease AcquireLastFrame() const;
+    void GetFrameInfo(struct FrameInfo* info) const;
+    int CopyMoveRects(DXGI_OUTDUPL_MOVE_RECT* output, int capacity, UINT64* frameSeq) const;
+    int CopyDirtyRects(RECT* output, int capacity, UINT64* frameSeq) const;
+    HRESULT GetFramePointerShape(
+        UINT bufferSize,
+        void* buffer,
+        UINT* requiredBufferSize,
+        DXGI_OUTDUPL_POINTER_SHAPE_INFO* shapeInfo);
+
+    bool StartRecording(const std::string& path);
+    void StopRecording();
+    bool IsRecording() const;
+    bool StartReplay(const std::string& path, ReplaySpeed speed, bool loop);
+    void StopReplay();
+    bool IsReplaying() const;
+    void RequestSnapshot(const std::shared_ptr<class Snapshot>& snapshot);
+    void SetComposite(const std::shared_ptr<class Composite>& composite);
+    void SetReplayRing(const std::shared_ptr<class ReplayRing>& replayRing);
+    void SetCrop(const RECT* rect);
+    INT64 GetCaptureLead() const;
 
 private:
     void InitializeDevice();
@@ -69,10 +100,20 @@ private:
     void CheckUnityAdapter();
 
     void Duplicate(UINT timeout);
+    bool DuplicateInPhase(UINT frameMicroSeconds);
+    void Replay();
+    bool SetFrameTexture(Frame* frame, const Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture);
+    void Publish(int slot, const DXGI_OUTDUPL_FRAME_INFO& frameInfo, const Metadata& metaData);
+    RECT GetCaptureArea(UINT width, UINT height) const;
+    const Metadata& CropMetadata(const RECT& area, bool isFullUpdate);
     void Release();
+    void ServeSnapshot();
+    void UpdateComposite();
+    void NotifyFrameReady();
+    void SetState(State state);
 
     void UpdateCursor(
-        const Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture,
+        const Frame& frame,
         const DXGI_OUTDUPL_FRAME_INFO& frameInfo);
 	void UpdateMetadata(UINT totalBufferSize);
     void UpdateMoveRects();
@@ -83,7 +124,10 @@ private:
 
     std::shared_ptr<class IsolatedD3D11Device> device_;
     Microsoft::WRL::ComPtr<IDXGIOutputDuplication> dupl_;
-    Frame lastFrame_ = {};
+    // The capture thread writes into free slots while Unity's render thread and API callers
+    // lease the latest one. lastFrame_ points to the latest slot and is only used on the capture thread.
+    mutable FramePool<Frame> framePool_ { kFrameSlotCount };
+    const Frame* lastFrame_ = nullptr;
     UINT lastFrameId_ = 0;
     bool isFrameAcquired_ = false;
 
@@ -92,4 +136,34 @@ private:
     mutable std::mutex mutex_;
 
     Metadata metaData_ = {};
+    FrameTimestamps timestamps_ = {};
+
+    std::unique_ptr<class Recorder> recorder_;
+    std::unique_ptr<Replayer> replayer_;
+    Replayer::Frame replayFrame_;
+    Buffer<BYTE> replayBuffer_;
+    State stateBeforeReplay_ = State::Ready;
+
+    std::shared_ptr<class Snapshot> snapshot_;
+
+    // Instant replay ring set from the main thread (guarded by mutex_)
+    std::shared_ptr<class ReplayRing> replayRing_;
+
+    std::shared_ptr<class Composite> composite_;
+    bool isCompositeChanged_ = false;
+    std::vector<RECT> compositeRects_;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> compositeTexture_;
+
+    // Desktop image coordinates (guarded by mutex_)
+    RECT cropRect_ = {};
+    bool isCropEnabled_ = false;
+    Metadata croppedMetaData_ = {};
+
+    // Phase locked capture (capture thread only, except for the lead which is reported).
+    // The lead is the smoothed capture cost plus the oversleep of the thread and a margin.
+    static constexpr INT64 kCaptureLeadMarginUs = 1000;
+    std::atomic<INT64> captureLeadUs_ { kCaptureLeadMarginUs };
+    double captureCostUs_ = 0.0;
+    double oversleepUs_ = 0.0;
+    INT64 lastPhaseCaptureTime_ = 0;
 };
@@ -0,0 +1,115 @@
+#include <atomic>
+#include <mutex>
+
+#include "Event.h"
+
+
+
+namespace
+{
+    // Bounded MPSC queue: producers claim a cell with a CAS on the enqueue position, and each
+    // cell's sequence number tells whether it is free or holds a published event.
+    constexpr UINT kCapacity = 4096;
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "kCapacity must be a power of two.");
+
+    struct Cell
+    {
+        std::atomic<UINT> sequence;
+        Event event;
+    };
+
+    struct Queue
+    {
+        Queue()
+        {
+            for (UINT i = 0; i < kCapacity; ++i)
+            {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        Cell cells[kCapacity];
+        std::atomic<UINT> enqueuePos { 0 };
+        UINT dequeuePos = 0;
+        std::atomic<UINT> droppedCount { 0 };
+        std::mutex consumerMutex;
+    };
+
+    Queue g_queue;
+}
+
+
+
+bool EventQueue::Push(const Event& event)
+{
+    auto pos = g_queue.enqueuePos.load(std::memory_order_relaxed);
+    Cell* cell = nullptr;
+
+    for (;;)
+    {
+        cell = &g_queue.cells[pos & (kCapacity - 1)];
+        const auto sequence = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<int>(sequence - pos);
+        if (diff == 0)
+        {
+            if (g_queue.enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            g_queue.droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = g_queue.enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->event = event;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+
+int EventQueue::Drain(Event* buffer, int capacity)
+{
+    if (!buffer || capacity <= 0) return 0;
+
+    std::lock_guard<std::mutex> lock(g_queue.consumerMutex);
+
+    int count = 0;
+
+    // Dropped events are reported first so that the receiver can resynchronize its state.
+    if (const auto droppedCount = g_queue.droppedCount.exchange(0, std::memory_order_relaxed))
+    {
+        buffer[count] = Event();
+        buffer[count].type = EventType::Overflow;
+        buffer[count].id = -1;
+        buffer[count].value = static_cast<int>(droppedCount);
+        ++count;
+    }
+
+    while (count < capacity)
+    {
+        auto& pos = g_queue.dequeuePos;
+        auto& cell = g_queue.cells[pos & (kCapacity - 1)];
+        const auto sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<int>(sequence - (pos + 1)) < 0) break;
+
+        buffer[count++] = cell.event;
+        cell.sequence.store(pos + kCapacity, std::memory_order_release);
+        ++pos;
+    }
+
+    return count;
+}
+
+
+void EventQueue::Clear()
+{
+    Event buffer[64];
+    while (Drain(buffer, 64) > 0);
+}
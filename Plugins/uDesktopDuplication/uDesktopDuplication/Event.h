@@ -0,0 +1,47 @@
+#pragma once
+
+#include <d3d11.h>
+
+
+// Events are pushed from capture, render and encoder threads without locking,
+// and Unity fetches all of them once per frame with DrainEvents().
+enum class EventType
+{
+    None = 0,
+    Message = 1,
+    FrameReady = 2,
+    CursorMoved = 3,
+    CursorShapeChanged = 4,
+    StateChanged = 5,
+    TopologyChanged = 6,
+    Overflow = 7,
+    WatchRegionChanged = 8,
+};
+
+
+// The layout is shared with the Event struct in Lib.cs.
+struct Event
+{
+    EventType type;
+    int id;          // Monitor id, or -1 for events which are not bound to a monitor.
+    UINT seq;        // FrameReady, WatchRegionChanged: frame id.
+    int value;       // Message, DuplicatorState, cursor visibility, cursor shape type,
+                     // monitor count, the number of dropped events (Overflow), or region id.
+    int x;           // FrameReady: damage bounds, CursorMoved: position,
+    int y;           // CursorShapeChanged: shape size, WatchRegionChanged: changed part of the region.
+    int width;
+    int height;
+    UINT moveRectCount;
+    UINT dirtyRectCount;
+};
+
+
+class EventQueue
+{
+public:
+    // Returns false and counts the event as dropped when the queue is full.
+    static bool Push(const Event& event);
+    // Must not be called from more than one thread at the same time.
+    static int Drain(Event* buffer, int capacity);
+    static void Clear();
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+
+// Fixed set of frame resources shared between one producer and any number of consumers.
+//
+// The producer takes a free slot with BeginWrite(), fills its resource and publishes it with
+// EndWrite(), which tags the slot with a new generation. Consumers lease the latest published
+// slot with AcquireLatest(); a leased slot is never handed out for writing until every lease on
+// it has been returned, so a consumer never sees a resource that is being overwritten.
+// The latest slot is never written either, so there is always a complete frame to read.
+//
+// T is the per-slot resource (a GPU texture, a CPU buffer...). It is only touched through
+// GetResource(), so the pool itself does not depend on any graphics API.
+template <class T>
+class FramePool final
+{
+public:
+    static constexpr int kInvalidSlot = -1;
+
+    class Lease final
+    {
+    public:
+        Lease() = default;
+        ~Lease() { Release(); }
+
+        Lease(Lease&& other)
+            : pool_(other.pool_), slot_(other.slot_), generation_(other.generation_)
+        {
+            other.pool_ = nullptr;
+            other.slot_ = kInvalidSlot;
+        }
+
+        Lease& operator=(Lease&& other)
+        {
+            if (this != &other)
+            {
+                Release();
+                pool_ = other.pool_;
+                slot_ = other.slot_;
+                generation_ = other.generation_;
+                other.pool_ = nullptr;
+                other.slot_ = kInvalidSlot;
+            }
+            return *this;
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        explicit operator bool() const { return pool_ != nullptr; }
+        const T* operator->() const { return &Get(); }
+        const T& operator*() const { return Get(); }
+        const T& Get() const { return pool_->slots_[slot_].resource; }
+        int GetSlot() const { return slot_; }
+        uint64_t GetGeneration() const { return generation_; }
+
+        void Release()
+        {
+            if (pool_) pool_->Return(slot_);
+            pool_ = nullptr;
+            slot_ = kInvalidSlot;
+        }
+
+    private:
+        friend class FramePool;
+        Lease(FramePool* pool, int slot, uint64_t generation)
+            : pool_(pool), slot_(slot), generation_(generation) {}
+
+        FramePool* pool_ = nullptr;
+        int slot_ = kInvalidSlot;
+        uint64_t generation_ = 0;
+    };
+
+    explicit FramePool(int slotCount)
+        : slots_(slotCount > 2 ? slotCount : 2)
+    {
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    int GetSlotCount() const
+    {
+        return static_cast<int>(slots_.size());
+    }
+
+    // Direct access for the producer (to the slot it is writing or the latest one) and for
+    // resource (re)creation while no frame has been published.
+    T& GetResource(int slot)
+    {
+        return slots_[slot].resource;
+    }
+
+    // Returns a slot which is neither latest, leased nor being written, preferring the one
+    // published longest ago, or kInvalidSlot when consumers hold all the other slots.
+    int BeginWrite()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        int found = kInvalidSlot;
+        for (int i = 0; i < GetSlotCount(); ++i)
+        {
+            const auto& slot = slots_[i];
+            if (i == latest_ || slot.leaseCount > 0 || slot.isWriting) continue;
+            if (found == kInvalidSlot || slot.generation < slots_[found].generation)
+            {
+                found = i;
+            }
+        }
+
+        if (found == kInvalidSlot)
+        {
+            ++starvedCount_;
+            return kInvalidSlot;
+        }
+
+        slots_[found].isWriting = true;
+        return found;
+    }
+
+    // Publishes the slot as the latest frame and returns its generation.
+    uint64_t EndWrite(int slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_[slot].isWriting = false;
+        slots_[slot].generation = ++generation_;
+        latest_ = slot;
+        return generation_;
+    }
+
+    // Gives the slot back without publishing it (e.g. the copy into it failed).
+    void CancelWrite(int slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_[slot].isWriting = false;
+    }
+
+    // Leases the latest published slot; the returned lease is empty until the first EndWrite().
+    Lease AcquireLatest()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (latest_ == kInvalidSlot) return Lease();
+        ++slots_[latest_].leaseCount;
+        return Lease(this, latest_, slots_[latest_].generation);
+    }
+
+    int GetLatestSlot() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return latest_;
+    }
+
+    uint64_t GetLatestGeneration() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return generation_;
+    }
+
+    // Number of BeginWrite() calls which found no free slot.
+    uint64_t GetStarvedCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return starvedCount_;
+    }
+
+private:
+    struct Slot
+    {
+        T resource = {};
+        uint64_t generation = 0;
+        int leaseCount = 0;
+        bool isWriting = false;
+    };
+
+    void Return(int slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --slots_[slot].leaseCount;
+    }
+
+    std::vector<Slot> slots_;
+    int latest_ = kInvalidSlot;
+    uint64_t generation_ = 0;
+    uint64_t starvedCount_ = 0;
+    mutable std::mutex mutex_;
+};
+
+
+// Needed when kInvalidSlot is bound to a reference (C++14 has no inline variables).
+template <class T>
+constexpr int FramePool<T>::kInvalidSlot;
@@ -0,0 +1,449 @@
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define UDD_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "Kernels.h"
+
+
+
+namespace Kernels
+{
+
+
+namespace
+{
+
+
+// Maps a pixel (u, v) of the desktop image to (x, y) on the monitor.
+template <uint32_t Rot>
+inline void MapToMonitor(uint32_t u, uint32_t v, uint32_t monitorWidth, uint32_t monitorHeight, uint32_t& x, uint32_t& y)
+{
+    if (Rot == Rotation90)
+    {
+        x = monitorWidth - 1 - v;
+        y = u;
+    }
+    else if (Rot == Rotation180)
+    {
+        x = monitorWidth - 1 - u;
+        y = monitorHeight - 1 - v;
+    }
+    else
+    {
+        x = v;
+        y = monitorHeight - 1 - u;
+    }
+}
+
+
+template <uint32_t Rot>
+void BlitRotatedRectImpl(
+    const uint8_t* src,
+    uint32_t srcPitch,
+    uint8_t* dst,
+    uint32_t dstPitch,
+    uint32_t monitorWidth,
+    uint32_t monitorHeight,
+    int32_t left,
+    int32_t top,
+    int32_t right,
+    int32_t bottom)
+{
+    for (int32_t v = top; v < bottom; ++v)
+    {
+        const auto row = reinterpret_cast<const uint32_t*>(src + v * srcPitch);
+        for (int32_t u = left; u < right; ++u)
+        {
+            uint32_t x, y;
+            MapToMonitor<Rot>(u, v, monitorWidth, monitorHeight, x, y);
+            reinterpret_cast<uint32_t*>(dst + y * dstPitch)[x] = row[u];
+        }
+    }
+}
+
+
+inline uint32_t BgraToRgba(uint32_t bgra)
+{
+    return (bgra & 0xFF00FF00) | ((bgra >> 16) & 0xFF) | ((bgra & 0xFF) << 16);
+}
+
+
+template <uint32_t Rot>
+void CopyPixelsToRgbaImpl(
+    const uint8_t* src,
+    uint32_t srcPitch,
+    int32_t left,
+    int32_t top,
+    int32_t right,
+    int32_t bottom,
+    int32_t width,
+    int32_t height,
+    uint8_t* output)
+{
+    for (int32_t row = 0; row < height; ++row)
+    {
+        const auto out = reinterpret_cast<uint32_t*>(output) + (height - 1 - row) * width;
+        for (int32_t col = 0; col < width; ++col)
+        {
+            int32_t inCol, inRow;
+            if (Rot == Rotation90)
+            {
+                inCol = left + row;
+                inRow = bottom - 1 - col;
+            }
+            else if (Rot == Rotation180)
+            {
+                inCol = right - 1 - col;
+                inRow = bottom - 1 - row;
+            }
+            else if (Rot == Rotation270)
+            {
+                inCol = right - 1 - row;
+                inRow = top + col;
+            }
+            else
+            {
+                inCol = left + col;
+                inRow = top + row;
+            }
+            out[col] = BgraToRgba(reinterpret_cast<const uint32_t*>(src + inRow * srcPitch)[inCol]);
+        }
+    }
+}
+
+
+template <uint32_t Rot, uint32_t Type>
+void CompositeCursorImpl(
+    const uint8_t* desktop,
+    uint32_t desktopPitch,
+    const uint8_t* shape,
+    uint32_t shapePitch,
+    int32_t shapeWidth,
+    int32_t shapeHeight,
+    int32_t offsetX,
+    int32_t offsetY,
+    int32_t width,
+    int32_t height,
+    uint8_t* output)
+{
+    const auto output32 = reinterpret_cast<uint32_t*>(output);
+
+    for (int32_t y = 0; y < height; ++y)
+    {
+        const auto desktop32 = reinterpret_cast<const uint32_t*>(desktop + y * desktopPitch);
+        for (int32_t x = 0; x < width; ++x)
+        {
+            // Cursor coordinates
+            int32_t cursorX, cursorY;
+            if (Rot == Rotation90)
+            {
+                cursorX = (shapeWidth - 1) - (y + offsetY);
+                cursorY = (x + offsetX);
+            }
+            else if (Rot == Rotation180)
+            {
+                cursorX = (shapeWidth  - 1) - (x + offsetX);
+                cursorY = (shapeHeight - 1) - (y + offsetY);
+            }
+            else if (Rot == Rotation270)
+            {
+                cursorX = (y + offsetY);
+                cursorY = (shapeHeight - 1) - (x + offsetX);
+            }
+            else
+            {
+                cursorX = (x + offsetX);
+                cursorY = (y + offsetY);
+            }
+
+            const auto d = desktop32[x];
+            auto& out = output32[y * width + x];
+
+            if (Type == PointerShapeMonochrome)
+            {
+                // The AND mask is followed by the XOR mask, each 1 bit per pixel.
+                const uint8_t mask = 0x80 >> (cursorX % 8);
+                const auto andMask = shape[cursorX / 8 + cursorY * shapePitch] & mask;
+                const auto xorMask = shape[cursorX / 8 + (cursorY + shapeHeight) * shapePitch] & mask;
+                const uint32_t andMask32 = andMask ? 0xFFFFFFFF : 0x00000000;
+                const uint32_t xorMask32 = xorMask ? 0xFFFFFFFF : 0x00000000;
+                out = (d & andMask32) ^ xorMask32;
+            }
+            else if (Type == PointerShapeMaskedColor)
+            {
+                const auto c = reinterpret_cast<const uint32_t*>(shape + cursorY * shapePitch)[cursorX];
+                out = ((c & 0xFF000000) ? (d ^ c) : c) | 0xFF000000;
+            }
+            else
+            {
+                const auto c = reinterpret_cast<const uint32_t*>(shape + cursorY * shapePitch)[cursorX];
+                const uint32_t a0 = c >> 24;
+                const uint32_t a1 = 255 - a0;
+                const uint32_t b = (( c        & 0xFF) * a0 + ( d        & 0xFF) * a1) / 255;
+                const uint32_t g = (((c >> 8)  & 0xFF) * a0 + ((d >> 8)  & 0xFF) * a1) / 255;
+                const uint32_t r = (((c >> 16) & 0xFF) * a0 + ((d >> 16) & 0xFF) * a1) / 255;
+                out = (d & 0xFF000000) | (r << 16) | (g << 8) | b;
+            }
+        }
+    }
+}
+
+
+template <uint32_t Rot>
+bool CompositeCursorRot(
+    uint32_t shapeType,
+    const uint8_t* desktop,
+    uint32_t desktopPitch,
+    const uint8_t* shape,
+    uint32_t shapePitch,
+    int32_t shapeWidth,
+    int32_t shapeHeight,
+    int32_t offsetX,
+    int32_t offsetY,
+    int32_t width,
+    int32_t height,
+    uint8_t* output)
+{
+    switch (shapeType)
+    {
+        case PointerShapeMonochrome:
+            CompositeCursorImpl<Rot, PointerShapeMonochrome>(
+                desktop, desktopPitch, shape, shapePitch, shapeWidth, shapeHeight, offsetX, offsetY, width, height, output);
+            return true;
+        case PointerShapeColor:
+            CompositeCursorImpl<Rot, PointerShapeColor>(
+                desktop, desktopPitch, shape, shapePitch, shapeWidth, shapeHeight, offsetX, offsetY, width, height, output);
+            return true;
+        case PointerShapeMaskedColor:
+            CompositeCursorImpl<Rot, PointerShapeMaskedColor>(
+                desktop, desktopPitch, shape, shapePitch, shapeWidth, shapeHeight, offsetX, offsetY, width, height, output);
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+}
+
+
+
+void BlitRotatedRect(
+    const uint8_t* src,
+    uint32_t srcPitch,
+    uint8_t* dst,
+    uint32_t dstPitch,
+    uint32_t rotation,
+    uint32_t monitorWidth,
+    uint32_t monitorHeight,
+    int32_t left,
+    int32_t top,
+    int32_t right,
+    int32_t bottom)
+{
+    switch (rotation)
+    {
+        case Rotation90:
+            BlitRotatedRectImpl<Rotation90>(src, srcPitch, dst, dstPitch, monitorWidth, monitorHeight, left, top, right, bottom);
+            break;
+        case Rotation180:
+            BlitRotatedRectImpl<Rotation180>(src, srcPitch, dst, dstPitch, monitorWidth, monitorHeight, left, top, right, bottom);
+            break;
+        case Rotation270:
+            BlitRotatedRectImpl<Rotation270>(src, srcPitch, dst, dstPitch, monitorWidth, monitorHeight, left, top, right, bottom);
+            break;
+        default:
+            for (int32_t v = top; v < bottom; ++v)
+            {
+                std::memcpy(
+                    dst + v * dstPitch + left * sizeof(uint32_t),
+                    src + v * srcPitch + left * sizeof(uint32_t),
+                    (right - left) * sizeof(uint32_t));
+            }
+            break;
+    }
+}
+
+
+void CopyPixelsToRgba(
+    const uint8_t* src,
+    uint32_t srcPitch,
+    uint32_t rotation,
+    int32_t left,
+    int32_t top,
+    int32_t right,
+    int32_t bottom,
+    int32_t width,
+    int32_t height,
+    uint8_t* output)
+{
+    switch (rotation)
+    {
+        case Rotation90:
+            CopyPixelsToRgbaImpl<Rotation90>(src, srcPitch, left, top, right, bottom, width, height, output);
+            break;
+        case Rotation180:
+            CopyPixelsToRgbaImpl<Rotation180>(src, srcPitch, left, top, right, bottom, width, height, output);
+            break;
+        case Rotation270:
+            CopyPixelsToRgbaImpl<Rotation270>(src, srcPitch, left, top, right, bottom, width, height, output);
+            break;
+        default:
+            CopyPixelsToRgbaImpl<RotationIdentity>(src, srcPitch, left, top, right, bottom, width, height, output);
+            break;
+    }
+}
+
+
+bool CompositeCursor(
+    uint32_t shapeType,
+    uint32_t rotation,
+    const uint8_t* desktop,
+    uint32_t desktopPitch,
+    const uint8_t* shape,
+    uint32_t shapePitch,
+    int32_t shapeWidth,
+    int32_t shapeHeight,
+    int32_t offsetX,
+    int32_t offsetY,
+    int32_t width,
+    int32_t height,
+    uint8_t* output)
+{
+    switch (rotation)
+    {
+        case Rotation90:
+            return CompositeCursorRot<Rotation90>(
+                shapeType, desktop, desktopPitch, shape, shapePitch, shapeWidth, shapeHeight, offsetX, offsetY, width, height, output);
+        case Rotation180:
+            return CompositeCursorRot<Rotation180>(
+                shapeType, desktop, desktopPitch, shape, shapePitch, shapeWidth, shapeHeight, offsetX, offsetY, width, height, output);
+        case Rotation270:
+            return CompositeCursorRot<Rotation270>(
+                shapeType, desktop, desktopPitch, shape, shapePitch, shapeWidth, shapeHeight, offsetX, offsetY, width, height, output);
+        default:
+            return CompositeCursorRot<RotationIdentity>(
+                shapeType, desktop, desktopPitch, shape, shapePitch, shapeWidth, shapeHeight, offsetX, offsetY, width, height, output);
+    }
+}
+
+
+
+
+void ComputeLuma(
+    const uint8_t* src,
+    uint32_t count,
+    uint8_t* output)
+{
+    uint32_t i = 0;
+
+#ifdef UDD_KERNELS_SSE2
+    // 4 pixels per iteration: the channels are widened to 16 bits, multiplied and summed in pairs
+    // with pmaddwd, and the pairs of each pixel are added after splitting them into even and odd lanes.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(19, 183, 54, 0, 19, 183, 54, 0);
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+        const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+        const __m128 loPs = _mm_castsi128_ps(lo);
+        const __m128 hiPs = _mm_castsi128_ps(hi);
+        const __m128i bg = _mm_castps_si128(_mm_shuffle_ps(loPs, hiPs, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i ra = _mm_castps_si128(_mm_shuffle_ps(loPs, hiPs, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m128i luma = _mm_srli_epi32(_mm_add_epi32(bg, ra), 8);
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(luma, zero), zero);
+        const int value = _mm_cvtsi128_si32(packed);
+        std::memcpy(output + i, &value, 4);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        const auto pixel = src + i * 4;
+        output[i] = static_cast<uint8_t>((pixel[0] * 19 + pixel[1] * 183 + pixel[2] * 54) >> 8);
+    }
+}
+
+
+uint32_t DotProduct(
+    const uint8_t* a,
+    const uint8_t* b,
+    uint32_t count)
+{
+    uint32_t i = 0;
+    uint32_t sum = 0;
+
+#ifdef UDD_KERNELS_SSE2
+    // 16 values per iteration: widened to 16 bits and multiplied and summed in pairs with pmaddwd.
+    // Each lane gets a quarter of the products, so it stays below 2^31 for any valid count.
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sums = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)));
+    }
+    // Template rows of coarse levels are short, so 8 more values are taken in a half register.
+    if (i + 8 <= count)
+    {
+        const __m128i va = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i));
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+        i += 8;
+    }
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = static_cast<uint32_t>(_mm_cvtsi128_si32(sums));
+#endif
+
+    for (; i < count; ++i)
+    {
+        sum += static_cast<uint32_t>(a[i]) * b[i];
+    }
+
+    return sum;
+}
+
+
+uint32_t SumOfAbsoluteDifferences(
+    const uint8_t* a,
+    const uint8_t* b,
+    uint32_t count)
+{
+    uint32_t i = 0;
+    uint32_t sum = 0;
+
+#ifdef UDD_KERNELS_SSE2
+    __m128i sums = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(va, vb));
+    }
+    if (i + 8 <= count)
+    {
+        const __m128i va = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i));
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(va, vb));
+        i += 8;
+    }
+    sum = static_cast<uint32_t>(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+#endif
+
+    for (; i < count; ++i)
+    {
+        sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+
+    return sum;
+}
+
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+
+
+// CPU pixel kernels of the capture paths.
+// They depend on no Windows / D3D header so that they can be built and measured on any platform.
+// Rotations and pointer shape types take the values of DXGI_MODE_ROTATION and
+// DXGI_OUTDUPL_POINTER_SHAPE_TYPE. All images are 32-bit BGRA unless noted.
+namespace Kernels
+{
+    enum Rotation : uint32_t
+    {
+        RotationUnspecified = 0,
+        RotationIdentity = 1,
+        Rotation90 = 2,
+        Rotation180 = 3,
+        Rotation270 = 4,
+    };
+
+    enum PointerShapeType : uint32_t
+    {
+        PointerShapeMonochrome = 1,
+        PointerShapeColor = 2,
+        PointerShapeMaskedColor = 4,
+    };
+
+    // Copies the rect [left, right) x [top, bottom) of a desktop image (texture coordinates)
+    // to where it appears on the monitor. dst points to the top-left pixel of the monitor.
+    void BlitRotatedRect(
+        const uint8_t* src,
+        uint32_t srcPitch,
+        uint8_t* dst,
+        uint32_t dstPitch,
+        uint32_t rotation,
+        uint32_t monitorWidth,
+        uint32_t monitorHeight,
+        int32_t left,
+        int32_t top,
+        int32_t right,
+        int32_t bottom);
+
+    // Reads the region (left, top) ~ (right, bottom) (inclusive, desktop image coordinates)
+    // as a bottom-up RGBA32 image of width x height in monitor orientation (Monitor::GetPixels()).
+    void CopyPixelsToRgba(
+        const uint8_t* src,
+        uint32_t srcPitch,
+        uint32_t rotation,
+        int32_t left,
+        int32_t top,
+        int32_t right,
+        int32_t bottom,
+        int32_t width,
+        int32_t height,
+        uint8_t* output);
+
+    // Blends a pointer shape onto the desktop image under it (Cursor::UpdateTexture()).
+    // desktop is width x height in desktop image coordinates and output is packed with the
+    // same size. (offsetX, offsetY) is the position of the desktop image in the rotated shape.
+    // Returns false for an unknown shape type.
+    bool CompositeCursor(
+        uint32_t shapeType,
+        uint32_t rotation,
+        const uint8_t* desktop,
+        uint32_t desktopPitch,
+        const uint8_t* shape,
+        uint32_t shapePitch,
+        int32_t shapeWidth,
+        int32_t shapeHeight,
+        int32_t offsetX,
+        int32_t offsetY,
+        int32_t width,
+        int32_t height,
+        uint8_t* output);
+
+    // Converts count BGRA pixels to 8-bit luma with the BT.709 weights (R * 54 + G * 183 + B * 19) / 256.
+    // SSE2 is used where available and the result is the same as the scalar path.
+    void ComputeLuma(
+        const uint8_t* src,
+        uint32_t count,
+        uint8_t* output);
+
+    // Sum of a[i] * b[i] over count 8-bit values (TemplateMatcher). count must be at most 66051 to fit.
+    uint32_t DotProduct(
+        const uint8_t* a,
+        const uint8_t* b,
+        uint32_t count);
+
+    // Sum of |a[i] - b[i]| over count 8-bit values (TemplateMatcher).
+    uint32_t SumOfAbsoluteDifferences(
+        const uint8_t* a,
+        const uint8_t* b,
+        uint32_t count);
+}
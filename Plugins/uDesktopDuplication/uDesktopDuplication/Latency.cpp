@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstring>
+
+#include "Latency.h"
+
+
+
+namespace
+{
+    constexpr UINT kProbeMarker = 0xFFFF00FF; // magenta
+    constexpr UINT kProbeOne = 0xFFFFFFFF;
+    constexpr UINT kProbeZero = 0xFF000000;
+}
+
+
+
+INT64 GetLatencyTimestamp()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+
+double LatencyTicksToMicroseconds(INT64 ticks)
+{
+    static const auto frequency = []
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return static_cast<double>(frequency.QuadPart);
+    }();
+    return ticks * 1000000.0 / frequency;
+}
+
+
+INT64 GetLatencyTimestampMicroseconds()
+{
+    return static_cast<INT64>(LatencyTicksToMicroseconds(GetLatencyTimestamp()));
+}
+
+
+
+UINT LatencyHistogram::GetBucketIndex(UINT64 us)
+{
+    // 0-15 us are linear, then 4 buckets per power of two.
+    if (us < 16) return static_cast<UINT>(us);
+
+    UINT exponent = 4;
+    while ((us >> (exponent + 1)) != 0) ++exponent;
+    const auto subBucket = static_cast<UINT>((us >> (exponent - 2)) & 3);
+    return std::min(16 + (exponent - 4) * 4 + subBucket, kBucketCount - 1);
+}
+
+
+double LatencyHistogram::GetBucketValue(UINT index)
+{
+    if (index < 16) return index;
+
+    // The middle of the bucket
+    const auto exponent = (index - 16) / 4 + 4;
+    const auto subBucket = (index - 16) % 4;
+    const auto width = static_cast<double>(1ull << (exponent - 2));
+    return (4 + subBucket) * width + width / 2;
+}
+
+
+void LatencyHistogram::Add(INT64 fromTicks, INT64 toTicks)
+{
+    if (fromTicks == 0 || toTicks == 0 || toTicks < fromTicks) return;
+
+    const auto us = static_cast<UINT64>(LatencyTicksToMicroseconds(toTicks - fromTicks));
+    ++buckets_[GetBucketIndex(us)];
+    ++count_;
+    sum_ += us;
+
+    auto max = max_.load();
+    while (us > max && !max_.compare_exchange_weak(max, us));
+}
+
+
+LatencyStats LatencyHistogram::GetStats() const
+{
+    LatencyStats stats = {};
+
+    UINT counts[kBucketCount];
+    UINT total = 0;
+    for (UINT i = 0; i < kBucketCount; ++i)
+    {
+        counts[i] = buckets_[i];
+        total += counts[i];
+    }
+    if (total == 0) return stats;
+
+    const auto getPercentile = [&](double ratio)
+    {
+        const auto target = static_cast<UINT>(total * ratio);
+        UINT accumulated = 0;
+        for (UINT i = 0; i < kBucketCount; ++i)
+        {
+            accumulated += counts[i];
+            if (accumulated > target) return static_cast<float>(GetBucketValue(i));
+        }
+        return static_cast<float>(GetBucketValue(kBucketCount - 1));
+    };
+
+    stats.count = total;
+    stats.mean = static_cast<float>(static_cast<double>(sum_) / std::max<UINT>(count_, 1));
+    stats.p50 = getPercentile(0.5);
+    stats.p90 = getPercentile(0.9);
+    stats.p99 = getPercentile(0.99);
+    stats.max = static_cast<float>(max_);
+
+    return stats;
+}
+
+
+void LatencyHistogram::Reset()
+{
+    for (auto& bucket : buckets_)
+    {
+        bucket = 0;
+    }
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+}
+
+
+
+void LatencyProbe::Draw(BYTE* pixels, INT64 time)
+{
+    const auto counter = nextCounter_++;
+    const auto slot = counter % kSlotCount;
+    slotCounters_[slot] = 0;
+    slotTimes_[slot] = time;
+    slotCounters_[slot] = counter;
+
+    UINT probe[kWidth];
+    probe[0] = kProbeMarker;
+    for (UINT i = 0; i < 32; ++i)
+    {
+        probe[1 + i] = ((counter >> (31 - i)) & 1) ? kProbeOne : kProbeZero;
+    }
+    probe[kWidth - 1] = kProbeMarker;
+    std::memcpy(pixels, probe, sizeof(probe));
+}
+
+
+INT64 LatencyProbe::Find(const BYTE* pixels) const
+{
+    UINT probe[kWidth];
+    std::memcpy(probe, pixels, sizeof(probe));
+    if (probe[0] != kProbeMarker || probe[kWidth - 1] != kProbeMarker) return 0;
+
+    UINT counter = 0;
+    for (UINT i = 0; i < 32; ++i)
+    {
+        counter = (counter << 1) | (((probe[1 + i] >> 8) & 0xFF) > 0x7F ? 1 : 0);
+    }
+
+    // Draw() may be rewriting the slot, so the counter is checked on both sides of the time.
+    const auto slot = counter % kSlotCount;
+    if (slotCounters_[slot] != counter) return 0;
+    const auto time = slotTimes_[slot].load();
+    return slotCounters_[slot] == counter ? time : 0;
+}
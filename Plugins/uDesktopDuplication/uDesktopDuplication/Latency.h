@@ -0,0 +1,92 @@
+#pragma once
+
+#include <d3d11.h>
+#include <atomic>
+
+
+// Points of the capture pipeline of a frame in QueryPerformanceCounter ticks, which is also the
+// timebase of DXGI_OUTDUPL_FRAME_INFO::LastPresentTime. 0 means the point was not recorded.
+struct FrameTimestamps
+{
+    INT64 present = 0;   // the OS presented the frame (0 when only the pointer changed)
+    INT64 acquired = 0;  // AcquireNextFrame() returned (or a replayed frame was due)
+    INT64 copied = 0;    // the copy to the shared texture was issued
+    INT64 published = 0; // the frame became visible to Monitor::Render()
+    INT64 probe = 0;     // the probe counter was drawn into the frame
+};
+
+
+enum class LatencyStage
+{
+    PresentToAcquire = 0,
+    AcquireToCopy = 1,
+    CopyToPublish = 2,
+    PublishToRender = 3,
+    RenderToReadback = 4,
+    PresentToRender = 5,
+    ProbeToReadback = 6,
+    FrameAge = 7,        // acquire to every Render() which uses the frame, reused frames included
+    Count,
+};
+
+
+// All durations are in microseconds.
+struct LatencyStats
+{
+    UINT count;
+    float mean;
+    float p50;
+    float p90;
+    float p99;
+    float max;
+};
+
+
+INT64 GetLatencyTimestamp();
+double LatencyTicksToMicroseconds(INT64 ticks);
+INT64 GetLatencyTimestampMicroseconds();
+
+
+// Log-linear histogram (4 sub-buckets per power of two) which can be read while being written.
+class LatencyHistogram final
+{
+public:
+    void Add(INT64 fromTicks, INT64 toTicks);
+    LatencyStats GetStats() const;
+    void Reset();
+
+private:
+    static constexpr UINT kBucketCount = 128;
+    static UINT GetBucketIndex(UINT64 us);
+    static double GetBucketValue(UINT index);
+
+    std::atomic<UINT> buckets_[kBucketCount] = {};
+    std::atomic<UINT> count_ = { 0 };
+    std::atomic<UINT64> sum_ = { 0 };
+    std::atomic<UINT64> max_ = { 0 };
+};
+
+
+// Draws a frame counter into the first pixels of replayed frames and finds it again in the CPU
+// readback, which measures the whole path from the source to the readable buffer.
+class LatencyProbe final
+{
+public:
+    static constexpr UINT kWidth = 34;
+
+    void SetEnabled(bool enabled) { isEnabled_ = enabled; }
+    bool IsEnabled() const { return isEnabled_; }
+
+    // Fills kWidth BGRA pixels with the next counter and remembers when it was drawn.
+    void Draw(BYTE* pixels, INT64 time);
+
+    // Returns the time the counter in the pixels was drawn, or 0 if there is none.
+    INT64 Find(const BYTE* pixels) const;
+
+private:
+    static constexpr UINT kSlotCount = 64;
+    std::atomic<bool> isEnabled_ = { false };
+    UINT nextCounter_ = 1;
+    std::atomic<UINT> slotCounters_[kSlotCount] = {};
+    std::atomic<INT64> slotTimes_[kSlotCount] = {};
+};
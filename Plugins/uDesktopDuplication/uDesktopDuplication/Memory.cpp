@@ -0,0 +1,104 @@
+#include "Memory.h"
+
+
+
+std::atomic<INT64> MemoryBudget::budget_ { 0 };
+std::atomic<int> MemoryBudget::readbackIdleFrameCount_ { 0 };
+
+
+
+MemoryAccount::MemoryAccount()
+{
+    for (auto& bytes : bytes_)
+    {
+        bytes.store(0);
+    }
+}
+
+
+void MemoryAccount::Set(MemoryCategory category, INT64 bytes)
+{
+    bytes_[static_cast<int>(category)].store(bytes, std::memory_order_relaxed);
+}
+
+
+INT64 MemoryAccount::Get(MemoryCategory category) const
+{
+    return bytes_[static_cast<int>(category)].load(std::memory_order_relaxed);
+}
+
+
+INT64 MemoryAccount::GetTotal() const
+{
+    INT64 total = 0;
+    for (const auto& bytes : bytes_)
+    {
+        total += bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+
+void MemoryAccount::AddEviction(INT64 bytes)
+{
+    evictionCount_.fetch_add(1, std::memory_order_relaxed);
+    evictedBytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+
+void MemoryAccount::AddTo(MemoryStats* stats) const
+{
+    for (int i = 0; i < static_cast<int>(MemoryCategory::Count); ++i)
+    {
+        const auto bytes = bytes_[i].load(std::memory_order_relaxed);
+        stats->bytes[i] += bytes;
+        stats->totalBytes += bytes;
+    }
+    stats->evictionCount += evictionCount_.load(std::memory_order_relaxed);
+    stats->evictedBytes += evictedBytes_.load(std::memory_order_relaxed);
+}
+
+
+
+void MemoryBudget::SetBudget(INT64 bytes)
+{
+    budget_ = bytes > 0 ? bytes : 0;
+}
+
+
+INT64 MemoryBudget::GetBudget()
+{
+    return budget_;
+}
+
+
+void MemoryBudget::SetReadbackIdleFrameCount(int count)
+{
+    readbackIdleFrameCount_ = count > 0 ? count : 0;
+}
+
+
+int MemoryBudget::GetReadbackIdleFrameCount()
+{
+    return readbackIdleFrameCount_;
+}
+
+
+
+INT64 GetTextureByteSize(const D3D11_TEXTURE2D_DESC& desc)
+{
+    INT64 bytesPerPixel = 4;
+    switch (desc.Format)
+    {
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+            bytesPerPixel = 8;
+            break;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            bytesPerPixel = 16;
+            break;
+        default:
+            break;
+    }
+    return static_cast<INT64>(desc.Width) * desc.Height * desc.ArraySize * bytesPerPixel;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <d3d11.h>
+#include <atomic>
+
+
+enum class MemoryCategory
+{
+    SharedTexture = 0,   // frame pool textures on the capture device
+    ReadbackTexture = 1, // staging texture of the CPU copy
+    ReadbackBuffer = 2,  // CPU copy kept for GetPixels()
+    Metadata = 3,        // move and dirty rects
+    Cursor = 4,          // pointer shape and its BGRA image
+    RegionStats = 5,     // tables and luma plane of the region statistics
+    CursorRegion = 6,    // staging texture and CPU copy of the region around the cursor
+    ReplayRing = 7,      // staging texture and encoded frames of the instant replay ring
+    Count,
+};
+
+
+struct MemoryStats
+{
+    INT64 bytes[static_cast<int>(MemoryCategory::Count)];
+    INT64 totalBytes;
+    INT64 evictionCount;
+    INT64 evictedBytes;
+};
+
+
+// Bytes held by one owner (a monitor or the cursor) per category and the evictions done on it.
+// Owners set their sizes from their own threads and anyone can read them.
+class MemoryAccount final
+{
+public:
+    MemoryAccount();
+    void Set(MemoryCategory category, INT64 bytes);
+    INT64 Get(MemoryCategory category) const;
+    INT64 GetTotal() const;
+    void AddEviction(INT64 bytes);
+    void AddTo(MemoryStats* stats) const;
+
+private:
+    std::atomic<INT64> bytes_[static_cast<int>(MemoryCategory::Count)];
+    std::atomic<INT64> evictionCount_ { 0 };
+    std::atomic<INT64> evictedBytes_ { 0 };
+};
+
+
+// Global limits checked by MonitorManager::Update().
+// Budget 0 means no limit, and idle frame count 0 keeps unused readback resources forever.
+// Both are off by default; the CPU copy of a monitor with UseGetPixels(true) is never released as idle.
+class MemoryBudget final
+{
+public:
+    static void SetBudget(INT64 bytes);
+    static INT64 GetBudget();
+    static void SetReadbackIdleFrameCount(int count);
+    static int GetReadbackIdleFrameCount();
+
+private:
+    static std::atomic<INT64> budget_;
+    static std::atomic<int> readbackIdleFrameCount_;
+};
+
+
+INT64 GetTextureByteSize(const D3D11_TEXTURE2D_DESC& desc);
@@ -2,12 +2,19 @@
 #include <dxgi1_6.h>
 #include <ShellScalingAPI.h>
 #include <queue>
+#include <algorithm>
 #include "Monitor.h"
 #include "Duplicator.h"
 #include "Debug.h"
 #include "Cursor.h"
 #include "MonitorManager.h"
 #include "Device.h"
+#include "SharedFrameRing.h"
+#include "StreamServer.h"
+#include "ReplayRing.h"
+#include "Kernels.h"
+#include "Crop.h"
+#include "Event.h"
 
 using namespace Microsoft::WRL;
 
@@ -37,14 +44,14 @@ void Monitor::Initialize(
 
 	if (FAILED(output->GetDesc(&outputDesc_)))
 	{
-		Debug::Error("Monitor::Initialize() => IDXGIOutput::GetDesc() failed.");
+		UDD_ERROR("Monitor::Initialize() => IDXGIOutput::GetDesc() failed.");
 		return;
 	}
 
 	monitorInfo_.cbSize = sizeof(MONITORINFOEX);
 	if (!GetMonitorInfo(outputDesc_.Monitor, &monitorInfo_))
 	{
-		Debug::Error("Monitor::Initialize() => GetMonitorInfo() failed.");
+		UDD_ERROR("Monitor::Initialize() => GetMonitorInfo() failed.");
 		return;
 	}
 	else
@@ -56,7 +63,7 @@ void Monitor::Initialize(
 
 	if (FAILED(GetDpiForMonitor(outputDesc_.Monitor, MDT_RAW_DPI, &dpiX_, &dpiY_)))
 	{
-		Debug::Error("Monitor::Initialize() => GetDpiForMonitor() failed.");
+		UDD_ERROR("Monitor::Initialize() => GetDpiForMonitor() failed.");
 		// DPI is set as -1, so the application has to use the appropriate value.
 	}
 
@@ -71,11 +78,11 @@ void Monitor::Initialize(
     }
 
     const auto rot = outputDesc_.Rotation;
-    Debug::Log("Monitor::Initialized() =>");
-    Debug::Log("    ID    : ", id_);
-    Debug::Log("    Size  : (", width_, ", ", height_, ")");
-    Debug::Log("    DPI   : (", dpiX_, ", ", dpiY_, ")");
-    Debug::Log("    Rot   : ",
+    UDD_LOG("Monitor::Initialized() =>");
+    UDD_LOG("    ID    : ", id_);
+    UDD_LOG("    Size  : (", width_, ", ", height_, ")");
+    UDD_LOG("    DPI   : (", dpiX_, ", ", dpiY_, ")");
+    UDD_LOG("    Rot   : ",
         rot == DXGI_MODE_ROTATION_IDENTITY ? "Landscape" :
         rot == DXGI_MODE_ROTATION_ROTATE90 ? "Portrait" :
         rot == DXGI_MODE_ROTATION_ROTATE180 ? "Landscape (flipped)" :
@@ -98,49 +105,77 @@ void Monitor::Render()
 {
     UDD_FUNCTION_SCOPE_TIMER
 
-    const auto& frame = duplicator_->GetLastFrame();
+    // The capture thread does not write into the leased slot until the lease is returned.
+    const auto frame = duplicator_->AcquireLastFrame();
 
-    if (frame.id == lastFrameId_) return;
-    lastFrameId_ = frame.id;
+    // Every call counts for the render cadence and the frame age, even when the frame is reused.
+    const auto renderTime = GetLatencyTimestamp();
+    phaseLock_.AddRenderTime(static_cast<INT64>(LatencyTicksToMicroseconds(renderTime)));
+    if (!frame) return;
+
+    const auto acquiredTime = frame->timestamps.acquired;
+    latencyHistograms_[static_cast<int>(LatencyStage::FrameAge)].Add(acquiredTime, renderTime);
+    if (acquiredTime != 0 && renderTime >= acquiredTime)
+    {
+        frameAgeMs_ = static_cast<float>(LatencyTicksToMicroseconds(renderTime - acquiredTime) / 1000.0);
+    }
+
+    const auto cursorSeq = GetMonitorManager()->GetCursor()->GetSequence();
+
+    if (frame->id == lastFrameId_)
+    {
+        // Pointer-only updates do not publish new frames (see Duplicator::Duplicate()),
+        // so only the cursor is redrawn and the CPU readback is skipped.
+        // The region around the cursor follows it though, which is the point of it.
+        if (cursorSeq != lastCursorSeq_)
+        {
+            lastCursorSeq_ = cursorSeq;
+            RenderCursor(frame.GetSlot(), frame->textureHandle);
+            CopyCursorRegion();
+        }
+        return;
+    }
+    lastFrameId_ = frame->id;
+    lastCursorSeq_ = cursorSeq;
 
     if (unityTexture_ == nullptr) 
     {
-        Debug::Error("Monitor::Render() => Target texture has not been set yet.");
+        UDD_ERROR("Monitor::Render() => Target texture has not been set yet.");
         return;
     }
 
-    if (!frame.texture)
+    if (!frame->texture)
     {
-        Debug::Error("Monitor::Render() => frame doesn't have texture.");
+        UDD_ERROR("Monitor::Render() => frame doesn't have texture.");
         return;
     }
 
     D3D11_TEXTURE2D_DESC srcDesc, dstDesc;
-    frame.texture->GetDesc(&srcDesc);
+    frame->texture->GetDesc(&srcDesc);
     unityTexture_->GetDesc(&dstDesc);
     if (srcDesc.Width  != dstDesc.Width ||
         srcDesc.Height != dstDesc.Height)
     {
-        Debug::Error("Monitor::Render() => Texture sizes are defferent.");
-        Debug::Error("    Source : (", srcDesc.Width, ", ", srcDesc.Height, ")");
-        Debug::Error("    Dest   : (", dstDesc.Width, ", ", dstDesc.Height, ")");
+        // Right after the crop is changed, the sizes differ until the next frame is captured.
+        if (frame->isCropped || GetCropRect(nullptr))
+        {
+            lastFrameId_ = -1;
+            return;
+        }
+        UDD_ERROR("Monitor::Render() => Texture sizes are defferent.");
+        UDD_ERROR("    Source : (", srcDesc.Width, ", ", srcDesc.Height, ")");
+        UDD_ERROR("    Dest   : (", dstDesc.Width, ", ", dstDesc.Height, ")");
         return;
     }
     else
     {
-        ComPtr<ID3D11Texture2D> desktopTexture;
-        if (FAILED(GetUnityDevice()->OpenSharedResource(
-            frame.textureHandle,
-            __uuidof(ID3D11Texture2D),
-            &desktopTexture)))
-        {
-            Debug::Error("Monitor::Render() => Failed to open shared resource.");
-            return;
-        }
+        const auto desktopTexture = OpenDesktopTexture(frame.GetSlot(), frame->textureHandle);
+        if (!desktopTexture) return;
 
         ComPtr<ID3D11DeviceContext> context;
         GetUnityDevice()->GetImmediateContext(&context);
         context->CopyResource(unityTexture_, desktopTexture.Get());
+        drawnCursorArea_ = {};
 
         auto& manager = GetMonitorManager();
         if (id_ == manager->GetCursorMonitorId())
@@ -150,20 +185,137 @@ void Monitor::Render()
                 if (cursor->IsVisible())
                 {
                     cursor->Draw(unityTexture_);
+                    drawnCursorArea_ = cursor->GetCapturedImageArea();
                 }
             }
         }
     }
 
-	if (UseGetPixels())
-	{
-		CopyTextureFromGpuToCpu(unityTexture_);
-	}
+    // Only counted once the frame is drawn, since a frame skipped above (e.g. for a crop size
+    // mismatch) is rendered again later. All timestamps are QueryPerformanceCounter ticks,
+    // the same timebase as LastPresentTime.
+    const auto& timestamps = frame->timestamps;
+    lastRenderTime_ = renderTime;
+    latencyHistograms_[static_cast<int>(LatencyStage::PresentToAcquire)].Add(timestamps.present, timestamps.acquired);
+    latencyHistograms_[static_cast<int>(LatencyStage::AcquireToCopy)].Add(timestamps.acquired, timestamps.copied);
+    latencyHistograms_[static_cast<int>(LatencyStage::CopyToPublish)].Add(timestamps.copied, timestamps.published);
+    latencyHistograms_[static_cast<int>(LatencyStage::PublishToRender)].Add(timestamps.published, lastRenderTime_);
+    latencyHistograms_[static_cast<int>(LatencyStage::PresentToRender)].Add(timestamps.present, lastRenderTime_);
+
+    // The rects are also kept with the GetPixels() buffer for FindTemplate().
+    if (HasCpuFrameConsumers() || UseGetPixels())
+    {
+        // Pixels around the cursor change without being reported as dirty, so the areas where
+        // it was drawn last time and this time are passed as dirty too.
+        cpuFrameDirtyRects_.clear();
+        const auto& metaData = frame->metaData;
+        const auto dirtyRects = metaData.buffer.As<RECT>(metaData.moveRectSize);
+        const auto dirtyRectCount = metaData.dirtyRectSize / sizeof(RECT);
+        cpuFrameDirtyRects_.assign(dirtyRects, dirtyRects + dirtyRectCount);
+
+        D3D11_BOX cursorArea = {};
+        auto& manager = GetMonitorManager();
+        if (id_ == manager->GetCursorMonitorId())
+        {
+            if (auto cursor = manager->GetCursor())
+            {
+                if (cursor->IsVisible()) cursorArea = cursor->GetCapturedImageArea();
+            }
+        }
+        for (const auto& box : { lastCursorArea_, cursorArea })
+        {
+            if (box.right <= box.left || box.bottom <= box.top) continue;
+            cpuFrameDirtyRects_.push_back({
+                static_cast<LONG>(box.left),
+                static_cast<LONG>(box.top),
+                static_cast<LONG>(box.right),
+                static_cast<LONG>(box.bottom) });
+        }
+        lastCursorArea_ = cursorArea;
+
+        CpuFrame cpuFrame = {};
+        cpuFrame.id = frame->id;
+        cpuFrame.presentTime = frame->info.LastPresentTime;
+        cpuFrame.width = srcDesc.Width;
+        cpuFrame.height = srcDesc.Height;
+        cpuFrame.moveRects = metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>();
+        cpuFrame.moveRectCount = metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+        cpuFrame.dirtyRects = cpuFrameDirtyRects_.data();
+        cpuFrame.dirtyRectCount = static_cast<UINT>(cpuFrameDirtyRects_.size());
+        CopyTextureFromGpuToCpu(unityTexture_, &cpuFrame);
+    }
+
+    CopyCursorRegion();
 
 	hasBeenUpdated_ = true;
 }
 
 
+void Monitor::RenderCursor(int slot, HANDLE desktopTextureHandle)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    auto& manager = GetMonitorManager();
+    const auto cursor = manager->GetCursor();
+    const bool shouldDraw = cursor && cursor->IsVisible() && id_ == manager->GetCursorMonitorId();
+    const bool hasDrawn = drawnCursorArea_.right > drawnCursorArea_.left;
+    if (!unityTexture_ || !desktopTextureHandle || (!shouldDraw && !hasDrawn)) return;
+
+    // The desktop image under the cursor drawn last time is restored from the shared texture.
+    if (hasDrawn)
+    {
+        const auto desktopTexture = OpenDesktopTexture(slot, desktopTextureHandle);
+        if (!desktopTexture) return;
+
+        ComPtr<ID3D11DeviceContext> context;
+        GetUnityDevice()->GetImmediateContext(&context);
+        context->CopySubresourceRegion(
+            unityTexture_, 0,
+            drawnCursorArea_.left, drawnCursorArea_.top, 0,
+            desktopTexture.Get(), 0,
+            &drawnCursorArea_);
+        drawnCursorArea_ = {};
+    }
+
+    if (shouldDraw)
+    {
+        cursor->Draw(unityTexture_);
+        drawnCursorArea_ = cursor->GetCapturedImageArea();
+    }
+}
+
+
+ComPtr<ID3D11Texture2D> Monitor::OpenDesktopTexture(int slot, HANDLE desktopTextureHandle)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (slot < 0) return nullptr;
+    if (slot >= static_cast<int>(openedTextures_.size()))
+    {
+        openedTextures_.resize(slot + 1);
+    }
+
+    auto& opened = openedTextures_[slot];
+    if (opened.texture && opened.handle == desktopTextureHandle)
+    {
+        return opened.texture;
+    }
+
+    opened = OpenedTexture();
+    if (FAILED(GetUnityDevice()->OpenSharedResource(
+        desktopTextureHandle,
+        __uuidof(ID3D11Texture2D),
+        &opened.texture)))
+    {
+        UDD_ERROR("Monitor::OpenDesktopTexture() => Failed to open shared resource.");
+        return nullptr;
+    }
+    opened.handle = desktopTextureHandle;
+
+    return opened.texture;
+}
+
+
 void Monitor::StartCapture()
 {
     UDD_FUNCTION_SCOPE_TIMER
@@ -223,8 +375,34 @@ HANDLE Monitor::GetSharedTextureHandle() const
 {
     UDD_FUNCTION_SCOPE_TIMER
 
-    const auto& frame = duplicator_->GetLastFrame();
-    return frame.textureHandle;
+    const auto frame = duplicator_->AcquireLastFrame();
+    return frame ? frame->textureHandle : nullptr;
+}
+
+
+void Monitor::GetInfo(MonitorInfo* info) const
+{
+    info->id = id_;
+    info->state = static_cast<int>(GetDuplicatorState());
+    info->left = GetLeft();
+    info->top = GetTop();
+    info->right = GetRight();
+    info->bottom = GetBottom();
+    info->width = GetWidth();
+    info->height = GetHeight();
+    info->rotation = GetRotation();
+    info->dpiX = GetDpiX();
+    info->dpiY = GetDpiY();
+    info->isPrimary = IsPrimary() ? 1 : 0;
+    info->isHDR = IsHDR() ? 1 : 0;
+}
+
+
+void Monitor::GetFrameInfo(FrameInfo* info) const
+{
+    duplicator_->GetFrameInfo(info);
+    info->renderedId = lastFrameId_;
+    info->hasBeenUpdated = HasBeenUpdated() ? 1 : 0;
 }
 
 
@@ -314,35 +492,228 @@ bool Monitor::IsHDR() const
 
 int Monitor::GetMoveRectCount() const
 {
-    const auto& metaData = duplicator_->GetLastFrame().metaData;
-    return metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    return duplicator_->CopyMoveRects(nullptr, 0, nullptr);
 }
 
 
+// The pointer refers to a frame pool slot which the capture thread reuses a couple of frames
+// later, so it is only valid right after the call. CopyMoveRects() should be used instead.
 DXGI_OUTDUPL_MOVE_RECT* Monitor::GetMoveRects() const
 {
-    const auto& metaData = duplicator_->GetLastFrame().metaData;
-    return metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>();
+    const auto frame = duplicator_->AcquireLastFrame();
+    return frame ? frame->metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>() : nullptr;
 }
 
 
 int Monitor::GetDirtyRectCount() const
 {
-    const auto& metaData = duplicator_->GetLastFrame().metaData;
-    return metaData.dirtyRectSize / sizeof(RECT);
+    return duplicator_->CopyDirtyRects(nullptr, 0, nullptr);
 }
 
 
+// Same as GetMoveRects(), CopyDirtyRects() should be used instead.
 RECT* Monitor::GetDirtyRects() const
 {
-    const auto& metaData = duplicator_->GetLastFrame().metaData;
-    return metaData.buffer.As<RECT>(metaData.moveRectSize);
+    const auto frame = duplicator_->AcquireLastFrame();
+    return frame ? frame->metaData.buffer.As<RECT>(frame->metaData.moveRectSize) : nullptr;
+}
+
+
+int Monitor::CopyMoveRects(DXGI_OUTDUPL_MOVE_RECT* output, int capacity, UINT64* frameSeq) const
+{
+    return duplicator_->CopyMoveRects(output, capacity, frameSeq);
+}
+
+
+int Monitor::CopyDirtyRects(RECT* output, int capacity, UINT64* frameSeq) const
+{
+    return duplicator_->CopyDirtyRects(output, capacity, frameSeq);
+}
+
+
+bool Monitor::SetCropRect(int x, int y, int width, int height)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (width <= 0 || height <= 0 ||
+        x < 0 || y < 0 ||
+        x + width > GetWidth() ||
+        y + height > GetHeight())
+    {
+        UDD_ERROR("Monitor::SetCropRect() => (", x, ", ", y, ", ", width, ", ", height, ") is out of monitor ", id_, ".");
+        return false;
+    }
+
+    const RECT rect = { x, y, x + width, y + height };
+    {
+        std::lock_guard<std::mutex> lock(cropMutex_);
+        cropRect_ = rect;
+    }
+
+    const auto imageRect = Crop::ToDesktopImage(rect, GetRotation(), GetWidth(), GetHeight());
+    duplicator_->SetCrop(&imageRect);
+
+    return true;
+}
+
+
+void Monitor::ClearCropRect()
+{
+    {
+        std::lock_guard<std::mutex> lock(cropMutex_);
+        cropRect_ = {};
+    }
+    duplicator_->SetCrop(nullptr);
+}
+
+
+bool Monitor::GetCropRect(RECT* rect) const
+{
+    std::lock_guard<std::mutex> lock(cropMutex_);
+    if (rect) *rect = cropRect_;
+    return !Crop::IsEmpty(cropRect_);
+}
+
+
+void Monitor::GetCaptureImageSize(int* width, int* height) const
+{
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(GetRotation());
+    const auto isVertical = 
+        rot == DXGI_MODE_ROTATION_ROTATE90 || 
+        rot == DXGI_MODE_ROTATION_ROTATE270;
+
+    RECT crop;
+    const bool isCropped = GetCropRect(&crop);
+    const auto captureWidth  = isCropped ? crop.right - crop.left : GetWidth();
+    const auto captureHeight = isCropped ? crop.bottom - crop.top : GetHeight();
+    *width  = !isVertical ? captureWidth  : captureHeight;
+    *height = !isVertical ? captureHeight : captureWidth;
+}
+
+
+bool Monitor::RegisterWatchRegion(int regionId, int x, int y, int width, int height)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (width <= 0 || height <= 0 ||
+        x < 0 || y < 0 ||
+        x + width > GetWidth() ||
+        y + height > GetHeight())
+    {
+        UDD_ERROR("Monitor::RegisterWatchRegion() => (", x, ", ", y, ", ", width, ", ", height, ") is out of monitor ", id_, ".");
+        return false;
+    }
+
+    // Regions are kept in desktop image coordinates so that the rects of frames are used as they are.
+    const RECT rect = { x, y, x + width, y + height };
+    const auto imageRect = Crop::ToDesktopImage(rect, GetRotation(), GetWidth(), GetHeight());
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(GetRotation());
+    const auto isVertical = 
+        rot == DXGI_MODE_ROTATION_ROTATE90 || 
+        rot == DXGI_MODE_ROTATION_ROTATE270;
+
+    std::lock_guard<std::mutex> lock(watchRegionMutex_);
+    watchRegions_.SetBounds(
+        !isVertical ? GetWidth() : GetHeight(),
+        !isVertical ? GetHeight() : GetWidth());
+    return watchRegions_.Add(regionId, { imageRect.left, imageRect.top, imageRect.right, imageRect.bottom });
+}
+
+
+bool Monitor::UnregisterWatchRegion(int regionId)
+{
+    std::lock_guard<std::mutex> lock(watchRegionMutex_);
+    return watchRegions_.Remove(regionId);
+}
+
+
+void Monitor::ClearWatchRegions()
+{
+    std::lock_guard<std::mutex> lock(watchRegionMutex_);
+    watchRegions_.Clear();
+}
+
+
+int Monitor::GetWatchRegionCount() const
+{
+    std::lock_guard<std::mutex> lock(watchRegionMutex_);
+    return watchRegions_.GetCount();
+}
+
+
+// Called by the capture thread for every published frame. The rects are relative to area,
+// the part of the desktop image in the frame (the crop), and move rects count as changes of
+// their destination.
+void Monitor::NotifyWatchRegions(
+    UINT frameId,
+    const RECT& area,
+    const DXGI_OUTDUPL_MOVE_RECT* moveRects,
+    UINT moveRectCount,
+    const RECT* dirtyRects,
+    UINT dirtyRectCount)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    std::lock_guard<std::mutex> lock(watchRegionMutex_);
+    if (watchRegions_.GetCount() == 0) return;
+
+    const auto addChange = [this, &area](const RECT& rect)
+    {
+        watchRegions_.AddChange({
+            rect.left + area.left,
+            rect.top + area.top,
+            rect.right + area.left,
+            rect.bottom + area.top });
+    };
+
+    watchRegions_.BeginFrame();
+    for (UINT i = 0; i < moveRectCount; ++i)
+    {
+        addChange(moveRects[i].DestinationRect);
+    }
+    for (UINT i = 0; i < dirtyRectCount; ++i)
+    {
+        addChange(dirtyRects[i]);
+    }
+    watchRegionHits_.clear();
+    watchRegions_.EndFrame(&watchRegionHits_);
+
+    for (const auto& hit : watchRegionHits_)
+    {
+        const RECT imageRect = { hit.changedRect.left, hit.changedRect.top, hit.changedRect.right, hit.changedRect.bottom };
+        const auto rect = Crop::FromDesktopImage(imageRect, GetRotation(), GetWidth(), GetHeight());
+
+        Event event = {};
+        event.type = EventType::WatchRegionChanged;
+        event.id = id_;
+        event.seq = frameId;
+        event.value = hit.regionId;
+        event.x = rect.left;
+        event.y = rect.top;
+        event.width = rect.right - rect.left;
+        event.height = rect.bottom - rect.top;
+        EventQueue::Push(event);
+    }
 }
 
 
 void Monitor::UseGetPixels(bool use)
 {
     useGetPixels_ = use;
+
+    // The CPU copy is only read by GetPixels(), so it is not kept after it is disabled.
+    // The staging texture may still be used by other CPU consumers and is left to the idle check.
+    if (!use)
+    {
+        INT64 bytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(pixelsMutex_);
+            bytes = bufferForGetPixels_.Size();
+            bufferForGetPixels_.Reset();
+            memoryAccount_.Set(MemoryCategory::ReadbackBuffer, 0);
+        }
+        AddEviction(bytes, "GetPixels disabled");
+    }
 }
 
 
@@ -352,68 +723,182 @@ bool Monitor::UseGetPixels() const
 }
 
 
-void Monitor::CopyTextureFromGpuToCpu(ID3D11Texture2D* texture)
+void Monitor::CopyTextureFromGpuToCpu(ID3D11Texture2D* texture, CpuFrame* cpuFrame)
 {
     UDD_FUNCTION_SCOPE_TIMER
 
-    const auto monitorRot = static_cast<DXGI_MODE_ROTATION>(GetRotation());
-    const auto monitorWidth = GetWidth();
-    const auto monitorHeight = GetHeight();
-    const auto isVertical = 
-        monitorRot == DXGI_MODE_ROTATION_ROTATE90 || 
-        monitorRot == DXGI_MODE_ROTATION_ROTATE270;
-    const auto desktopImageWidth  = !isVertical ? monitorWidth  : monitorHeight;
-    const auto desktopImageHeight = !isVertical ? monitorHeight : monitorWidth;
+    // The texture has the size of the captured area, which is smaller than the monitor when cropped.
+    D3D11_TEXTURE2D_DESC srcDesc;
+    texture->GetDesc(&srcDesc);
+    const auto desktopImageWidth  = static_cast<int>(srcDesc.Width);
+    const auto desktopImageHeight = static_cast<int>(srcDesc.Height);
 
-    if (!textureForGetPixels_)
+    lastReadbackFrame_ = GetMonitorManager()->GetFrameCount();
+
+    // The local reference keeps the staging texture alive even if ReleaseReadback() is called meanwhile.
+    ComPtr<ID3D11Texture2D> readbackTexture;
     {
-        D3D11_TEXTURE2D_DESC desc;
-        desc.Width              = desktopImageWidth;
-        desc.Height             = desktopImageHeight;
-        desc.MipLevels          = 1;
-        desc.ArraySize          = 1;
-        desc.Format             = DXGI_FORMAT_B8G8R8A8_UNORM;
-        desc.SampleDesc.Count   = 1;
-        desc.SampleDesc.Quality = 0;
-        desc.Usage              = D3D11_USAGE_STAGING;
-        desc.BindFlags          = 0;
-        desc.CPUAccessFlags     = D3D11_CPU_ACCESS_READ;
-        desc.MiscFlags          = 0;
+        std::lock_guard<std::mutex> lock(pixelsMutex_);
 
-        if (FAILED(GetUnityDevice()->CreateTexture2D(&desc, nullptr, &textureForGetPixels_)))
+        if (textureForGetPixels_)
         {
-            Debug::Error("Monitor::CopyTextureFromGpuToCpu() => GetDevice()->CreateTexture2D() failed.");
-            return;
+            D3D11_TEXTURE2D_DESC currentDesc;
+            textureForGetPixels_->GetDesc(&currentDesc);
+            if (currentDesc.Width  != static_cast<UINT>(desktopImageWidth) ||
+                currentDesc.Height != static_cast<UINT>(desktopImageHeight))
+            {
+                textureForGetPixels_.Reset();
+                memoryAccount_.Set(MemoryCategory::ReadbackTexture, 0);
+            }
         }
+
+        if (!textureForGetPixels_)
+        {
+            D3D11_TEXTURE2D_DESC desc;
+            desc.Width              = desktopImageWidth;
+            desc.Height             = desktopImageHeight;
+            desc.MipLevels          = 1;
+            desc.ArraySize          = 1;
+            desc.Format             = DXGI_FORMAT_B8G8R8A8_UNORM;
+            desc.SampleDesc.Count   = 1;
+            desc.SampleDesc.Quality = 0;
+            desc.Usage              = D3D11_USAGE_STAGING;
+            desc.BindFlags          = 0;
+            desc.CPUAccessFlags     = D3D11_CPU_ACCESS_READ;
+            desc.MiscFlags          = 0;
+
+            if (FAILED(GetUnityDevice()->CreateTexture2D(&desc, nullptr, &textureForGetPixels_)))
+            {
+                UDD_ERROR("Monitor::CopyTextureFromGpuToCpu() => GetDevice()->CreateTexture2D() failed.");
+                return;
+            }
+            memoryAccount_.Set(MemoryCategory::ReadbackTexture, GetTextureByteSize(desc));
+        }
+
+        readbackTexture = textureForGetPixels_;
     }
 
     {
         ComPtr<ID3D11DeviceContext> context;
         GetUnityDevice()->GetImmediateContext(&context);
-        context->CopyResource(textureForGetPixels_.Get(), texture);
+        context->CopyResource(readbackTexture.Get(), texture);
     }
 
     ComPtr<IDXGISurface> surface;
-    if (FAILED(textureForGetPixels_.As(&surface)))
+    if (FAILED(readbackTexture.As(&surface)))
     {
-        Debug::Error("Monitor::CopyTextureFromGpuToCpu() => texture.As() failed.");
+        UDD_ERROR("Monitor::CopyTextureFromGpuToCpu() => texture.As() failed.");
         return;
     }
 
     DXGI_MAPPED_RECT mappedSurface;
     if (FAILED(surface->Map(&mappedSurface, DXGI_MAP_READ)))
     {
-        Debug::Error("Monitor::CopyTextureFromGpuToCpu() => surface->Map() failed.");
+        UDD_ERROR("Monitor::CopyTextureFromGpuToCpu() => surface->Map() failed.");
         return;
     }
 
-    const UINT size = desktopImageWidth * desktopImageHeight * sizeof(UINT);
-    bufferForGetPixels_.ExpandIfNeeded(size);
-    std::memcpy(bufferForGetPixels_.Get(), mappedSurface.pBits, size);
+    const auto readbackTime = GetLatencyTimestamp();
+    latencyHistograms_[static_cast<int>(LatencyStage::RenderToReadback)].Add(lastRenderTime_, readbackTime);
+    if (latencyProbe_.IsEnabled() && desktopImageWidth >= static_cast<int>(LatencyProbe::kWidth))
+    {
+        const auto probeTime = latencyProbe_.Find(static_cast<const BYTE*>(mappedSurface.pBits));
+        latencyHistograms_[static_cast<int>(LatencyStage::ProbeToReadback)].Add(probeTime, readbackTime);
+    }
+
+    if (UseGetPixels())
+    {
+        const UINT size = desktopImageWidth * desktopImageHeight * sizeof(UINT);
+        UINT shrunkBytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(pixelsMutex_);
+
+            // Buffer only grows by itself, so it is reallocated when the desktop got smaller.
+            if (bufferForGetPixels_.Size() > size)
+            {
+                shrunkBytes = bufferForGetPixels_.Size() - size;
+                bufferForGetPixels_.Reset();
+            }
+            bufferForGetPixels_.ExpandIfNeeded(size);
+            Crop::CopyRows(
+                static_cast<const BYTE*>(mappedSurface.pBits),
+                mappedSurface.Pitch,
+                bufferForGetPixels_.Get(),
+                desktopImageWidth * sizeof(UINT),
+                desktopImageHeight);
+
+            // Rects only describe the change from the previous readback, so after skipped frames
+            // or a size change the whole image counts as changed.
+            const auto& last = readbackChanges_[(readbackChangeCount_ + kReadbackChangeCount - 1) % kReadbackChangeCount];
+            auto& change = readbackChanges_[readbackChangeCount_ % kReadbackChangeCount];
+            change.frameId = cpuFrame ? cpuFrame->id : 0;
+            change.isFullUpdate = 
+                !cpuFrame || 
+                readbackChangeCount_ == 0 || 
+                last.frameId + 1 != change.frameId ||
+                readbackWidth_ != desktopImageWidth ||
+                readbackHeight_ != desktopImageHeight;
+            change.rects.clear();
+            if (!change.isFullUpdate)
+            {
+                for (UINT i = 0; i < cpuFrame->moveRectCount; ++i)
+                {
+                    change.rects.push_back(cpuFrame->moveRects[i].DestinationRect);
+                }
+                change.rects.insert(change.rects.end(), cpuFrame->dirtyRects, cpuFrame->dirtyRects + cpuFrame->dirtyRectCount);
+            }
+            ++readbackChangeCount_;
+
+            readbackWidth_ = desktopImageWidth;
+            readbackHeight_ = desktopImageHeight;
+            memoryAccount_.Set(MemoryCategory::ReadbackBuffer, bufferForGetPixels_.Size());
+        }
+        AddEviction(shrunkBytes, "resolution drop");
+    }
+
+    if (cpuFrame)
+    {
+        // Consumers read straight from the mapped staging texture so that they cost no extra copy.
+        cpuFrame->pixels = mappedSurface.pBits;
+        cpuFrame->pitch = mappedSurface.Pitch;
+
+        std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+        if (sharedFrameRing_)
+        {
+            sharedFrameRing_->Write(*cpuFrame);
+        }
+        if (streamServer_)
+        {
+            streamServer_->Update(*cpuFrame);
+        }
+        if (regionStats_)
+        {
+            regionStatsChanges_.clear();
+            for (UINT i = 0; i < cpuFrame->moveRectCount; ++i)
+            {
+                const auto& rect = cpuFrame->moveRects[i].DestinationRect;
+                regionStatsChanges_.push_back({ rect.left, rect.top, rect.right, rect.bottom });
+            }
+            for (UINT i = 0; i < cpuFrame->dirtyRectCount; ++i)
+            {
+                const auto& rect = cpuFrame->dirtyRects[i];
+                regionStatsChanges_.push_back({ rect.left, rect.top, rect.right, rect.bottom });
+            }
+            regionStats_->Update(
+                cpuFrame->id,
+                cpuFrame->pixels,
+                cpuFrame->pitch,
+                desktopImageWidth,
+                desktopImageHeight,
+                regionStatsChanges_.data(),
+                regionStatsChanges_.size());
+            memoryAccount_.Set(MemoryCategory::RegionStats, regionStats_->GetByteSize());
+        }
+    }
 
     if (FAILED(surface->Unmap()))
     {
-        Debug::Error("Monitor::CopyTextureFromGpuToCpu() => surface->Unmap() failed.");
+        UDD_ERROR("Monitor::CopyTextureFromGpuToCpu() => surface->Unmap() failed.");
         return;
     }
 }
@@ -425,24 +910,29 @@ bool Monitor::GetPixels(BYTE* output, int x, int y, int width, int height)
 
     if (!UseGetPixels())
     {
-        Debug::Error("Monitor::GetPixels() => UseGetPixels(true) must have been called when you want to use GetPixels().");
+        UDD_ERROR("Monitor::GetPixels() => UseGetPixels(true) must have been called when you want to use GetPixels().");
         return false;
     }
 
+    // GetPixels() can be called from worker threads while the render thread updates the buffer.
+    std::lock_guard<std::mutex> lock(pixelsMutex_);
+    lastReadbackFrame_ = GetMonitorManager()->GetFrameCount();
+
     if (!bufferForGetPixels_)
     {
-        Debug::Error("Monitor::GetPixels() => CopyTextureFromGpuToCpu() has not been called yet.");
+        UDD_ERROR("Monitor::GetPixels() => CopyTextureFromGpuToCpu() has not been called yet.");
         return false;
     }
 
+    // Coordinates are relative to the crop when it is set, so the captured size is used as the monitor size.
     const auto monitorRot = static_cast<DXGI_MODE_ROTATION>(GetRotation());
-    const auto monitorWidth = GetWidth();
-    const auto monitorHeight = GetHeight();
     const auto isVertical = 
         monitorRot == DXGI_MODE_ROTATION_ROTATE90 || 
         monitorRot == DXGI_MODE_ROTATION_ROTATE270;
-    const auto desktopImageWidth  = !isVertical ? monitorWidth  : monitorHeight;
-    const auto desktopImageHeight = !isVertical ? monitorHeight : monitorWidth;
+    const auto desktopImageWidth  = readbackWidth_;
+    const auto desktopImageHeight = readbackHeight_;
+    const auto monitorWidth  = !isVertical ? desktopImageWidth  : desktopImageHeight;
+    const auto monitorHeight = !isVertical ? desktopImageHeight : desktopImageWidth;
 
     // check area in destop coorinates.
     int left, top, right, bottom;
@@ -490,8 +980,8 @@ bool Monitor::GetPixels(BYTE* output, int x, int y, int width, int height)
         right  >= desktopImageWidth || 
         bottom >= desktopImageHeight)
     {
-        Debug::Error("Monitor::GetPixels() => is out of area.");
-        Debug::Error(
+        UDD_ERROR("Monitor::GetPixels() => is out of area.");
+        UDD_ERROR(
             "    ",
             "(", left, ", ", top, ")", 
             " ~ (", right, ", ", bottom, ") > ",
@@ -499,56 +989,924 @@ bool Monitor::GetPixels(BYTE* output, int x, int y, int width, int height)
         return false;
     }
 
-    for (int row = 0; row < height; ++row)
+    Kernels::CopyPixelsToRgba(
+        bufferForGetPixels_.Get(),
+        desktopImageWidth * sizeof(UINT),
+        monitorRot,
+        left,
+        top,
+        right,
+        bottom,
+        width,
+        height,
+        output);
+
+    return true;
+}
+
+
+int Monitor::FindTemplate(
+    const BYTE* pixels,
+    int width,
+    int height,
+    const RECT* searchRect,
+    float threshold,
+    UINT* frameId,
+    TemplateMatch* results,
+    int capacity)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (!UseGetPixels())
+    {
+        UDD_ERROR("Monitor::FindTemplate() => UseGetPixels(true) must have been called when you want to use FindTemplate().");
+        return 0;
+    }
+
+    if (width <= 0 || height <= 0 || capacity <= 0)
+    {
+        UDD_ERROR("Monitor::FindTemplate() => Invalid template size (", width, ", ", height, ") or capacity ", capacity, ".");
+        return 0;
+    }
+
+    // The template has the layout of GetPixels() (bottom-up RGBA32 as displayed),
+    // so it is turned into luma in the orientation of the desktop image first.
+    const auto rotation = GetRotation();
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(rotation);
+    const auto isVertical = 
+        rot == DXGI_MODE_ROTATION_ROTATE90 || 
+        rot == DXGI_MODE_ROTATION_ROTATE270;
+    const auto templateWidth  = !isVertical ? width  : height;
+    const auto templateHeight = !isVertical ? height : width;
+
+    std::vector<uint8_t> templateLuma(static_cast<size_t>(templateWidth) * templateHeight);
+    for (int v = 0; v < templateHeight; ++v)
+    {
+        for (int u = 0; u < templateWidth; ++u)
+        {
+            const RECT imagePixel = { u, v, u + 1, v + 1 };
+            const auto monitorPixel = Crop::FromDesktopImage(imagePixel, rotation, width, height);
+            const auto pixel = pixels + ((height - 1 - monitorPixel.top) * width + monitorPixel.left) * 4;
+            templateLuma[v * templateWidth + u] = static_cast<uint8_t>((pixel[0] * 54 + pixel[1] * 183 + pixel[2] * 19) >> 8);
+        }
+    }
+    const TemplateMatcher matcher(templateLuma.data(), templateWidth, templateHeight);
+
+    // Only the luma of the searched part is taken under the lock, and the search itself runs without it.
+    std::vector<uint8_t> luma;
+    std::vector<TemplateMatcher::Rect> positions;
+    RECT area = {};
+    int monitorWidth, monitorHeight;
     {
-        for (int col = 0; col < width; ++col)
+        std::lock_guard<std::mutex> lock(pixelsMutex_);
+        lastReadbackFrame_ = GetMonitorManager()->GetFrameCount();
+
+        if (!bufferForGetPixels_)
+        {
+            UDD_ERROR("Monitor::FindTemplate() => CopyTextureFromGpuToCpu() has not been called yet.");
+            return 0;
+        }
+
+        monitorWidth  = !isVertical ? readbackWidth_  : readbackHeight_;
+        monitorHeight = !isVertical ? readbackHeight_ : readbackWidth_;
+
+        RECT search = { 0, 0, readbackWidth_, readbackHeight_ };
+        if (searchRect)
+        {
+            search = Crop::ToDesktopImage(*searchRect, rotation, monitorWidth, monitorHeight);
+            const RECT bounds = { 0, 0, readbackWidth_, readbackHeight_ };
+            if (!Crop::Clip(bounds, &search)) return 0;
+        }
+        const RECT searchPositions = 
+        {
+            search.left,
+            search.top,
+            search.right - templateWidth + 1,
+            search.bottom - templateHeight + 1,
+        };
+
+        // Positions whose window overlaps a change since frameId are searched, or all of them
+        // when the history does not reach back that far.
+        bool isFullSearch = !frameId || *frameId == 0;
+        std::vector<RECT> changes;
+        if (!isFullSearch)
         {
-            int inRow, inCol;
-            switch (monitorRot)
+            isFullSearch = true;
+            for (UINT i = 0; i < kReadbackChangeCount && i < readbackChangeCount_; ++i)
             {
-                case DXGI_MODE_ROTATION_ROTATE90:
-                    inCol = left + row;
-                    inRow = bottom - 1 - col;
-                    break;
-                case DXGI_MODE_ROTATION_ROTATE180:
-                    inCol = right - 1 - col;
-                    inRow = bottom - 1 - row;
-                    break;
-                case DXGI_MODE_ROTATION_ROTATE270:
-                    inCol = right - 1 - row;
-                    inRow = top + col;
-                    break;
-                case DXGI_MODE_ROTATION_IDENTITY:
-                case DXGI_MODE_ROTATION_UNSPECIFIED:
-                default:
-                    inCol = left + col;
-                    inRow = top + row;
+                const auto& change = readbackChanges_[(readbackChangeCount_ - 1 - i) % kReadbackChangeCount];
+                if (change.frameId <= *frameId)
+                {
+                    isFullSearch = false;
                     break;
+                }
+                if (change.isFullUpdate) break;
+                changes.insert(changes.end(), change.rects.begin(), change.rects.end());
             }
-            const auto inIndex = 4 * (inRow * desktopImageWidth + inCol);
+        }
+        if (isFullSearch)
+        {
+            changes.assign(1, { searchPositions.left, searchPositions.top, searchPositions.right + templateWidth - 1, searchPositions.bottom + templateHeight - 1 });
+        }
+        if (frameId && readbackChangeCount_ > 0)
+        {
+            *frameId = readbackChanges_[(readbackChangeCount_ - 1) % kReadbackChangeCount].frameId;
+        }
 
-            const auto outRow = height - 1 - row;
-            const auto outCol = col;
-            const auto outIndex = 4 * (outRow * width + outCol);
+        area = { readbackWidth_, readbackHeight_, 0, 0 };
+        for (const auto& change : changes)
+        {
+            RECT position = 
+            {
+                change.left - templateWidth + 1,
+                change.top - templateHeight + 1,
+                change.right,
+                change.bottom,
+            };
+            if (!Crop::Clip(searchPositions, &position)) continue;
+
+            positions.push_back({ position.left, position.top, position.right, position.bottom });
+            area.left   = (std::min)(area.left,   position.left);
+            area.top    = (std::min)(area.top,    position.top);
+            area.right  = (std::max)(area.right,  position.right + templateWidth - 1);
+            area.bottom = (std::max)(area.bottom, position.bottom + templateHeight - 1);
+        }
+        if (positions.empty()) return 0;
 
-            // BGRA -> RGBA
-            output[outIndex + 0] = bufferForGetPixels_[inIndex + 2];
-            output[outIndex + 1] = bufferForGetPixels_[inIndex + 1];
-            output[outIndex + 2] = bufferForGetPixels_[inIndex + 0];
-            output[outIndex + 3] = bufferForGetPixels_[inIndex + 3];
+        const auto areaWidth = area.right - area.left;
+        luma.resize(static_cast<size_t>(areaWidth) * (area.bottom - area.top));
+        for (LONG y = area.top; y < area.bottom; ++y)
+        {
+            Kernels::ComputeLuma(
+                bufferForGetPixels_.Get() + (y * readbackWidth_ + area.left) * sizeof(UINT),
+                areaWidth,
+                luma.data() + (y - area.top) * areaWidth);
         }
     }
 
-    return true;
+    for (auto& position : positions)
+    {
+        position.left -= area.left;
+        position.top -= area.top;
+        position.right -= area.left;
+        position.bottom -= area.top;
+    }
+
+    const auto count = matcher.Find(
+        luma.data(),
+        area.right - area.left,
+        area.bottom - area.top,
+        positions.data(),
+        positions.size(),
+        threshold,
+        results,
+        capacity);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const RECT imageRect =
+        {
+            results[i].x + area.left,
+            results[i].y + area.top,
+            results[i].x + area.left + templateWidth,
+            results[i].y + area.top + templateHeight,
+        };
+        const auto monitorRect = Crop::FromDesktopImage(imageRect, rotation, monitorWidth, monitorHeight);
+        results[i].x = monitorRect.left;
+        results[i].y = monitorRect.top;
+    }
+
+    return count;
 }
 
 
-BYTE* Monitor::GetBuffer() const
+// The buffer is reallocated when the desktop size changes and released when it is evicted, and
+// the render thread writes to it on every readback, so the pointer is only safe to read while
+// nothing else happens. CopyBuffer() should be used instead.
+BYTE* Monitor::GetBuffer()
 {
+    std::lock_guard<std::mutex> lock(pixelsMutex_);
+    lastReadbackFrame_ = GetMonitorManager()->GetFrameCount();
+
     if (!bufferForGetPixels_)
     {
-        Debug::Error("Monitor::GetBuffer() => CopyTextureFromGpuToCpu() has not been called yet.");
+        UDD_ERROR("Monitor::GetBuffer() => CopyTextureFromGpuToCpu() has not been called yet.");
         return nullptr;
     }
     return bufferForGetPixels_.Get();
 }
+
+
+// Copies the last readback (BGRA32, desktop image orientation) while the render thread cannot
+// update it. Returns the size of the whole buffer, which can be larger than size (0 when none).
+int Monitor::CopyBuffer(BYTE* output, int size)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    std::lock_guard<std::mutex> lock(pixelsMutex_);
+    lastReadbackFrame_ = GetMonitorManager()->GetFrameCount();
+
+    if (!bufferForGetPixels_) return 0;
+
+    const auto bufferSize = static_cast<int>(bufferForGetPixels_.Size());
+    if (output && size > 0)
+    {
+        std::memcpy(output, bufferForGetPixels_.Get(), (std::min)(size, bufferSize));
+    }
+    return bufferSize;
+}
+
+
+bool Monitor::StartRecording(const std::string& path)
+{
+    return duplicator_->StartRecording(path);
+}
+
+
+void Monitor::StopRecording()
+{
+    duplicator_->StopRecording();
+}
+
+
+bool Monitor::IsRecording() const
+{
+    return duplicator_->IsRecording();
+}
+
+
+bool Monitor::StartReplay(const std::string& path, ReplaySpeed speed, bool loop)
+{
+    return duplicator_->StartReplay(path, speed, loop);
+}
+
+
+void Monitor::StopReplay()
+{
+    duplicator_->StopReplay();
+}
+
+
+bool Monitor::IsReplaying() const
+{
+    return duplicator_->IsReplaying();
+}
+
+
+bool Monitor::EnableReplayRing(INT64 maxBytes, float durationSec, float keyFrameIntervalSec)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (maxBytes <= 0 || durationSec <= 0.f || keyFrameIntervalSec <= 0.f)
+    {
+        UDD_ERROR("Monitor::EnableReplayRing() => maxBytes, durationSec and keyFrameIntervalSec must be positive.");
+        return false;
+    }
+
+    // A new ring starts empty, so enabling it again drops the frames kept so far.
+    const auto replayRing = std::make_shared<ReplayRing>(maxBytes, durationSec, keyFrameIntervalSec);
+    {
+        std::lock_guard<std::mutex> lock(replayRingMutex_);
+        replayRing_ = replayRing;
+    }
+    duplicator_->SetReplayRing(replayRing);
+
+    return true;
+}
+
+
+void Monitor::DisableReplayRing()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    std::shared_ptr<ReplayRing> replayRing;
+    {
+        std::lock_guard<std::mutex> lock(replayRingMutex_);
+        replayRing.swap(replayRing_);
+    }
+    duplicator_->SetReplayRing(nullptr);
+    memoryAccount_.Set(MemoryCategory::ReplayRing, 0);
+}
+
+
+bool Monitor::IsReplayRingEnabled() const
+{
+    std::lock_guard<std::mutex> lock(replayRingMutex_);
+    return replayRing_ != nullptr;
+}
+
+
+bool Monitor::ExportReplayRing(const std::string& path, ReplayExportFormat format)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    std::shared_ptr<ReplayRing> replayRing;
+    {
+        std::lock_guard<std::mutex> lock(replayRingMutex_);
+        replayRing = replayRing_;
+    }
+
+    if (!replayRing)
+    {
+        UDD_ERROR("Monitor::ExportReplayRing() => EnableReplayRing() must have been called.");
+        return false;
+    }
+
+    return replayRing->Export(path, format);
+}
+
+
+ReplayExportState Monitor::GetReplayExportState() const
+{
+    std::lock_guard<std::mutex> lock(replayRingMutex_);
+    return replayRing_ ? replayRing_->GetExportState() : ReplayExportState::None;
+}
+
+
+bool Monitor::GetReplayRingInfo(ReplayRingInfo* info) const
+{
+    std::lock_guard<std::mutex> lock(replayRingMutex_);
+    if (!replayRing_) return false;
+    replayRing_->GetInfo(info);
+    return true;
+}
+
+
+bool Monitor::EnableSharedMemoryExport(int slotCount)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (slotCount <= 0)
+    {
+        UDD_ERROR("Monitor::EnableSharedMemoryExport() => slotCount must be positive.");
+        return false;
+    }
+
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(GetRotation());
+    const auto isVertical = 
+        rot == DXGI_MODE_ROTATION_ROTATE90 || 
+        rot == DXGI_MODE_ROTATION_ROTATE270;
+    const auto desktopImageWidth  = !isVertical ? GetWidth()  : GetHeight();
+    const auto desktopImageHeight = !isVertical ? GetHeight() : GetWidth();
+
+    // The previous ring has to be closed first since the new one reuses its name.
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    sharedFrameRing_.reset();
+
+    auto ring = std::make_unique<SharedFrameRing>();
+    if (!ring->Create(id_, slotCount, desktopImageWidth, desktopImageHeight))
+    {
+        return false;
+    }
+    sharedFrameRing_ = std::move(ring);
+
+    return true;
+}
+
+
+void Monitor::DisableSharedMemoryExport()
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    sharedFrameRing_.reset();
+}
+
+
+bool Monitor::IsSharedMemoryExportEnabled() const
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    return sharedFrameRing_ != nullptr;
+}
+
+
+bool Monitor::StartStreaming(int port)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (port <= 0 || port > 0xFFFF)
+    {
+        UDD_ERROR("Monitor::StartStreaming() => Invalid port ", port, ".");
+        return false;
+    }
+
+    // Streams have a fixed size, so they have to be restarted after the crop is changed.
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(GetRotation());
+    int desktopImageWidth, desktopImageHeight;
+    GetCaptureImageSize(&desktopImageWidth, &desktopImageHeight);
+
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    streamServer_.reset();
+
+    auto server = std::make_unique<StreamServer>();
+    if (!server->Start(static_cast<USHORT>(port), desktopImageWidth, desktopImageHeight, rot))
+    {
+        return false;
+    }
+    streamServer_ = std::move(server);
+
+    return true;
+}
+
+
+void Monitor::StopStreaming()
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    streamServer_.reset();
+}
+
+
+bool Monitor::IsStreaming() const
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    return streamServer_ != nullptr;
+}
+
+
+int Monitor::GetStreamingClientCount() const
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    return streamServer_ ? static_cast<int>(streamServer_->GetClientCount()) : 0;
+}
+
+
+bool Monitor::EnableRegionStats(int cellSize)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (cellSize <= 0)
+    {
+        UDD_ERROR("Monitor::EnableRegionStats() => cellSize must be positive.");
+        return false;
+    }
+
+    // Tables are built from the next frame, which is always a full update for a new engine.
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    if (regionStats_ && regionStats_->GetCellSize() == cellSize) return true;
+    regionStats_ = std::make_unique<RegionStats>(cellSize);
+    memoryAccount_.Set(MemoryCategory::RegionStats, regionStats_->GetByteSize());
+
+    return true;
+}
+
+
+void Monitor::DisableRegionStats()
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    regionStats_.reset();
+    memoryAccount_.Set(MemoryCategory::RegionStats, 0);
+}
+
+
+bool Monitor::IsRegionStatsEnabled() const
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    return regionStats_ != nullptr;
+}
+
+
+bool Monitor::SetRegionStatsEdgeZones(int horizontalCount, int verticalCount, int depth)
+{
+    if (horizontalCount < 0 || verticalCount < 0 || depth < 0)
+    {
+        UDD_ERROR("Monitor::SetRegionStatsEdgeZones() => Counts and depth must not be negative.");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    edgeZoneHorizontalCount_ = horizontalCount;
+    edgeZoneVerticalCount_ = verticalCount;
+    edgeZoneDepth_ = depth;
+
+    return true;
+}
+
+
+void Monitor::SetRegionStatsRects(const RECT* rects, int count)
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    regionStatsRects_.assign(rects, rects + (std::max)(count, 0));
+}
+
+
+int Monitor::GetRegionStats(RegionStatsInfo* info, RegionMean* means, int capacity, UINT* histogram) const
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    *info = {};
+
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    if (!regionStats_ || !regionStats_->HasImage()) return 0;
+
+    // Queries are in the captured area as displayed, while the tables have the desktop image orientation.
+    const auto rotation = GetRotation();
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(rotation);
+    const auto isVertical = 
+        rot == DXGI_MODE_ROTATION_ROTATE90 || 
+        rot == DXGI_MODE_ROTATION_ROTATE270;
+    const auto width  = !isVertical ? regionStats_->GetWidth()  : regionStats_->GetHeight();
+    const auto height = !isVertical ? regionStats_->GetHeight() : regionStats_->GetWidth();
+
+    int count = 0;
+    const auto addMean = [&](int left, int top, int right, int bottom)
+    {
+        if (count < capacity)
+        {
+            const RegionStats::Rect rect = { left, top, right, bottom };
+            means[count] = regionStats_->GetMean(Crop::ToDesktopImage(rect, rotation, width, height));
+        }
+        ++count;
+    };
+
+    // Edge zones go clockwise from the top left corner so that they can be mapped to a LED strip in order.
+    if (edgeZoneDepth_ > 0)
+    {
+        const auto h = edgeZoneHorizontalCount_;
+        const auto v = edgeZoneVerticalCount_;
+        const auto depthX = (std::min)(edgeZoneDepth_, width);
+        const auto depthY = (std::min)(edgeZoneDepth_, height);
+        for (int i = 0; i < h; ++i)
+        {
+            addMean(width * i / h, 0, width * (i + 1) / h, depthY);
+        }
+        for (int i = 0; i < v; ++i)
+        {
+            addMean(width - depthX, height * i / v, width, height * (i + 1) / v);
+        }
+        for (int i = h - 1; i >= 0; --i)
+        {
+            addMean(width * i / h, height - depthY, width * (i + 1) / h, height);
+        }
+        for (int i = v - 1; i >= 0; --i)
+        {
+            addMean(0, height * i / v, depthX, height * (i + 1) / v);
+        }
+        info->edgeZoneCount = count;
+    }
+
+    for (const auto& rect : regionStatsRects_)
+    {
+        addMean(rect.left, rect.top, rect.right, rect.bottom);
+    }
+
+    info->frameId = regionStats_->GetFrameId();
+    info->width = width;
+    info->height = height;
+    info->cellSize = regionStats_->GetCellSize();
+    info->regionCount = static_cast<int>(regionStatsRects_.size());
+    info->meanLuma = regionStats_->GetMeanLuma();
+    info->updateMs = regionStats_->GetUpdateMs();
+
+    if (histogram)
+    {
+        std::memcpy(histogram, regionStats_->GetHistogram(), RegionStats::kHistogramBinCount * sizeof(UINT));
+    }
+
+    return count;
+}
+
+
+bool Monitor::EnableCursorRegion(int width, int height)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (width <= 0 || height <= 0)
+    {
+        UDD_ERROR("Monitor::EnableCursorRegion() => (", width, ", ", height, ") is not a valid size.");
+        return false;
+    }
+
+    // The region is copied from the next frame or cursor move, and a smaller one is kept until then.
+    std::lock_guard<std::mutex> lock(cursorRegionMutex_);
+    cursorRegionWidth_ = width;
+    cursorRegionHeight_ = height;
+
+    return true;
+}
+
+
+void Monitor::DisableCursorRegion()
+{
+    std::lock_guard<std::mutex> lock(cursorRegionMutex_);
+    cursorRegionWidth_ = 0;
+    cursorRegionHeight_ = 0;
+    cursorRegionTexture_.Reset();
+    cursorRegionBuffer_.Reset();
+    cursorRegionInfo_ = {};
+    memoryAccount_.Set(MemoryCategory::CursorRegion, 0);
+}
+
+
+bool Monitor::IsCursorRegionEnabled() const
+{
+    std::lock_guard<std::mutex> lock(cursorRegionMutex_);
+    return cursorRegionWidth_ > 0;
+}
+
+
+bool Monitor::GetCursorRegion(CursorRegionInfo* info, BYTE* output, int capacity) const
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    // The info is returned even when output is too small so that the caller can resize it.
+    std::lock_guard<std::mutex> lock(cursorRegionMutex_);
+    *info = cursorRegionInfo_;
+    if (info->sequence == 0) return false;
+
+    const auto pixelCount = info->width * info->height;
+    if (!output || capacity < pixelCount) return false;
+
+    std::memcpy(output, cursorRegionBuffer_.Get(), pixelCount * sizeof(UINT));
+
+    return true;
+}
+
+
+void Monitor::CopyCursorRegion()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    auto& manager = GetMonitorManager();
+    const auto cursor = manager->GetCursor();
+    if (!unityTexture_ || !cursor || id_ != manager->GetCursorMonitorId()) return;
+
+    // The region is in the captured area as displayed, like the coordinates of GetPixels().
+    RECT capture;
+    if (!GetCropRect(&capture))
+    {
+        capture = { 0, 0, GetWidth(), GetHeight() };
+    }
+    const int captureWidth  = capture.right - capture.left;
+    const int captureHeight = capture.bottom - capture.top;
+    const int cursorX = cursor->GetX() + cursor->GetHotSpotX() - capture.left;
+    const int cursorY = cursor->GetY() + cursor->GetHotSpotY() - capture.top;
+
+    std::lock_guard<std::mutex> lock(cursorRegionMutex_);
+    if (cursorRegionWidth_ <= 0 || cursorRegionHeight_ <= 0) return;
+
+    // The box is centered on the hot spot and pushed back into the captured area instead of being cut,
+    // so a magnifier keeps its size at the edges (it only shrinks when the area itself is smaller).
+    const int width  = (std::min)(cursorRegionWidth_, captureWidth);
+    const int height = (std::min)(cursorRegionHeight_, captureHeight);
+    const int left = (std::max)((std::min)(cursorX - width / 2, captureWidth - width), 0);
+    const int top  = (std::max)((std::min)(cursorY - height / 2, captureHeight - height), 0);
+    const RECT region = { left, top, left + width, top + height };
+    const auto imageRect = Crop::ToDesktopImage(region, GetRotation(), captureWidth, captureHeight);
+    const auto imageWidth  = static_cast<UINT>(imageRect.right - imageRect.left);
+    const auto imageHeight = static_cast<UINT>(imageRect.bottom - imageRect.top);
+
+    // Right after the crop is changed, the texture still has the previous size until the next frame.
+    D3D11_TEXTURE2D_DESC srcDesc;
+    unityTexture_->GetDesc(&srcDesc);
+    if (static_cast<UINT>(imageRect.right)  > srcDesc.Width ||
+        static_cast<UINT>(imageRect.bottom) > srcDesc.Height)
+    {
+        return;
+    }
+
+    if (cursorRegionTexture_)
+    {
+        D3D11_TEXTURE2D_DESC currentDesc;
+        cursorRegionTexture_->GetDesc(&currentDesc);
+        if (currentDesc.Width != imageWidth || currentDesc.Height != imageHeight)
+        {
+            cursorRegionTexture_.Reset();
+        }
+    }
+
+    if (!cursorRegionTexture_)
+    {
+        D3D11_TEXTURE2D_DESC desc;
+        desc.Width              = imageWidth;
+        desc.Height             = imageHeight;
+        desc.MipLevels          = 1;
+        desc.ArraySize          = 1;
+        desc.Format             = DXGI_FORMAT_B8G8R8A8_UNORM;
+        desc.SampleDesc.Count   = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Usage              = D3D11_USAGE_STAGING;
+        desc.BindFlags          = 0;
+        desc.CPUAccessFlags     = D3D11_CPU_ACCESS_READ;
+        desc.MiscFlags          = 0;
+
+        if (FAILED(GetUnityDevice()->CreateTexture2D(&desc, nullptr, &cursorRegionTexture_)))
+        {
+            UDD_ERROR("Monitor::CopyCursorRegion() => GetDevice()->CreateTexture2D() failed.");
+            return;
+        }
+    }
+
+    // Only the box is copied out of the Unity texture, so the cursor drawn on it is included.
+    {
+        const D3D11_BOX box = 
+        {
+            static_cast<UINT>(imageRect.left),
+            static_cast<UINT>(imageRect.top),
+            0,
+            static_cast<UINT>(imageRect.right),
+            static_cast<UINT>(imageRect.bottom),
+            1,
+        };
+        ComPtr<ID3D11DeviceContext> context;
+        GetUnityDevice()->GetImmediateContext(&context);
+        context->CopySubresourceRegion(cursorRegionTexture_.Get(), 0, 0, 0, 0, unityTexture_, 0, &box);
+    }
+
+    ComPtr<IDXGISurface> surface;
+    if (FAILED(cursorRegionTexture_.As(&surface)))
+    {
+        UDD_ERROR("Monitor::CopyCursorRegion() => texture.As() failed.");
+        return;
+    }
+
+    DXGI_MAPPED_RECT mappedSurface;
+    if (FAILED(surface->Map(&mappedSurface, DXGI_MAP_READ)))
+    {
+        UDD_ERROR("Monitor::CopyCursorRegion() => surface->Map() failed.");
+        return;
+    }
+
+    cursorRegionBuffer_.ExpandIfNeeded(width * height * sizeof(UINT));
+    Kernels::CopyPixelsToRgba(
+        mappedSurface.pBits,
+        mappedSurface.Pitch,
+        GetRotation(),
+        0,
+        0,
+        imageWidth - 1,
+        imageHeight - 1,
+        width,
+        height,
+        cursorRegionBuffer_.Get());
+
+    surface->Unmap();
+
+    ++cursorRegionInfo_.sequence;
+    cursorRegionInfo_.frameId = lastFrameId_;
+    cursorRegionInfo_.isCursorVisible = cursor->IsVisible();
+    cursorRegionInfo_.x = left;
+    cursorRegionInfo_.y = top;
+    cursorRegionInfo_.width = width;
+    cursorRegionInfo_.height = height;
+    cursorRegionInfo_.cursorX = cursorX;
+    cursorRegionInfo_.cursorY = cursorY;
+
+    D3D11_TEXTURE2D_DESC textureDesc;
+    cursorRegionTexture_->GetDesc(&textureDesc);
+    memoryAccount_.Set(
+        MemoryCategory::CursorRegion, 
+        GetTextureByteSize(textureDesc) + cursorRegionBuffer_.Size());
+}
+
+
+void Monitor::RequestSnapshot(const std::shared_ptr<Snapshot>& snapshot)
+{
+    duplicator_->RequestSnapshot(snapshot);
+}
+
+
+void Monitor::SetComposite(const std::shared_ptr<Composite>& composite)
+{
+    duplicator_->SetComposite(composite);
+}
+
+
+LatencyProbe& Monitor::GetLatencyProbe()
+{
+    return latencyProbe_;
+}
+
+
+LatencyStats Monitor::GetLatencyStats(LatencyStage stage) const
+{
+    const auto index = static_cast<int>(stage);
+    if (index < 0 || index >= static_cast<int>(LatencyStage::Count)) return LatencyStats {};
+    return latencyHistograms_[index].GetStats();
+}
+
+
+void Monitor::ResetLatencyStats()
+{
+    for (auto& histogram : latencyHistograms_)
+    {
+        histogram.Reset();
+    }
+}
+
+
+MemoryAccount& Monitor::GetMemoryAccount()
+{
+    return memoryAccount_;
+}
+
+
+const MemoryAccount& Monitor::GetMemoryAccount() const
+{
+    return memoryAccount_;
+}
+
+
+UINT64 Monitor::GetLastReadbackFrame() const
+{
+    return lastReadbackFrame_;
+}
+
+
+INT64 Monitor::ReleaseReadback(const char* reason)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    INT64 bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(pixelsMutex_);
+        bytes = 
+            memoryAccount_.Get(MemoryCategory::ReadbackTexture) + 
+            memoryAccount_.Get(MemoryCategory::ReadbackBuffer);
+        textureForGetPixels_.Reset();
+        bufferForGetPixels_.Reset();
+        memoryAccount_.Set(MemoryCategory::ReadbackTexture, 0);
+        memoryAccount_.Set(MemoryCategory::ReadbackBuffer, 0);
+    }
+    AddEviction(bytes, reason);
+
+    return bytes;
+}
+
+
+void Monitor::AddEviction(INT64 bytes, const char* reason)
+{
+    if (bytes <= 0) return;
+    memoryAccount_.AddEviction(bytes);
+    UDD_LOG("Monitor::AddEviction() => Released ", bytes, " bytes of monitor ", id_, " (", reason, ").");
+}
+
+
+QosAccount& Monitor::GetQosAccount()
+{
+    return qosAccount_;
+}
+
+
+const QosAccount& Monitor::GetQosAccount() const
+{
+    return qosAccount_;
+}
+
+
+UINT Monitor::GetEffectiveFrameRate() const
+{
+    // Until the scheduler has run once, the monitor follows the global frame rate.
+    if (const auto frameRate = qosAccount_.GetEffectiveFrameRate()) return frameRate;
+    return (std::max)(GetMonitorManager()->GetFrameRate(), QosBudget::kMinFrameRate);
+}
+
+
+void Monitor::GetQosInfo(QosInfo* info) const
+{
+    int width, height;
+    GetCaptureImageSize(&width, &height);
+    const auto frameRate = GetEffectiveFrameRate();
+
+    info->targetFrameRate = qosAccount_.GetTargetFrameRate();
+    info->priority = static_cast<int>(qosAccount_.GetPriority());
+    info->effectiveFrameRate = frameRate;
+    info->effectivePriority = static_cast<int>(qosAccount_.GetEffectivePriority());
+    info->measuredFrameRate = qosAccount_.GetMeasuredFrameRate();
+    info->frameCostMs = qosAccount_.GetFrameCostMs();
+    info->pixelsPerSecond = static_cast<INT64>(width) * height * frameRate;
+}
+
+
+void Monitor::SetPhaseLockEnabled(bool enabled)
+{
+    isPhaseLockEnabled_ = enabled;
+}
+
+
+bool Monitor::IsPhaseLockEnabled() const
+{
+    return isPhaseLockEnabled_;
+}
+
+
+const PhaseLock& Monitor::GetPhaseLock() const
+{
+    return phaseLock_;
+}
+
+
+void Monitor::GetPhaseLockInfo(PhaseLockInfo* info) const
+{
+    const auto stats = phaseLock_.GetStats();
+    info->isEnabled = IsPhaseLockEnabled();
+    info->isLocked = stats.isLocked;
+    info->renderPeriodMs = static_cast<float>(stats.periodUs / 1000.0);
+    info->renderJitterMs = static_cast<float>(stats.jitterUs / 1000.0);
+    info->captureLeadMs = duplicator_ ? duplicator_->GetCaptureLead() / 1000.f : 0.f;
+    info->frameAgeMs = frameAgeMs_;
+}
+
+
+bool Monitor::HasCpuFrameConsumers() const
+{
+    std::lock_guard<std::mutex> lock(cpuFrameMutex_);
+    return sharedFrameRing_ || streamServer_ || regionStats_;
+}
@@ -4,13 +4,102 @@
 #include <dxgi1_2.h>
 #include <wrl/client.h>
 #include <memory>
+#include <atomic>
 #include <mutex>
 #include <thread>
+#include <string>
+#include <vector>
 #include "Common.h"
+#include "CpuFrame.h"
+#include "Latency.h"
+#include "Memory.h"
+#include "Qos.h"
+#include "PhaseLock.h"
+#include "WatchRegion.h"
+#include "RegionStats.h"
+#include "TemplateMatch.h"
 
 
 class MonitorManager;
+class SharedFrameRing;
+class StreamServer;
 enum class DuplicatorState;
+enum class ReplaySpeed;
+enum class ReplayExportFormat;
+enum class ReplayExportState;
+struct ReplayRingInfo;
+
+
+// Blittable snapshots which let Unity read everything with one call
+// (the layouts are shared with MonitorInfo and FrameInfo in Lib.cs).
+struct MonitorInfo
+{
+    int id;
+    int state;
+    int left;
+    int top;
+    int right;
+    int bottom;
+    int width;
+    int height;
+    int rotation;
+    int dpiX;
+    int dpiY;
+    int isPrimary;
+    int isHDR;
+};
+
+
+struct FrameInfo
+{
+    INT64 presentTime;          // LastPresentTime of the latest captured frame.
+    UINT id;                    // Id of the latest captured frame.
+    UINT renderedId;            // Id of the frame last copied to the Unity texture.
+    UINT accumulatedFrames;
+    int moveRectCount;
+    int dirtyRectCount;
+    int hasBeenUpdated;
+};
+
+
+struct PhaseLockInfo
+{
+    int isEnabled;
+    int isLocked;          // the render cadence is stable enough to capture in phase with it
+    float renderPeriodMs;  // estimated interval of Render() calls
+    float renderJitterMs;
+    float captureLeadMs;   // how long before the expected render the capture starts
+    float frameAgeMs;      // time from the acquire of the frame to the last Render()
+};
+
+
+// Returned with the means by Monitor::GetRegionStats() (the layout is shared with RegionStatsInfo in Lib.cs)
+struct RegionStatsInfo
+{
+    UINT frameId;
+    int width;             // captured area as displayed
+    int height;
+    int cellSize;
+    int edgeZoneCount;     // means of the edge zones come first, then the ones of the regions
+    int regionCount;
+    float meanLuma;        // 0 - 255
+    float updateMs;        // cost of the last update on the render thread
+};
+
+
+// Returned with the pixels by Monitor::GetCursorRegion() (the layout is shared with CursorRegionInfo in Lib.cs)
+struct CursorRegionInfo
+{
+    UINT64 sequence;       // incremented on every copy, 0 until the first one
+    UINT frameId;          // frame the region was copied from
+    int isCursorVisible;
+    int x;                 // region in captured area coordinates as displayed
+    int y;
+    int width;
+    int height;
+    int cursorX;           // hot spot in captured area coordinates as displayed
+    int cursorY;
+};
 
 
 class Monitor final
@@ -47,18 +136,98 @@ public:
     int GetDpiX() const;
     int GetDpiY() const;
     bool IsHDR() const;
+    void GetInfo(MonitorInfo* info) const;
+    void GetFrameInfo(FrameInfo* info) const;
     Microsoft::WRL::ComPtr<IDXGIOutputDuplication> GetDeskDupl();
     int GetMoveRectCount() const;
     DXGI_OUTDUPL_MOVE_RECT* GetMoveRects() const;
     int GetDirtyRectCount() const;
     RECT* GetDirtyRects() const;
+    int CopyMoveRects(DXGI_OUTDUPL_MOVE_RECT* output, int capacity, UINT64* frameSeq) const;
+    int CopyDirtyRects(RECT* output, int capacity, UINT64* frameSeq) const;
+    bool SetCropRect(int x, int y, int width, int height);
+    void ClearCropRect();
+    bool GetCropRect(RECT* rect) const;
+    bool RegisterWatchRegion(int regionId, int x, int y, int width, int height);
+    bool UnregisterWatchRegion(int regionId);
+    void ClearWatchRegions();
+    int GetWatchRegionCount() const;
+    void NotifyWatchRegions(
+        UINT frameId,
+        const RECT& area,
+        const DXGI_OUTDUPL_MOVE_RECT* moveRects,
+        UINT moveRectCount,
+        const RECT* dirtyRects,
+        UINT dirtyRectCount);
     void UseGetPixels(bool use);
     bool UseGetPixels() const;
     bool GetPixels(BYTE* output, int x, int y, int width, int height);
-    BYTE* GetBuffer() const;
+    int FindTemplate(
+        const BYTE* pixels,
+        int width,
+        int height,
+        const RECT* searchRect,
+        float threshold,
+        UINT* frameId,
+        TemplateMatch* results,
+        int capacity);
+    BYTE* GetBuffer();
+    int CopyBuffer(BYTE* output, int size);
+    bool StartRecording(const std::string& path);
+    void StopRecording();
+    bool IsRecording() const;
+    bool StartReplay(const std::string& path, ReplaySpeed speed, bool loop);
+    void StopReplay();
+    bool IsReplaying() const;
+    bool EnableReplayRing(INT64 maxBytes, float durationSec, float keyFrameIntervalSec);
+    void DisableReplayRing();
+    bool IsReplayRingEnabled() const;
+    bool ExportReplayRing(const std::string& path, ReplayExportFormat format);
+    ReplayExportState GetReplayExportState() const;
+    bool GetReplayRingInfo(ReplayRingInfo* info) const;
+    bool EnableSharedMemoryExport(int slotCount);
+    void DisableSharedMemoryExport();
+    bool IsSharedMemoryExportEnabled() const;
+    bool StartStreaming(int port);
+    void StopStreaming();
+    bool IsStreaming() const;
+    int GetStreamingClientCount() const;
+    bool EnableRegionStats(int cellSize);
+    void DisableRegionStats();
+    bool IsRegionStatsEnabled() const;
+    bool SetRegionStatsEdgeZones(int horizontalCount, int verticalCount, int depth);
+    void SetRegionStatsRects(const RECT* rects, int count);
+    int GetRegionStats(RegionStatsInfo* info, RegionMean* means, int capacity, UINT* histogram) const;
+    bool EnableCursorRegion(int width, int height);
+    void DisableCursorRegion();
+    bool IsCursorRegionEnabled() const;
+    bool GetCursorRegion(CursorRegionInfo* info, BYTE* output, int capacity) const;
+    void RequestSnapshot(const std::shared_ptr<class Snapshot>& snapshot);
+    void SetComposite(const std::shared_ptr<class Composite>& composite);
+    LatencyProbe& GetLatencyProbe();
+    LatencyStats GetLatencyStats(LatencyStage stage) const;
+    void ResetLatencyStats();
+    MemoryAccount& GetMemoryAccount();
+    const MemoryAccount& GetMemoryAccount() const;
+    UINT64 GetLastReadbackFrame() const;
+    INT64 ReleaseReadback(const char* reason);
+    QosAccount& GetQosAccount();
+    const QosAccount& GetQosAccount() const;
+    UINT GetEffectiveFrameRate() const;
+    void GetQosInfo(QosInfo* info) const;
+    void SetPhaseLockEnabled(bool enabled);
+    bool IsPhaseLockEnabled() const;
+    const PhaseLock& GetPhaseLock() const;
+    void GetPhaseLockInfo(PhaseLockInfo* info) const;
+    void GetCaptureImageSize(int* width, int* height) const;
 
 private:
-    void CopyTextureFromGpuToCpu(ID3D11Texture2D* texture);
+    void RenderCursor(int slot, HANDLE desktopTextureHandle);
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> OpenDesktopTexture(int slot, HANDLE desktopTextureHandle);
+    bool HasCpuFrameConsumers() const;
+    void CopyTextureFromGpuToCpu(ID3D11Texture2D* texture, CpuFrame* cpuFrame);
+    void CopyCursorRegion();
+    void AddEviction(INT64 bytes, const char* reason);
 
     MonitorManager* manager_ = nullptr;
     const int id_;
@@ -74,9 +243,82 @@ private:
     MONITORINFOEX monitorInfo_ = {};
 
     std::shared_ptr<class Duplicator> duplicator_;
+    std::shared_ptr<class ReplayRing> replayRing_;
+    mutable std::mutex replayRingMutex_;
     UINT lastFrameId_ = -1;
+    UINT lastCursorSeq_ = 0;
+    D3D11_BOX drawnCursorArea_ = {};
+
+    // Capture crop in monitor coordinates (empty when the whole monitor is captured)
+    RECT cropRect_ = {};
+    mutable std::mutex cropMutex_;
+
+    // Watch regions in desktop image coordinates (guarded by watchRegionMutex_)
+    WatchRegionIndex watchRegions_;
+    std::vector<WatchRegionIndex::Hit> watchRegionHits_;
+    mutable std::mutex watchRegionMutex_;
+
+    // Shared textures opened on Unity's device, one per frame pool slot of the duplicator.
+    // A slot keeps its texture until the desktop size or format changes, which gives it a new handle.
+    struct OpenedTexture
+    {
+        HANDLE handle = nullptr;
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+    };
+    std::vector<OpenedTexture> openedTextures_;
 
     ID3D11Texture2D* unityTexture_ = nullptr;
+    // Readback resources (guarded by pixelsMutex_ since MonitorManager releases them from the main thread)
     Microsoft::WRL::ComPtr<ID3D11Texture2D> textureForGetPixels_;
     Buffer<BYTE> bufferForGetPixels_;
+    std::mutex pixelsMutex_;
+    std::atomic<UINT64> lastReadbackFrame_ { 0 }; // last readback or read of the CPU copy
+    int readbackWidth_ = 0, readbackHeight_ = 0;
+
+    // Changed rects of the last readbacks, which let FindTemplate() search only where the image
+    // changed after a frame the caller has already searched (guarded by pixelsMutex_)
+    struct ReadbackChange
+    {
+        UINT frameId = 0;
+        bool isFullUpdate = true;
+        std::vector<RECT> rects;
+    };
+    static constexpr UINT kReadbackChangeCount = 16;
+    ReadbackChange readbackChanges_[kReadbackChangeCount];
+    UINT readbackChangeCount_ = 0;
+    MemoryAccount memoryAccount_;
+    QosAccount qosAccount_;
+
+    // Consumers of the CPU copy other than GetPixels() (guarded by cpuFrameMutex_)
+    std::unique_ptr<SharedFrameRing> sharedFrameRing_;
+    std::unique_ptr<StreamServer> streamServer_;
+    std::unique_ptr<RegionStats> regionStats_;
+    mutable std::mutex cpuFrameMutex_;
+    std::vector<RECT> cpuFrameDirtyRects_;
+    D3D11_BOX lastCursorArea_ = {};
+
+    // Region statistics queries in captured area coordinates as displayed (guarded by cpuFrameMutex_)
+    int edgeZoneHorizontalCount_ = 0;
+    int edgeZoneVerticalCount_ = 0;
+    int edgeZoneDepth_ = 0;
+    std::vector<RECT> regionStatsRects_;
+    std::vector<RegionStats::Rect> regionStatsChanges_;
+
+    // Box around the cursor copied on every frame and cursor move without the full readback
+    // (guarded by cursorRegionMutex_, the size is 0 while disabled)
+    int cursorRegionWidth_ = 0;
+    int cursorRegionHeight_ = 0;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> cursorRegionTexture_;
+    Buffer<BYTE> cursorRegionBuffer_;
+    CursorRegionInfo cursorRegionInfo_ = {};
+    mutable std::mutex cursorRegionMutex_;
+
+    LatencyHistogram latencyHistograms_[static_cast<int>(LatencyStage::Count)];
+    LatencyProbe latencyProbe_;
+    INT64 lastRenderTime_ = 0;
+
+    // Render() times tracked for the phase locked capture (see Duplicator::DuplicateInPhase())
+    PhaseLock phaseLock_;
+    std::atomic<bool> isPhaseLockEnabled_ { false };
+    std::atomic<float> frameAgeMs_ { 0.f };
 };
@@ -12,6 +12,10 @@
 #include "Debug.h"
 #include "Monitor.h"
 #include "Cursor.h"
+#include "Snapshot.h"
+#include "Composite.h"
+#include "Event.h"
+#include "Qos.h"
 #include "MonitorManager.h"
 
 using namespace Microsoft::WRL;
@@ -35,7 +39,7 @@ void MonitorManager::Initialize()
     ComPtr<IDXGIFactory1> factory;
     if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))))
     {
-        Debug::Error("MonitorManager::Initialize() => CreateDXGIFactory1() failed.");
+        UDD_ERROR("MonitorManager::Initialize() => CreateDXGIFactory1() failed.");
         return;
     }
 
@@ -46,14 +50,14 @@ void MonitorManager::Initialize()
     {
         DXGI_ADAPTER_DESC desc;
         if (FAILED(adapter->GetDesc(&desc))) continue;
-        Debug::Log("Graphics Card [", i, "] : ", desc.Description);
+        UDD_LOG("Graphics Card [", i, "] : ", desc.Description);
 
         ComPtr<IDXGIOutput> output;
         for (int j = 0; (adapter->EnumOutputs(j, &output) != DXGI_ERROR_NOT_FOUND); ++j) 
         {
             DXGI_OUTPUT_DESC desc;
             if (FAILED(output->GetDesc(&desc))) continue;
-            Debug::Log("  > Monitor[", j, "] : ", desc.DeviceName);
+            UDD_LOG("  > Monitor[", j, "] : ", desc.DeviceName);
             outputs.emplace_back(adapter, output);
         }
     }
@@ -66,6 +70,16 @@ void MonitorManager::Initialize()
         monitor->StartCapture();
         monitors_.push_back(monitor);
     }
+
+    reportedMonitorCount_ = static_cast<int>(monitors_.size());
+    lastTopologyCheckTime_ = std::chrono::steady_clock::now();
+    lastQosMeasureTime_ = lastTopologyCheckTime_;
+
+    // The layout may have changed, so the composite buffer is recreated with the new monitors.
+    if (isCompositeEnabled_)
+    {
+        CreateComposite();
+    }
 }
 
 
@@ -91,12 +105,170 @@ void MonitorManager::Update()
         Reinitialize();
         isReinitializationRequired_ = false;
     }
+
+    ++frameCount_;
+    CheckTopology();
+    EnforceMemoryBudget();
+    ScheduleQos();
+}
+
+
+void MonitorManager::CheckTopology()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    // Enumerating outputs is not cheap, so it is done at most once per second.
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastTopologyCheckTime_ < std::chrono::seconds(1)) return;
+    lastTopologyCheckTime_ = now;
+
+    const auto count = EnumerateMonitorCount();
+    if (count < 0 || count == reportedMonitorCount_) return;
+    reportedMonitorCount_ = count;
+
+    Event event = {};
+    event.type = EventType::TopologyChanged;
+    event.id = -1;
+    event.value = count;
+    EventQueue::Push(event);
+}
+
+
+void MonitorManager::EnforceMemoryBudget()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    const UINT64 frameCount = frameCount_;
+
+    // Readback resources are the only ones that can be released without stopping the capture,
+    // so they are dropped once nothing has read them back or read from them for a while...
+    // except the CPU copy requested with UseGetPixels(true), which has to be there for GetPixels()
+    // even when the desktop does not change, and whose GetBuffer() pointer the caller may keep.
+    const auto idleFrameCount = MemoryBudget::GetReadbackIdleFrameCount();
+    if (idleFrameCount > 0)
+    {
+        for (const auto& monitor : monitors_)
+        {
+            if (monitor->UseGetPixels()) continue;
+
+            const auto& account = monitor->GetMemoryAccount();
+            const auto hasReadback = 
+                account.Get(MemoryCategory::ReadbackTexture) > 0 ||
+                account.Get(MemoryCategory::ReadbackBuffer) > 0;
+            if (hasReadback && frameCount - monitor->GetLastReadbackFrame() > static_cast<UINT64>(idleFrameCount))
+            {
+                monitor->ReleaseReadback("idle");
+            }
+        }
+    }
+
+    // ...and, while the total is over the budget, in least recently used order.
+    // Monitors read back in the last frame are still in use and are not evicted.
+    const auto budget = MemoryBudget::GetBudget();
+    if (budget <= 0) return;
+
+    MemoryStats stats = {};
+    GetMemoryStats(-1, &stats);
+    auto total = stats.totalBytes;
+    if (total <= budget) return;
+
+    std::vector<std::shared_ptr<Monitor>> candidates;
+    for (const auto& monitor : monitors_)
+    {
+        if (monitor->GetLastReadbackFrame() + 1 >= frameCount) continue;
+        candidates.push_back(monitor);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const std::shared_ptr<Monitor>& a, const std::shared_ptr<Monitor>& b)
+    {
+        return a->GetLastReadbackFrame() < b->GetLastReadbackFrame();
+    });
+
+    for (const auto& monitor : candidates)
+    {
+        if (total <= budget) break;
+        total -= monitor->ReleaseReadback("over budget");
+    }
+}
+
+
+void MonitorManager::ScheduleQos()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (monitors_.empty()) return;
+
+    // The monitor holding the cursor is the one being worked on, so it is always scheduled as high priority.
+    std::vector<QosDemand> demands(monitors_.size());
+    for (size_t i = 0; i < monitors_.size(); ++i)
+    {
+        const auto& monitor = monitors_[i];
+        const auto& account = monitor->GetQosAccount();
+        auto& demand = demands[i];
+
+        int width, height;
+        monitor->GetCaptureImageSize(&width, &height);
+
+        const auto targetFrameRate = account.GetTargetFrameRate();
+        demand.targetFrameRate = targetFrameRate > 0 ? targetFrameRate : frameRate_;
+        demand.priority = monitor->GetId() == cursorMonitorId_ ? QosPriority::High : account.GetPriority();
+        demand.pixelCost = static_cast<double>(width) * height;
+        demand.cpuCost = account.GetFrameCostMs();
+    }
+
+    ScheduleFrameRates(&demands, QosBudget::GetPixelBudget(), QosBudget::GetCpuBudget());
+
+    for (size_t i = 0; i < monitors_.size(); ++i)
+    {
+        monitors_[i]->GetQosAccount().SetEffective(demands[i].frameRate, demands[i].priority);
+    }
+
+    // Measured rates are averaged over a second so that they do not jitter with Unity's frame time.
+    const auto now = std::chrono::steady_clock::now();
+    const auto elapsed = std::chrono::duration<double>(now - lastQosMeasureTime_).count();
+    if (elapsed < 1.0) return;
+    lastQosMeasureTime_ = now;
+
+    for (const auto& monitor : monitors_)
+    {
+        monitor->GetQosAccount().UpdateMeasuredFrameRate(elapsed);
+    }
+}
+
+
+bool MonitorManager::GetMemoryStats(int id, MemoryStats* stats) const
+{
+    *stats = {};
+
+    // -1 is every monitor and the cursor, which is shared by all of them.
+    if (id < 0)
+    {
+        for (const auto& monitor : monitors_)
+        {
+            monitor->GetMemoryAccount().AddTo(stats);
+        }
+        cursor_->GetMemoryAccount().AddTo(stats);
+        return true;
+    }
+
+    if (const auto monitor = GetMonitor(id))
+    {
+        monitor->GetMemoryAccount().AddTo(stats);
+        return true;
+    }
+
+    return false;
+}
+
+
+UINT64 MonitorManager::GetFrameCount() const
+{
+    return frameCount_;
 }
 
 
 void MonitorManager::RequireReinitilization()
 {
-    Debug::Log("MonitorManager::Reinitialize() was required.");
+    UDD_LOG("MonitorManager::Reinitialize() was required.");
     isReinitializationRequired_ = true;
 }
 
@@ -105,7 +277,7 @@ void MonitorManager::Reinitialize()
 {
     UDD_FUNCTION_SCOPE_TIMER
 
-    Debug::Log("MonitorManager::Reinitialize()");
+    UDD_LOG("MonitorManager::Reinitialize()");
     Finalize();
     Initialize();
     SendMessageToUnity(Message::Reinitialized);
@@ -116,11 +288,20 @@ bool MonitorManager::HasMonitorCountChanged() const
 {
     UDD_FUNCTION_SCOPE_TIMER
 
+    const auto count = EnumerateMonitorCount();
+    return count >= 0 && monitors_.size() != count;
+}
+
+
+int MonitorManager::EnumerateMonitorCount() const
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
     ComPtr<IDXGIFactory1> factory;
     if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))))
     {
-        Debug::Error("MonitorManager::CheckMonitorConnection() => CreateDXGIFactory1() failed.");
-        return false;
+        UDD_ERROR("MonitorManager::EnumerateMonitorCount() => CreateDXGIFactory1() failed.");
+        return -1;
     }
 
     int id = 0;
@@ -134,7 +315,7 @@ bool MonitorManager::HasMonitorCountChanged() const
         }
     }
 
-    return monitors_.size() != id;
+    return id;
 }
 
 
@@ -160,6 +341,28 @@ int MonitorManager::GetMonitorCount() const
 }
 
 
+int MonitorManager::GetTotalLeft() const
+{
+    std::vector<int> lefts;
+    for (const auto& monitor : monitors_)
+    {
+        lefts.push_back(monitor->GetLeft());
+    }
+    return *std::min_element(lefts.begin(), lefts.end());
+}
+
+
+int MonitorManager::GetTotalTop() const
+{
+    std::vector<int> tops;
+    for (const auto& monitor : monitors_)
+    {
+        tops.push_back(monitor->GetTop());
+    }
+    return *std::min_element(tops.begin(), tops.end());
+}
+
+
 int MonitorManager::GetTotalWidth() const
 {
     std::vector<int> lefts, rights;
@@ -198,3 +401,133 @@ UINT MonitorManager::GetFrameRate() const
 {
     return frameRate_;
 }
+
+
+bool MonitorManager::TakeSnapshot(const std::string& path)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (monitors_.empty())
+    {
+        UDD_ERROR("MonitorManager::TakeSnapshot() => There is no monitor.");
+        return false;
+    }
+
+    const auto state = GetSnapshotState();
+    if (state == SnapshotState::Capturing || state == SnapshotState::Encoding)
+    {
+        UDD_ERROR("MonitorManager::TakeSnapshot() => The previous snapshot has not finished yet.");
+        return false;
+    }
+
+    // Each capture thread copies its own desktop image, so Unity's render thread is never involved.
+    snapshot_ = std::make_shared<Snapshot>(
+        path,
+        GetTotalLeft(),
+        GetTotalTop(),
+        GetTotalWidth(),
+        GetTotalHeight(),
+        static_cast<UINT>(monitors_.size()));
+    for (const auto& monitor : monitors_)
+    {
+        monitor->RequestSnapshot(snapshot_);
+    }
+
+    return true;
+}
+
+
+SnapshotState MonitorManager::GetSnapshotState() const
+{
+    return snapshot_ ? snapshot_->GetState() : SnapshotState::None;
+}
+
+
+std::shared_ptr<Snapshot> MonitorManager::GetSnapshot() const
+{
+    return snapshot_;
+}
+
+
+void MonitorManager::EnableComposite()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (isCompositeEnabled_) return;
+
+    isCompositeEnabled_ = true;
+    CreateComposite();
+}
+
+
+void MonitorManager::DisableComposite()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (!isCompositeEnabled_) return;
+
+    isCompositeEnabled_ = false;
+    composite_.reset();
+    for (const auto& monitor : monitors_)
+    {
+        monitor->SetComposite(nullptr);
+    }
+}
+
+
+bool MonitorManager::IsCompositeEnabled() const
+{
+    return isCompositeEnabled_;
+}
+
+
+std::shared_ptr<Composite> MonitorManager::GetComposite() const
+{
+    return composite_;
+}
+
+
+BYTE* MonitorManager::LockComposite(UINT* pitch)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (!composite_ || lockedComposite_)
+    {
+        UDD_ERROR("MonitorManager::LockComposite() => The composite buffer is disabled or already locked.");
+        return nullptr;
+    }
+
+    // The leased buffer is kept alive even if monitors are reinitialized before UnlockComposite().
+    lockedComposite_ = composite_;
+    return lockedComposite_->Lock(pitch);
+}
+
+
+void MonitorManager::UnlockComposite()
+{
+    if (!lockedComposite_) return;
+
+    lockedComposite_->Unlock();
+    lockedComposite_.reset();
+}
+
+
+void MonitorManager::CreateComposite()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    composite_.reset();
+    if (monitors_.empty()) return;
+
+    // Each capture thread fills its own region, so the first frame of every monitor is a full copy
+    // and later frames only copy their dirty and move rects.
+    composite_ = std::make_shared<Composite>(
+        GetTotalLeft(),
+        GetTotalTop(),
+        GetTotalWidth(),
+        GetTotalHeight());
+    for (const auto& monitor : monitors_)
+    {
+        monitor->SetComposite(composite_);
+    }
+}
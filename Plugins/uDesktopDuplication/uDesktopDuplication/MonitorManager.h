@@ -5,10 +5,16 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <chrono>
+#include <atomic>
 
 struct IUnityInterfaces;
 class Monitor;
 class Cursor;
+class Snapshot;
+class Composite;
+enum class SnapshotState;
+struct MemoryStats;
 
 class MonitorManager final
 {
@@ -27,17 +33,44 @@ public:
     std::shared_ptr<Cursor> GetCursor() const;
     void SetFrameRate(UINT frameRate);
     UINT GetFrameRate() const;
+    bool TakeSnapshot(const std::string& path);
+    SnapshotState GetSnapshotState() const;
+    std::shared_ptr<Snapshot> GetSnapshot() const;
+    void EnableComposite();
+    void DisableComposite();
+    bool IsCompositeEnabled() const;
+    std::shared_ptr<Composite> GetComposite() const;
+    BYTE* LockComposite(UINT* pitch);
+    void UnlockComposite();
+    UINT64 GetFrameCount() const;
+    bool GetMemoryStats(int id, MemoryStats* stats) const;
 
 public:
     int GetMonitorCount() const;
+    int GetTotalLeft() const;
+    int GetTotalTop() const;
     int GetTotalWidth() const;
     int GetTotalHeight() const;
 
 private:
+    void CreateComposite();
+    int EnumerateMonitorCount() const;
+    void CheckTopology();
+    void EnforceMemoryBudget();
+    void ScheduleQos();
+
     UINT frameRate_ = 60;
     bool enableTextureCopyFromGpuToCpu_ = false;
     std::vector<std::shared_ptr<Monitor>> monitors_;
     std::shared_ptr<Cursor> cursor_ = std::make_shared<Cursor>();
     int cursorMonitorId_ = -1;
     bool isReinitializationRequired_ = false;
+    std::shared_ptr<Snapshot> snapshot_;
+    bool isCompositeEnabled_ = false;
+    std::shared_ptr<Composite> composite_;
+    std::shared_ptr<Composite> lockedComposite_;
+    std::chrono::steady_clock::time_point lastTopologyCheckTime_;
+    std::chrono::steady_clock::time_point lastQosMeasureTime_;
+    int reportedMonitorCount_ = 0;
+    std::atomic<UINT64> frameCount_ { 0 };
 };
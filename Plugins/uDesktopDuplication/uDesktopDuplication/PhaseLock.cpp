@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cmath>
+
+#include "PhaseLock.h"
+
+
+
+constexpr double PhaseLock::kPhaseGain;
+constexpr double PhaseLock::kPeriodGain;
+constexpr double PhaseLock::kMinPeriodUs;
+constexpr double PhaseLock::kMaxPeriodUs;
+constexpr int PhaseLock::kLockSampleCount;
+constexpr int PhaseLock::kMaxSkippedPeriods;
+
+
+
+void PhaseLock::AddRenderTime(int64_t timeUs)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto time = static_cast<double>(timeUs);
+
+    if (sampleCount_ == 0)
+    {
+        phase_ = time;
+        sampleCount_ = 1;
+        return;
+    }
+
+    const auto elapsed = time - phase_;
+    if (elapsed <= 0.0) return;
+
+    if (sampleCount_ == 1)
+    {
+        period_ = (std::min)((std::max)(elapsed, kMinPeriodUs), kMaxPeriodUs);
+        phase_ = time;
+        jitter_ = 0.0;
+        lastError_ = 0.0;
+        skipStreak_ = 0;
+        sampleCount_ = 2;
+        return;
+    }
+
+    // The render is matched to the nearest predicted one. Renders more than half a period early
+    // still count as the next one, so the error pulls the period down.
+    const auto cycles = (std::max)(1.0, std::round(elapsed / period_));
+    if (cycles > kMaxSkippedPeriods)
+    {
+        ResetNoLock();
+        phase_ = time;
+        sampleCount_ = 1;
+        return;
+    }
+
+    // Skipping periods every time means the consumer now runs at a fraction of the estimated
+    // rate rather than dropping frames, so the period is measured again.
+    skipStreak_ = cycles > 1.0 ? skipStreak_ + 1 : 0;
+    if (skipStreak_ >= kLockSampleCount)
+    {
+        ResetNoLock();
+        phase_ = time;
+        sampleCount_ = 1;
+        return;
+    }
+
+    const auto error = elapsed - cycles * period_;
+    phase_ += cycles * period_ + kPhaseGain * error;
+    period_ += kPeriodGain * error / cycles;
+    period_ = (std::min)((std::max)(period_, kMinPeriodUs), kMaxPeriodUs);
+    jitter_ += (std::abs(error) - jitter_) * 0.1;
+    lastError_ = error;
+    if (sampleCount_ < kLockSampleCount) ++sampleCount_;
+}
+
+
+int64_t PhaseLock::GetNextRenderTime(int64_t timeUs) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!IsLockedNoLock()) return -1;
+
+    const auto cycles = (std::max)(1.0, std::ceil((static_cast<double>(timeUs) - phase_) / period_));
+    return static_cast<int64_t>(std::llround(phase_ + cycles * period_));
+}
+
+
+bool PhaseLock::IsLocked() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return IsLockedNoLock();
+}
+
+
+double PhaseLock::GetPeriod() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return period_;
+}
+
+
+PhaseLock::Stats PhaseLock::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Stats stats;
+    stats.isLocked = IsLockedNoLock();
+    stats.periodUs = period_;
+    stats.jitterUs = jitter_;
+    stats.lastErrorUs = lastError_;
+    return stats;
+}
+
+
+void PhaseLock::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ResetNoLock();
+}
+
+
+bool PhaseLock::IsLockedNoLock() const
+{
+    // Renders at random times are a quarter of a period from the nearest prediction on average,
+    // so a consumer needs to stay well within that to have a usable phase.
+    return sampleCount_ >= kLockSampleCount && jitter_ < period_ * 0.125;
+}
+
+
+void PhaseLock::ResetNoLock()
+{
+    sampleCount_ = 0;
+    phase_ = 0.0;
+    period_ = 0.0;
+    jitter_ = 0.0;
+    lastError_ = 0.0;
+    skipStreak_ = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+
+
+// Tracks the cadence of a consumer (Unity's render thread calling Monitor::Render()) so that
+// the capture thread can publish a fresh frame just before the next render instead of free-running.
+//
+// It is a second order PLL: each render time is compared with the predicted one, and the phase
+// and the period are both pulled towards it. A render which comes a whole number of periods late
+// (a Unity hitch) is matched to the period it fell into, so a dropped frame does not unlock it,
+// while renders far from any prediction (a change of the target frame rate) make it lock again.
+//
+// Times are in microseconds of any monotonic clock and the class has no platform dependency,
+// so it can be driven by a simulated consumer.
+class PhaseLock final
+{
+public:
+    struct Stats
+    {
+        bool isLocked;
+        double periodUs;     // estimated render interval
+        double jitterUs;     // average distance between renders and their predictions
+        double lastErrorUs;  // distance of the last render from its prediction
+    };
+
+    void AddRenderTime(int64_t timeUs);
+
+    // Returns the first predicted render at or after timeUs, or -1 while not locked.
+    int64_t GetNextRenderTime(int64_t timeUs) const;
+
+    bool IsLocked() const;
+    double GetPeriod() const;
+    Stats GetStats() const;
+    void Reset();
+
+private:
+    bool IsLockedNoLock() const;
+    void ResetNoLock();
+
+    static constexpr double kPhaseGain = 0.2;
+    static constexpr double kPeriodGain = 0.02;
+    static constexpr double kMinPeriodUs = 1000.0;     // 1000 Hz
+    static constexpr double kMaxPeriodUs = 250000.0;   // 4 Hz
+    static constexpr int kLockSampleCount = 8;
+    static constexpr int kMaxSkippedPeriods = 8;
+
+    mutable std::mutex mutex_;
+    int sampleCount_ = 0;
+    double phase_ = 0.0;   // filtered time of the last render
+    double period_ = 0.0;
+    double jitter_ = 0.0;
+    double lastError_ = 0.0;
+    int skipStreak_ = 0;
+};
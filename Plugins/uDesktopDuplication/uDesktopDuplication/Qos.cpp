@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Qos.h"
+
+
+
+constexpr UINT QosBudget::kMinFrameRate;
+std::atomic<INT64> QosBudget::pixelBudget_ { 0 };
+std::atomic<float> QosBudget::cpuBudget_ { 0.f };
+
+
+
+void QosAccount::SetTargetFrameRate(UINT frameRate)
+{
+    targetFrameRate_ = frameRate;
+}
+
+
+UINT QosAccount::GetTargetFrameRate() const
+{
+    return targetFrameRate_;
+}
+
+
+void QosAccount::SetPriority(QosPriority priority)
+{
+    priority_ = static_cast<int>(priority);
+}
+
+
+QosPriority QosAccount::GetPriority() const
+{
+    return static_cast<QosPriority>(priority_.load());
+}
+
+
+void QosAccount::SetEffective(UINT frameRate, QosPriority priority)
+{
+    effectiveFrameRate_ = frameRate;
+    effectivePriority_ = static_cast<int>(priority);
+}
+
+
+UINT QosAccount::GetEffectiveFrameRate() const
+{
+    return effectiveFrameRate_;
+}
+
+
+QosPriority QosAccount::GetEffectivePriority() const
+{
+    return static_cast<QosPriority>(effectivePriority_.load());
+}
+
+
+void QosAccount::AddFrame(INT64 costMicroSeconds)
+{
+    // Smoothed so that a single slow frame (e.g. a texture reallocation) does not drop the rate.
+    const auto costMs = static_cast<float>(costMicroSeconds) / 1000.f;
+    const auto average = frameCostMs_.load(std::memory_order_relaxed);
+    frameCostMs_.store(average > 0.f ? average * 0.9f + costMs * 0.1f : costMs, std::memory_order_relaxed);
+    frameCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+INT64 QosAccount::GetFrameCount() const
+{
+    return frameCount_.load(std::memory_order_relaxed);
+}
+
+
+float QosAccount::GetFrameCostMs() const
+{
+    return frameCostMs_.load(std::memory_order_relaxed);
+}
+
+
+// Called by the main thread with the time since the previous call.
+void QosAccount::UpdateMeasuredFrameRate(double elapsedSeconds)
+{
+    if (elapsedSeconds <= 0.0) return;
+    const auto frameCount = GetFrameCount();
+    measuredFrameRate_ = static_cast<float>((frameCount - measuredFrameCount_) / elapsedSeconds);
+    measuredFrameCount_ = frameCount;
+}
+
+
+float QosAccount::GetMeasuredFrameRate() const
+{
+    return measuredFrameRate_;
+}
+
+
+
+void QosBudget::SetPixelBudget(INT64 pixelsPerSecond)
+{
+    pixelBudget_ = pixelsPerSecond > 0 ? pixelsPerSecond : 0;
+}
+
+
+INT64 QosBudget::GetPixelBudget()
+{
+    return pixelBudget_;
+}
+
+
+void QosBudget::SetCpuBudget(float msPerSecond)
+{
+    cpuBudget_ = msPerSecond > 0.f ? msPerSecond : 0.f;
+}
+
+
+float QosBudget::GetCpuBudget()
+{
+    return cpuBudget_;
+}
+
+
+
+namespace
+{
+
+
+void FitToBudget(std::vector<QosDemand>* demands, double budget, double QosDemand::*cost)
+{
+    if (budget <= 0.0) return;
+
+    double total = 0.0;
+    for (const auto& demand : *demands)
+    {
+        total += demand.frameRate * (demand.*cost);
+    }
+
+    for (int priority = 0; priority < static_cast<int>(QosPriority::Count) && total > budget; ++priority)
+    {
+        double reducible = 0.0;
+        for (const auto& demand : *demands)
+        {
+            if (static_cast<int>(demand.priority) != priority) continue;
+            reducible += (demand.frameRate - QosBudget::kMinFrameRate) * (demand.*cost);
+        }
+        if (reducible <= 0.0) continue;
+
+        // Every monitor of the class gives up the same share of its rate above the minimum.
+        // Rates are rounded down (with some slack for the floating point error of the ratio)
+        // so that the class never ends up above its share.
+        const auto ratio = (std::min)(1.0, (total - budget) / reducible);
+        for (auto& demand : *demands)
+        {
+            if (static_cast<int>(demand.priority) != priority) continue;
+            const auto excess = demand.frameRate - QosBudget::kMinFrameRate;
+            const auto reduction = (std::min)(excess, static_cast<UINT>(std::ceil(excess * ratio - 1e-6)));
+            demand.frameRate -= reduction;
+            total -= reduction * (demand.*cost);
+        }
+    }
+}
+
+
+}
+
+
+void ScheduleFrameRates(std::vector<QosDemand>* demands, INT64 pixelBudget, float cpuBudget)
+{
+    for (auto& demand : *demands)
+    {
+        demand.frameRate = (std::max)(demand.targetFrameRate, QosBudget::kMinFrameRate);
+    }
+
+    // Lowering rates for one budget never breaks the other, so they are simply applied in turn.
+    FitToBudget(demands, static_cast<double>(pixelBudget), &QosDemand::pixelCost);
+    FitToBudget(demands, static_cast<double>(cpuBudget), &QosDemand::cpuCost);
+}
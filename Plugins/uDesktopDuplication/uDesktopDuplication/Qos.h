@@ -0,0 +1,89 @@
+#pragma once
+
+#include <d3d11.h>
+#include <atomic>
+#include <vector>
+
+
+enum class QosPriority
+{
+    Low = 0,    // lowered first when over the budget
+    Normal = 1,
+    High = 2,   // the monitor holding the cursor is always raised to this
+    Count,
+};
+
+
+struct QosInfo
+{
+    int targetFrameRate;      // requested rate (0 follows the global frame rate)
+    int priority;             // requested priority
+    int effectiveFrameRate;   // rate the capture thread runs at after the budget
+    int effectivePriority;    // priority the scheduler used
+    float measuredFrameRate;  // frames actually acquired per second
+    float frameCostMs;        // average CPU time spent on an acquired frame
+    INT64 pixelsPerSecond;    // capture pixels at the effective rate
+};
+
+
+// Frame rate request of one monitor, the result of the scheduler and what the capture thread measured.
+// The main thread sets the request and the effective values, and the capture thread adds frames.
+class QosAccount final
+{
+public:
+    void SetTargetFrameRate(UINT frameRate);
+    UINT GetTargetFrameRate() const;
+    void SetPriority(QosPriority priority);
+    QosPriority GetPriority() const;
+    void SetEffective(UINT frameRate, QosPriority priority);
+    UINT GetEffectiveFrameRate() const;
+    QosPriority GetEffectivePriority() const;
+    void AddFrame(INT64 costMicroSeconds);
+    INT64 GetFrameCount() const;
+    float GetFrameCostMs() const;
+    void UpdateMeasuredFrameRate(double elapsedSeconds);
+    float GetMeasuredFrameRate() const;
+
+private:
+    std::atomic<UINT> targetFrameRate_ { 0 };
+    std::atomic<int> priority_ { static_cast<int>(QosPriority::Normal) };
+    std::atomic<UINT> effectiveFrameRate_ { 0 };
+    std::atomic<int> effectivePriority_ { static_cast<int>(QosPriority::Normal) };
+    std::atomic<INT64> frameCount_ { 0 };
+    std::atomic<float> frameCostMs_ { 0.f };
+    std::atomic<float> measuredFrameRate_ { 0.f };
+    INT64 measuredFrameCount_ = 0;
+};
+
+
+// Global limits enforced by MonitorManager::Update(); 0 means no limit.
+class QosBudget final
+{
+public:
+    static constexpr UINT kMinFrameRate = 1;
+
+    static void SetPixelBudget(INT64 pixelsPerSecond);
+    static INT64 GetPixelBudget();
+    static void SetCpuBudget(float msPerSecond);
+    static float GetCpuBudget();
+
+private:
+    static std::atomic<INT64> pixelBudget_;
+    static std::atomic<float> cpuBudget_;
+};
+
+
+// Input and output of ScheduleFrameRates(), one per monitor.
+struct QosDemand
+{
+    UINT targetFrameRate = 0;
+    QosPriority priority = QosPriority::Normal;
+    double pixelCost = 0.0; // pixels per frame
+    double cpuCost = 0.0;   // CPU milliseconds per frame
+    UINT frameRate = 0;     // result
+};
+
+// Starts every monitor at its target rate and, while a budget is exceeded, lowers the rates
+// of the lowest priority class proportionally (down to QosBudget::kMinFrameRate) before
+// touching the next class.
+void ScheduleFrameRates(std::vector<QosDemand>* demands, INT64 pixelBudget, float cpuBudget);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+
+
+
+// Session file layout (little endian, tightly packed):
+//   FileHeader
+//   { ChunkHeader, payload }*
+// A Frame chunk is laid out as FrameHeader, move rects, dirty rects and then
+// regionCount x { RegionHeader, RLE compressed BGRA pixels }.
+// A PointerShape chunk (PointerShapeHeader + shape buffer) precedes the frame it belongs to.
+namespace Record
+{
+    constexpr UINT kMagic = 0x52444455; // "UDDR"
+    constexpr UINT kVersion = 1;
+
+    enum class ChunkType : UINT
+    {
+        Frame = 0x4D415246,        // "FRAM"
+        PointerShape = 0x45504853, // "SHPE"
+    };
+
+#pragma pack(push, 1)
+    struct FileHeader
+    {
+        UINT magic;
+        UINT version;
+        UINT width;
+        UINT height;
+        UINT format;
+        UINT rotation;
+    };
+
+    struct ChunkHeader
+    {
+        ChunkType type;
+        UINT size;
+    };
+
+    struct FrameHeader
+    {
+        UINT64 timestamp; // [us] since the recording started
+        UINT id;
+        DXGI_OUTDUPL_FRAME_INFO info;
+        UINT moveRectCount;
+        UINT dirtyRectCount;
+        UINT regionCount;
+    };
+
+    struct RegionHeader
+    {
+        RECT rect;
+        UINT size;
+    };
+
+    struct PointerShapeHeader
+    {
+        DXGI_OUTDUPL_POINTER_SHAPE_INFO info;
+        UINT size;
+    };
+#pragma pack(pop)
+}
@@ -0,0 +1,329 @@
+#include <algorithm>
+
+#include "Recorder.h"
+#include "Codec.h"
+#include "Cursor.h"
+#include "Monitor.h"
+#include "MonitorManager.h"
+#include "Debug.h"
+
+using namespace Microsoft::WRL;
+
+
+
+namespace
+{
+    template <class T>
+    void Append(std::vector<BYTE>& buffer, const T* data, size_t count = 1)
+    {
+        const auto bytes = reinterpret_cast<const BYTE*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T) * count);
+    }
+}
+
+
+
+Recorder::Recorder()
+{
+}
+
+
+Recorder::~Recorder()
+{
+    Stop();
+}
+
+
+bool Recorder::Start(const std::string& path)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (fs_.is_open())
+    {
+        fs_.close();
+    }
+
+    fs_.open(path, std::ios::binary | std::ios::trunc);
+    if (!fs_.good())
+    {
+        UDD_ERROR("Recorder::Start() => Could not open ", path.c_str(), ".");
+        return false;
+    }
+
+    isHeaderWritten_ = false;
+    startTime_ = std::chrono::steady_clock::now();
+    UDD_LOG("Recorder::Start() => ", path.c_str());
+
+    return true;
+}
+
+
+void Recorder::Stop()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!fs_.is_open()) return;
+
+    fs_.close();
+    stagingTexture_.Reset();
+    UDD_LOG("Recorder::Stop()");
+}
+
+
+bool Recorder::IsRecording() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fs_.is_open();
+}
+
+
+void Recorder::Record(Duplicator* duplicator, const Duplicator::Frame& frame)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!fs_.is_open() || !frame.texture) return;
+
+    D3D11_TEXTURE2D_DESC desc;
+    frame.texture->GetDesc(&desc);
+
+    // The first frame is always stored as a key frame so that replay starts from a complete image.
+    const auto isKeyFrame = !isHeaderWritten_;
+    if (isKeyFrame)
+    {
+        const auto rotation = static_cast<DXGI_MODE_ROTATION>(duplicator->GetMonitor()->GetRotation());
+        if (!WriteFileHeader(desc, rotation) ||
+            !CreateStagingTexture(duplicator->GetDevice(), desc))
+        {
+            fs_.close();
+            return;
+        }
+    }
+    else if (desc.Width != desc_.Width || desc.Height != desc_.Height || desc.Format != desc_.Format)
+    {
+        UDD_ERROR("Recorder::Record() => Texture size or format has changed, so stop recording.");
+        fs_.close();
+        stagingTexture_.Reset();
+        return;
+    }
+
+    if (isKeyFrame)
+    {
+        regions_.clear();
+        regions_.push_back({ 0, 0, static_cast<LONG>(desc.Width), static_cast<LONG>(desc.Height) });
+    }
+    else
+    {
+        CollectRegions(frame, desc.Width, desc.Height);
+    }
+
+    ComPtr<ID3D11DeviceContext> context;
+    duplicator->GetDevice()->GetImmediateContext(&context);
+
+    for (const auto& rect : regions_)
+    {
+        const D3D11_BOX box =
+        {
+            static_cast<UINT>(rect.left),
+            static_cast<UINT>(rect.top),
+            0,
+            static_cast<UINT>(rect.right),
+            static_cast<UINT>(rect.bottom),
+            1
+        };
+        context->CopySubresourceRegion(
+            stagingTexture_.Get(), 0, box.left, box.top, 0,
+            frame.texture.Get(), 0, &box);
+    }
+
+    const auto& metaData = frame.metaData;
+    const auto moveRectCount = metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    const auto dirtyRectCount = metaData.dirtyRectSize / sizeof(RECT);
+
+    const auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime_).count();
+
+    Record::FrameHeader header = {};
+    header.timestamp = static_cast<UINT64>(timestamp);
+    header.id = frame.id;
+    header.info = frame.info;
+    header.moveRectCount = static_cast<UINT>(moveRectCount);
+    header.dirtyRectCount = static_cast<UINT>(dirtyRectCount);
+    header.regionCount = static_cast<UINT>(regions_.size());
+
+    payload_.clear();
+    Append(payload_, &header);
+    if (moveRectCount > 0)
+    {
+        Append(payload_, metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>(), moveRectCount);
+    }
+    if (dirtyRectCount > 0)
+    {
+        Append(payload_, metaData.buffer.As<RECT>(metaData.moveRectSize), dirtyRectCount);
+    }
+
+    if (!regions_.empty())
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        if (FAILED(context->Map(stagingTexture_.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+        {
+            UDD_ERROR("Recorder::Record() => Map() failed.");
+            return;
+        }
+
+        for (const auto& rect : regions_)
+        {
+            const auto offset = payload_.size();
+            Record::RegionHeader region = { rect, 0 };
+            Append(payload_, &region);
+
+            const auto src =
+                static_cast<const BYTE*>(mapped.pData) +
+                rect.top * mapped.RowPitch +
+                rect.left * sizeof(UINT);
+            Codec::EncodeRle(
+                src,
+                rect.right - rect.left,
+                rect.bottom - rect.top,
+                mapped.RowPitch,
+                payload_);
+
+            region.size = static_cast<UINT>(payload_.size() - offset - sizeof(region));
+            std::memcpy(payload_.data() + offset, &region, sizeof(region));
+        }
+
+        context->Unmap(stagingTexture_.Get(), 0);
+    }
+
+    WritePointerShape(duplicator, frame);
+    WriteChunk(Record::ChunkType::Frame, payload_);
+}
+
+
+bool Recorder::WriteFileHeader(const D3D11_TEXTURE2D_DESC& desc, DXGI_MODE_ROTATION rotation)
+{
+    if (desc.Format != DXGI_FORMAT_B8G8R8A8_UNORM)
+    {
+        UDD_ERROR("Recorder::WriteFileHeader() => Only B8G8R8A8 desktop images can be recorded.");
+        return false;
+    }
+
+    const Record::FileHeader header =
+    {
+        Record::kMagic,
+        Record::kVersion,
+        desc.Width,
+        desc.Height,
+        static_cast<UINT>(desc.Format),
+        static_cast<UINT>(rotation),
+    };
+    fs_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    desc_ = desc;
+    isHeaderWritten_ = true;
+
+    return fs_.good();
+}
+
+
+bool Recorder::CreateStagingTexture(
+    const ComPtr<ID3D11Device>& device,
+    const D3D11_TEXTURE2D_DESC& srcDesc)
+{
+    D3D11_TEXTURE2D_DESC desc;
+    desc.Width              = srcDesc.Width;
+    desc.Height             = srcDesc.Height;
+    desc.MipLevels          = 1;
+    desc.ArraySize          = 1;
+    desc.Format             = srcDesc.Format;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Usage              = D3D11_USAGE_STAGING;
+    desc.BindFlags          = 0;
+    desc.CPUAccessFlags     = D3D11_CPU_ACCESS_READ;
+    desc.MiscFlags          = 0;
+
+    if (FAILED(device->CreateTexture2D(&desc, nullptr, &stagingTexture_)))
+    {
+        UDD_ERROR("Recorder::CreateStagingTexture() => CreateTexture2D() failed.");
+        return false;
+    }
+
+    return true;
+}
+
+
+void Recorder::CollectRegions(const Duplicator::Frame& frame, UINT width, UINT height)
+{
+    regions_.clear();
+
+    const auto addRegion = [&](const RECT& rect)
+    {
+        RECT clipped;
+        clipped.left   = std::max<LONG>(rect.left, 0);
+        clipped.top    = std::max<LONG>(rect.top, 0);
+        clipped.right  = std::min<LONG>(rect.right, static_cast<LONG>(width));
+        clipped.bottom = std::min<LONG>(rect.bottom, static_cast<LONG>(height));
+        if (clipped.left < clipped.right && clipped.top < clipped.bottom)
+        {
+            regions_.push_back(clipped);
+        }
+    };
+
+    // Pixels of move destinations are stored too, so the replayed image never depends on
+    // how the move rects are applied.
+    const auto& metaData = frame.metaData;
+    const auto moveRects = metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>();
+    const auto moveRectCount = metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    for (UINT i = 0; i < moveRectCount; ++i)
+    {
+        addRegion(moveRects[i].DestinationRect);
+    }
+
+    const auto dirtyRects = metaData.buffer.As<RECT>(metaData.moveRectSize);
+    const auto dirtyRectCount = metaData.dirtyRectSize / sizeof(RECT);
+    for (UINT i = 0; i < dirtyRectCount; ++i)
+    {
+        addRegion(dirtyRects[i]);
+    }
+}
+
+
+void Recorder::WritePointerShape(Duplicator* duplicator, const Duplicator::Frame& frame)
+{
+    const auto size = frame.info.PointerShapeBufferSize;
+    if (size == 0) return;
+
+    auto& manager = GetMonitorManager();
+    if (manager->GetCursorMonitorId() != duplicator->GetMonitor()->GetId()) return;
+
+    const auto cursor = manager->GetCursor();
+    const auto& buffer = cursor->GetShapeBuffer();
+    if (!buffer || buffer.Size() < size) return;
+
+    std::vector<BYTE> payload;
+    const Record::PointerShapeHeader header = { cursor->GetShapeInfo(), size };
+    Append(payload, &header);
+    Append(payload, buffer.Get(), size);
+    WriteChunk(Record::ChunkType::PointerShape, payload);
+}
+
+
+void Recorder::WriteChunk(Record::ChunkType type, const std::vector<BYTE>& payload)
+{
+    const Record::ChunkHeader header = { type, static_cast<UINT>(payload.size()) };
+    fs_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fs_.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+    if (!fs_.good())
+    {
+        UDD_ERROR("Recorder::WriteChunk() => Failed to write, so stop recording.");
+        fs_.close();
+        stagingTexture_.Reset();
+    }
+}
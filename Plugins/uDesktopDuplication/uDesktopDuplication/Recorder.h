@@ -0,0 +1,45 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <wrl/client.h>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Record.h"
+#include "Duplicator.h"
+
+
+
+// Writes frames published by a Duplicator into a session file
+class Recorder final
+{
+public:
+    Recorder();
+    ~Recorder();
+    bool Start(const std::string& path);
+    void Stop();
+    bool IsRecording() const;
+    void Record(Duplicator* duplicator, const Duplicator::Frame& frame);
+
+private:
+    bool WriteFileHeader(const D3D11_TEXTURE2D_DESC& desc, DXGI_MODE_ROTATION rotation);
+    bool CreateStagingTexture(
+        const Microsoft::WRL::ComPtr<ID3D11Device>& device,
+        const D3D11_TEXTURE2D_DESC& desc);
+    void CollectRegions(const Duplicator::Frame& frame, UINT width, UINT height);
+    void WritePointerShape(Duplicator* duplicator, const Duplicator::Frame& frame);
+    void WriteChunk(Record::ChunkType type, const std::vector<BYTE>& payload);
+
+    std::ofstream fs_;
+    mutable std::mutex mutex_;
+    bool isHeaderWritten_ = false;
+    std::chrono::time_point<std::chrono::steady_clock> startTime_;
+    D3D11_TEXTURE2D_DESC desc_ = {};
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> stagingTexture_;
+    std::vector<RECT> regions_;
+    std::vector<BYTE> payload_;
+};
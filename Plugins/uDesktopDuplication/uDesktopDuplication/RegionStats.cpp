@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "Kernels.h"
+#include "RegionStats.h"
+
+
+
+constexpr int RegionStats::kHistogramBinCount;
+
+
+
+RegionStats::RegionStats(int cellSize)
+    : cellSize_((std::max)(cellSize, 1))
+    , histogram_(kHistogramBinCount)
+{
+}
+
+
+void RegionStats::Update(
+    uint32_t frameId,
+    const uint8_t* pixels,
+    uint32_t pitch,
+    int width,
+    int height,
+    const Rect* rects,
+    size_t rectCount)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    if (width <= 0 || height <= 0) return;
+
+    const bool isSizeChanged = width != width_ || height != height_;
+    const bool isFullUpdate = !hasFrame_ || isSizeChanged || frameId != frameId_ + 1;
+    if (isSizeChanged)
+    {
+        Resize(width, height);
+    }
+
+    if (isFullUpdate)
+    {
+        std::fill(histogram_.begin(), histogram_.end(), 0);
+        lumaSum_ = 0;
+        UpdateCells(pixels, pitch, 0, 0, columnCount_ - 1, rowCount_ - 1, true);
+        UpdateTable(0);
+    }
+    else
+    {
+        // Rects often overlap (e.g. the cursor areas and the dirty rects under them),
+        // so the touched cells are marked first and every cell is read only once.
+        int minColumn = columnCount_, minRow = rowCount_, maxColumn = -1, maxRow = -1;
+        for (size_t i = 0; i < rectCount; ++i)
+        {
+            const auto left   = (std::max)(rects[i].left, 0);
+            const auto top    = (std::max)(rects[i].top, 0);
+            const auto right  = (std::min)(rects[i].right, width_);
+            const auto bottom = (std::min)(rects[i].bottom, height_);
+            if (left >= right || top >= bottom) continue;
+
+            const auto column0 = left / cellSize_;
+            const auto row0 = top / cellSize_;
+            const auto column1 = (right - 1) / cellSize_;
+            const auto row1 = (bottom - 1) / cellSize_;
+            for (int row = row0; row <= row1; ++row)
+            {
+                std::fill_n(dirtyCells_.begin() + row * columnCount_ + column0, column1 - column0 + 1, 1);
+            }
+            minColumn = (std::min)(minColumn, column0);
+            minRow = (std::min)(minRow, row0);
+            maxColumn = (std::max)(maxColumn, column1);
+            maxRow = (std::max)(maxRow, row1);
+        }
+
+        for (int row = minRow; row <= maxRow; ++row)
+        {
+            auto cells = dirtyCells_.data() + row * columnCount_;
+            for (int column = minColumn; column <= maxColumn; )
+            {
+                if (!cells[column])
+                {
+                    ++column;
+                    continue;
+                }
+
+                int end = column;
+                while (end + 1 <= maxColumn && cells[end + 1]) ++end;
+                UpdateCells(pixels, pitch, column, row, end, row, false);
+                std::fill(cells + column, cells + end + 1, 0);
+                column = end + 1;
+            }
+        }
+
+        // Cells only change the table below and to the right of them.
+        if (maxRow >= 0)
+        {
+            UpdateTable(minRow);
+        }
+    }
+
+    hasFrame_ = true;
+    frameId_ = frameId;
+
+    const auto elapsed = std::chrono::steady_clock::now() - startTime;
+    updateMs_ = std::chrono::duration<float, std::milli>(elapsed).count();
+}
+
+
+RegionMean RegionStats::GetMean(const Rect& rect) const
+{
+    RegionMean mean = {};
+    if (!HasImage()) return mean;
+
+    const auto left   = (std::max)(rect.left, 0);
+    const auto top    = (std::max)(rect.top, 0);
+    const auto right  = (std::min)(rect.right, width_);
+    const auto bottom = (std::min)(rect.bottom, height_);
+    if (left >= right || top >= bottom) return mean;
+
+    // Edges are snapped to the nearest cell edge (the image border is one too), keeping at least one cell.
+    const auto snap = [this](int value, int size, int count)
+    {
+        return value == size ? count : (std::min)((value + cellSize_ / 2) / cellSize_, count);
+    };
+    auto column0 = snap(left, width_, columnCount_);
+    auto row0 = snap(top, height_, rowCount_);
+    auto column1 = snap(right, width_, columnCount_);
+    auto row1 = snap(bottom, height_, rowCount_);
+    if (column1 <= column0)
+    {
+        column0 = (std::min)(column0, columnCount_ - 1);
+        column1 = column0 + 1;
+    }
+    if (row1 <= row0)
+    {
+        row0 = (std::min)(row0, rowCount_ - 1);
+        row1 = row0 + 1;
+    }
+
+    const auto stride = static_cast<size_t>(columnCount_ + 1) * 3;
+    const auto at = [this, stride](int row, int column)
+    {
+        return table_.data() + row * stride + column * 3;
+    };
+    const auto a = at(row0, column0);
+    const auto b = at(row0, column1);
+    const auto c = at(row1, column0);
+    const auto d = at(row1, column1);
+
+    // Cells on the right and bottom edges of the image can be smaller than cellSize.
+    const auto pixelCount =
+        static_cast<double>((std::min)(column1 * cellSize_, width_) - column0 * cellSize_) *
+        static_cast<double>((std::min)(row1 * cellSize_, height_) - row0 * cellSize_);
+
+    mean.b = static_cast<float>((d[0] - b[0] - c[0] + a[0]) / pixelCount);
+    mean.g = static_cast<float>((d[1] - b[1] - c[1] + a[1]) / pixelCount);
+    mean.r = static_cast<float>((d[2] - b[2] - c[2] + a[2]) / pixelCount);
+    mean.luma = (mean.r * 54.f + mean.g * 183.f + mean.b * 19.f) / 256.f;
+    return mean;
+}
+
+
+float RegionStats::GetMeanLuma() const
+{
+    if (!HasImage()) return 0.f;
+    return static_cast<float>(static_cast<double>(lumaSum_) / (static_cast<double>(width_) * height_));
+}
+
+
+int64_t RegionStats::GetByteSize() const
+{
+    return
+        static_cast<int64_t>(cellSums_.size() * sizeof(uint32_t)) +
+        static_cast<int64_t>(table_.size() * sizeof(uint64_t)) +
+        static_cast<int64_t>(luma_.size()) +
+        static_cast<int64_t>(dirtyCells_.size()) +
+        static_cast<int64_t>(lumaRow_.size()) +
+        static_cast<int64_t>(histogram_.size() * sizeof(uint32_t));
+}
+
+
+void RegionStats::Resize(int width, int height)
+{
+    width_ = width;
+    height_ = height;
+    columnCount_ = (width_ + cellSize_ - 1) / cellSize_;
+    rowCount_ = (height_ + cellSize_ - 1) / cellSize_;
+
+    const auto cellCount = static_cast<size_t>(columnCount_) * rowCount_;
+    cellSums_.assign(cellCount * 3, 0);
+    table_.assign(static_cast<size_t>(columnCount_ + 1) * (rowCount_ + 1) * 3, 0);
+    luma_.assign(static_cast<size_t>(width_) * height_, 0);
+    dirtyCells_.assign(cellCount, 0);
+}
+
+
+void RegionStats::UpdateCells(const uint8_t* pixels, uint32_t pitch, int column0, int row0, int column1, int row1, bool isFullUpdate)
+{
+    const auto x0 = column0 * cellSize_;
+    const auto x1 = (std::min)((column1 + 1) * cellSize_, width_);
+    const auto count = static_cast<uint32_t>(x1 - x0);
+
+    if (lumaRow_.size() < count) lumaRow_.resize(width_);
+
+    for (int row = row0; row <= row1; ++row)
+    {
+        auto sums = cellSums_.data() + (static_cast<size_t>(row) * columnCount_ + column0) * 3;
+        std::fill(sums, sums + (column1 - column0 + 1) * 3, 0);
+
+        const auto y0 = row * cellSize_;
+        const auto y1 = (std::min)(y0 + cellSize_, height_);
+        for (int y = y0; y < y1; ++y)
+        {
+            const auto src = pixels + static_cast<size_t>(y) * pitch + x0 * 4;
+
+            // The histogram only changes where the luma did, which is a small part of most dirty rects.
+            Kernels::ComputeLuma(src, count, lumaRow_.data());
+            auto luma = luma_.data() + static_cast<size_t>(y) * width_ + x0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const auto newLuma = lumaRow_[i];
+                if (isFullUpdate)
+                {
+                    ++histogram_[newLuma];
+                    lumaSum_ += newLuma;
+                }
+                else if (luma[i] != newLuma)
+                {
+                    --histogram_[luma[i]];
+                    ++histogram_[newLuma];
+                    lumaSum_ += newLuma;
+                    lumaSum_ -= luma[i];
+                }
+            }
+            std::memcpy(luma, lumaRow_.data(), count);
+
+            for (int column = column0; column <= column1; ++column)
+            {
+                const auto cellX0 = column * cellSize_;
+                const auto cellX1 = (std::min)(cellX0 + cellSize_, width_);
+                auto sum = sums + (column - column0) * 3;
+                for (auto pixel = src + (cellX0 - x0) * 4, end = src + (cellX1 - x0) * 4; pixel != end; pixel += 4)
+                {
+                    sum[0] += pixel[0];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[2];
+                }
+            }
+        }
+    }
+}
+
+
+void RegionStats::UpdateTable(int row0)
+{
+    const auto stride = static_cast<size_t>(columnCount_ + 1) * 3;
+    for (int row = row0; row < rowCount_; ++row)
+    {
+        const auto sums = cellSums_.data() + static_cast<size_t>(row) * columnCount_ * 3;
+        const auto above = table_.data() + row * stride;
+        auto current = table_.data() + (row + 1) * stride;
+
+        uint64_t rowSum[3] = {};
+        for (int column = 0; column < columnCount_; ++column)
+        {
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                rowSum[channel] += sums[column * 3 + channel];
+                current[(column + 1) * 3 + channel] = above[(column + 1) * 3 + channel] + rowSum[channel];
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+
+// Mean color of a rect (0 - 255). The layout is shared with RegionMean in Lib.cs.
+struct RegionMean
+{
+    float r;
+    float g;
+    float b;
+    float luma;
+};
+
+
+// Statistics of a BGRA desktop image which are kept up to date from the changed rects of each frame
+// (see Monitor::EnableRegionStats()).
+//
+// The image is split into cells of cellSize x cellSize pixels, and a summed-area table of the cell
+// sums gives the mean of any rect in O(1). Rects are snapped to the nearest cell edges, so cellSize 1
+// is exact and larger cells trade edge precision for memory. A luma plane is kept next to the tables
+// so that the luma histogram is updated by removing the old pixels of a changed rect and adding the new ones.
+//
+// Everything is in desktop image coordinates and the class has no platform dependency.
+class RegionStats final
+{
+public:
+    struct Rect
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    static constexpr int kHistogramBinCount = 256;
+
+    explicit RegionStats(int cellSize);
+
+    // rects are the parts changed since the previous frame. The whole image is taken instead for
+    // the first frame, after a size change, and when frames were skipped (frameId is not the next one).
+    void Update(
+        uint32_t frameId,
+        const uint8_t* pixels,
+        uint32_t pitch,
+        int width,
+        int height,
+        const Rect* rects,
+        size_t rectCount);
+
+    RegionMean GetMean(const Rect& rect) const;
+    const uint32_t* GetHistogram() const { return histogram_.data(); }
+    float GetMeanLuma() const;
+
+    bool HasImage() const { return hasFrame_; }
+    uint32_t GetFrameId() const { return frameId_; }
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+    int GetCellSize() const { return cellSize_; }
+    float GetUpdateMs() const { return updateMs_; }
+    int64_t GetByteSize() const;
+
+private:
+    void Resize(int width, int height);
+    void UpdateCells(const uint8_t* pixels, uint32_t pitch, int column0, int row0, int column1, int row1, bool isFullUpdate);
+    void UpdateTable(int row0);
+
+    const int cellSize_;
+    int width_ = 0;
+    int height_ = 0;
+    int columnCount_ = 0;
+    int rowCount_ = 0;
+    bool hasFrame_ = false;
+    uint32_t frameId_ = 0;
+    float updateMs_ = 0.f;
+
+    // Per cell B, G, R sums and their summed-area table with one extra row and column of zeros.
+    std::vector<uint32_t> cellSums_;
+    std::vector<uint64_t> table_;
+    std::vector<uint8_t> luma_;
+    std::vector<uint32_t> histogram_;
+    uint64_t lumaSum_ = 0;
+    std::vector<uint8_t> dirtyCells_;
+    std::vector<uint8_t> lumaRow_;
+};
@@ -0,0 +1,501 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "ReplayRing.h"
+#include "Codec.h"
+#include "Crop.h"
+#include "Cursor.h"
+#include "Kernels.h"
+#include "Memory.h"
+#include "Monitor.h"
+#include "MonitorManager.h"
+#include "Debug.h"
+
+using namespace Microsoft::WRL;
+
+
+
+namespace
+{
+    using Seconds = std::chrono::duration<float>;
+
+    template <class T>
+    void Append(std::vector<BYTE>& buffer, const T* data, size_t count = 1)
+    {
+        const auto bytes = reinterpret_cast<const BYTE*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T) * count);
+    }
+
+    void AppendChunk(std::vector<BYTE>& buffer, Record::ChunkType type, const std::vector<BYTE>& payload)
+    {
+        const Record::ChunkHeader header = { type, static_cast<UINT>(payload.size()) };
+        Append(buffer, &header);
+        buffer.insert(buffer.end(), payload.begin(), payload.end());
+    }
+}
+
+
+
+constexpr int ReplayRing::kTileSize;
+constexpr float ReplayRing::kAddMsSmoothing;
+
+
+
+ReplayRing::ReplayRing(INT64 maxBytes, float durationSec, float keyFrameIntervalSec)
+    : maxBytes_(maxBytes)
+    , duration_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(Seconds(durationSec)))
+    , keyFrameInterval_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(Seconds(keyFrameIntervalSec)))
+{
+}
+
+
+ReplayRing::~ReplayRing()
+{
+    if (exportThread_.joinable())
+    {
+        exportThread_.join();
+    }
+}
+
+
+void ReplayRing::Add(Duplicator* duplicator, const Duplicator::Frame& frame)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (!frame.texture) return;
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // Deltas only apply to the same image, so the ring starts over when the size, the format or the crop changes.
+    D3D11_TEXTURE2D_DESC desc;
+    frame.texture->GetDesc(&desc);
+    if (desc.Width  != desc_.Width ||
+        desc.Height != desc_.Height ||
+        desc.Format != desc_.Format ||
+        !Crop::IsEqual(frame.area, area_))
+    {
+        Reset(duplicator, frame, desc);
+    }
+    if (!stagingTexture_) return;
+
+    const bool isKeyFrame =
+        needsKeyFrame_ ||
+        frame.id != lastFrameId_ + 1 ||
+        startTime - lastKeyFrameTime_ >= keyFrameInterval_;
+    lastFrameId_ = frame.id;
+
+    regions_.clear();
+    if (isKeyFrame)
+    {
+        regions_.push_back({ 0, 0, static_cast<LONG>(desc_.Width), static_cast<LONG>(desc_.Height) });
+    }
+    else
+    {
+        CollectTiles(frame);
+    }
+
+    ComPtr<ID3D11DeviceContext> context;
+    duplicator->GetDevice()->GetImmediateContext(&context);
+
+    for (const auto& rect : regions_)
+    {
+        const D3D11_BOX box =
+        {
+            static_cast<UINT>(rect.left),
+            static_cast<UINT>(rect.top),
+            0,
+            static_cast<UINT>(rect.right),
+            static_cast<UINT>(rect.bottom),
+            1
+        };
+        context->CopySubresourceRegion(
+            stagingTexture_.Get(), 0, box.left, box.top, 0,
+            frame.texture.Get(), 0, &box);
+    }
+
+    // The shape comes first as in session files. Key frames carry the current one so that
+    // an export starting from them shows the right cursor.
+    std::vector<BYTE> chunks;
+    UINT shapeSize = 0;
+    AppendPointerShape(duplicator, frame, isKeyFrame, chunks, &shapeSize);
+
+    const auto& metaData = frame.metaData;
+    const auto moveRectCount = metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    const auto dirtyRectCount = metaData.dirtyRectSize / sizeof(RECT);
+
+    Record::FrameHeader header = {};
+    header.timestamp = static_cast<UINT64>(
+        std::chrono::duration_cast<std::chrono::microseconds>(startTime - startTime_).count());
+    header.id = frame.id;
+    header.info = frame.info;
+    header.info.PointerShapeBufferSize = shapeSize;
+    header.moveRectCount = static_cast<UINT>(moveRectCount);
+    header.dirtyRectCount = static_cast<UINT>(dirtyRectCount);
+    header.regionCount = static_cast<UINT>(regions_.size());
+
+    payload_.clear();
+    Append(payload_, &header);
+    if (moveRectCount > 0)
+    {
+        Append(payload_, metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>(), moveRectCount);
+    }
+    if (dirtyRectCount > 0)
+    {
+        Append(payload_, metaData.buffer.As<RECT>(metaData.moveRectSize), dirtyRectCount);
+    }
+
+    if (!regions_.empty())
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        if (FAILED(context->Map(stagingTexture_.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+        {
+            UDD_ERROR("ReplayRing::Add() => Map() failed.");
+            needsKeyFrame_ = true;
+            return;
+        }
+
+        Codec::EncodeRegions(
+            static_cast<const BYTE*>(mapped.pData),
+            mapped.RowPitch,
+            regions_.data(),
+            regions_.size(),
+            payload_);
+
+        context->Unmap(stagingTexture_.Get(), 0);
+    }
+
+    AppendChunk(chunks, Record::ChunkType::Frame, payload_);
+
+    if (isKeyFrame)
+    {
+        lastKeyFrameTime_ = startTime;
+        needsKeyFrame_ = false;
+    }
+
+    Entry entry;
+    entry.time = startTime;
+    entry.isKeyFrame = isKeyFrame;
+    entry.chunks = std::make_shared<const std::vector<BYTE>>(std::move(chunks));
+
+    const auto elapsed = std::chrono::steady_clock::now() - startTime;
+    const auto addMs = std::chrono::duration<float, std::milli>(elapsed).count();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        addMs_ = entries_.empty() ? addMs : addMs_ + (addMs - addMs_) * kAddMsSmoothing;
+    }
+    Push(std::move(entry));
+
+    duplicator->GetMonitor()->GetMemoryAccount().Set(MemoryCategory::ReplayRing, GetByteSize());
+}
+
+
+bool ReplayRing::Export(const std::string& path, ReplayExportFormat format)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (exportState_ == ReplayExportState::Exporting)
+    {
+        UDD_ERROR("ReplayRing::Export() => The last export has not finished yet.");
+        return false;
+    }
+
+    if (exportThread_.joinable())
+    {
+        exportThread_.join();
+    }
+
+    // Chunks are immutable and shared, so the ring keeps taking frames while they are written.
+    std::vector<Entry> entries;
+    Record::FileHeader header;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries.assign(entries_.begin(), entries_.end());
+        header = fileHeader_;
+    }
+
+    if (entries.empty())
+    {
+        UDD_ERROR("ReplayRing::Export() => No frames have been kept yet.");
+        return false;
+    }
+
+    exportState_ = ReplayExportState::Exporting;
+    exportThread_ = std::thread([this, path, format, header, entries = std::move(entries)]
+    {
+        Trace::SetThreadName("Replay Export Thread");
+
+        const bool succeeded = format == ReplayExportFormat::QoiSequence ?
+            WriteQoiSequence(path, header, entries) :
+            WriteSession(path, header, entries);
+        if (succeeded)
+        {
+            UDD_LOG("ReplayRing::Export() => ", path.c_str(), " (", entries.size(), " frames)");
+        }
+        exportState_ = succeeded ? ReplayExportState::Completed : ReplayExportState::Failed;
+    });
+
+    return true;
+}
+
+
+ReplayExportState ReplayRing::GetExportState() const
+{
+    return exportState_;
+}
+
+
+void ReplayRing::GetInfo(ReplayRingInfo* info) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    info->bytes = bytes_ + stagingBytes_;
+    info->maxBytes = maxBytes_;
+    info->frameCount = static_cast<int>(entries_.size());
+    info->keyFrameCount = keyFrameCount_;
+    info->durationSec = entries_.empty() ? 0.f : Seconds(entries_.back().time - entries_.front().time).count();
+    info->addMs = addMs_;
+}
+
+
+INT64 ReplayRing::GetByteSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_ + stagingBytes_;
+}
+
+
+void ReplayRing::Reset(Duplicator* duplicator, const Duplicator::Frame& frame, const D3D11_TEXTURE2D_DESC& srcDesc)
+{
+    desc_ = srcDesc;
+    area_ = frame.area;
+    stagingTexture_.Reset();
+    needsKeyFrame_ = true;
+    startTime_ = std::chrono::steady_clock::now();
+
+    const auto rotation = duplicator->GetMonitor()->GetRotation();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        bytes_ = 0;
+        stagingBytes_ = 0;
+        keyFrameCount_ = 0;
+        fileHeader_ =
+        {
+            Record::kMagic,
+            Record::kVersion,
+            srcDesc.Width,
+            srcDesc.Height,
+            static_cast<UINT>(srcDesc.Format),
+            static_cast<UINT>(rotation),
+        };
+    }
+
+    if (srcDesc.Format != DXGI_FORMAT_B8G8R8A8_UNORM)
+    {
+        UDD_ERROR("ReplayRing::Reset() => Only B8G8R8A8 desktop images can be kept.");
+        return;
+    }
+
+    D3D11_TEXTURE2D_DESC desc;
+    desc.Width              = srcDesc.Width;
+    desc.Height             = srcDesc.Height;
+    desc.MipLevels          = 1;
+    desc.ArraySize          = 1;
+    desc.Format             = srcDesc.Format;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Usage              = D3D11_USAGE_STAGING;
+    desc.BindFlags          = 0;
+    desc.CPUAccessFlags     = D3D11_CPU_ACCESS_READ;
+    desc.MiscFlags          = 0;
+
+    if (FAILED(duplicator->GetDevice()->CreateTexture2D(&desc, nullptr, &stagingTexture_)))
+    {
+        UDD_ERROR("ReplayRing::Reset() => CreateTexture2D() failed.");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stagingBytes_ = GetTextureByteSize(desc);
+    }
+
+    tiles_.Reset(static_cast<int>(desc.Width), static_cast<int>(desc.Height));
+}
+
+
+void ReplayRing::CollectTiles(const Duplicator::Frame& frame)
+{
+    // Pixels of move destinations are stored too, as Recorder does.
+    const auto& metaData = frame.metaData;
+    const auto moveRects = metaData.buffer.As<DXGI_OUTDUPL_MOVE_RECT>();
+    const auto moveRectCount = metaData.moveRectSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    for (UINT i = 0; i < moveRectCount; ++i)
+    {
+        tiles_.Mark(moveRects[i].DestinationRect);
+    }
+
+    const auto dirtyRects = metaData.buffer.As<RECT>(metaData.moveRectSize);
+    const auto dirtyRectCount = metaData.dirtyRectSize / sizeof(RECT);
+    for (UINT i = 0; i < dirtyRectCount; ++i)
+    {
+        tiles_.Mark(dirtyRects[i]);
+    }
+
+    tiles_.Collect(&regions_);
+}
+
+
+void ReplayRing::AppendPointerShape(
+    Duplicator* duplicator,
+    const Duplicator::Frame& frame,
+    bool isKeyFrame,
+    std::vector<BYTE>& chunks,
+    UINT* shapeSize)
+{
+    *shapeSize = 0;
+    if (!isKeyFrame && frame.info.PointerShapeBufferSize == 0) return;
+
+    auto& manager = GetMonitorManager();
+    if (manager->GetCursorMonitorId() != duplicator->GetMonitor()->GetId()) return;
+
+    const auto cursor = manager->GetCursor();
+    const auto& buffer = cursor->GetShapeBuffer();
+    const auto& shapeInfo = cursor->GetShapeInfo();
+    const auto size = isKeyFrame ? shapeInfo.Pitch * shapeInfo.Height : frame.info.PointerShapeBufferSize;
+    if (size == 0 || !buffer || buffer.Size() < size) return;
+
+    std::vector<BYTE> payload;
+    const Record::PointerShapeHeader header = { shapeInfo, size };
+    Append(payload, &header);
+    Append(payload, buffer.Get(), size);
+    AppendChunk(chunks, Record::ChunkType::PointerShape, payload);
+    *shapeSize = size;
+}
+
+
+void ReplayRing::Push(Entry&& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto newestTime = entry.time;
+    bytes_ += static_cast<INT64>(entry.chunks->size());
+    if (entry.isKeyFrame) ++keyFrameCount_;
+    entries_.push_back(std::move(entry));
+
+    // The oldest key frame goes with its deltas, either when the rest still covers the duration
+    // or when the ring is too large.
+    while (keyFrameCount_ > 1)
+    {
+        const auto next = std::find_if(
+            entries_.begin() + 1,
+            entries_.end(),
+            [](const Entry& e) { return e.isKeyFrame; });
+        if (newestTime - next->time < duration_ && bytes_ <= maxBytes_) break;
+
+        for (auto it = entries_.begin(); it != next; ++it)
+        {
+            bytes_ -= static_cast<INT64>(it->chunks->size());
+        }
+        entries_.erase(entries_.begin(), next);
+        --keyFrameCount_;
+    }
+
+    // A single group only shrinks by starting the next one, which is worth it
+    // when its deltas have grown larger than the key frame.
+    const auto keyFrameBytes = static_cast<INT64>(entries_.front().chunks->size());
+    if (bytes_ > maxBytes_ && bytes_ - keyFrameBytes > keyFrameBytes)
+    {
+        needsKeyFrame_ = true;
+    }
+}
+
+
+bool ReplayRing::WriteSession(const std::string& path, const Record::FileHeader& header, const std::vector<Entry>& entries)
+{
+    std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+    fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& entry : entries)
+    {
+        fs.write(reinterpret_cast<const char*>(entry.chunks->data()), entry.chunks->size());
+    }
+
+    if (!fs.good())
+    {
+        UDD_ERROR("ReplayRing::WriteSession() => Could not write ", path.c_str(), ".");
+        return false;
+    }
+
+    return true;
+}
+
+
+bool ReplayRing::WriteQoiSequence(const std::string& path, const Record::FileHeader& header, const std::vector<Entry>& entries)
+{
+    // Regions are applied to a desktop image, which is rotated to the monitor orientation for each file.
+    const auto rotation = header.rotation;
+    const bool isVertical = rotation == DXGI_MODE_ROTATION_ROTATE90 || rotation == DXGI_MODE_ROTATION_ROTATE270;
+    const auto monitorWidth = !isVertical ? header.width : header.height;
+    const auto monitorHeight = !isVertical ? header.height : header.width;
+    const auto pitch = header.width * sizeof(UINT);
+    const auto monitorPitch = monitorWidth * sizeof(UINT);
+    std::vector<BYTE> image(static_cast<size_t>(pitch) * header.height, 0);
+    std::vector<BYTE> monitorImage(static_cast<size_t>(monitorPitch) * monitorHeight, 0);
+    std::vector<BYTE> data;
+
+    UINT index = 0;
+    for (const auto& entry : entries)
+    {
+        const auto& chunks = *entry.chunks;
+        for (size_t offset = 0; offset + sizeof(Record::ChunkHeader) <= chunks.size(); )
+        {
+            Record::ChunkHeader chunk;
+            std::memcpy(&chunk, chunks.data() + offset, sizeof(chunk));
+            const auto payload = chunks.data() + offset + sizeof(chunk);
+            offset += sizeof(chunk) + chunk.size;
+            if (chunk.type != Record::ChunkType::Frame) continue;
+
+            Record::FrameHeader frameHeader;
+            std::memcpy(&frameHeader, payload, sizeof(frameHeader));
+            const auto regionOffset =
+                sizeof(frameHeader) +
+                frameHeader.moveRectCount * sizeof(DXGI_OUTDUPL_MOVE_RECT) +
+                frameHeader.dirtyRectCount * sizeof(RECT);
+            if (regionOffset > chunk.size || !Codec::DecodeRegions(
+                payload + regionOffset,
+                chunk.size - regionOffset,
+                frameHeader.regionCount,
+                image.data(),
+                header.width,
+                header.height,
+                static_cast<UINT>(pitch)))
+            {
+                UDD_ERROR("ReplayRing::WriteQoiSequence() => Could not decode frame ", frameHeader.id, ".");
+                return false;
+            }
+
+            Kernels::BlitRotatedRect(
+                image.data(), static_cast<UINT>(pitch),
+                monitorImage.data(), static_cast<UINT>(monitorPitch),
+                rotation, monitorWidth, monitorHeight,
+                0, 0, header.width, header.height);
+
+            data.clear();
+            Codec::EncodeQoi(monitorImage.data(), monitorWidth, monitorHeight, static_cast<UINT>(monitorPitch), data);
+
+            char suffix[32];
+            std::snprintf(suffix, sizeof(suffix), "_%06u.qoi", index++);
+            const auto filePath = path + suffix;
+            std::ofstream fs(filePath, std::ios::binary | std::ios::trunc);
+            fs.write(reinterpret_cast<const char*>(data.data()), data.size());
+            if (!fs.good())
+            {
+                UDD_ERROR("ReplayRing::WriteQoiSequence() => Could not write ", filePath.c_str(), ".");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <wrl/client.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Record.h"
+#include "Duplicator.h"
+#include "ReplayTiles.h"
+
+
+
+enum class ReplayExportFormat
+{
+    Session = 0,     // session file which StartReplay() plays
+    QoiSequence = 1, // one QOI image per frame in monitor orientation
+};
+
+
+enum class ReplayExportState
+{
+    None = 0,
+    Exporting = 1,
+    Completed = 2,
+    Failed = 3,
+};
+
+
+// Summary of a ReplayRing (the layout is shared with ReplayRingInfo in Lib.cs)
+struct ReplayRingInfo
+{
+    INT64 bytes;
+    INT64 maxBytes;
+    int frameCount;
+    int keyFrameCount;
+    float durationSec;     // time covered from the oldest key frame
+    float addMs;           // smoothed cost of adding a frame on the capture thread
+};
+
+
+// Keeps the last frames published by a Duplicator in memory so that they can be exported
+// after something happened, without recording to disk all the time.
+//
+// Frames are stored as chunks of the session file format (see Record.h). A key frame with
+// the whole image is stored every keyFrameInterval, and the frames in between only have the
+// tiles under their move and dirty rects, which are copied to a staging texture and RLE encoded.
+// The oldest key frame and its deltas are dropped together when the ring covers more than
+// duration without them or gets larger than maxBytes, so the ring always starts with a key frame.
+// A key frame is forced when maxBytes is reached within one interval, so maxBytes can be
+// exceeded by about one key frame.
+class ReplayRing final
+{
+public:
+    static constexpr int kTileSize = 32;
+    static constexpr float kAddMsSmoothing = 0.05f;
+
+    ReplayRing(INT64 maxBytes, float durationSec, float keyFrameIntervalSec);
+    ~ReplayRing();
+    void Add(Duplicator* duplicator, const Duplicator::Frame& frame);
+    bool Export(const std::string& path, ReplayExportFormat format);
+    ReplayExportState GetExportState() const;
+    void GetInfo(ReplayRingInfo* info) const;
+    INT64 GetByteSize() const;
+
+private:
+    struct Entry
+    {
+        std::chrono::steady_clock::time_point time;
+        bool isKeyFrame = false;
+        std::shared_ptr<const std::vector<BYTE>> chunks;
+    };
+
+    void Reset(Duplicator* duplicator, const Duplicator::Frame& frame, const D3D11_TEXTURE2D_DESC& desc);
+    void CollectTiles(const Duplicator::Frame& frame);
+    void AppendPointerShape(
+        Duplicator* duplicator,
+        const Duplicator::Frame& frame,
+        bool isKeyFrame,
+        std::vector<BYTE>& chunks,
+        UINT* shapeSize);
+    void Push(Entry&& entry);
+    static bool WriteSession(const std::string& path, const Record::FileHeader& header, const std::vector<Entry>& entries);
+    static bool WriteQoiSequence(const std::string& path, const Record::FileHeader& header, const std::vector<Entry>& entries);
+
+    const INT64 maxBytes_;
+    const std::chrono::steady_clock::duration duration_;
+    const std::chrono::steady_clock::duration keyFrameInterval_;
+
+    // Capture thread only
+    D3D11_TEXTURE2D_DESC desc_ = {};
+    RECT area_ = {};
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> stagingTexture_;
+    INT64 stagingBytes_ = 0;
+    std::chrono::steady_clock::time_point startTime_;
+    std::chrono::steady_clock::time_point lastKeyFrameTime_;
+    UINT lastFrameId_ = 0;
+    bool needsKeyFrame_ = true;
+    ReplayTiles tiles_ { kTileSize };
+    std::vector<RECT> regions_;
+    std::vector<BYTE> payload_;
+
+    // Entries and the header of the exported files (guarded by mutex_)
+    std::deque<Entry> entries_;
+    Record::FileHeader fileHeader_ = {};
+    INT64 bytes_ = 0;
+    int keyFrameCount_ = 0;
+    float addMs_ = 0.f;
+    mutable std::mutex mutex_;
+
+    std::atomic<ReplayExportState> exportState_ = { ReplayExportState::None };
+    std::thread exportThread_;
+};
@@ -0,0 +1,64 @@
+#include <algorithm>
+
+#include "ReplayTiles.h"
+
+
+
+ReplayTiles::ReplayTiles(int tileSize)
+    : tileSize_((std::max)(tileSize, 1))
+{
+}
+
+
+void ReplayTiles::Reset(int width, int height)
+{
+    width_ = (std::max)(width, 0);
+    height_ = (std::max)(height, 0);
+    columnCount_ = (width_ + tileSize_ - 1) / tileSize_;
+    rowCount_ = (height_ + tileSize_ - 1) / tileSize_;
+    tiles_.assign(static_cast<size_t>(columnCount_) * rowCount_, 0);
+}
+
+
+void ReplayTiles::Mark(const RECT& rect)
+{
+    const auto left   = (std::max)(static_cast<int>(rect.left), 0);
+    const auto top    = (std::max)(static_cast<int>(rect.top), 0);
+    const auto right  = (std::min)(static_cast<int>(rect.right), width_);
+    const auto bottom = (std::min)(static_cast<int>(rect.bottom), height_);
+    if (left >= right || top >= bottom) return;
+
+    const auto column0 = left / tileSize_;
+    const auto column1 = (right - 1) / tileSize_;
+    for (auto row = top / tileSize_; row <= (bottom - 1) / tileSize_; ++row)
+    {
+        std::fill_n(tiles_.begin() + row * columnCount_ + column0, column1 - column0 + 1, 1);
+    }
+}
+
+
+void ReplayTiles::Collect(std::vector<RECT>* regions)
+{
+    for (int row = 0; row < rowCount_; ++row)
+    {
+        auto tiles = tiles_.data() + row * columnCount_;
+        for (int column = 0; column < columnCount_; )
+        {
+            if (!tiles[column])
+            {
+                ++column;
+                continue;
+            }
+
+            int end = column;
+            while (end + 1 < columnCount_ && tiles[end + 1]) ++end;
+            regions->push_back({
+                column * tileSize_,
+                row * tileSize_,
+                (std::min)((end + 1) * tileSize_, width_),
+                (std::min)((row + 1) * tileSize_, height_) });
+            std::fill(tiles + column, tiles + end + 1, 0);
+            column = end + 1;
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <windows.h>
+
+
+
+// Tiles of a desktop image changed since the last key frame of a ReplayRing.
+//
+// Changed rects mark the tiles under them, and Collect() turns the runs of marked tiles in each row
+// into regions. Snapping to tiles keeps the number of regions (and the copies and headers for them)
+// small for frames with many tiny rects such as typed text.
+//
+// The class has no D3D dependency so that it can be tested anywhere.
+class ReplayTiles final
+{
+public:
+    explicit ReplayTiles(int tileSize);
+
+    // Clears the marks for a width x height image.
+    void Reset(int width, int height);
+
+    // Rects are clipped to the image.
+    void Mark(const RECT& rect);
+
+    // Appends one region per run of marked tiles, row by row, and clears the marks.
+    void Collect(std::vector<RECT>* regions);
+
+    int GetTileSize() const { return tileSize_; }
+
+private:
+    const int tileSize_;
+    int width_ = 0;
+    int height_ = 0;
+    int columnCount_ = 0;
+    int rowCount_ = 0;
+    std::vector<BYTE> tiles_;
+};
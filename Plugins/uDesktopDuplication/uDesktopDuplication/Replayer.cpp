@@ -0,0 +1,304 @@
+#include <cstring>
+
+#include "Replayer.h"
+#include "Debug.h"
+
+
+
+Replayer::Replayer()
+{
+}
+
+
+Replayer::~Replayer()
+{
+    Close();
+}
+
+
+bool Replayer::Open(const std::string& path, ReplaySpeed speed, bool loop)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    Close();
+
+    file_ = CreateFileA(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        UDD_ERROR("Replayer::Open() => Could not open ", path.c_str(), ".");
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(Record::FileHeader)))
+    {
+        UDD_ERROR("Replayer::Open() => ", path.c_str(), " is too small.");
+        Close();
+        return false;
+    }
+    size_ = static_cast<UINT64>(size.QuadPart);
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_)
+    {
+        UDD_ERROR("Replayer::Open() => CreateFileMapping() failed.");
+        Close();
+        return false;
+    }
+
+    view_ = static_cast<const BYTE*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!view_)
+    {
+        UDD_ERROR("Replayer::Open() => MapViewOfFile() failed.");
+        Close();
+        return false;
+    }
+
+    std::memcpy(&header_, view_, sizeof(header_));
+    if (header_.magic != Record::kMagic || header_.version != Record::kVersion)
+    {
+        UDD_ERROR("Replayer::Open() => ", path.c_str(), " is not a session file.");
+        Close();
+        return false;
+    }
+
+    if (!BuildIndex())
+    {
+        Close();
+        return false;
+    }
+
+    speed_ = speed;
+    loop_ = loop;
+    nextIndex_ = 0;
+
+    UDD_LOG("Replayer::Open() => ", path.c_str());
+    UDD_LOG("    Size   : (", header_.width, ", ", header_.height, ")");
+    UDD_LOG("    Frames : ", frames_.size());
+
+    return true;
+}
+
+
+void Replayer::Close()
+{
+    if (view_)
+    {
+        UnmapViewOfFile(view_);
+        view_ = nullptr;
+    }
+
+    if (mapping_)
+    {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+
+    if (file_ != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+
+    size_ = 0;
+    frames_.clear();
+}
+
+
+bool Replayer::IsOpen() const
+{
+    return view_ != nullptr;
+}
+
+
+const Record::FileHeader& Replayer::GetFileHeader() const
+{
+    return header_;
+}
+
+
+UINT Replayer::GetFrameCount() const
+{
+    return static_cast<UINT>(frames_.size());
+}
+
+
+ReplaySpeed Replayer::GetSpeed() const
+{
+    return speed_;
+}
+
+
+bool Replayer::Next(Frame* frame)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (nextIndex_ >= frames_.size())
+    {
+        if (!loop_) return false;
+        nextIndex_ = 0;
+    }
+
+    if (!GetFrame(nextIndex_, frame)) return false;
+
+    if (nextIndex_ == 0)
+    {
+        startTime_ = std::chrono::steady_clock::now();
+        startTimestamp_ = frame->header->timestamp;
+    }
+    ++nextIndex_;
+
+    return true;
+}
+
+
+Replayer::TimePoint Replayer::GetDueTime(const Frame& frame) const
+{
+    const auto elapsed = frame.header->timestamp - startTimestamp_;
+    return startTime_ + std::chrono::microseconds(elapsed);
+}
+
+
+bool Replayer::BuildIndex()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    frames_.clear();
+
+    UINT64 offset = sizeof(Record::FileHeader);
+    UINT64 pointerShapeOffset = 0;
+
+    while (offset + sizeof(Record::ChunkHeader) <= size_)
+    {
+        Record::ChunkHeader chunk;
+        std::memcpy(&chunk, view_ + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+
+        if (offset + chunk.size > size_)
+        {
+            // A recording which was not stopped cleanly ends with a partial chunk.
+            UDD_LOG("Replayer::BuildIndex() => Truncated chunk at the end was skipped.");
+            break;
+        }
+
+        switch (chunk.type)
+        {
+            case Record::ChunkType::Frame:
+            {
+                if (chunk.size < sizeof(Record::FrameHeader))
+                {
+                    UDD_ERROR("Replayer::BuildIndex() => Broken frame chunk.");
+                    return false;
+                }
+                frames_.push_back({ offset, chunk.size, pointerShapeOffset });
+                pointerShapeOffset = 0;
+                break;
+            }
+            case Record::ChunkType::PointerShape:
+            {
+                Record::PointerShapeHeader shape;
+                if (chunk.size >= sizeof(shape))
+                {
+                    std::memcpy(&shape, view_ + offset, sizeof(shape));
+                }
+                if (chunk.size < sizeof(shape) || shape.size > chunk.size - sizeof(shape))
+                {
+                    UDD_ERROR("Replayer::BuildIndex() => Broken pointer shape chunk.");
+                    return false;
+                }
+                pointerShapeOffset = offset;
+                break;
+            }
+            default:
+            {
+                // Unknown chunks are skipped for forward compatibility.
+                break;
+            }
+        }
+
+        offset += chunk.size;
+    }
+
+    if (frames_.empty())
+    {
+        UDD_ERROR("Replayer::BuildIndex() => No frame was found.");
+        return false;
+    }
+
+    return true;
+}
+
+
+bool Replayer::GetFrame(UINT index, Frame* frame) const
+{
+    if (!IsOpen() || index >= frames_.size()) return false;
+
+    const auto& entry = frames_[index];
+    const auto begin = view_ + entry.offset;
+    const auto end = begin + entry.size;
+    auto data = begin;
+
+    frame->header = reinterpret_cast<const Record::FrameHeader*>(data);
+    data += sizeof(Record::FrameHeader);
+
+    const auto& header = *frame->header;
+    const auto rectsSize =
+        header.moveRectCount * sizeof(DXGI_OUTDUPL_MOVE_RECT) +
+        header.dirtyRectCount * sizeof(RECT);
+    if (data + rectsSize > end)
+    {
+        UDD_ERROR("Replayer::GetFrame() => Broken frame ", index, ".");
+        return false;
+    }
+
+    frame->moveRects = reinterpret_cast<const DXGI_OUTDUPL_MOVE_RECT*>(data);
+    data += header.moveRectCount * sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    frame->dirtyRects = reinterpret_cast<const RECT*>(data);
+    data += header.dirtyRectCount * sizeof(RECT);
+
+    frame->regions.clear();
+    for (UINT i = 0; i < header.regionCount; ++i)
+    {
+        if (data + sizeof(Record::RegionHeader) > end)
+        {
+            UDD_ERROR("Replayer::GetFrame() => Broken region in frame ", index, ".");
+            return false;
+        }
+
+        Region region;
+        region.header = reinterpret_cast<const Record::RegionHeader*>(data);
+        region.data = data + sizeof(Record::RegionHeader);
+        data = region.data + region.header->size;
+
+        const auto& rect = region.header->rect;
+        if (data > end ||
+            rect.left < 0 || rect.top < 0 ||
+            rect.right > static_cast<LONG>(header_.width) ||
+            rect.bottom > static_cast<LONG>(header_.height) ||
+            rect.left >= rect.right || rect.top >= rect.bottom)
+        {
+            UDD_ERROR("Replayer::GetFrame() => Broken region in frame ", index, ".");
+            return false;
+        }
+
+        frame->regions.push_back(region);
+    }
+
+    frame->pointerShape = nullptr;
+    frame->pointerShapeData = nullptr;
+    if (entry.pointerShapeOffset != 0)
+    {
+        const auto shape = view_ + entry.pointerShapeOffset;
+        frame->pointerShape = reinterpret_cast<const Record::PointerShapeHeader*>(shape);
+        frame->pointerShapeData = shape + sizeof(Record::PointerShapeHeader);
+    }
+
+    return true;
+}
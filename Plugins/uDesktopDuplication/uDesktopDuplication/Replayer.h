@@ -0,0 +1,75 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Record.h"
+
+
+enum class ReplaySpeed
+{
+    Recorded = 0,
+    Maximum = 1,
+};
+
+
+// Plays back a session file written by Recorder through a memory-mapped view
+class Replayer final
+{
+public:
+    struct Region
+    {
+        const Record::RegionHeader* header = nullptr;
+        const BYTE* data = nullptr;
+    };
+
+    struct Frame
+    {
+        const Record::FrameHeader* header = nullptr;
+        const DXGI_OUTDUPL_MOVE_RECT* moveRects = nullptr;
+        const RECT* dirtyRects = nullptr;
+        std::vector<Region> regions;
+        const Record::PointerShapeHeader* pointerShape = nullptr;
+        const BYTE* pointerShapeData = nullptr;
+    };
+
+    using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
+
+    Replayer();
+    ~Replayer();
+    bool Open(const std::string& path, ReplaySpeed speed, bool loop);
+    void Close();
+    bool IsOpen() const;
+    const Record::FileHeader& GetFileHeader() const;
+    UINT GetFrameCount() const;
+    ReplaySpeed GetSpeed() const;
+    bool Next(Frame* frame);
+    TimePoint GetDueTime(const Frame& frame) const;
+
+private:
+    bool BuildIndex();
+    bool GetFrame(UINT index, Frame* frame) const;
+
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+    const BYTE* view_ = nullptr;
+    UINT64 size_ = 0;
+    Record::FileHeader header_ = {};
+
+    struct FrameIndex
+    {
+        UINT64 offset;
+        UINT size;
+        UINT64 pointerShapeOffset; // 0 when the frame has no shape update
+    };
+    std::vector<FrameIndex> frames_;
+
+    ReplaySpeed speed_ = ReplaySpeed::Recorded;
+    bool loop_ = false;
+    UINT nextIndex_ = 0;
+    TimePoint startTime_;
+    UINT64 startTimestamp_ = 0;
+};
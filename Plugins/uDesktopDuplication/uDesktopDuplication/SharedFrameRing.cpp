@@ -0,0 +1,200 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "SharedFrameRing.h"
+#include "Debug.h"
+
+
+
+SharedFrameRing::SharedFrameRing()
+{
+}
+
+
+SharedFrameRing::~SharedFrameRing()
+{
+    Destroy();
+}
+
+
+bool SharedFrameRing::Create(int monitorId, UINT slotCount, UINT width, UINT height)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    Destroy();
+
+    if (slotCount == 0 || width == 0 || height == 0)
+    {
+        UDD_ERROR("SharedFrameRing::Create() => Invalid ring size.");
+        return false;
+    }
+
+    const UINT64 maxFrameSize = static_cast<UINT64>(width) * height * sizeof(UINT);
+    const UINT64 slotStride = udd_shm_slot_stride(maxFrameSize);
+    const UINT64 size = udd_shm_slot_offset() + slotStride * slotCount;
+
+    char name[64];
+    sprintf_s(name, sizeof(name), UDD_SHM_NAME_FORMAT, monitorId);
+
+    mapping_ = CreateFileMappingA(
+        INVALID_HANDLE_VALUE,
+        nullptr,
+        PAGE_READWRITE,
+        static_cast<DWORD>(size >> 32),
+        static_cast<DWORD>(size & 0xFFFFFFFF),
+        name);
+    if (!mapping_)
+    {
+        UDD_ERROR("SharedFrameRing::Create() => CreateFileMapping() failed.");
+        return false;
+    }
+
+    if (GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        // Another process (e.g. a second editor instance) already exports this monitor.
+        UDD_ERROR("SharedFrameRing::Create() => ", name, " is already used by another producer.");
+        Destroy();
+        return false;
+    }
+
+    view_ = static_cast<BYTE*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (!view_)
+    {
+        UDD_ERROR("SharedFrameRing::Create() => MapViewOfFile() failed.");
+        Destroy();
+        return false;
+    }
+
+    // Pages of a new mapping are zero-filled, so every slot starts with an even sequence.
+    auto header = GetHeader();
+    header->slotCount = slotCount;
+    header->slotHeaderSize = static_cast<uint32_t>(udd_shm_slot_header_size());
+    header->slotStride = slotStride;
+    header->slotOffset = udd_shm_slot_offset();
+    header->maxFrameSize = maxFrameSize;
+    header->latestFrameId = 0;
+    header->latestSlot = 0;
+    header->version = UDD_SHM_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = UDD_SHM_MAGIC;
+
+    nextSlot_ = 0;
+
+    UDD_LOG("SharedFrameRing::Create() => ", name);
+    UDD_LOG("    Size  : (", width, ", ", height, ")");
+    UDD_LOG("    Slots : ", slotCount);
+
+    return true;
+}
+
+
+void SharedFrameRing::Destroy()
+{
+    if (view_)
+    {
+        UnmapViewOfFile(view_);
+        view_ = nullptr;
+    }
+
+    if (mapping_)
+    {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+}
+
+
+bool SharedFrameRing::IsCreated() const
+{
+    return view_ != nullptr;
+}
+
+
+void SharedFrameRing::Write(const CpuFrame& frame)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (!IsCreated()) return;
+
+    auto header = GetHeader();
+    const UINT64 rowSize = static_cast<UINT64>(frame.width) * sizeof(UINT);
+    if (rowSize * frame.height > header->maxFrameSize)
+    {
+        UDD_ERROR("SharedFrameRing::Write() => Frame is larger than the ring slots.");
+        return;
+    }
+
+    const auto index = nextSlot_;
+    nextSlot_ = (nextSlot_ + 1) % header->slotCount;
+
+    auto slot = GetSlot(index);
+    const auto sequence = slot->sequence;
+
+    // Readers which see an odd sequence, or a different one after reading, retry.
+    slot->sequence = sequence + 1;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Ids are shifted by one because 0 means "nothing published yet" to readers.
+    const UINT64 frameId = frame.id + 1ull;
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    slot->format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    slot->frameId = frameId;
+    slot->captureTime = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    slot->presentTime = frame.presentTime.QuadPart;
+    slot->width = frame.width;
+    slot->height = frame.height;
+    slot->pitch = static_cast<uint32_t>(rowSize);
+
+    // Readers only see pixels, so move destinations are reported as dirty as well.
+    const auto rectCount = frame.moveRectCount + frame.dirtyRectCount;
+    if (rectCount > UDD_SHM_MAX_DIRTY_RECTS)
+    {
+        slot->dirtyRectCount = UDD_SHM_DIRTY_RECTS_OVERFLOW;
+    }
+    else
+    {
+        slot->dirtyRectCount = rectCount;
+        for (UINT i = 0; i < rectCount; ++i)
+        {
+            const auto& rect = (i < frame.moveRectCount) ?
+                frame.moveRects[i].DestinationRect :
+                frame.dirtyRects[i - frame.moveRectCount];
+            slot->dirtyRects[i] = { rect.left, rect.top, rect.right, rect.bottom };
+        }
+    }
+
+    auto dst = reinterpret_cast<BYTE*>(slot) + header->slotHeaderSize;
+    if (frame.pitch == rowSize)
+    {
+        std::memcpy(dst, frame.pixels, static_cast<size_t>(rowSize * frame.height));
+    }
+    else
+    {
+        for (UINT y = 0; y < frame.height; ++y)
+        {
+            std::memcpy(dst + y * rowSize, frame.pixels + y * frame.pitch, static_cast<size_t>(rowSize));
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->sequence = sequence + 2;
+
+    header->latestSlot = index;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->latestFrameId = frameId;
+}
+
+
+UddShmRingHeader* SharedFrameRing::GetHeader() const
+{
+    return reinterpret_cast<UddShmRingHeader*>(view_);
+}
+
+
+UddShmSlotHeader* SharedFrameRing::GetSlot(UINT index) const
+{
+    const auto header = GetHeader();
+    return reinterpret_cast<UddShmSlotHeader*>(view_ + header->slotOffset + header->slotStride * index);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+
+#include "CpuFrame.h"
+#include "../Consumer/uDesktopDuplicationShm.h"
+
+
+
+// Publishes CPU copies of a monitor into a named shared-memory ring (see Consumer/uDesktopDuplicationShm.h)
+class SharedFrameRing final
+{
+public:
+    SharedFrameRing();
+    ~SharedFrameRing();
+    bool Create(int monitorId, UINT slotCount, UINT width, UINT height);
+    void Destroy();
+    bool IsCreated() const;
+    void Write(const CpuFrame& frame);
+
+private:
+    UddShmRingHeader* GetHeader() const;
+    UddShmSlotHeader* GetSlot(UINT index) const;
+
+    HANDLE mapping_ = nullptr;
+    BYTE* view_ = nullptr;
+    UINT nextSlot_ = 0;
+};
@@ -0,0 +1,126 @@
+#include <fstream>
+
+#include "Snapshot.h"
+#include "Codec.h"
+#include "Kernels.h"
+#include "Monitor.h"
+#include "Debug.h"
+
+
+
+Snapshot::Snapshot(const std::string& path, int left, int top, UINT width, UINT height, UINT monitorCount)
+    : path_(path)
+    , left_(left)
+    , top_(top)
+    , width_(width)
+    , height_(height)
+    , canvas_(static_cast<size_t>(width) * height * sizeof(UINT), 0)
+    , pendingMonitorCount_(monitorCount)
+{
+    if (monitorCount == 0)
+    {
+        state_ = SnapshotState::Failed;
+    }
+}
+
+
+Snapshot::~Snapshot()
+{
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+
+SnapshotState Snapshot::GetState() const
+{
+    return state_;
+}
+
+
+const std::vector<BYTE>& Snapshot::GetData() const
+{
+    return data_;
+}
+
+
+void Snapshot::Blit(const Monitor* monitor, const BYTE* pixels, UINT pitch, UINT width, UINT height)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    const auto rot = static_cast<DXGI_MODE_ROTATION>(monitor->GetRotation());
+    const auto monitorWidth = monitor->GetWidth();
+    const auto monitorHeight = monitor->GetHeight();
+    const auto isVertical =
+        rot == DXGI_MODE_ROTATION_ROTATE90 ||
+        rot == DXGI_MODE_ROTATION_ROTATE270;
+    const auto offsetX = monitor->GetLeft() - left_;
+    const auto offsetY = monitor->GetTop() - top_;
+
+    if (width != static_cast<UINT>(!isVertical ? monitorWidth : monitorHeight) ||
+        height != static_cast<UINT>(!isVertical ? monitorHeight : monitorWidth) ||
+        offsetX < 0 || offsetY < 0 ||
+        offsetX + monitorWidth > static_cast<int>(width_) ||
+        offsetY + monitorHeight > static_cast<int>(height_))
+    {
+        UDD_ERROR("Snapshot::Blit() => Monitor ", monitor->GetId(), " does not fit in the snapshot.");
+        OnMonitorDone();
+        return;
+    }
+
+    const auto canvasPitch = width_ * sizeof(UINT);
+    const auto canvas = canvas_.data() + offsetY * canvasPitch + offsetX * sizeof(UINT);
+    Kernels::BlitRotatedRect(pixels, pitch, canvas, canvasPitch, rot, monitorWidth, monitorHeight, 0, 0, width, height);
+
+    OnMonitorDone();
+}
+
+
+void Snapshot::Skip(const Monitor* monitor)
+{
+    UDD_LOG("Snapshot::Skip() => Monitor ", monitor->GetId(), " is not captured, so it is left black.");
+    OnMonitorDone();
+}
+
+
+void Snapshot::OnMonitorDone()
+{
+    // The last monitor starts encoding; this is called from capture threads.
+    if (--pendingMonitorCount_ != 0) return;
+
+    state_ = SnapshotState::Encoding;
+    thread_ = std::thread([this]
+    {
+        Trace::SetThreadName("Snapshot Encode Thread");
+        Encode();
+    });
+}
+
+
+void Snapshot::Encode()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    Codec::EncodeQoi(canvas_.data(), width_, height_, width_ * sizeof(UINT), data_);
+
+    // The canvas is the largest buffer here (e.g. ~100 MB for 3x4K), so it is released early.
+    std::vector<BYTE>().swap(canvas_);
+
+    if (!path_.empty())
+    {
+        std::ofstream fs(path_, std::ios::binary | std::ios::trunc);
+        fs.write(reinterpret_cast<const char*>(data_.data()), data_.size());
+        if (!fs.good())
+        {
+            UDD_ERROR("Snapshot::Encode() => Could not write ", path_.c_str(), ".");
+            state_ = SnapshotState::Failed;
+            SendMessageToUnity(Message::SnapshotFailed);
+            return;
+        }
+    }
+
+    UDD_LOG("Snapshot::Encode() => ", width_, "x", height_, " (", data_.size(), " bytes)");
+    state_ = SnapshotState::Completed;
+    SendMessageToUnity(Message::SnapshotCompleted);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d3d11.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class Monitor;
+
+
+enum class SnapshotState
+{
+    None = 0,
+    Capturing = 1,
+    Encoding = 2,
+    Completed = 3,
+    Failed = 4,
+};
+
+
+// Stitches the desktop images of all monitors into the virtual desktop layout
+// and encodes it as QOI on a background thread
+class Snapshot final
+{
+public:
+    Snapshot(const std::string& path, int left, int top, UINT width, UINT height, UINT monitorCount);
+    ~Snapshot();
+    SnapshotState GetState() const;
+    const std::vector<BYTE>& GetData() const;
+    void Blit(const Monitor* monitor, const BYTE* pixels, UINT pitch, UINT width, UINT height);
+    void Skip(const Monitor* monitor);
+
+private:
+    void OnMonitorDone();
+    void Encode();
+
+    const std::string path_;
+    const int left_;
+    const int top_;
+    const UINT width_;
+    const UINT height_;
+    std::vector<BYTE> canvas_;
+    std::vector<BYTE> data_;
+    std::atomic<UINT> pendingMonitorCount_;
+    std::atomic<SnapshotState> state_ = { SnapshotState::Capturing };
+    std::thread thread_;
+};
@@ -0,0 +1,527 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "StreamServer.h"
+#include "Codec.h"
+#include "Debug.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+
+
+namespace
+{
+    // Copies pending for a client which has not caught up are turned into damage after this.
+    constexpr size_t kMaxPendingCopies = 256;
+
+    // The network thread polls for new damage with this interval while all clients are idle.
+    constexpr long kPollIntervalUs = 2000;
+
+    constexpr size_t kSendChunkSize = 256 * 1024;
+}
+
+
+
+StreamServer::StreamServer()
+{
+}
+
+
+StreamServer::~StreamServer()
+{
+    Stop();
+}
+
+
+bool StreamServer::Start(USHORT port, UINT width, UINT height, DXGI_MODE_ROTATION rotation)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    Stop();
+
+    if (width == 0 || height == 0 || width > 0xFFFF || height > 0xFFFF)
+    {
+        UDD_ERROR("StreamServer::Start() => Invalid image size.");
+        return false;
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        UDD_ERROR("StreamServer::Start() => WSAStartup() failed.");
+        return false;
+    }
+
+    const auto listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket == INVALID_SOCKET)
+    {
+        UDD_ERROR("StreamServer::Start() => socket() failed.");
+        WSACleanup();
+        return false;
+    }
+    listenSocket_ = listenSocket;
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    u_long nonBlocking = 1;
+    if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+        listen(listenSocket, SOMAXCONN) == SOCKET_ERROR ||
+        ioctlsocket(listenSocket, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+    {
+        UDD_ERROR("StreamServer::Start() => Could not listen on port ", port, " (", WSAGetLastError(), ").");
+        closesocket(listenSocket);
+        listenSocket_ = kInvalidSocket;
+        WSACleanup();
+        return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    tilesX_ = (width + UDD_STREAM_TILE_SIZE - 1) / UDD_STREAM_TILE_SIZE;
+    tilesY_ = (height + UDD_STREAM_TILE_SIZE - 1) / UDD_STREAM_TILE_SIZE;
+    rotation_ = rotation;
+    image_.assign(static_cast<size_t>(width) * height * sizeof(UINT), 0);
+    frameId_ = 0;
+
+    isRunning_ = true;
+    thread_ = std::thread([this]
+    {
+        Trace::SetThreadName("Stream Server Thread");
+        Run();
+    });
+
+    UDD_LOG("StreamServer::Start() => Port ", port);
+    UDD_LOG("    Size  : (", width, ", ", height, ")");
+
+    return true;
+}
+
+
+void StreamServer::Stop()
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (listenSocket_ == kInvalidSocket) return;
+
+    isRunning_ = false;
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+
+    for (const auto& client : clients_)
+    {
+        closesocket(client->socket);
+    }
+    clients_.clear();
+
+    closesocket(listenSocket_);
+    listenSocket_ = kInvalidSocket;
+    WSACleanup();
+
+    UDD_LOG("StreamServer::Stop()");
+}
+
+
+bool StreamServer::IsRunning() const
+{
+    return isRunning_;
+}
+
+
+UINT StreamServer::GetClientCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<UINT>(clients_.size());
+}
+
+
+void StreamServer::Update(const CpuFrame& frame)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    if (!IsRunning()) return;
+
+    if (frame.width != width_ || frame.height != height_)
+    {
+        UDD_ERROR("StreamServer::Update() => Frame size differs from the stream.");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto rowSize = width_ * sizeof(UINT);
+    const auto copyRect = [&](const RECT& rect)
+    {
+        const auto left   = std::max<LONG>(rect.left, 0);
+        const auto top    = std::max<LONG>(rect.top, 0);
+        const auto right  = std::min<LONG>(rect.right, static_cast<LONG>(width_));
+        const auto bottom = std::min<LONG>(rect.bottom, static_cast<LONG>(height_));
+        if (left >= right || top >= bottom) return;
+
+        for (LONG y = top; y < bottom; ++y)
+        {
+            std::memcpy(
+                image_.data() + y * rowSize + left * sizeof(UINT),
+                frame.pixels + y * frame.pitch + left * sizeof(UINT),
+                (right - left) * sizeof(UINT));
+        }
+    };
+
+    // Rects only describe the change from the previous capture, so the whole image is taken
+    // for the first frame and whenever Monitor::Render() skipped captured frames.
+    const auto isFullUpdate = frameId_ == 0 || frame.id != frameId_;
+    if (isFullUpdate)
+    {
+        copyRect({ 0, 0, static_cast<LONG>(width_), static_cast<LONG>(height_) });
+    }
+    else
+    {
+        for (UINT i = 0; i < frame.moveRectCount; ++i)
+        {
+            copyRect(frame.moveRects[i].DestinationRect);
+        }
+        for (UINT i = 0; i < frame.dirtyRectCount; ++i)
+        {
+            copyRect(frame.dirtyRects[i]);
+        }
+    }
+
+    frameId_ = frame.id + 1ull;
+    captureTime_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for (const auto& client : clients_)
+    {
+        if (isFullUpdate)
+        {
+            DamageAll(*client);
+            continue;
+        }
+
+        // Moves refer to the previous frame, so they can be sent as copies only while the client
+        // has no unsent damage. Otherwise the destinations are merged into the damage instead.
+        const auto canCopy =
+            client->damagedTileCount == 0 &&
+            client->copies.size() + frame.moveRectCount <= kMaxPendingCopies;
+
+        for (UINT i = 0; i < frame.moveRectCount; ++i)
+        {
+            const auto& move = frame.moveRects[i];
+            if (canCopy)
+            {
+                const UddStreamCopy copy =
+                {
+                    move.SourcePoint.x,
+                    move.SourcePoint.y,
+                    move.DestinationRect.left,
+                    move.DestinationRect.top,
+                    move.DestinationRect.right,
+                    move.DestinationRect.bottom,
+                };
+                client->copies.push_back(copy);
+            }
+            else
+            {
+                DamageRect(*client, move.DestinationRect);
+            }
+        }
+
+        for (UINT i = 0; i < frame.dirtyRectCount; ++i)
+        {
+            DamageRect(*client, frame.dirtyRects[i]);
+        }
+    }
+}
+
+
+void StreamServer::Run()
+{
+    while (isRunning_)
+    {
+        fd_set readSet, writeSet;
+        FD_ZERO(&readSet);
+        FD_ZERO(&writeSet);
+        FD_SET(static_cast<SOCKET>(listenSocket_), &readSet);
+
+        // A frame is built only after the previous one has been sent completely, so a slow
+        // client keeps accumulating (and merging) damage instead of queueing frames.
+        for (const auto& client : clients_)
+        {
+            if (client->sentSize == client->output.size())
+            {
+                client->output.clear();
+                client->sentSize = 0;
+                BuildFrame(*client);
+            }
+            if (!client->output.empty())
+            {
+                FD_SET(static_cast<SOCKET>(client->socket), &writeSet);
+            }
+        }
+
+        timeval timeout = { 0, kPollIntervalUs };
+        const auto result = select(0, &readSet, &writeSet, nullptr, &timeout);
+        if (result == SOCKET_ERROR)
+        {
+            UDD_ERROR("StreamServer::Run() => select() failed (", WSAGetLastError(), ").");
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        if (FD_ISSET(static_cast<SOCKET>(listenSocket_), &readSet))
+        {
+            Accept();
+        }
+
+        for (auto& client : clients_)
+        {
+            if (!FD_ISSET(static_cast<SOCKET>(client->socket), &writeSet)) continue;
+            if (!Send(*client))
+            {
+                closesocket(client->socket);
+                client->socket = kInvalidSocket;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        clients_.erase(
+            std::remove_if(clients_.begin(), clients_.end(),
+                [](const std::unique_ptr<Client>& client) { return client->socket == kInvalidSocket; }),
+            clients_.end());
+    }
+}
+
+
+void StreamServer::Accept()
+{
+    const auto socket = accept(static_cast<SOCKET>(listenSocket_), nullptr, nullptr);
+    if (socket == INVALID_SOCKET) return;
+
+    // select() can not watch more sockets than FD_SETSIZE including the listening one.
+    if (clients_.size() + 1 >= FD_SETSIZE)
+    {
+        UDD_ERROR("StreamServer::Accept() => Too many clients.");
+        closesocket(socket);
+        return;
+    }
+
+    u_long nonBlocking = 1;
+    BOOL noDelay = TRUE;
+    if (ioctlsocket(socket, FIONBIO, &nonBlocking) == SOCKET_ERROR ||
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay)) == SOCKET_ERROR)
+    {
+        UDD_ERROR("StreamServer::Accept() => Failed to configure the client socket.");
+        closesocket(socket);
+        return;
+    }
+
+    auto client = std::make_unique<Client>();
+    client->socket = socket;
+    client->damage.assign(tilesX_ * tilesY_, 0);
+
+    const UddStreamHello hello =
+    {
+        UDD_STREAM_MAGIC,
+        UDD_STREAM_VERSION,
+        width_,
+        height_,
+        DXGI_FORMAT_B8G8R8A8_UNORM,
+        static_cast<uint32_t>(rotation_),
+        UDD_STREAM_TILE_SIZE,
+    };
+    AppendMessage(client->output, UDD_STREAM_MESSAGE_HELLO, &hello, sizeof(hello));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    DamageAll(*client);
+    clients_.push_back(std::move(client));
+
+    UDD_LOG("StreamServer::Accept() => ", clients_.size(), " client(s).");
+}
+
+
+bool StreamServer::Send(Client& client)
+{
+    while (client.sentSize < client.output.size())
+    {
+        const auto size = std::min(client.output.size() - client.sentSize, kSendChunkSize);
+        const auto sent = send(
+            static_cast<SOCKET>(client.socket),
+            reinterpret_cast<const char*>(client.output.data() + client.sentSize),
+            static_cast<int>(size),
+            0);
+        if (sent == SOCKET_ERROR)
+        {
+            if (WSAGetLastError() == WSAEWOULDBLOCK) return true;
+            UDD_LOG("StreamServer::Send() => Client disconnected.");
+            return false;
+        }
+        client.sentSize += sent;
+    }
+
+    return true;
+}
+
+
+void StreamServer::BuildFrame(Client& client)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    UddStreamFrameBegin begin = {};
+
+    // Only the raw pixels of damaged tiles are copied while holding the lock;
+    // encoding happens afterwards so that Update() is never blocked by it.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (client.damagedTileCount == 0 && client.copies.empty()) return;
+
+        tiles_.clear();
+        for (UINT i = 0; i < client.damage.size(); ++i)
+        {
+            if (!client.damage[i]) continue;
+            tiles_.push_back(i);
+            client.damage[i] = 0;
+        }
+        client.damagedTileCount = 0;
+
+        copies_.swap(client.copies);
+        client.copies.clear();
+
+        const auto tileSize = UDD_STREAM_TILE_SIZE * UDD_STREAM_TILE_SIZE * sizeof(UINT);
+        tilePixels_.resize(tiles_.size() * tileSize);
+
+        const auto rowSize = width_ * sizeof(UINT);
+        for (size_t i = 0; i < tiles_.size(); ++i)
+        {
+            const auto x = (tiles_[i] % tilesX_) * UDD_STREAM_TILE_SIZE;
+            const auto y = (tiles_[i] / tilesX_) * UDD_STREAM_TILE_SIZE;
+            const auto w = std::min(UDD_STREAM_TILE_SIZE, width_ - x);
+            const auto h = std::min(UDD_STREAM_TILE_SIZE, height_ - y);
+            auto dst = tilePixels_.data() + i * tileSize;
+            for (UINT row = 0; row < h; ++row)
+            {
+                std::memcpy(dst + row * w * sizeof(UINT), image_.data() + (y + row) * rowSize + x * sizeof(UINT), w * sizeof(UINT));
+            }
+        }
+
+        begin.frameId = frameId_;
+        begin.captureTime = captureTime_;
+    }
+
+    begin.copyCount = static_cast<uint32_t>(copies_.size());
+    begin.tileCount = static_cast<uint32_t>(tiles_.size());
+    AppendMessage(client.output, UDD_STREAM_MESSAGE_FRAME_BEGIN, &begin, sizeof(begin));
+
+    for (const auto& copy : copies_)
+    {
+        AppendMessage(client.output, UDD_STREAM_MESSAGE_COPY, &copy, sizeof(copy));
+    }
+
+    const auto tileSize = UDD_STREAM_TILE_SIZE * UDD_STREAM_TILE_SIZE * sizeof(UINT);
+    for (size_t i = 0; i < tiles_.size(); ++i)
+    {
+        const auto x = (tiles_[i] % tilesX_) * UDD_STREAM_TILE_SIZE;
+        const auto y = (tiles_[i] / tilesX_) * UDD_STREAM_TILE_SIZE;
+        const auto w = std::min(UDD_STREAM_TILE_SIZE, width_ - x);
+        const auto h = std::min(UDD_STREAM_TILE_SIZE, height_ - y);
+        EncodeTile(client.output, x, y, w, h, tilePixels_.data() + i * tileSize);
+    }
+
+    AppendMessage(client.output, UDD_STREAM_MESSAGE_FRAME_END, nullptr, 0);
+}
+
+
+void StreamServer::DamageRect(Client& client, const RECT& rect)
+{
+    const auto left   = std::max<LONG>(rect.left, 0);
+    const auto top    = std::max<LONG>(rect.top, 0);
+    const auto right  = std::min<LONG>(rect.right, static_cast<LONG>(width_));
+    const auto bottom = std::min<LONG>(rect.bottom, static_cast<LONG>(height_));
+    if (left >= right || top >= bottom) return;
+
+    for (UINT ty = top / UDD_STREAM_TILE_SIZE; ty <= (bottom - 1) / UDD_STREAM_TILE_SIZE; ++ty)
+    {
+        for (UINT tx = left / UDD_STREAM_TILE_SIZE; tx <= (right - 1) / UDD_STREAM_TILE_SIZE; ++tx)
+        {
+            auto& flag = client.damage[ty * tilesX_ + tx];
+            if (!flag)
+            {
+                flag = 1;
+                ++client.damagedTileCount;
+            }
+        }
+    }
+}
+
+
+void StreamServer::DamageAll(Client& client)
+{
+    std::fill(client.damage.begin(), client.damage.end(), 1);
+    client.damagedTileCount = static_cast<UINT>(client.damage.size());
+    client.copies.clear();
+}
+
+
+void StreamServer::EncodeTile(std::vector<BYTE>& output, UINT x, UINT y, UINT width, UINT height, const BYTE* pixels)
+{
+    UddStreamTile tile =
+    {
+        static_cast<uint16_t>(x),
+        static_cast<uint16_t>(y),
+        static_cast<uint16_t>(width),
+        static_cast<uint16_t>(height),
+        UDD_STREAM_TILE_SOLID,
+    };
+
+    const auto count = width * height;
+    const auto data = reinterpret_cast<const UINT*>(pixels);
+    if (std::all_of(data + 1, data + count, [&](UINT pixel) { return pixel == data[0]; }))
+    {
+        tilePayload_.assign(pixels, pixels + sizeof(UINT));
+    }
+    else
+    {
+        const auto rawSize = count * sizeof(UINT);
+        tilePayload_.clear();
+        Codec::EncodeRle(pixels, width, height, width * sizeof(UINT), tilePayload_);
+        tile.encoding = UDD_STREAM_TILE_RLE;
+
+        // Photos and gradients do not compress with RLE, so they are sent as they are.
+        if (tilePayload_.size() >= rawSize)
+        {
+            tilePayload_.assign(pixels, pixels + rawSize);
+            tile.encoding = UDD_STREAM_TILE_RAW;
+        }
+    }
+
+    const UddStreamMessageHeader header =
+    {
+        UDD_STREAM_MESSAGE_TILE,
+        static_cast<uint32_t>(sizeof(tile) + tilePayload_.size()),
+    };
+    const auto offset = output.size();
+    output.resize(offset + sizeof(header) + sizeof(tile) + tilePayload_.size());
+    std::memcpy(output.data() + offset, &header, sizeof(header));
+    std::memcpy(output.data() + offset + sizeof(header), &tile, sizeof(tile));
+    std::memcpy(output.data() + offset + sizeof(header) + sizeof(tile), tilePayload_.data(), tilePayload_.size());
+}
+
+
+void StreamServer::AppendMessage(std::vector<BYTE>& output, UINT type, const void* data, size_t size)
+{
+    const UddStreamMessageHeader header = { type, static_cast<uint32_t>(size) };
+    const auto offset = output.size();
+    output.resize(offset + sizeof(header) + size);
+    std::memcpy(output.data() + offset, &header, sizeof(header));
+    if (size > 0)
+    {
+        std::memcpy(output.data() + offset + sizeof(header), data, size);
+    }
+}
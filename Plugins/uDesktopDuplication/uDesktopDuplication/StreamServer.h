@@ -0,0 +1,72 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CpuFrame.h"
+#include "../Consumer/uDesktopDuplicationStream.h"
+
+
+
+// Streams changed tiles of a monitor to TCP clients (see Consumer/uDesktopDuplicationStream.h)
+class StreamServer final
+{
+public:
+    StreamServer();
+    ~StreamServer();
+    bool Start(USHORT port, UINT width, UINT height, DXGI_MODE_ROTATION rotation);
+    void Stop();
+    bool IsRunning() const;
+    UINT GetClientCount() const;
+    void Update(const CpuFrame& frame);
+
+private:
+    struct Client
+    {
+        UINT_PTR socket = kInvalidSocket;
+        std::vector<BYTE> damage; // one flag per tile
+        UINT damagedTileCount = 0;
+        std::vector<UddStreamCopy> copies;
+        std::vector<BYTE> output;
+        size_t sentSize = 0;
+    };
+
+    void Run();
+    void Accept();
+    bool Send(Client& client);
+    void BuildFrame(Client& client);
+    void DamageRect(Client& client, const RECT& rect);
+    void DamageAll(Client& client);
+    void EncodeTile(std::vector<BYTE>& output, UINT x, UINT y, UINT width, UINT height, const BYTE* pixels);
+    void AppendMessage(std::vector<BYTE>& output, UINT type, const void* data, size_t size);
+
+    // SOCKET is kept as UINT_PTR so that this header does not depend on winsock2.h.
+    static constexpr UINT_PTR kInvalidSocket = ~static_cast<UINT_PTR>(0);
+    UINT_PTR listenSocket_ = kInvalidSocket;
+    std::thread thread_;
+    std::atomic<bool> isRunning_ = { false };
+
+    UINT width_ = 0;
+    UINT height_ = 0;
+    UINT tilesX_ = 0;
+    UINT tilesY_ = 0;
+    DXGI_MODE_ROTATION rotation_ = DXGI_MODE_ROTATION_UNSPECIFIED;
+
+    // Guards image_, frameId_ and the pending damage of clients; only held for memcpy.
+    mutable std::mutex mutex_;
+    std::vector<BYTE> image_;
+    UINT64 frameId_ = 0;
+    INT64 captureTime_ = 0;
+    std::vector<std::unique_ptr<Client>> clients_;
+
+    // Used only by the network thread
+    std::vector<UINT> tiles_;
+    std::vector<BYTE> tilePixels_;
+    std::vector<BYTE> tilePayload_;
+    std::vector<UddStreamCopy> copies_;
+};
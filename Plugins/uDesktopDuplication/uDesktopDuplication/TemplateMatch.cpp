@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "Kernels.h"
+#include "TemplateMatch.h"
+
+
+
+constexpr int TemplateMatcher::kMinTemplateSize;
+constexpr int TemplateMatcher::kMaxLevelCount;
+constexpr int TemplateMatcher::kMaxCandidateCount;
+constexpr float TemplateMatcher::kCoarseThresholdMargin;
+
+
+
+namespace
+{
+
+
+// Halves a plane with 2x2 averages (odd last rows and columns are dropped).
+void Downsample(const uint8_t* src, int width, int height, int pitch, std::vector<uint8_t>* dst)
+{
+    const auto dstWidth = width / 2;
+    const auto dstHeight = height / 2;
+    dst->resize(static_cast<size_t>(dstWidth) * dstHeight);
+    for (int y = 0; y < dstHeight; ++y)
+    {
+        const auto row0 = src + static_cast<size_t>(y * 2) * pitch;
+        const auto row1 = row0 + pitch;
+        auto out = dst->data() + static_cast<size_t>(y) * dstWidth;
+        for (int x = 0; x < dstWidth; ++x)
+        {
+            out[x] = static_cast<uint8_t>((row0[x * 2] + row0[x * 2 + 1] + row1[x * 2] + row1[x * 2 + 1] + 2) >> 2);
+        }
+    }
+}
+
+
+}
+
+
+
+TemplateMatcher::TemplateMatcher(const uint8_t* luma, int width, int height)
+{
+    levels_.emplace_back();
+    levels_[0].pixels.assign(luma, luma + static_cast<size_t>(width) * height);
+    levels_[0].width = width;
+    levels_[0].height = height;
+
+    while (static_cast<int>(levels_.size()) < kMaxLevelCount &&
+           levels_.back().width / 2 >= kMinTemplateSize &&
+           levels_.back().height / 2 >= kMinTemplateSize)
+    {
+        const auto& src = levels_.back();
+        Level level;
+        Downsample(src.pixels.data(), src.width, src.height, src.width, &level.pixels);
+        level.width = src.width / 2;
+        level.height = src.height / 2;
+        levels_.push_back(std::move(level));
+    }
+
+    for (auto& level : levels_)
+    {
+        double sum = 0.0, squareSum = 0.0;
+        for (const auto value : level.pixels)
+        {
+            sum += value;
+            squareSum += static_cast<double>(value) * value;
+        }
+        const auto count = static_cast<double>(level.pixels.size());
+        level.sum = sum;
+        level.deviation = squareSum - sum * sum / count;
+
+        // Less than a gray level of standard deviation is noise rather than a pattern.
+        level.isUniform = level.deviation < count;
+    }
+}
+
+
+int TemplateMatcher::Find(
+    const uint8_t* image,
+    int width,
+    int height,
+    const Rect* positionRects,
+    size_t positionRectCount,
+    float threshold,
+    TemplateMatch* results,
+    int capacity) const
+{
+    if (capacity <= 0 || width < GetWidth() || height < GetHeight()) return 0;
+
+    // Positions outside of the image are dropped first, so that an empty search costs nothing.
+    std::vector<Rect> rects;
+    Rect bounds = { width, height, 0, 0 };
+    for (size_t i = 0; i < positionRectCount; ++i)
+    {
+        const Rect rect =
+        {
+            (std::max)(positionRects[i].left, 0),
+            (std::max)(positionRects[i].top, 0),
+            (std::min)(positionRects[i].right, width - GetWidth() + 1),
+            (std::min)(positionRects[i].bottom, height - GetHeight() + 1),
+        };
+        if (rect.left >= rect.right || rect.top >= rect.bottom) continue;
+
+        rects.push_back(rect);
+        bounds.left   = (std::min)(bounds.left,   rect.left);
+        bounds.top    = (std::min)(bounds.top,    rect.top);
+        bounds.right  = (std::max)(bounds.right,  rect.right);
+        bounds.bottom = (std::max)(bounds.bottom, rect.bottom);
+    }
+    if (rects.empty()) return 0;
+
+    // Only the part of the image under the positions is searched, and positions are relative to it from here.
+    for (auto& rect : rects)
+    {
+        rect.left -= bounds.left;
+        rect.top -= bounds.top;
+        rect.right -= bounds.left;
+        rect.bottom -= bounds.top;
+    }
+    const Plane area =
+    {
+        image + static_cast<size_t>(bounds.top) * width + bounds.left,
+        bounds.right - bounds.left + GetWidth() - 1,
+        bounds.bottom - bounds.top + GetHeight() - 1,
+        width,
+    };
+
+    // Image levels stop where the template no longer fits.
+    std::vector<std::vector<uint8_t>> ownedPlanes;
+    std::vector<Plane> planes = { area };
+    ownedPlanes.reserve(levels_.size());
+    while (planes.size() < levels_.size())
+    {
+        const auto& src = planes.back();
+        const auto& level = levels_[planes.size()];
+        if (src.width / 2 < level.width || src.height / 2 < level.height) break;
+
+        ownedPlanes.emplace_back();
+        Downsample(src.pixels, src.width, src.height, src.pitch, &ownedPlanes.back());
+        planes.push_back({ ownedPlanes.back().data(), src.width / 2, src.height / 2, src.width / 2 });
+    }
+
+    const auto coarsest = static_cast<int>(planes.size()) - 1;
+    const auto& plane = planes[coarsest];
+    const auto& level = levels_[coarsest];
+
+    // Coarse positions which cover any of the full resolution ones.
+    const auto columnCount = plane.width - level.width + 1;
+    const auto rowCount = plane.height - level.height + 1;
+    std::vector<uint8_t> mask(static_cast<size_t>(columnCount) * rowCount, 0);
+    for (const auto& rect : rects)
+    {
+        const auto left = rect.left >> coarsest;
+        const auto top = rect.top >> coarsest;
+        const auto right = (std::min)(((rect.right - 1) >> coarsest) + 1, columnCount);
+        const auto bottom = (std::min)(((rect.bottom - 1) >> coarsest) + 1, rowCount);
+        for (int y = top; y < bottom; ++y)
+        {
+            std::fill(mask.begin() + y * columnCount + left, mask.begin() + y * columnCount + right, 1);
+        }
+    }
+
+    // Window sums at the coarsest level slide over sums of template-high columns, which keeps
+    // the memory at a row even when a small template is searched at full resolution.
+    std::vector<uint32_t> columnSums(plane.width, 0);
+    std::vector<uint32_t> columnSquareSums(plane.width, 0);
+    const auto addRow = [&](int y, int sign)
+    {
+        const auto row = plane.pixels + static_cast<size_t>(y) * plane.pitch;
+        for (int x = 0; x < plane.width; ++x)
+        {
+            columnSums[x] += sign * row[x];
+            columnSquareSums[x] += sign * row[x] * row[x];
+        }
+    };
+
+    const float kNotSearched = -2.f;
+    std::vector<float> scores(mask.size(), kNotSearched);
+    for (int y = 0; y < rowCount; ++y)
+    {
+        if (y == 0)
+        {
+            for (int row = 0; row < level.height; ++row) addRow(row, 1);
+        }
+        else
+        {
+            addRow(y - 1, -1);
+            addRow(y + level.height - 1, 1);
+        }
+
+        const auto rowMask = mask.data() + y * columnCount;
+        if (std::find(rowMask, rowMask + columnCount, 1) == rowMask + columnCount) continue;
+
+        uint64_t windowSum = 0, windowSquareSum = 0;
+        for (int x = 0; x < level.width; ++x)
+        {
+            windowSum += columnSums[x];
+            windowSquareSum += columnSquareSums[x];
+        }
+        for (int x = 0; x < columnCount; ++x)
+        {
+            if (x > 0)
+            {
+                windowSum += columnSums[x + level.width - 1] - static_cast<uint64_t>(columnSums[x - 1]);
+                windowSquareSum += columnSquareSums[x + level.width - 1] - static_cast<uint64_t>(columnSquareSums[x - 1]);
+            }
+            if (!rowMask[x]) continue;
+
+            scores[y * columnCount + x] = Score(
+                plane,
+                level,
+                x,
+                y,
+                static_cast<double>(windowSum),
+                static_cast<double>(windowSquareSum));
+        }
+    }
+
+    // Candidates are the local maxima of the coarse scores. Averaging blurs small details, and a match
+    // at an odd position is averaged across other pixel pairs than the template, so a perfect match can
+    // score only about 0.55 one level down (3 pixel icon details); the margin keeps those.
+    const auto coarseThreshold = threshold - kCoarseThresholdMargin * coarsest;
+    std::vector<TemplateMatch> candidates;
+    for (int y = 0; y < rowCount; ++y)
+    {
+        for (int x = 0; x < columnCount; ++x)
+        {
+            const auto score = scores[y * columnCount + x];
+            if (score < coarseThreshold) continue;
+
+            bool isMaximum = true;
+            for (int dy = -1; dy <= 1 && isMaximum; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    const auto nx = x + dx;
+                    const auto ny = y + dy;
+                    if (nx < 0 || ny < 0 || nx >= columnCount || ny >= rowCount) continue;
+                    if (scores[ny * columnCount + nx] > score)
+                    {
+                        isMaximum = false;
+                        break;
+                    }
+                }
+            }
+            if (isMaximum) candidates.push_back({ x, y, score });
+        }
+    }
+
+    const auto byScore = [](const TemplateMatch& a, const TemplateMatch& b) { return a.score > b.score; };
+    const auto candidateCount = (std::min)(candidates.size(), static_cast<size_t>((std::max)(kMaxCandidateCount, capacity * 2)));
+    std::partial_sort(candidates.begin(), candidates.begin() + candidateCount, candidates.end(), byScore);
+    candidates.resize(candidateCount);
+
+    const auto isSearched = [&rects](int x, int y)
+    {
+        for (const auto& rect : rects)
+        {
+            if (x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom) return true;
+        }
+        return false;
+    };
+
+    const auto searchAround = [&](int i, int left, int top, int right, int bottom, TemplateMatch* best)
+    {
+        const auto& finePlane = planes[i];
+        const auto& fineLevel = levels_[i];
+        for (int y = top; y <= bottom; ++y)
+        {
+            for (int x = left; x <= right; ++x)
+            {
+                if (x < 0 || y < 0 ||
+                    x > finePlane.width - fineLevel.width ||
+                    y > finePlane.height - fineLevel.height) continue;
+                if (i == 0 && !isSearched(x, y)) continue;
+
+                const auto score = Score(finePlane, fineLevel, x, y);
+                if (score > best->score) *best = { x, y, score };
+            }
+        }
+    };
+
+    // Each level doubles the position, and the +-1 pixel around it covers the rounding of the averages.
+    // Blurred coarse maxima can still be a few pixels off, so the best position then climbs
+    // to a neighbor for as long as one scores higher.
+    const int kMaxClimbStepCount = 8;
+    std::vector<TemplateMatch> matches;
+    for (auto candidate : candidates)
+    {
+        bool isFound = true;
+        for (int i = coarsest - 1; i >= 0; --i)
+        {
+            TemplateMatch best = { 0, 0, kNotSearched };
+            searchAround(i, candidate.x * 2 - 1, candidate.y * 2 - 1, candidate.x * 2 + 2, candidate.y * 2 + 2, &best);
+            if (best.score == kNotSearched)
+            {
+                isFound = false;
+                break;
+            }
+
+            for (int step = 0; step < kMaxClimbStepCount; ++step)
+            {
+                const auto current = best;
+                searchAround(i, current.x - 1, current.y - 1, current.x + 1, current.y + 1, &best);
+                if (best.x == current.x && best.y == current.y) break;
+            }
+            candidate = best;
+        }
+
+        if (isFound && candidate.score >= threshold && (coarsest > 0 || isSearched(candidate.x, candidate.y)))
+        {
+            matches.push_back(candidate);
+        }
+    }
+
+    // Candidates from neighboring coarse maxima often converge to the same match.
+    std::sort(matches.begin(), matches.end(), byScore);
+    int count = 0;
+    for (auto match : matches)
+    {
+        match.x += bounds.left;
+        match.y += bounds.top;
+
+        bool isOverlapping = false;
+        for (int i = 0; i < count; ++i)
+        {
+            if (std::abs(results[i].x - match.x) * 2 < GetWidth() &&
+                std::abs(results[i].y - match.y) * 2 < GetHeight())
+            {
+                isOverlapping = true;
+                break;
+            }
+        }
+        if (isOverlapping) continue;
+
+        results[count++] = match;
+        if (count == capacity) break;
+    }
+
+    return count;
+}
+
+
+float TemplateMatcher::Score(const Plane& image, const Level& level, int x, int y, double windowSum, double windowSquareSum) const
+{
+    const auto count = static_cast<double>(level.width) * level.height;
+
+    if (level.isUniform)
+    {
+        uint64_t sad = 0;
+        for (int row = 0; row < level.height; ++row)
+        {
+            sad += Kernels::SumOfAbsoluteDifferences(
+                image.pixels + static_cast<size_t>(y + row) * image.pitch + x,
+                level.pixels.data() + static_cast<size_t>(row) * level.width,
+                level.width);
+        }
+        return static_cast<float>(1.0 - sad / (255.0 * count));
+    }
+
+    const auto windowDeviation = windowSquareSum - windowSum * windowSum / count;
+    if (windowDeviation < count) return 0.f;
+
+    uint64_t dot = 0;
+    for (int row = 0; row < level.height; ++row)
+    {
+        dot += Kernels::DotProduct(
+            image.pixels + static_cast<size_t>(y + row) * image.pitch + x,
+            level.pixels.data() + static_cast<size_t>(row) * level.width,
+            level.width);
+    }
+
+    const auto covariance = static_cast<double>(dot) - windowSum * level.sum / count;
+    return static_cast<float>(covariance / std::sqrt(windowDeviation * level.deviation));
+}
+
+
+float TemplateMatcher::Score(const Plane& image, const Level& level, int x, int y) const
+{
+    // Refinement scores only a few positions per level, so their window sums are taken directly.
+    double windowSum = 0.0, windowSquareSum = 0.0;
+    for (int row = 0; row < level.height; ++row)
+    {
+        const auto pixels = image.pixels + static_cast<size_t>(y + row) * image.pitch + x;
+        uint32_t rowSum = 0;
+        for (int i = 0; i < level.width; ++i)
+        {
+            rowSum += pixels[i];
+        }
+        windowSum += rowSum;
+        windowSquareSum += Kernels::DotProduct(pixels, pixels, level.width);
+    }
+    return Score(image, level, x, y, windowSum, windowSquareSum);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+
+// Position of a template found on a monitor (see Monitor::FindTemplate()).
+// The layout is shared with TemplateMatch in Lib.cs.
+struct TemplateMatch
+{
+    int x;       // top-left corner
+    int y;
+    float score; // -1 - 1, where 1 is identical up to brightness and contrast
+};
+
+
+// Finds a template in an 8-bit luma image by normalized cross-correlation.
+//
+// The template and the image are reduced to pyramids of 2x2 averages while the template stays at least
+// kMinTemplateSize on both sides. The coarsest level is searched exhaustively, its local maxima above a
+// threshold loosened per level become candidates, and each candidate is refined level by level in a few
+// pixels around twice its position, so the scores at full resolution are exact.
+// A template of a single color has no correlation with anything, so it is scored by the sum of
+// absolute differences instead (1 - SAD / (255 * pixel count)).
+//
+// The class has no platform dependency so that it can be measured with synthetic desktops anywhere.
+class TemplateMatcher final
+{
+public:
+    struct Rect
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    static constexpr int kMinTemplateSize = 8;
+    static constexpr int kMaxLevelCount = 6;
+    static constexpr int kMaxCandidateCount = 64;
+    static constexpr float kCoarseThresholdMargin = 0.4f;
+
+    // luma is width x height without padding.
+    TemplateMatcher(const uint8_t* luma, int width, int height);
+
+    int GetWidth() const { return levels_[0].width; }
+    int GetHeight() const { return levels_[0].height; }
+
+    // image is width x height without padding. positionRects are where the top-left corner of the template
+    // is tested (right and bottom exclusive), which keeps a search to the changed parts of an image.
+    // Matches are sorted by score, overlap each other by less than half of the template, and
+    // the number written to results is returned.
+    int Find(
+        const uint8_t* image,
+        int width,
+        int height,
+        const Rect* positionRects,
+        size_t positionRectCount,
+        float threshold,
+        TemplateMatch* results,
+        int capacity) const;
+
+private:
+    struct Level
+    {
+        std::vector<uint8_t> pixels;
+        int width = 0;
+        int height = 0;
+        double sum = 0.0;
+        double deviation = 0.0; // sum of squared differences from the mean
+        bool isUniform = false;
+    };
+
+    struct Plane
+    {
+        const uint8_t* pixels;
+        int width;
+        int height;
+        int pitch;
+    };
+
+    float Score(const Plane& image, const Level& level, int x, int y, double windowSum, double windowSquareSum) const;
+    float Score(const Plane& image, const Level& level, int x, int y) const;
+
+    std::vector<Level> levels_;
+};
@@ -0,0 +1,230 @@
+#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Trace.h"
+#include "Debug.h"
+
+
+
+namespace
+{
+
+
+struct TraceEvent
+{
+    const char* name;
+    std::chrono::steady_clock::rep tick;
+    Trace::EventType type;
+};
+
+
+// Written only by its owner thread; Dump() detects the slots overwritten while it is copying.
+struct TraceRing
+{
+    static constexpr UINT64 kCapacity = 8192;
+    TraceEvent events[kCapacity];
+    std::atomic<UINT64> head = { 0 };
+    std::atomic<bool> isAlive = { true };
+    DWORD threadId = 0;
+    std::string threadName;
+};
+
+
+constexpr size_t kMaxRetiredRingCount = 16;
+std::mutex g_ringsMutex;
+std::vector<std::shared_ptr<TraceRing>> g_rings;
+std::atomic<std::chrono::steady_clock::rep> g_enabledTick = { 0 };
+
+
+struct ThreadRing
+{
+    ~ThreadRing()
+    {
+        if (ring) ring->isAlive = false;
+    }
+
+    std::shared_ptr<TraceRing> ring;
+    std::string threadName;
+};
+
+thread_local ThreadRing t_ring;
+
+
+TraceRing* GetThreadRing()
+{
+    if (t_ring.ring) return t_ring.ring.get();
+
+    auto ring = std::make_shared<TraceRing>();
+    ring->threadId = GetCurrentThreadId();
+    ring->threadName = t_ring.threadName;
+
+    {
+        std::lock_guard<std::mutex> lock(g_ringsMutex);
+
+        // Capture threads are recreated on reinitialization, so only recent dead threads are kept.
+        const auto retiredCount = std::count_if(g_rings.begin(), g_rings.end(),
+            [](const std::shared_ptr<TraceRing>& r) { return !r->isAlive; });
+        if (retiredCount >= static_cast<std::ptrdiff_t>(kMaxRetiredRingCount))
+        {
+            const auto it = std::find_if(g_rings.begin(), g_rings.end(),
+                [](const std::shared_ptr<TraceRing>& r) { return !r->isAlive; });
+            g_rings.erase(it);
+        }
+
+        g_rings.push_back(ring);
+    }
+
+    t_ring.ring = ring;
+    return ring.get();
+}
+
+
+void WriteEscaped(std::ofstream& fs, const char* str)
+{
+    for (auto c = str; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\') fs << '\\';
+        fs << *c;
+    }
+}
+
+
+}
+
+
+
+std::atomic<bool> Trace::isEnabled_ = { false };
+
+
+void Trace::Enable()
+{
+    // Events recorded before this point are left in the rings but not dumped.
+    g_enabledTick = std::chrono::steady_clock::now().time_since_epoch().count();
+    isEnabled_ = true;
+}
+
+
+void Trace::Disable()
+{
+    isEnabled_ = false;
+}
+
+
+void Trace::SetThreadName(const std::string& name)
+{
+    // The ring is allocated lazily by the first event, so the name is kept until then.
+    t_ring.threadName = name;
+    if (!t_ring.ring) return;
+
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    t_ring.ring->threadName = name;
+}
+
+
+void Trace::Push(const char* name, EventType type)
+{
+    auto ring = GetThreadRing();
+    const auto head = ring->head.load(std::memory_order_relaxed);
+    auto& ev = ring->events[head % TraceRing::kCapacity];
+    ev.name = name;
+    ev.tick = std::chrono::steady_clock::now().time_since_epoch().count();
+    ev.type = type;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+
+bool Trace::Dump(const std::string& path)
+{
+    UDD_FUNCTION_SCOPE_TIMER
+
+    using namespace std::chrono;
+
+    std::ofstream fs(path, std::ios::trunc);
+    if (!fs.good())
+    {
+        UDD_ERROR("Trace::Dump() => Could not open ", path.c_str(), ".");
+        return false;
+    }
+
+    const auto baseTick = g_enabledTick.load();
+    const auto toMicroseconds = [baseTick](steady_clock::rep tick)
+    {
+        return duration<double, std::micro>(steady_clock::duration(tick - baseTick)).count();
+    };
+
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+
+    fs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool isFirst = true;
+    char buf[128];
+
+    std::vector<TraceEvent> events;
+    std::vector<const TraceEvent*> stack;
+    for (const auto& ring : g_rings)
+    {
+        const auto head = ring->head.load(std::memory_order_acquire);
+        const auto begin = head > TraceRing::kCapacity ? head - TraceRing::kCapacity : 0;
+        events.clear();
+        for (auto i = begin; i < head; ++i)
+        {
+            events.push_back(ring->events[i % TraceRing::kCapacity]);
+        }
+
+        // The owner may have wrapped around while copying; drop the slots it could have touched.
+        const auto headAfter = ring->head.load(std::memory_order_acquire);
+        const auto validBegin = headAfter >= TraceRing::kCapacity ? headAfter - TraceRing::kCapacity + 1 : 0;
+        const auto skipCount = static_cast<size_t>(std::min(std::max(validBegin, begin) - begin, head - begin));
+
+        if (!isFirst) fs << ",";
+        isFirst = false;
+        fs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId << ",\"args\":{\"name\":\"";
+        WriteEscaped(fs, ring->threadName.empty() ? "Thread" : ring->threadName.c_str());
+        fs << "\"}}";
+
+        // Begin / end pairs are merged into complete events; an end whose begin is lost is skipped.
+        stack.clear();
+        for (size_t i = skipCount; i < events.size(); ++i)
+        {
+            const auto& ev = events[i];
+            if (ev.tick < baseTick) continue;
+
+            if (ev.type == EventType::Begin)
+            {
+                stack.push_back(&ev);
+                continue;
+            }
+
+            if (stack.empty() || stack.back()->name != ev.name) continue;
+
+            const auto& beginEvent = *stack.back();
+            stack.pop_back();
+            fs << ",{\"name\":\"";
+            WriteEscaped(fs, beginEvent.name);
+            snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+                static_cast<unsigned long>(ring->threadId),
+                toMicroseconds(beginEvent.tick),
+                toMicroseconds(ev.tick) - toMicroseconds(beginEvent.tick));
+            fs << buf;
+        }
+
+        for (const auto beginEvent : stack)
+        {
+            fs << ",{\"name\":\"";
+            WriteEscaped(fs, beginEvent->name);
+            snprintf(buf, sizeof(buf), "\",\"ph\":\"B\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f}",
+                static_cast<unsigned long>(ring->threadId),
+                toMicroseconds(beginEvent->tick));
+            fs << buf;
+        }
+    }
+
+    fs << "]}" << std::endl;
+
+    return fs.good();
+}
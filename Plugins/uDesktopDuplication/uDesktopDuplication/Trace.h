@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+
+// Low-overhead timeline tracing.
+// Each thread writes begin/end events into its own ring buffer without locking, and the rings
+// are dumped as Chrome / Perfetto trace JSON (chrome://tracing or ui.perfetto.dev).
+// Probe names must be string literals (e.g. __FUNCTION__) since only their pointers are stored.
+class Trace
+{
+public:
+    enum class EventType : unsigned char
+    {
+        Begin = 0,
+        End = 1,
+    };
+
+    static void Enable();
+    static void Disable();
+    static bool IsEnabled() { return isEnabled_.load(std::memory_order_relaxed); }
+    static void SetThreadName(const std::string& name);
+    static void Push(const char* name, EventType type);
+    static bool Dump(const std::string& path);
+
+private:
+    static std::atomic<bool> isEnabled_;
+};
+
+
+class TraceScope final
+{
+public:
+    explicit TraceScope(const char* name)
+        : name_(Trace::IsEnabled() ? name : nullptr)
+    {
+        if (name_) Trace::Push(name_, Trace::EventType::Begin);
+    }
+
+    ~TraceScope()
+    {
+        if (name_) Trace::Push(name_, Trace::EventType::End);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* const name_;
+};
+
+
+#define UDD_TRACE_CONCAT_IMPL(A, B) A##B
+#define UDD_TRACE_CONCAT(A, B) UDD_TRACE_CONCAT_IMPL(A, B)
+#define UDD_TRACE_SCOPE(Name) \
+    TraceScope UDD_TRACE_CONCAT(_trace_, __LINE__)(Name);
@@ -0,0 +1,250 @@
+#include <algorithm>
+
+#include "WatchRegion.h"
+
+
+
+constexpr int WatchRegionIndex::kDefaultCellSize;
+
+
+
+WatchRegionIndex::WatchRegionIndex(int cellSize)
+    : cellSize_(cellSize > 0 ? cellSize : kDefaultCellSize)
+{
+}
+
+
+void WatchRegionIndex::SetBounds(int width, int height)
+{
+    width = (std::max)(width, 0);
+    height = (std::max)(height, 0);
+    if (width == width_ && height == height_) return;
+
+    width_ = width;
+    height_ = height;
+    columnCount_ = (width_ + cellSize_ - 1) / cellSize_;
+    rowCount_ = (height_ + cellSize_ - 1) / cellSize_;
+
+    cells_.clear();
+    cells_.resize(static_cast<size_t>(columnCount_) * rowCount_);
+
+    // Regions keep their registered rects, and the ones which are outside of the new size
+    // are simply not binned until the size grows again.
+    for (int i = 0; i < static_cast<int>(entries_.size()); ++i)
+    {
+        if (entries_[i].isAlive) Bin(i);
+    }
+}
+
+
+bool WatchRegionIndex::Add(int regionId, const Rect& rect)
+{
+    Rect clipped = rect;
+    if (!Clip(&clipped)) return false;
+
+    Remove(regionId);
+
+    int index;
+    if (!freeEntries_.empty())
+    {
+        index = freeEntries_.back();
+        freeEntries_.pop_back();
+    }
+    else
+    {
+        index = static_cast<int>(entries_.size());
+        entries_.emplace_back();
+    }
+
+    auto& entry = entries_[index];
+    entry.regionId = regionId;
+    entry.rect = rect;
+    entry.stamp = 0;
+    entry.isAlive = true;
+    entryIndices_[regionId] = index;
+    Bin(index);
+
+    return true;
+}
+
+
+bool WatchRegionIndex::Remove(int regionId)
+{
+    const auto it = entryIndices_.find(regionId);
+    if (it == entryIndices_.end()) return false;
+
+    const auto index = it->second;
+    Unbin(index);
+    entries_[index].isAlive = false;
+    freeEntries_.push_back(index);
+    entryIndices_.erase(it);
+
+    return true;
+}
+
+
+void WatchRegionIndex::Clear()
+{
+    for (auto& cell : cells_)
+    {
+        cell.clear();
+    }
+    entries_.clear();
+    freeEntries_.clear();
+    entryIndices_.clear();
+    touchedEntries_.clear();
+}
+
+
+int WatchRegionIndex::GetCount() const
+{
+    return static_cast<int>(entryIndices_.size());
+}
+
+
+void WatchRegionIndex::BeginFrame()
+{
+    touchedEntries_.clear();
+
+    // Stamps tell whether an entry was already touched in this frame without clearing a flag
+    // on every entry. 0 is never used so that new entries are untouched.
+    if (++stamp_ == 0)
+    {
+        for (auto& entry : entries_)
+        {
+            entry.stamp = 0;
+        }
+        stamp_ = 1;
+    }
+}
+
+
+void WatchRegionIndex::AddChange(const Rect& rect)
+{
+    Rect clipped = rect;
+    if (!Clip(&clipped)) return;
+
+    int column0, row0, column1, row1;
+    GetCellRange(clipped, &column0, &row0, &column1, &row1);
+
+    // A rect covering more cells than there are entries (e.g. the full update of the first frame)
+    // is cheaper to test against every entry directly.
+    const auto cellCount = static_cast<size_t>(column1 - column0 + 1) * (row1 - row0 + 1);
+    if (cellCount > entries_.size())
+    {
+        for (int i = 0; i < static_cast<int>(entries_.size()); ++i)
+        {
+            if (entries_[i].isAlive) Touch(i, clipped);
+        }
+        return;
+    }
+
+    for (int row = row0; row <= row1; ++row)
+    {
+        for (int column = column0; column <= column1; ++column)
+        {
+            for (const auto index : cells_[row * columnCount_ + column])
+            {
+                Touch(index, clipped);
+            }
+        }
+    }
+}
+
+
+void WatchRegionIndex::EndFrame(std::vector<Hit>* hits)
+{
+    for (const auto index : touchedEntries_)
+    {
+        const auto& entry = entries_[index];
+        hits->push_back({ entry.regionId, entry.changedRect });
+    }
+    touchedEntries_.clear();
+}
+
+
+bool WatchRegionIndex::Clip(Rect* rect) const
+{
+    rect->left   = (std::max)(rect->left, 0);
+    rect->top    = (std::max)(rect->top, 0);
+    rect->right  = (std::min)(rect->right, width_);
+    rect->bottom = (std::min)(rect->bottom, height_);
+    return rect->left < rect->right && rect->top < rect->bottom;
+}
+
+
+void WatchRegionIndex::GetCellRange(const Rect& rect, int* column0, int* row0, int* column1, int* row1) const
+{
+    // rect must be clipped, so right and bottom are exclusive and inside the bounds.
+    *column0 = rect.left / cellSize_;
+    *row0 = rect.top / cellSize_;
+    *column1 = (rect.right - 1) / cellSize_;
+    *row1 = (rect.bottom - 1) / cellSize_;
+}
+
+
+void WatchRegionIndex::Bin(int entryIndex)
+{
+    Rect clipped = entries_[entryIndex].rect;
+    if (!Clip(&clipped)) return;
+
+    int column0, row0, column1, row1;
+    GetCellRange(clipped, &column0, &row0, &column1, &row1);
+    for (int row = row0; row <= row1; ++row)
+    {
+        for (int column = column0; column <= column1; ++column)
+        {
+            cells_[row * columnCount_ + column].push_back(entryIndex);
+        }
+    }
+}
+
+
+void WatchRegionIndex::Unbin(int entryIndex)
+{
+    Rect clipped = entries_[entryIndex].rect;
+    if (!Clip(&clipped)) return;
+
+    int column0, row0, column1, row1;
+    GetCellRange(clipped, &column0, &row0, &column1, &row1);
+    for (int row = row0; row <= row1; ++row)
+    {
+        for (int column = column0; column <= column1; ++column)
+        {
+            auto& cell = cells_[row * columnCount_ + column];
+            const auto it = std::find(cell.begin(), cell.end(), entryIndex);
+            if (it == cell.end()) continue;
+            *it = cell.back();
+            cell.pop_back();
+        }
+    }
+}
+
+
+void WatchRegionIndex::Touch(int entryIndex, const Rect& rect)
+{
+    auto& entry = entries_[entryIndex];
+
+    const Rect overlap =
+    {
+        (std::max)(entry.rect.left,   rect.left),
+        (std::max)(entry.rect.top,    rect.top),
+        (std::min)(entry.rect.right,  rect.right),
+        (std::min)(entry.rect.bottom, rect.bottom),
+    };
+    if (overlap.left >= overlap.right || overlap.top >= overlap.bottom) return;
+
+    if (entry.stamp != stamp_)
+    {
+        entry.stamp = stamp_;
+        entry.changedRect = overlap;
+        touchedEntries_.push_back(entryIndex);
+        return;
+    }
+
+    auto& changed = entry.changedRect;
+    changed.left   = (std::min)(changed.left,   overlap.left);
+    changed.top    = (std::min)(changed.top,    overlap.top);
+    changed.right  = (std::max)(changed.right,  overlap.right);
+    changed.bottom = (std::max)(changed.bottom, overlap.bottom);
+}
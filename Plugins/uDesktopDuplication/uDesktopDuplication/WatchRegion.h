@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+
+// Spatial index of watch regions (see Monitor::RegisterWatchRegion()).
+//
+// The desktop image is split into square cells and every cell lists the regions overlapping it,
+// so a changed rect only tests the regions in the cells it covers instead of all of them.
+// Between BeginFrame() and EndFrame() the rects of a frame are added one by one, and each
+// touched region is reported once with the bounds of its changed part.
+//
+// The index is not thread safe and has no platform dependency.
+class WatchRegionIndex final
+{
+public:
+    struct Rect
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    struct Hit
+    {
+        int regionId;
+        Rect changedRect; // part of the region covered by the rects of the frame (bounds)
+    };
+
+    static constexpr int kDefaultCellSize = 64;
+
+    explicit WatchRegionIndex(int cellSize = kDefaultCellSize);
+
+    // Sets the size of the image; regions are clipped to it and binned again.
+    void SetBounds(int width, int height);
+
+    // Adds or replaces a region. Returns false if nothing of it is inside the bounds.
+    bool Add(int regionId, const Rect& rect);
+    bool Remove(int regionId);
+    void Clear();
+    int GetCount() const;
+
+    void BeginFrame();
+    void AddChange(const Rect& rect);
+    void EndFrame(std::vector<Hit>* hits);
+
+private:
+    struct Entry
+    {
+        int regionId = 0;
+        Rect rect = {};
+        Rect changedRect = {};
+        uint32_t stamp = 0;
+        bool isAlive = false;
+    };
+
+    bool Clip(Rect* rect) const;
+    void GetCellRange(const Rect& rect, int* column0, int* row0, int* column1, int* row1) const;
+    void Bin(int entryIndex);
+    void Unbin(int entryIndex);
+    void Touch(int entryIndex, const Rect& rect);
+
+    const int cellSize_;
+    int width_ = 0;
+    int height_ = 0;
+    int columnCount_ = 0;
+    int rowCount_ = 0;
+
+    std::vector<Entry> entries_;
+    std::vector<int> freeEntries_;
+    std::unordered_map<int, int> entryIndices_;
+    std::vector<std::vector<int>> cells_;
+
+    uint32_t stamp_ = 0;
+    std::vector<int> touchedEntries_;
+};
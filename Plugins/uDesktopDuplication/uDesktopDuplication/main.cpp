@@ -3,7 +3,6 @@
 #include <vector>
 #include <string>
 #include <memory>
-#include <queue>
 
 #include "IUnityInterface.h"
 #include "IUnityGraphics.h"
@@ -15,6 +14,10 @@
 #include "Duplicator.h"
 #include "Cursor.h"
 #include "MonitorManager.h"
+#include "Snapshot.h"
+#include "Composite.h"
+#include "ReplayRing.h"
+#include "Event.h"
 
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "Shcore.lib")
@@ -22,7 +25,6 @@
 
 IUnityInterfaces* g_unity = nullptr;
 std::unique_ptr<MonitorManager> g_manager;
-std::queue<Message> g_messages;
 
 
 extern "C"
@@ -53,8 +55,7 @@ extern "C"
             g_manager.reset();
         }
 
-        std::queue<Message> empty;
-        g_messages.swap(empty);
+        EventQueue::Clear();
 
         Debug::Finalize();
     }
@@ -92,6 +93,13 @@ extern "C"
 
     void UNITY_INTERFACE_API OnRenderEvent(int id)
     {
+        static thread_local bool isTraceThreadNamed = false;
+        if (!isTraceThreadNamed)
+        {
+            Trace::SetThreadName("Unity Render Thread");
+            isTraceThreadNamed = true;
+        }
+
         if (!g_manager) return;
         if (auto monitor = g_manager->GetMonitor(id))
         {
@@ -116,13 +124,21 @@ extern "C"
         g_manager->Update();
     }
 
-    UNITY_INTERFACE_EXPORT Message UNITY_INTERFACE_API PopMessage()
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API DrainEvents(Event* buffer, int capacity)
     {
-        if (g_messages.empty()) return Message::None;
+        return EventQueue::Drain(buffer, capacity);
+    }
 
-        const auto message = g_messages.front();
-        g_messages.pop();
-        return message;
+    // Kept for scripts written before DrainEvents(). Messages share the event queue, so the
+    // other events taken out of it here are discarded.
+    UNITY_INTERFACE_EXPORT Message UNITY_INTERFACE_API PopMessage()
+    {
+        Event event;
+        while (EventQueue::Drain(&event, 1) == 1)
+        {
+            if (event.type == EventType::Message) return static_cast<Message>(event.value);
+        }
+        return Message::None;
     }
 
     UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetDebugMode(Debug::Mode mode)
@@ -130,6 +146,11 @@ extern "C"
         Debug::SetMode(mode);
     }
 
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetDebugLevel(Debug::Level level)
+    {
+        Debug::SetLevel(level);
+    }
+
     UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetLogFunc(Debug::DebugLogFuncPtr func)
     {
         Debug::SetLogFunc(func);
@@ -179,6 +200,33 @@ extern "C"
         }
     }
 
+    // Fills up to capacity monitors and returns the number of monitors.
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetMonitorInfos(MonitorInfo* infos, int capacity)
+    {
+        if (!g_manager) return 0;
+        const auto count = g_manager->GetMonitorCount();
+        if (!infos) return count;
+        for (int id = 0; id < count && id < capacity; ++id)
+        {
+            if (auto monitor = g_manager->GetMonitor(id))
+            {
+                monitor->GetInfo(&infos[id]);
+            }
+        }
+        return count;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetFrameInfo(int id, FrameInfo* info)
+    {
+        if (!g_manager || !info) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->GetFrameInfo(info);
+            return true;
+        }
+        return false;
+    }
+
     UNITY_INTERFACE_EXPORT DuplicatorState UNITY_INTERFACE_API GetState(int id)
     {
         if (!g_manager) return DuplicatorState::NotSet;
@@ -362,6 +410,12 @@ extern "C"
         return g_manager->GetCursor()->GetHotSpotY();
     }
 
+    UNITY_INTERFACE_EXPORT UINT UNITY_INTERFACE_API GetCursorSequence()
+    {
+        if (!g_manager) return 0;
+        return g_manager->GetCursor()->GetSequence();
+    }
+
     UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API GetCursorTexture(ID3D11Texture2D* texture)
     {
         if (!g_manager) return;
@@ -428,6 +482,27 @@ extern "C"
         return nullptr;
     }
 
+    // Copies up to capacity rects of the latest frame under the capture lock and returns the total count.
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API CopyMoveRects(int id, DXGI_OUTDUPL_MOVE_RECT* output, int capacity, UINT64* frameSeq)
+    {
+        if (!g_manager) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->CopyMoveRects(output, capacity, frameSeq);
+        }
+        return 0;
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API CopyDirtyRects(int id, RECT* output, int capacity, UINT64* frameSeq)
+    {
+        if (!g_manager) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->CopyDirtyRects(output, capacity, frameSeq);
+        }
+        return 0;
+    }
+
     UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetPixels(int id, BYTE* output, int x, int y, int width, int height)
     {
         if (!g_manager) return false;
@@ -438,6 +513,28 @@ extern "C"
         return false;
     }
 
+    // Finds a bottom-up RGBA32 template in the GetPixels() buffer. searchRect can be null for the whole monitor.
+    // frameId (can be null) limits the search to what changed after it and receives the frame searched.
+    // Returns the number of matches written to results, best first.
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API FindTemplate(
+        int id,
+        const BYTE* pixels,
+        int width,
+        int height,
+        const RECT* searchRect,
+        float threshold,
+        UINT* frameId,
+        TemplateMatch* results,
+        int capacity)
+    {
+        if (!g_manager || !pixels || !results) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->FindTemplate(pixels, width, height, searchRect, threshold, frameId, results, capacity);
+        }
+        return 0;
+    }
+
     UNITY_INTERFACE_EXPORT BYTE* UNITY_INTERFACE_API GetBuffer(int id)
     {
         if (!g_manager) return nullptr;
@@ -448,6 +545,17 @@ extern "C"
         return nullptr;
     }
 
+    // Copies up to size bytes of the GetPixels() buffer and returns its whole size.
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API CopyBuffer(int id, BYTE* output, int size)
+    {
+        if (!g_manager) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->CopyBuffer(output, size);
+        }
+        return 0;
+    }
+
     UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API HasBeenUpdated(int id)
     {
         if (!g_manager) return nullptr;
@@ -458,6 +566,74 @@ extern "C"
         return false;
     }
 
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API SetCropRect(int id, int x, int y, int width, int height)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->SetCropRect(x, y, width, height);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API ClearCropRect(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->ClearCropRect();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetCropRect(int id, RECT* rect)
+    {
+        if (!g_manager || !rect) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetCropRect(rect);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API RegisterWatchRegion(int id, int regionId, int x, int y, int width, int height)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->RegisterWatchRegion(regionId, x, y, width, height);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API UnregisterWatchRegion(int id, int regionId)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->UnregisterWatchRegion(regionId);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API ClearWatchRegions(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->ClearWatchRegions();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetWatchRegionCount(int id)
+    {
+        if (!g_manager) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetWatchRegionCount();
+        }
+        return 0;
+    }
+
     UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API UseGetPixels(int id, bool use)
     {
         if (!g_manager) return;
@@ -472,4 +648,586 @@ extern "C"
         if (!g_manager) return;
         g_manager->SetFrameRate(frameRate);
     }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetTargetFrameRate(int id, UINT frameRate)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->GetQosAccount().SetTargetFrameRate(frameRate);
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT UINT UNITY_INTERFACE_API GetTargetFrameRate(int id)
+    {
+        if (!g_manager) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetQosAccount().GetTargetFrameRate();
+        }
+        return 0;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetQosPriority(int id, QosPriority priority)
+    {
+        if (!g_manager) return;
+        if (priority < QosPriority::Low || priority >= QosPriority::Count) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->GetQosAccount().SetPriority(priority);
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT QosPriority UNITY_INTERFACE_API GetQosPriority(int id)
+    {
+        if (!g_manager) return QosPriority::Normal;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetQosAccount().GetPriority();
+        }
+        return QosPriority::Normal;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetQosInfo(int id, QosInfo* info)
+    {
+        if (!g_manager || !info) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->GetQosInfo(info);
+            return true;
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetQosPixelBudget(INT64 pixelsPerSecond)
+    {
+        QosBudget::SetPixelBudget(pixelsPerSecond);
+    }
+
+    UNITY_INTERFACE_EXPORT INT64 UNITY_INTERFACE_API GetQosPixelBudget()
+    {
+        return QosBudget::GetPixelBudget();
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetQosCpuBudget(float msPerSecond)
+    {
+        QosBudget::SetCpuBudget(msPerSecond);
+    }
+
+    UNITY_INTERFACE_EXPORT float UNITY_INTERFACE_API GetQosCpuBudget()
+    {
+        return QosBudget::GetCpuBudget();
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API TakeSnapshot(const char* path)
+    {
+        if (!g_manager) return false;
+        return g_manager->TakeSnapshot(path ? path : "");
+    }
+
+    UNITY_INTERFACE_EXPORT SnapshotState UNITY_INTERFACE_API GetSnapshotState()
+    {
+        if (!g_manager) return SnapshotState::None;
+        return g_manager->GetSnapshotState();
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetSnapshotDataSize()
+    {
+        if (!g_manager) return 0;
+        const auto snapshot = g_manager->GetSnapshot();
+        if (!snapshot || snapshot->GetState() != SnapshotState::Completed) return 0;
+        return static_cast<int>(snapshot->GetData().size());
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetSnapshotData(BYTE* buffer, int size)
+    {
+        if (!g_manager || !buffer) return false;
+        const auto snapshot = g_manager->GetSnapshot();
+        if (!snapshot || snapshot->GetState() != SnapshotState::Completed) return false;
+        const auto& data = snapshot->GetData();
+        if (size < static_cast<int>(data.size())) return false;
+        memcpy(buffer, data.data(), data.size());
+        return true;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API EnableCompositeBuffer()
+    {
+        if (!g_manager) return;
+        g_manager->EnableComposite();
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API DisableCompositeBuffer()
+    {
+        if (!g_manager) return;
+        g_manager->DisableComposite();
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsCompositeBufferEnabled()
+    {
+        if (!g_manager) return false;
+        return g_manager->IsCompositeEnabled();
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetCompositeBufferLeft()
+    {
+        if (!g_manager) return 0;
+        const auto composite = g_manager->GetComposite();
+        return composite ? composite->GetLeft() : 0;
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetCompositeBufferTop()
+    {
+        if (!g_manager) return 0;
+        const auto composite = g_manager->GetComposite();
+        return composite ? composite->GetTop() : 0;
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetCompositeBufferWidth()
+    {
+        if (!g_manager) return 0;
+        const auto composite = g_manager->GetComposite();
+        return composite ? static_cast<int>(composite->GetWidth()) : 0;
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetCompositeBufferHeight()
+    {
+        if (!g_manager) return 0;
+        const auto composite = g_manager->GetComposite();
+        return composite ? static_cast<int>(composite->GetHeight()) : 0;
+    }
+
+    UNITY_INTERFACE_EXPORT UINT64 UNITY_INTERFACE_API GetCompositeBufferUpdateCount()
+    {
+        if (!g_manager) return 0;
+        const auto composite = g_manager->GetComposite();
+        return composite ? composite->GetUpdateCount() : 0;
+    }
+
+    UNITY_INTERFACE_EXPORT BYTE* UNITY_INTERFACE_API LockCompositeBuffer(int* pitch)
+    {
+        if (!g_manager) return nullptr;
+        UINT bufferPitch = 0;
+        const auto buffer = g_manager->LockComposite(&bufferPitch);
+        if (pitch) *pitch = static_cast<int>(bufferPitch);
+        return buffer;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API UnlockCompositeBuffer()
+    {
+        if (!g_manager) return;
+        g_manager->UnlockComposite();
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetLatencyStats(int id, LatencyStage stage, LatencyStats* stats)
+    {
+        if (!g_manager || !stats) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            *stats = monitor->GetLatencyStats(stage);
+            return true;
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API ResetLatencyStats(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->ResetLatencyStats();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetLatencyProbeEnabled(int id, bool enabled)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->GetLatencyProbe().SetEnabled(enabled);
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsLatencyProbeEnabled(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetLatencyProbe().IsEnabled();
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetPhaseLockEnabled(int id, bool enabled)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->SetPhaseLockEnabled(enabled);
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsPhaseLockEnabled(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->IsPhaseLockEnabled();
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetPhaseLockInfo(int id, PhaseLockInfo* info)
+    {
+        if (!g_manager || !info) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->GetPhaseLockInfo(info);
+            return true;
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetMemoryStats(int id, MemoryStats* stats)
+    {
+        if (!g_manager || !stats) return false;
+        return g_manager->GetMemoryStats(id, stats);
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetMemoryBudget(INT64 bytes)
+    {
+        MemoryBudget::SetBudget(bytes);
+    }
+
+    UNITY_INTERFACE_EXPORT INT64 UNITY_INTERFACE_API GetMemoryBudget()
+    {
+        return MemoryBudget::GetBudget();
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetReadbackIdleFrameCount(int count)
+    {
+        MemoryBudget::SetReadbackIdleFrameCount(count);
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetReadbackIdleFrameCount()
+    {
+        return MemoryBudget::GetReadbackIdleFrameCount();
+    }
+
+    UNITY_INTERFACE_EXPORT INT64 UNITY_INTERFACE_API ReleaseReadback(int id)
+    {
+        if (!g_manager) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->ReleaseReadback("requested");
+        }
+        return 0;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API EnableTrace()
+    {
+        Trace::Enable();
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API DisableTrace()
+    {
+        Trace::Disable();
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsTraceEnabled()
+    {
+        return Trace::IsEnabled();
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API DumpTrace(const char* path)
+    {
+        if (!path) return false;
+        return Trace::Dump(path);
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API StartRecording(int id, const char* path)
+    {
+        if (!g_manager || !path) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->StartRecording(path);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API StopRecording(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->StopRecording();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsRecording(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->IsRecording();
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API StartReplay(int id, const char* path, ReplaySpeed speed, bool loop)
+    {
+        if (!g_manager || !path) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->StartReplay(path, speed, loop);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API StopReplay(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->StopReplay();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsReplaying(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->IsReplaying();
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API EnableSharedMemoryExport(int id, int slotCount)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->EnableSharedMemoryExport(slotCount);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API DisableSharedMemoryExport(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->DisableSharedMemoryExport();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsSharedMemoryExportEnabled(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->IsSharedMemoryExportEnabled();
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API StartStreaming(int id, int port)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->StartStreaming(port);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API StopStreaming(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->StopStreaming();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsStreaming(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->IsStreaming();
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetStreamingClientCount(int id)
+    {
+        if (!g_manager) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetStreamingClientCount();
+        }
+        return 0;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API EnableRegionStats(int id, int cellSize)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->EnableRegionStats(cellSize);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API DisableRegionStats(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->DisableRegionStats();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsRegionStatsEnabled(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->IsRegionStatsEnabled();
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API SetRegionStatsEdgeZones(int id, int horizontalCount, int verticalCount, int depth)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->SetRegionStatsEdgeZones(horizontalCount, verticalCount, depth);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetRegionStatsRects(int id, const RECT* rects, int count)
+    {
+        if (!g_manager || (!rects && count > 0)) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->SetRegionStatsRects(rects, count);
+        }
+    }
+
+    // Means of the edge zones and the regions, and optionally the 256 bin luma histogram, in one call per frame.
+    // Returns the number of means available, which can be more than capacity.
+    UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetRegionStats(int id, RegionStatsInfo* info, RegionMean* means, int capacity, UINT* histogram)
+    {
+        if (!g_manager || !info || (!means && capacity > 0)) return 0;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetRegionStats(info, means, capacity, histogram);
+        }
+        return 0;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API EnableCursorRegion(int id, int width, int height)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->EnableCursorRegion(width, height);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API DisableCursorRegion(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->DisableCursorRegion();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsCursorRegionEnabled(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->IsCursorRegionEnabled();
+        }
+        return false;
+    }
+
+    // Writes the last region around the cursor as bottom-up RGBA32 when capacity (in pixels) is enough.
+    // info is filled in any case, so output can be null to get the size first.
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetCursorRegion(int id, CursorRegionInfo* info, BYTE* output, int capacity)
+    {
+        if (!g_manager || !info) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetCursorRegion(info, output, capacity);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API EnableReplayRing(int id, INT64 maxBytes, float durationSec, float keyFrameIntervalSec)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->EnableReplayRing(maxBytes, durationSec, keyFrameIntervalSec);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API DisableReplayRing(int id)
+    {
+        if (!g_manager) return;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            monitor->DisableReplayRing();
+        }
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API IsReplayRingEnabled(int id)
+    {
+        if (!g_manager) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->IsReplayRingEnabled();
+        }
+        return false;
+    }
+
+    // Starts writing the frames kept in the ring on a background thread; poll GetReplayExportState() for the result.
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API ExportReplayRing(int id, const char* path, ReplayExportFormat format)
+    {
+        if (!g_manager || !path) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->ExportReplayRing(path, format);
+        }
+        return false;
+    }
+
+    UNITY_INTERFACE_EXPORT ReplayExportState UNITY_INTERFACE_API GetReplayExportState(int id)
+    {
+        if (!g_manager) return ReplayExportState::None;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetReplayExportState();
+        }
+        return ReplayExportState::None;
+    }
+
+    UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API GetReplayRingInfo(int id, ReplayRingInfo* info)
+    {
+        if (!g_manager || !info) return false;
+        if (auto monitor = g_manager->GetMonitor(id))
+        {
+            return monitor->GetReplayRingInfo(info);
+        }
+        return false;
+    }
 }
\ No newline at end of file